@@ -221,3 +221,10 @@ esp_err_t aws_mqtt_publish(const char *topic, const char *data, int len, int qos
     if (msg_id < 0) return ESP_FAIL;
     return ESP_OK;
 }
+
+size_t aws_mqtt_outbox_size(void)
+{
+    if (!s_client) return 0;
+    int size = esp_mqtt_client_get_outbox_size(s_client);
+    return size > 0 ? (size_t)size : 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <esp_err.h>
 
 // AWS IoT Core MQTT (mTLS) helper. Provides Device Shadow and Jobs handling stubs.
@@ -18,3 +19,7 @@ esp_err_t aws_handle_job(const char *job_id, const char *job_doc);
 // Generic MQTT publish helper (requires aws_mqtt_connect first).
 // qos: 0 or 1. Returns ESP_OK if queued.
 esp_err_t aws_mqtt_publish(const char *topic, const char *data, int len, int qos);
+
+// Bytes in the MQTT outbox: published and not yet acknowledged (QoS 1) or not yet sent.
+// 0 before aws_mqtt_connect().
+size_t aws_mqtt_outbox_size(void);
@@ -11,11 +11,15 @@
 #include "esp_gap_ble_api.h"
 #include "esp_gatt_common_api.h"
 #include "esp_task_wdt.h"
+#include "esp_attr.h"
 #include "crypto.h"
 #include "storage.h"
+#include "control.h"
+#include "telemetry.h"
 #include "cJSON.h"
 #include "ipc.h"
 #include "sdkconfig.h"
+#include "ble_replay.h"
 
 static const char *TAG = "ble";
 
@@ -72,50 +76,40 @@ static char s_ssid[32], s_psk[64], s_tz[64];
 // Secure session state
 static uint8_t s_session_key[32];
 static bool s_session_ready = false;
-static uint32_t s_peer_counter = 0;       // last accepted counter
-static uint64_t s_peer_window = 0;        // 64-bit sliding window bitmask
-static const char *STO_KEY_COUNTER = "ble_peer_counter";
-static const char *STO_KEY_WINDOW  = "ble_peer_window";
 
-static void replay_state_load(void) {
-    uint32_t c = 0; size_t len = sizeof(c);
-    if (storage_load_config(STO_KEY_COUNTER, &c, &len) == ESP_OK && len == sizeof(c)) {
-        s_peer_counter = c;
-    }
-    uint64_t w = 0; len = sizeof(w);
-    if (storage_load_config(STO_KEY_WINDOW, &w, &len) == ESP_OK && len == sizeof(w)) {
-        s_peer_window = w;
-    }
+// Replay window. RTC memory survives soft resets and costs nothing to update; after power
+// loss it is rebuilt from the counter mark in NVS, reserved once per CONFIG_BLE_REPLAY_RESERVE
+// messages (see ble_replay.h).
+#define STO_KEY_REPLAY_MARK "ble_ctr_mark"
+#define REPLAY_RTC_MAGIC    0x52504C59  // "RPLY"
+static RTC_NOINIT_ATTR struct {
+    uint32_t magic;
+    ble_replay_t state;
+} s_rtc_replay;
+
+static esp_err_t replay_persist(uint32_t mark, void *arg) {
+    esp_err_t err = storage_save_uint32(STO_KEY_REPLAY_MARK, mark);
+    if (err != ESP_OK) ESP_LOGE(TAG, "replay: cannot reserve counters: %s", esp_err_to_name(err));
+    return err;
 }
 
-static void replay_state_save(void) {
-    storage_save_config(STO_KEY_COUNTER, &s_peer_counter, sizeof(s_peer_counter));
-    storage_save_config(STO_KEY_WINDOW, &s_peer_window, sizeof(s_peer_window));
+static void replay_state_load(void) {
+    if (s_rtc_replay.magic == REPLAY_RTC_MAGIC) return; // soft reset: window intact
+    uint32_t mark = 0;
+    esp_err_t err = storage_load_uint32(STO_KEY_REPLAY_MARK, &mark);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        // Unknown mark: accept nothing until a new session resets the window
+        ESP_LOGE(TAG, "replay: cannot read counter mark: %s", esp_err_to_name(err));
+        mark = UINT32_MAX;
+    }
+    ble_replay_restore(&s_rtc_replay.state, mark);
+    s_rtc_replay.magic = REPLAY_RTC_MAGIC;
 }
 
 // Returns true if counter is new within window; updates window
 static bool replay_accept_and_update(uint32_t ctr) {
     if (!s_session_ready) return false;
-    if (ctr > s_peer_counter) {
-        uint32_t delta = ctr - s_peer_counter;
-        if (delta >= 64) {
-            s_peer_window = 1ULL; // only latest bit set
-        } else {
-            s_peer_window <<= delta;
-            s_peer_window |= 1ULL;
-        }
-        s_peer_counter = ctr;
-        replay_state_save();
-        return true;
-    }
-    // ctr <= s_peer_counter: check within window
-    uint32_t back = s_peer_counter - ctr;
-    if (back >= 64) return false; // too old
-    uint64_t mask = (1ULL << back);
-    if (s_peer_window & mask) return false; // already seen
-    s_peer_window |= mask;
-    replay_state_save();
-    return true;
+    return ble_replay_accept(&s_rtc_replay.state, ctr, CONFIG_BLE_REPLAY_RESERVE, replay_persist, NULL);
 }
 
 // Handle handshake JSON on control characteristic when session not ready
@@ -152,9 +146,10 @@ static bool handle_handshake(const uint8_t *buf, size_t len) {
                                                (const uint8_t*)pop->valuestring, strlen(pop->valuestring),
                                                s_session_key, sizeof(s_session_key)) == 0) {
                             s_session_ready = true;
-                            s_peer_counter = 0; s_peer_window = 0; replay_state_save();
+                            ble_replay_reset(&s_rtc_replay.state);
                             ok = true;
                             ESP_LOGI(TAG, "BLE secure session established");
+                            telemetry_audit_event(ACTOR_BLE, TELEMETRY_AUDIT_BLE_SESSION, 0, 0, 0);
                         }
                     }
                     crypto_ecdh_free(ctx);
@@ -166,32 +161,42 @@ static bool handle_handshake(const uint8_t *buf, size_t len) {
     return ok;
 }
 
+// Control message refused: audit record with the reason
+static void audit_reject(uint16_t reason) {
+    telemetry_audit_event(ACTOR_BLE, TELEMETRY_AUDIT_BLE_REJECT, reason, 0, 0);
+}
+
 // Decrypt and apply control message; format: {"ctr":N,"ramp_ms":ms,"light":p,"pump":p}
 static void handle_encrypted_control(const uint8_t *data, size_t len) {
-    if (!s_session_ready || len < (12+16)) { ESP_LOGW(TAG, "control: no session or too short"); return; }
+    if (!s_session_ready || len < (12+16)) {
+        ESP_LOGW(TAG, "control: no session or too short");
+        audit_reject(s_session_ready ? TELEMETRY_AUDIT_REJECT_MALFORMED : TELEMETRY_AUDIT_REJECT_NO_SESSION);
+        return;
+    }
     const uint8_t *iv = data;           // 12-byte nonce
     const uint8_t *ct = data + 12;      // ciphertext
     size_t ct_len = len - 12 - 16;
     const uint8_t *tag = data + 12 + ct_len; // 16-byte tag
-    uint8_t pt[256]; if (ct_len > sizeof(pt)) { ESP_LOGW(TAG, "control: msg too large"); return; }
+    uint8_t pt[256]; if (ct_len > sizeof(pt)) { ESP_LOGW(TAG, "control: msg too large"); audit_reject(TELEMETRY_AUDIT_REJECT_MALFORMED); return; }
     int rc = crypto_aes_gcm_decrypt(s_session_key, sizeof(s_session_key), iv, 12, NULL, 0, tag, 16, pt);
-    if (rc != 0) { ESP_LOGW(TAG, "control: decrypt fail"); return; }
+    if (rc != 0) { ESP_LOGW(TAG, "control: decrypt fail"); audit_reject(TELEMETRY_AUDIT_REJECT_DECRYPT); return; }
     // parse JSON
     cJSON *root = cJSON_ParseWithLength((const char*)pt, ct_len);
-    if (!root) { ESP_LOGW(TAG, "control: bad JSON"); return; }
+    if (!root) { ESP_LOGW(TAG, "control: bad JSON"); audit_reject(TELEMETRY_AUDIT_REJECT_MALFORMED); return; }
     cJSON *ctr = cJSON_GetObjectItemCaseSensitive(root, "ctr");
-    if (!cJSON_IsNumber(ctr)) { cJSON_Delete(root); return; }
+    if (!cJSON_IsNumber(ctr)) { audit_reject(TELEMETRY_AUDIT_REJECT_MALFORMED); cJSON_Delete(root); return; }
     uint32_t ctrv = (uint32_t)cJSON_GetNumberValue(ctr);
-    if (!replay_accept_and_update(ctrv)) { ESP_LOGW(TAG, "control: replay rejected"); cJSON_Delete(root); return; }
+    if (!replay_accept_and_update(ctrv)) { ESP_LOGW(TAG, "control: replay rejected"); audit_reject(TELEMETRY_AUDIT_REJECT_REPLAY); cJSON_Delete(root); return; }
     control_cmd_t cmd = {0};
     cmd.actor = ACTOR_BLE; cmd.ts = 0; cmd.seq = ctrv;
     cJSON *ramp = cJSON_GetObjectItemCaseSensitive(root, "ramp_ms");
     cJSON *light = cJSON_GetObjectItemCaseSensitive(root, "light");
     cJSON *pump = cJSON_GetObjectItemCaseSensitive(root, "pump");
     if (cJSON_IsNumber(ramp)) cmd.ramp_ms = (uint32_t)cJSON_GetNumberValue(ramp);
-    if (cJSON_IsNumber(light)) cmd.light_pct = (uint8_t)cJSON_GetNumberValue(light);
-    if (cJSON_IsNumber(pump)) cmd.pump_pct = (uint8_t)cJSON_GetNumberValue(pump);
-    xQueueSend(g_cmd_queue, &cmd, 0);
+    if (cJSON_IsNumber(light)) { cmd.light_pct = (uint8_t)cJSON_GetNumberValue(light); cmd.channels |= CMD_CH_LIGHT; }
+    if (cJSON_IsNumber(pump)) { cmd.pump_pct = (uint8_t)cJSON_GetNumberValue(pump); cmd.channels |= CMD_CH_PUMP; }
+    telemetry_audit_event(ACTOR_BLE, TELEMETRY_AUDIT_BLE_CMD, cmd.channels, (int32_t)ctrv, 0);
+    if (cmd.channels) control_post_cmd(&cmd);
     cJSON_Delete(root);
 }
 
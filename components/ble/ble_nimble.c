@@ -73,6 +73,7 @@
 
 #include "ipc.h"
 #include "net.h"
+#include "telemetry.h"
 #include "cJSON.h"
 
 #if CONFIG_BLE_PROV_USE_ESP_PROV
@@ -225,6 +226,7 @@ static void prov_event_handler(void *user_data, esp_event_base_t event_base, int
         break;
     case WIFI_PROV_CRED_SUCCESS:
         ESP_LOGI(TAG, "Provisioning successful");
+        telemetry_audit_event(ACTOR_BLE, TELEMETRY_AUDIT_BLE_PROVISION, 0, 0, 0);
         if (s_prov_cb) {
             s_prov_cb(s_last_ssid, (s_last_psk[0]?s_last_psk:NULL), (s_last_tz[0]?s_last_tz:NULL), s_prov_arg);
         }
@@ -392,6 +394,7 @@ static int prov_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct bl
         const char *tz   = cJSON_IsString(jtz)   ? jtz->valuestring   : NULL;
 
         if (ssid && s_prov_cb) {
+            telemetry_audit_event(ACTOR_BLE, TELEMETRY_AUDIT_BLE_PROVISION, 0, 0, 0);
             s_prov_cb(ssid, psk, tz, s_prov_arg);
             set_adv_flag(false);
             ble_gap_adv_stop(); s_adv_running = false;
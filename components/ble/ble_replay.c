@@ -0,0 +1,37 @@
+#include "ble_replay.h"
+
+void ble_replay_reset(ble_replay_t *r)
+{
+    *r = (ble_replay_t){0};
+}
+
+void ble_replay_restore(ble_replay_t *r, uint32_t mark)
+{
+    r->counter = mark;
+    r->window = UINT64_MAX;
+    r->reserved = mark;
+}
+
+bool ble_replay_accept(ble_replay_t *r, uint32_t ctr, uint32_t reserve,
+                       ble_replay_persist_t persist, void *arg)
+{
+    if (ctr > r->counter) {
+        if (ctr > r->reserved) {
+            if (reserve == 0) reserve = 1;
+            uint32_t mark = ctr > UINT32_MAX - reserve ? UINT32_MAX : ctr + reserve;
+            if (persist(mark, arg) != ESP_OK) return false;
+            r->reserved = mark;
+        }
+        uint32_t delta = ctr - r->counter;
+        r->window = delta >= BLE_REPLAY_WINDOW ? 1 : (r->window << delta) | 1;
+        r->counter = ctr;
+        return true;
+    }
+    // ctr <= counter: check within window
+    uint32_t back = r->counter - ctr;
+    if (back >= BLE_REPLAY_WINDOW) return false; // too old
+    uint64_t mask = 1ULL << back;
+    if (r->window & mask) return false; // already seen
+    r->window |= mask;
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Replay protection for encrypted BLE control messages (internal to the ble component).
+// A 64-message sliding window below the highest accepted counter, kept in RAM. Flash only
+// holds a reserved high-water mark: before a counter above the mark is accepted, the mark
+// is moved `reserve` counters ahead and persisted. Every accepted counter is therefore at or
+// below the persisted mark, so after power loss restoring with that mark rejects all of
+// them, at the cost of one flash write per `reserve` messages instead of one per message.
+
+#define BLE_REPLAY_WINDOW   64
+
+typedef struct {
+    uint32_t counter;   // highest accepted
+    uint64_t window;    // bit i: counter - i was accepted
+    uint32_t reserved;  // persisted mark; counters above it need a new reservation first
+} ble_replay_t;
+
+// Persist `mark`; acceptance waits for it and fails if it does not return ESP_OK
+typedef esp_err_t (*ble_replay_persist_t)(uint32_t mark, void *arg);
+
+// New session: nothing accepted, nothing reserved
+void ble_replay_reset(ble_replay_t *r);
+
+// After power loss: everything up to the persisted `mark` counts as seen
+void ble_replay_restore(ble_replay_t *r, uint32_t mark);
+
+// True if `ctr` was not accepted before and is not too old; records it. Moves the
+// reservation `reserve` (at least 1) counters past `ctr` when it runs out.
+bool ble_replay_accept(ble_replay_t *r, uint32_t ctr, uint32_t reserve,
+                       ble_replay_persist_t persist, void *arg);
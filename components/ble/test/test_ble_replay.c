@@ -1,52 +1,138 @@
 #include "unity.h"
-#include "storage.h"
+#include "ble_replay.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <stdint.h>
 
-// This unit test exercises the BLE replay/window persistence logic by directly
-// setting and reading the NVS keys used by the component. It simulates the
-// monotonic counter progression and ensures the saved values are as expected.
+// Host tests for the replay window with counter reservation: ordering and duplicates,
+// flash writes per accepted message, and replay safety across power loss at any point
+// (the window is rebuilt from whatever mark last reached flash).
 
-void setUp(void) {
-    storage_init();
+#define RESERVE         32
+#define MESSAGES        10000
+// Before: counter and window blobs per message, each with a backup copy
+#define WRITES_BEFORE   4
+
+typedef struct {
+    uint32_t mark;      // as in flash
+    int writes;
+    bool fail;
+} flash_t;
+
+static esp_err_t persist(uint32_t mark, void *arg)
+{
+    flash_t *f = arg;
+    if (f->fail) return ESP_FAIL;
+    f->mark = mark;
+    f->writes++;
+    return ESP_OK;
 }
 
-void tearDown(void) {
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_window_order_and_duplicates(void)
+{
+    flash_t f = {0};
+    ble_replay_t r;
+    ble_replay_reset(&r);
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, 5, RESERVE, persist, &f));
+    TEST_ASSERT_FALSE(ble_replay_accept(&r, 5, RESERVE, persist, &f));
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, 3, RESERVE, persist, &f));   // late, inside the window
+    TEST_ASSERT_FALSE(ble_replay_accept(&r, 3, RESERVE, persist, &f));
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, 100, RESERVE, persist, &f));
+    TEST_ASSERT_FALSE(ble_replay_accept(&r, 100 - BLE_REPLAY_WINDOW, RESERVE, persist, &f));  // too old
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, 100 - BLE_REPLAY_WINDOW + 1, RESERVE, persist, &f));
+    TEST_ASSERT_EQUAL_UINT32(100 + RESERVE, f.mark);
+    TEST_ASSERT_EQUAL_INT(2, f.writes);
 }
 
-static uint32_t read_saved_counter(void) {
-    uint32_t v = 0; size_t got = 0;
-    if (storage_load_config("ble_peer_counter", &v, sizeof(v), &got) == ESP_OK && got == sizeof(v)) return v;
-    return 0;
+void test_writes_per_message(void)
+{
+    flash_t f = {0};
+    ble_replay_t r;
+    ble_replay_reset(&r);
+    for (uint32_t ctr = 1; ctr <= MESSAGES; ++ctr) {
+        TEST_ASSERT_TRUE(ble_replay_accept(&r, ctr, RESERVE, persist, &f));
+    }
+    printf("%d messages: %d mark writes (%.3f per message, %d per message before)\n",
+           MESSAGES, f.writes, (double)f.writes / MESSAGES, WRITES_BEFORE);
+    TEST_ASSERT_EQUAL_INT((MESSAGES + RESERVE) / (RESERVE + 1), f.writes);
+    TEST_ASSERT_TRUE(f.writes * WRITES_BEFORE * 10 <= MESSAGES * WRITES_BEFORE);
 }
 
-static uint64_t read_saved_window(void) {
-    uint64_t v = 0; size_t got = 0;
-    if (storage_load_config("ble_peer_window", &v, sizeof(v), &got) == ESP_OK && got == sizeof(v)) return v;
-    return 0;
+void test_no_replay_after_power_loss(void)
+{
+    // Random traffic (mostly increasing, some late and duplicate counters), power lost at
+    // random points: nothing accepted before the loss may be accepted after it
+    srand(42);
+    static bool accepted[MESSAGES + 2 * BLE_REPLAY_WINDOW];
+    for (int run = 0; run < 200; ++run) {
+        memset(accepted, 0, sizeof(accepted));
+        flash_t f = {0};
+        ble_replay_t r;
+        ble_replay_reset(&r);
+        int loss_at = rand() % 2000;
+        uint32_t next = 1;
+        for (int i = 0; i < loss_at; ++i) {
+            uint32_t ctr = rand() % 4 ? next++ : next - (uint32_t)(rand() % (BLE_REPLAY_WINDOW + 8));
+            if (ctr == 0 || ctr >= MESSAGES) continue;
+            bool ok = ble_replay_accept(&r, ctr, 1 + rand() % RESERVE, persist, &f);
+            if (ok) {
+                TEST_ASSERT_FALSE(accepted[ctr]);
+                accepted[ctr] = true;
+            }
+        }
+
+        ble_replay_t after;
+        ble_replay_restore(&after, f.mark);
+        for (uint32_t ctr = 1; ctr < next + BLE_REPLAY_WINDOW && ctr < MESSAGES; ++ctr) {
+            if (accepted[ctr]) TEST_ASSERT_FALSE(ble_replay_accept(&after, ctr, RESERVE, persist, &f));
+        }
+        // Fresh counters above the mark still work
+        TEST_ASSERT_TRUE(ble_replay_accept(&after, f.mark + 1, RESERVE, persist, &f));
+    }
 }
 
-void test_initial_state(void) {
-    // Expect no saved counter initially
-    uint32_t c = read_saved_counter();
-    TEST_ASSERT_EQUAL_UINT32(0, c);
+void test_failed_reservation_rejects(void)
+{
+    flash_t f = {0};
+    ble_replay_t r;
+    ble_replay_reset(&r);
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, 1, RESERVE, persist, &f));
+    f.fail = true;
+    // Inside the reservation: no write needed
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, 2, RESERVE, persist, &f));
+    // Beyond it: rejected and not recorded, so it can be retried
+    TEST_ASSERT_FALSE(ble_replay_accept(&r, RESERVE + 5, RESERVE, persist, &f));
+    TEST_ASSERT_EQUAL_UINT32(2, r.counter);
+    f.fail = false;
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, RESERVE + 5, RESERVE, persist, &f));
+    TEST_ASSERT_EQUAL_UINT32(2 * RESERVE + 5, f.mark);
 }
 
-void test_persist_counter_and_window(void) {
-    // simulate saving counter = 5 and window = 0x1
-    uint32_t c = 5; uint64_t w = 1ULL;
-    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config("ble_peer_counter", &c, sizeof(c)));
-    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config("ble_peer_window", &w, sizeof(w)));
-    // reload
-    uint32_t rc = read_saved_counter();
-    uint64_t rw = read_saved_window();
-    TEST_ASSERT_EQUAL_UINT32(5, rc);
-    TEST_ASSERT_EQUAL_UINT64(1ULL, rw);
+void test_mark_saturates(void)
+{
+    flash_t f = {0};
+    ble_replay_t r;
+    ble_replay_reset(&r);
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, UINT32_MAX - 3, RESERVE, persist, &f));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, f.mark);
+    TEST_ASSERT_TRUE(ble_replay_accept(&r, UINT32_MAX, RESERVE, persist, &f));
+    TEST_ASSERT_EQUAL_INT(1, f.writes);
+    // An unreadable mark restores as UINT32_MAX: nothing is accepted
+    ble_replay_restore(&r, UINT32_MAX);
+    TEST_ASSERT_FALSE(ble_replay_accept(&r, UINT32_MAX, RESERVE, persist, &f));
+    TEST_ASSERT_FALSE(ble_replay_accept(&r, 1, RESERVE, persist, &f));
 }
 
-int main(void) {
+int main(void)
+{
     UNITY_BEGIN();
-    RUN_TEST(test_initial_state);
-    RUN_TEST(test_persist_counter_and_window);
+    RUN_TEST(test_window_order_and_duplicates);
+    RUN_TEST(test_writes_per_message);
+    RUN_TEST(test_no_replay_after_power_loss);
+    RUN_TEST(test_failed_reservation_rejects);
+    RUN_TEST(test_mark_saturates);
     return UNITY_END();
 }
@@ -1,94 +1,353 @@
 #include "control.h"
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
-#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "driver/ledc.h"
 #include "esp_task_wdt.h"
 #include "sdkconfig.h"
 #include "ipc.h"
+#include "telemetry.h"
+#include "control_arb.h"
+#include "control_channels.h"
+#include "control_estop.h"
+#include "control_plan.h"
+#include "control_ramp.h"
+#include "control_seqlock.h"
 
 static const char *TAG = "control";
 
-// Kconfig defaults
-#define LEDC_TIMER              LEDC_TIMER_0
 #define LEDC_SPEED_MODE         LEDC_LOW_SPEED_MODE
-#define LEDC_RESOLUTION         LEDC_TIMER_8_BIT
-#define LEDC_FREQ_HZ            CONFIG_CONTROL_LEDC_FREQ
-#define LEDC_LIGHT_CHANNEL      LEDC_CHANNEL_0
-#define LEDC_LIGHT_GPIO         CONFIG_CONTROL_LIGHT_GPIO
-#define LEDC_PUMP_CHANNEL       LEDC_CHANNEL_1
-#define LEDC_PUMP_GPIO          CONFIG_CONTROL_PUMP_GPIO
-
-// Mutex for thread-safe access to LEDC hardware and state
-static SemaphoreHandle_t s_ledc_mutex = NULL;
-// Last applied control state
-static control_state_t s_current_state = {0, 0};
+
+#if defined(CONFIG_CONTROL_DEFAULT_PROFILE_LINEAR)
+#define DEFAULT_PROFILE         CONTROL_PROFILE_LINEAR
+#elif defined(CONFIG_CONTROL_DEFAULT_PROFILE_SCURVE)
+#define DEFAULT_PROFILE         CONTROL_PROFILE_SCURVE
+#elif defined(CONFIG_CONTROL_DEFAULT_PROFILE_SUNRISE)
+#define DEFAULT_PROFILE         CONTROL_PROFILE_SUNRISE
+#else
+#define DEFAULT_PROFILE         CONTROL_PROFILE_PERCEPTUAL
+#endif
+
+// Channels that exist in this build; command bits outside it are ignored
+#define CONTROL_VALID_MASK      ((uint8_t)((1u << CONTROL_NUM_CHANNELS) - 1))
+
+// control_task notification bits: mailbox doorbell, emergency-off cleanup and one fade-end
+// bit per channel
+#define NOTIFY_CMD              (1u << 0)
+#define NOTIFY_ESTOP            (1u << 1)
+#define NOTIFY_FADE(idx)        (1u << (8 + (idx)))
+
+_Static_assert(CONTROL_NUM_CHANNELS <= CONTROL_MAX_CHANNELS, "too many PWM channels");
+_Static_assert(sizeof(s_channel_cfg) / sizeof(s_channel_cfg[0]) == CONTROL_NUM_CHANNELS,
+               "channel table does not match CONFIG_CONTROL_NUM_CHANNELS");
+
+// LEDC hardware, s_ramps and s_state are owned by control_task (and control_init before
+// the task starts). Other tasks only ever see s_pub_state, published through a seqlock,
+// so control_get_state() never waits behind LEDC driver calls.
+static bool s_inited = false;
+static control_state_t s_state = {0};
+static control_state_t s_pub_state = {0};
+static control_seqlock_t s_state_seq;
+static portMUX_TYPE s_state_lock = portMUX_INITIALIZER_UNLOCKED;
+// In-flight ramps: overall span in s_ramps, hardware fade segments in s_plans
+static control_ramp_t s_ramps[CONTROL_NUM_CHANNELS];
+static control_plan_t s_plans[CONTROL_NUM_CHANNELS];
+static uint8_t s_plan_pos[CONTROL_NUM_CHANNELS]; // segment currently fading
+static TaskHandle_t s_control_task = NULL;
+
+// Command mailbox: latest-wins slots per channel and actor, so bursts (e.g. a BLE slider)
+// collapse to the final target and a command that cannot win its channel is only stored.
+// s_owner_prio is written by control_task under the lock and lets control_post_cmd skip
+// waking the task for commands that a higher-priority hold would override anyway.
+static portMUX_TYPE s_mbox_lock = portMUX_INITIALIZER_UNLOCKED;
+static control_arb_slot_t s_mbox[CONTROL_NUM_CHANNELS][ACTOR_COUNT];
+static uint8_t s_owner_prio[CONTROL_NUM_CHANNELS];
+static uint32_t s_seen_stamp = 0;   // last stamp control_task has arbitrated
+static uint32_t s_mbox_stamp = 0;
+static control_mbox_stats_t s_mbox_stats = {0};
+// Owned by control_task: slot stamp currently driving each output
+static uint32_t s_applied_stamp[CONTROL_NUM_CHANNELS];
 
 // Forward declaration
 static void control_task(void *arg);
 
+// LEDC fade-end callback (ISR context): flag the channel to control_task
+static IRAM_ATTR bool on_fade_end(const ledc_cb_param_t *param, void *user_arg)
+{
+    BaseType_t woken = pdFALSE;
+    if (param->event == LEDC_FADE_END_EVT && s_control_task) {
+        uint32_t idx = (uint32_t)(uintptr_t)user_arg;
+        xTaskNotifyFromISR(s_control_task, NOTIFY_FADE(idx), eSetBits, &woken);
+    }
+    return woken == pdTRUE;
+}
+
 // internal helpers
-static void ledc_init_hw(void)
+static esp_err_t ledc_init_hw(void)
+{
+    // Configure each timer once; channels sharing a timer must agree on its settings
+    uint32_t timers_done = 0;
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+        const control_channel_cfg_t *cfg = &s_channel_cfg[i];
+        if (cfg->gpio < 0) {
+            ESP_LOGE(TAG, "ch%d has no GPIO (CONFIG_CONTROL_CH%d_GPIO)", i, i);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (timers_done & (1u << cfg->timer)) {
+            for (int j = 0; j < i; ++j) {
+                const control_channel_cfg_t *o = &s_channel_cfg[j];
+                if (o->timer == cfg->timer && (o->freq_hz != cfg->freq_hz || o->res_bits != cfg->res_bits)) {
+                    ESP_LOGE(TAG, "ch%d and ch%d share timer %d with different freq/resolution", j, i, cfg->timer);
+                    return ESP_ERR_INVALID_ARG;
+                }
+            }
+            continue;
+        }
+        ledc_timer_config_t timer_conf = {
+            .speed_mode = LEDC_SPEED_MODE,
+            .duty_resolution = (ledc_timer_bit_t)cfg->res_bits,
+            .timer_num = cfg->timer,
+            .freq_hz = cfg->freq_hz,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+        ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
+        timers_done |= (1u << cfg->timer);
+    }
+
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+        ledc_channel_config_t ch_conf = {
+            .gpio_num = s_channel_cfg[i].gpio,
+            .speed_mode = LEDC_SPEED_MODE,
+            .channel = (ledc_channel_t)i,
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = s_channel_cfg[i].timer,
+            .duty = 0,
+            .hpoint = 0,
+        };
+        ESP_ERROR_CHECK(ledc_channel_config(&ch_conf));
+    }
+
+    // Fade functions allow smooth transitions; completion is reported through on_fade_end
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+    ledc_cbs_t cbs = { .fade_cb = on_fade_end };
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+        ESP_ERROR_CHECK(ledc_cb_register(LEDC_SPEED_MODE, (ledc_channel_t)i, &cbs, (void *)(uintptr_t)i));
+    }
+    return ESP_OK;
+}
+
+// Convert percent (0-100) to duty at the channel's resolution and curve
+static inline uint32_t pct_to_duty(int idx, uint8_t pct)
+{
+    return control_pct_to_duty(pct, s_channel_cfg[idx].gamma, s_channel_cfg[idx].res_bits);
+}
+
+// Copy s_state to the reader-visible snapshot. The critical section keeps a reader on this
+// core from preempting the write while the sequence is odd; it covers a short memcpy only.
+static void publish_state(void)
+{
+    portENTER_CRITICAL(&s_state_lock);
+    control_seqlock_write_begin(&s_state_seq);
+    memcpy(&s_pub_state, &s_state, sizeof(s_pub_state));
+    control_seqlock_write_end(&s_state_seq);
+    portEXIT_CRITICAL(&s_state_lock);
+}
+
+// Phase 1 of a fade: preempt any fade still in flight and program the first segment of
+// the new one without starting it. The new ramp starts from the duty the hardware is at.
+static void prepare_fade(int idx, uint32_t duty, uint32_t ramp_ms, control_profile_t profile, int64_t now_us)
+{
+    ledc_channel_t ch = (ledc_channel_t)idx;
+    control_ramp_t *r = &s_ramps[idx];
+
+    if (r->active) {
+        // ledc_fade_start() would otherwise block until the previous fade completes
+        ledc_fade_stop(LEDC_SPEED_MODE, ch);
+    }
+    uint32_t from = ledc_get_duty(LEDC_SPEED_MODE, ch);
+    if (r->active) {
+        ESP_LOGD(TAG, "ch%d: preempting fade at duty %u (was heading to %u)", idx, from, r->target_duty);
+    }
+
+    control_ramp_begin(r, from, duty, ramp_ms, now_us);
+    if (r->active) {
+        const control_channel_cfg_t *cfg = &s_channel_cfg[idx];
+        control_plan_ramp(&s_plans[idx], profile, cfg->gamma, cfg->res_bits, from, duty,
+                          ramp_ms, CONFIG_CONTROL_RAMP_STEP_MS);
+        s_plan_pos[idx] = 0;
+        const control_seg_t *seg = &s_plans[idx].seg[0];
+        ledc_set_fade_with_time(LEDC_SPEED_MODE, ch, seg->duty, seg->ms);
+    } else {
+        // Nothing to fade: jump straight to the target (also covers from == duty)
+        ledc_set_duty(LEDC_SPEED_MODE, ch, duty);
+    }
+}
+
+// Phase 2: latch the programmed duty or kick off the programmed fade
+static inline void commit_fade(int idx)
+{
+    if (s_ramps[idx].active) {
+        ledc_fade_start(LEDC_SPEED_MODE, (ledc_channel_t)idx, LEDC_FADE_NO_WAIT);
+    } else {
+        ledc_update_duty(LEDC_SPEED_MODE, (ledc_channel_t)idx);
+    }
+}
+
+// Apply only the channels in `channels` (CMD_CH_* mask); the others keep their target
+// and any fade in progress. All channels are programmed first and then started back to
+// back, so a multi-channel command begins its fades together and ends them together.
+static void apply_duty(uint8_t channels, const uint8_t *pct, uint32_t ramp_ms, control_profile_t profile)
 {
-    // Configure timer
-    ledc_timer_config_t timer_conf = {
-        .speed_mode = LEDC_SPEED_MODE,
-        .duty_resolution = LEDC_RESOLUTION,
-        .timer_num = LEDC_TIMER,
-        .freq_hz = LEDC_FREQ_HZ,
-        .clk_cfg = LEDC_AUTO_CLK,
-    };
-    ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
+    channels &= CONTROL_VALID_MASK;
+    if (control_estop_active()) {
+        ESP_LOGW(TAG, "emergency-off latched; ignoring outputs 0x%x", channels);
+        return;
+    }
+    if (profile == CONTROL_PROFILE_DEFAULT || profile >= CONTROL_PROFILE_COUNT) {
+        profile = DEFAULT_PROFILE;
+    }
+    int64_t now_us = esp_timer_get_time();
+
+    for (uint32_t m = channels; m; m &= m - 1) {
+        int idx = __builtin_ctz(m);
+        prepare_fade(idx, pct_to_duty(idx, pct[idx]), ramp_ms, profile, now_us);
+    }
+    for (uint32_t m = channels; m; m &= m - 1) {
+        // An emergency-off may land between programming and starting; don't re-enable
+        if (control_estop_active()) break;
+        commit_fade(__builtin_ctz(m));
+    }
 
-    // Configure channels for light and pump
-    ledc_channel_config_t ch_conf = {
-        .speed_mode = LEDC_SPEED_MODE,
-        .intr_type = LEDC_INTR_DISABLE,
-        .timer_sel = LEDC_TIMER,
-        .duty = 0,
-        .hpoint = 0,
-    };
+    for (uint32_t m = channels; m; m &= m - 1) {
+        int idx = __builtin_ctz(m);
+        s_state.pct[idx] = pct[idx];
+        s_state.ramp_end_us[idx] = s_ramps[idx].end_us;
+        if (s_ramps[idx].active) {
+            s_state.ramping |= (uint8_t)(1u << idx);
+        } else {
+            s_state.ramping &= (uint8_t)~(1u << idx);
+        }
+    }
+    publish_state();
+}
 
-    ch_conf.channel = LEDC_LIGHT_CHANNEL;
-    ch_conf.gpio_num = LEDC_LIGHT_GPIO;
-    ESP_ERROR_CHECK(ledc_channel_config(&ch_conf));
+static void handle_fade_end(int idx)
+{
+    control_ramp_t *r = &s_ramps[idx];
+    if (!r->active) return;
+    // A fade that was preempted may still report completion; only the current segment counts
+    const control_plan_t *plan = &s_plans[idx];
+    uint32_t duty = ledc_get_duty(LEDC_SPEED_MODE, (ledc_channel_t)idx);
+    if (duty != plan->seg[s_plan_pos[idx]].duty) return;
 
-    ch_conf.channel = LEDC_PUMP_CHANNEL;
-    ch_conf.gpio_num = LEDC_PUMP_GPIO;
-    ESP_ERROR_CHECK(ledc_channel_config(&ch_conf));
+    if (s_plan_pos[idx] + 1 < plan->count && !control_estop_active()) {
+        // Shaped ramp: chain the next linear segment
+        const control_seg_t *seg = &plan->seg[++s_plan_pos[idx]];
+        ledc_set_fade_with_time(LEDC_SPEED_MODE, (ledc_channel_t)idx, seg->duty, seg->ms);
+        ledc_fade_start(LEDC_SPEED_MODE, (ledc_channel_t)idx, LEDC_FADE_NO_WAIT);
+        return;
+    }
 
-    // Fade functions allow smooth transitions
-    ledc_fade_func_install(0);
+    control_ramp_finish(r, duty);
+    ESP_LOGD(TAG, "ch%d: ramp complete at duty %u", idx, duty);
+    s_state.ramping &= (uint8_t)~(1u << idx);
+    publish_state();
 }
 
-// Convert percent (0-100) to duty (0..255 for 8-bit)
-static inline uint32_t pct_to_duty(uint8_t pct)
+// Slow half of an emergency-off, in task context: stop the driver's fade engine and zero
+// the duty registers so nothing can bring the outputs back, then force them low again in
+// case a fade was being started while control_emergency_off() ran.
+static void estop_cleanup(void)
 {
-    if (pct > 100) pct = 100;
-    return (uint32_t)((pct * ((1 << LEDC_RESOLUTION) - 1)) / 100);
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+        ledc_channel_t ch = (ledc_channel_t)i;
+        if (s_ramps[i].active) {
+            ledc_fade_stop(LEDC_SPEED_MODE, ch);
+        }
+        ledc_set_duty(LEDC_SPEED_MODE, ch, 0);
+        ledc_update_duty(LEDC_SPEED_MODE, ch);
+        ledc_stop(LEDC_SPEED_MODE, ch, 0);
+        control_ramp_finish(&s_ramps[i], 0);
+        s_state.pct[i] = 0;
+        s_state.owner[i] = ACTOR_SAFETY;
+    }
+    s_state.ramping = 0;
+    publish_state();
+
+    control_estop_stats_t st;
+    control_estop_get_stats(&st);
+    ESP_LOGW(TAG, "emergency-off: outputs forced low in %uus (worst %uus)", st.last_us, st.worst_us);
+    telemetry_audit_event(ACTOR_SAFETY, TELEMETRY_AUDIT_ESTOP, 0, (int32_t)st.last_us, 0);
 }
 
-static void apply_duty_locked(uint8_t light_pct, uint8_t pump_pct, uint32_t ramp_ms)
+// Pick the winning command for every channel and apply the ones that changed. Channels
+// won by the same command start their fades together. Returns the esp_timer time of the
+// next hold expiry (0 = none) so control_task can wake up and hand the channel back.
+static int64_t arbitrate(void)
 {
-    // This function must be called with s_ledc_mutex held
-    uint32_t light_duty = pct_to_duty(light_pct);
-    uint32_t pump_duty = pct_to_duty(pump_pct);
+    control_arb_slot_t win[CONTROL_NUM_CHANNELS];
+    uint8_t owner[CONTROL_NUM_CHANNELS];
+    int64_t now_us = esp_timer_get_time();
+    int64_t next_expiry = 0;
 
-    ESP_LOGI(TAG, "apply_duty: light=%u%% pump=%u%% ramp=%ums", light_pct, pump_pct, ramp_ms);
+    portENTER_CRITICAL(&s_mbox_lock);
+    for (int c = 0; c < CONTROL_NUM_CHANNELS; ++c) {
+        int best = control_arb_winner(s_mbox[c], now_us);
+        if (best < 0) {
+            win[c].stamp = 0;
+            owner[c] = ACTOR_UNKNOWN;
+            s_owner_prio[c] = 0;
+            continue;
+        }
+        win[c] = s_mbox[c][best];
+        owner[c] = (uint8_t)best;
+        s_owner_prio[c] = control_arb_policy[best].prio;
+        if (win[c].until_us && (next_expiry == 0 || win[c].until_us < next_expiry)) {
+            next_expiry = win[c].until_us;
+        }
+    }
+    s_seen_stamp = s_mbox_stamp;
+    portEXIT_CRITICAL(&s_mbox_lock);
 
-    ledc_set_fade_with_time(LEDC_SPEED_MODE, LEDC_LIGHT_CHANNEL, light_duty, ramp_ms);
-    ledc_fade_start(LEDC_SPEED_MODE, LEDC_LIGHT_CHANNEL, LEDC_FADE_NO_WAIT);
+    uint8_t todo = 0;
+    for (int c = 0; c < CONTROL_NUM_CHANNELS; ++c) {
+        s_state.owner[c] = owner[c];
+        if (win[c].stamp && win[c].stamp != s_applied_stamp[c]) todo |= (uint8_t)(1u << c);
+    }
 
-    ledc_set_fade_with_time(LEDC_SPEED_MODE, LEDC_PUMP_CHANNEL, pump_duty, ramp_ms);
-    ledc_fade_start(LEDC_SPEED_MODE, LEDC_PUMP_CHANNEL, LEDC_FADE_NO_WAIT);
+    uint32_t applied = 0;
+    while (todo) {
+        int first = __builtin_ctz(todo);
+        uint32_t stamp = win[first].stamp;
+        uint8_t mask = 0;
+        uint8_t pct[CONTROL_MAX_CHANNELS] = {0};
+        for (uint32_t m = todo; m; m &= m - 1) {
+            int c = __builtin_ctz(m);
+            if (win[c].stamp != stamp) continue;
+            mask |= (uint8_t)(1u << c);
+            pct[c] = win[c].pct;
+            s_applied_stamp[c] = stamp;
+            telemetry_audit_event(owner[c], TELEMETRY_AUDIT_OUTPUT, (uint16_t)c, pct[c],
+                                  (int32_t)win[c].ramp_ms);
+        }
+        todo &= (uint8_t)~mask;
+        ESP_LOGI(TAG, "arbitration: actor=%u mask=0x%x ramp=%u", owner[first], mask, win[first].ramp_ms);
+        apply_duty(mask, pct, win[first].ramp_ms, (control_profile_t)win[first].profile);
+        applied++;
+    }
+    if (!applied) {
+        publish_state(); // owners may have changed without any output change
+    }
 
-    // Update snapshot of the state
-    s_current_state.light_pct = light_pct;
-    s_current_state.pump_pct = pump_pct;
+    portENTER_CRITICAL(&s_mbox_lock);
+    s_mbox_stats.applied += applied;
+    portEXIT_CRITICAL(&s_mbox_lock);
+    return next_expiry;
 }
 
 static void control_task(void *arg)
@@ -97,34 +356,33 @@ static void control_task(void *arg)
     // Register WDT for this task
     ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
 
-    control_cmd_t cmd;
+    // Commands posted before the task existed are still waiting in the mailbox
+    int64_t next_expiry = arbitrate();
+
     for (;;) {
-    // Wait for a command from the global queue (bounded wait to feed WDT)
-    if (xQueueReceive(g_cmd_queue, &cmd, pdMS_TO_TICKS(1000)) == pdPASS) {
-            ESP_LOGI(TAG, "control_task got cmd: actor=%u seq=%u light=%u pump=%u ramp=%u",
-                     cmd.actor, cmd.seq, cmd.light_pct, cmd.pump_pct, cmd.ramp_ms);
-
-            // Clamp values to safe range
-            if (cmd.light_pct > 100) cmd.light_pct = 100;
-            if (cmd.pump_pct > 100) cmd.pump_pct = 100;
-
-            // Atomically update LEDC outputs
-            xSemaphoreTake(s_ledc_mutex, portMAX_DELAY);
-            apply_duty_locked(cmd.light_pct, cmd.pump_pct, cmd.ramp_ms);
-            xSemaphoreGive(s_ledc_mutex);
-
-            // The ramp is handled by hardware. For long ramps, chunk sleep and feed WDT.
-            if (cmd.ramp_ms > 0) {
-                uint32_t remaining = cmd.ramp_ms;
-                const uint32_t chunk_ms = 500; // <= 1s to be safe under 5s WDT
-                while (remaining > 0) {
-                    uint32_t d = remaining > chunk_ms ? chunk_ms : remaining;
-                    vTaskDelay(pdMS_TO_TICKS(d));
-                    remaining -= d;
-                    ESP_ERROR_CHECK(esp_task_wdt_reset());
-                }
+        // Wait for a mailbox doorbell, a fade-end event or the next hold expiry
+        // (bounded wait to feed WDT)
+        TickType_t wait = pdMS_TO_TICKS(1000);
+        if (next_expiry) {
+            int64_t left_us = next_expiry - esp_timer_get_time();
+            if (left_us <= 0) {
+                wait = 0;
+            } else if (left_us < (int64_t)wait * 1000000 / configTICK_RATE_HZ) {
+                // Round up to whole ticks: a partial tick must not become a zero wait and spin
+                wait = (TickType_t)((left_us * configTICK_RATE_HZ + 999999) / 1000000);
             }
         }
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, wait);
+        if (bits & NOTIFY_ESTOP) {
+            estop_cleanup();
+        }
+        for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+            if (bits & NOTIFY_FADE(i)) handle_fade_end(i);
+        }
+        if ((bits & NOTIFY_CMD) || (next_expiry && esp_timer_get_time() >= next_expiry)) {
+            next_expiry = arbitrate();
+        }
         // Pet the watchdog even if no command arrived in this iteration
         ESP_ERROR_CHECK(esp_task_wdt_reset());
     }
@@ -132,28 +390,24 @@ static void control_task(void *arg)
 
 esp_err_t control_init(void)
 {
-    if (s_ledc_mutex != NULL) {
+    if (s_inited) {
         return ESP_OK; // already initialized
     }
 
-    s_ledc_mutex = xSemaphoreCreateMutex();
-    if (!s_ledc_mutex) {
-        ESP_LOGE(TAG, "Failed to create mutex");
-        return ESP_ERR_NO_MEM;
-    }
-
     // Init LEDC hardware, set safe defaults (OFF)
-    ledc_init_hw();
-    xSemaphoreTake(s_ledc_mutex, portMAX_DELAY);
-    apply_duty_locked(0, 0, 0);
-    xSemaphoreGive(s_ledc_mutex);
+    esp_err_t err = ledc_init_hw();
+    if (err != ESP_OK) {
+        return err;
+    }
+    static const uint8_t off[CONTROL_MAX_CHANNELS] = {0};
+    apply_duty(CMD_CH_ALL, off, 0, CONTROL_PROFILE_LINEAR);
+    s_inited = true;
 
     // Start control task
-    BaseType_t r = xTaskCreatePinnedToCore(control_task, "control_task", 4096, NULL, 6, NULL, tskNO_AFFINITY);
+    BaseType_t r = xTaskCreatePinnedToCore(control_task, "control_task", 4096, NULL, 6, &s_control_task, tskNO_AFFINITY);
     if (r != pdPASS) {
         ESP_LOGE(TAG, "Failed to create control_task");
-        vSemaphoreDelete(s_ledc_mutex);
-        s_ledc_mutex = NULL;
+        s_inited = false;
         return ESP_FAIL;
     }
 
@@ -166,20 +420,113 @@ esp_err_t control_get_state(control_state_t *out_state)
     if (!out_state) {
         return ESP_ERR_INVALID_ARG;
     }
-    if (!s_ledc_mutex) {
+    if (!s_inited) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    xSemaphoreTake(s_ledc_mutex, portMAX_DELAY);
-    memcpy(out_state, &s_current_state, sizeof(s_current_state));
-    xSemaphoreGive(s_ledc_mutex);
+    // Lock-free: retry if control_task published a new state while we were copying
+    uint_fast32_t seq;
+    do {
+        seq = control_seqlock_read_begin(&s_state_seq);
+        memcpy(out_state, &s_pub_state, sizeof(*out_state));
+    } while (control_seqlock_read_retry(&s_state_seq, seq));
+
+    return ESP_OK;
+}
+
+// Set notification bits on control_task from task or ISR context
+static void notify_task(TaskHandle_t task, uint32_t bits)
+{
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(task, bits, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotify(task, bits, eSetBits);
+    }
+}
+
+esp_err_t control_post_cmd(const control_cmd_t *cmd)
+{
+    if (!cmd) return ESP_ERR_INVALID_ARG;
+    uint32_t actor = cmd->actor < ACTOR_COUNT ? cmd->actor : ACTOR_UNKNOWN;
+    uint8_t prio = control_arb_policy[actor].prio;
+
+    // Stale commands (e.g. a cloud command delivered late) must not override newer intent.
+    // ISR callers leave ts at 0, so the audit record is only made in task context.
+    if (control_arb_policy[actor].expiry_s && cmd->ts) {
+        time_t now = time(NULL);
+        if (control_arb_expired(actor, cmd->ts, now)) {
+            portENTER_CRITICAL_SAFE(&s_mbox_lock);
+            s_mbox_stats.dropped++;
+            portEXIT_CRITICAL_SAFE(&s_mbox_lock);
+            telemetry_audit_event((uint8_t)actor, TELEMETRY_AUDIT_CMD_STALE, cmd->channels,
+                                  (int32_t)cmd->seq, (int32_t)(now - (time_t)cmd->ts));
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    int64_t until_us = control_arb_hold_until(actor, now_us);
+    bool wake = false, changed = false, coalesced = false;
+
+    portENTER_CRITICAL_SAFE(&s_mbox_lock);
+    uint32_t stamp = ++s_mbox_stamp;
+    for (uint32_t m = cmd->channels & CONTROL_VALID_MASK; m; m &= m - 1) {
+        int c = __builtin_ctz(m);
+        control_arb_slot_t *slot = &s_mbox[c][actor];
+        uint8_t pct = cmd->pct[c] > 100 ? 100 : cmd->pct[c];
+        if (control_arb_live(slot, now_us) && slot->pct == pct && slot->profile == cmd->profile) {
+            // Same value again: only refresh the hold
+            slot->until_us = until_us;
+            continue;
+        }
+        if (slot->stamp > s_seen_stamp) coalesced = true;
+        *slot = (control_arb_slot_t){
+            .stamp = stamp, .until_us = until_us, .ramp_ms = cmd->ramp_ms,
+            .pct = pct, .profile = cmd->profile,
+        };
+        changed = true;
+        if (prio >= s_owner_prio[c]) wake = true;
+    }
+    s_mbox_stats.posted++;
+    if (coalesced) s_mbox_stats.coalesced++;
+    if (!changed) s_mbox_stats.redundant++;
+    else if (!wake) s_mbox_stats.deferred++;
+    TaskHandle_t task = s_control_task;
+    portEXIT_CRITICAL_SAFE(&s_mbox_lock);
+
+    // Before control_task exists the command just waits in its slot. A command that only
+    // repeats a live value or loses to a higher-priority hold needs no wakeup at all.
+    if (task && wake) {
+        notify_task(task, NOTIFY_CMD);
+    }
+    return ESP_OK;
+}
+
+esp_err_t control_emergency_off(void)
+{
+    // Outputs are low when this returns; control_task only tidies up afterwards
+    control_estop_trigger();
+    TaskHandle_t task = s_control_task;
+    if (task) {
+        notify_task(task, NOTIFY_ESTOP);
+    }
+    return ESP_OK;
+}
 
+esp_err_t control_get_estop_stats(control_estop_stats_t *out_stats)
+{
+    if (!out_stats) return ESP_ERR_INVALID_ARG;
+    control_estop_get_stats(out_stats);
     return ESP_OK;
 }
 
-// Utility for tests: number of steps for a ramp given step_ms granularity
-uint32_t control_calc_step_count(uint32_t ramp_ms, uint32_t step_ms)
+esp_err_t control_get_mbox_stats(control_mbox_stats_t *out_stats)
 {
-    if (step_ms == 0) return 0;
-    return (ramp_ms + step_ms - 1) / step_ms; // ceil
+    if (!out_stats) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&s_mbox_lock);
+    *out_stats = s_mbox_stats;
+    portEXIT_CRITICAL(&s_mbox_lock);
+    return ESP_OK;
 }
@@ -0,0 +1,35 @@
+#include "control_arb.h"
+#include "sdkconfig.h"
+
+const control_arb_policy_t control_arb_policy[ACTOR_COUNT] = {
+    [ACTOR_UNKNOWN]  = { 0, 0, 0 },
+    [ACTOR_SCHEDULE] = { 1, CONFIG_CONTROL_ARB_SCHEDULE_HOLD_S, CONFIG_CONTROL_ARB_SCHEDULE_EXPIRY_S },
+    [ACTOR_CLOUD]    = { 2, CONFIG_CONTROL_ARB_CLOUD_HOLD_S, CONFIG_CONTROL_ARB_CLOUD_EXPIRY_S },
+    [ACTOR_BLE]      = { 3, CONFIG_CONTROL_ARB_BLE_HOLD_S, CONFIG_CONTROL_ARB_BLE_EXPIRY_S },
+    [ACTOR_SAFETY]   = { 4, 0, 0 }, // latched until reboot
+};
+
+int64_t control_arb_hold_until(uint32_t actor, int64_t now_us)
+{
+    uint32_t hold_s = control_arb_policy[actor].hold_s;
+    return hold_s ? now_us + (int64_t)hold_s * 1000000 : 0;
+}
+
+bool control_arb_expired(uint32_t actor, uint64_t ts, time_t now)
+{
+    uint32_t expiry_s = control_arb_policy[actor].expiry_s;
+    if (!expiry_s || !ts || now <= (time_t)ts) return false;
+    return (uint64_t)(now - (time_t)ts) > expiry_s;
+}
+
+int control_arb_winner(const control_arb_slot_t slots[ACTOR_COUNT], int64_t now_us)
+{
+    int best = -1;
+    for (int a = 0; a < ACTOR_COUNT; ++a) {
+        if (control_arb_live(&slots[a], now_us) &&
+            (best < 0 || control_arb_policy[a].prio > control_arb_policy[best].prio)) {
+            best = a;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "ipc.h"
+
+// Command arbitration between actors (internal to the control component).
+// Each channel follows the highest-priority actor with a live command; the slots
+// themselves live in control.c.
+
+typedef struct {
+    uint8_t prio;       // higher wins
+    uint32_t hold_s;    // command stays live this long, 0 = until replaced
+    uint32_t expiry_s;  // commands with a wall-clock ts older than this are discarded, 0 = never
+} control_arb_policy_t;
+
+extern const control_arb_policy_t control_arb_policy[ACTOR_COUNT];
+
+// Latest command of one actor for one channel
+typedef struct {
+    uint32_t stamp;     // arrival order, 0 = slot empty
+    int64_t until_us;   // esp_timer time the hold ends, 0 = until replaced
+    uint32_t ramp_ms;
+    uint8_t pct;
+    uint8_t profile;
+} control_arb_slot_t;
+
+static inline bool control_arb_live(const control_arb_slot_t *slot, int64_t now_us)
+{
+    return slot->stamp && (slot->until_us == 0 || now_us < slot->until_us);
+}
+
+// End of the hold for a command from `actor` posted at `now_us`
+int64_t control_arb_hold_until(uint32_t actor, int64_t now_us);
+
+// True if a command stamped `ts` (wall clock, 0 = unknown) is too old for `actor` at `now`
+bool control_arb_expired(uint32_t actor, uint64_t ts, time_t now);
+
+// Index of the winning actor among one channel's slots, or -1 if none is live
+int control_arb_winner(const control_arb_slot_t slots[ACTOR_COUNT], int64_t now_us);
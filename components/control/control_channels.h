@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "driver/ledc.h"
+
+// Static PWM channel table built from Kconfig (internal to the control component).
+// Index n is LEDC channel n and bit n of control_cmd_t.channels. Adding a channel is a
+// Kconfig change only; control.c loops over this table and never names a channel.
+
+typedef struct {
+    int gpio;
+    ledc_timer_t timer;
+    uint32_t freq_hz;
+    uint8_t res_bits;
+    bool gamma;     // perceptual levels (CIE 1931) instead of linear duty
+} control_channel_cfg_t;
+
+// Kconfig bools are left undefined when off
+#ifdef CONFIG_CONTROL_CH0_GAMMA
+#define CONTROL_CH0_GAMMA true
+#else
+#define CONTROL_CH0_GAMMA false
+#endif
+#ifdef CONFIG_CONTROL_CH1_GAMMA
+#define CONTROL_CH1_GAMMA true
+#else
+#define CONTROL_CH1_GAMMA false
+#endif
+#ifdef CONFIG_CONTROL_CH2_GAMMA
+#define CONTROL_CH2_GAMMA true
+#else
+#define CONTROL_CH2_GAMMA false
+#endif
+#ifdef CONFIG_CONTROL_CH3_GAMMA
+#define CONTROL_CH3_GAMMA true
+#else
+#define CONTROL_CH3_GAMMA false
+#endif
+#ifdef CONFIG_CONTROL_CH4_GAMMA
+#define CONTROL_CH4_GAMMA true
+#else
+#define CONTROL_CH4_GAMMA false
+#endif
+#ifdef CONFIG_CONTROL_CH5_GAMMA
+#define CONTROL_CH5_GAMMA true
+#else
+#define CONTROL_CH5_GAMMA false
+#endif
+
+#define CONTROL_CH_ENTRY(n) {                              \
+    .gpio = CONFIG_CONTROL_CH##n##_GPIO,                   \
+    .timer = (ledc_timer_t)CONFIG_CONTROL_CH##n##_TIMER,   \
+    .freq_hz = CONFIG_CONTROL_CH##n##_FREQ_HZ,             \
+    .res_bits = CONFIG_CONTROL_CH##n##_RES_BITS,           \
+    .gamma = CONTROL_CH##n##_GAMMA,                        \
+}
+
+static const control_channel_cfg_t s_channel_cfg[] = {
+    CONTROL_CH_ENTRY(0),
+#if CONFIG_CONTROL_NUM_CHANNELS > 1
+    CONTROL_CH_ENTRY(1),
+#endif
+#if CONFIG_CONTROL_NUM_CHANNELS > 2
+    CONTROL_CH_ENTRY(2),
+#endif
+#if CONFIG_CONTROL_NUM_CHANNELS > 3
+    CONTROL_CH_ENTRY(3),
+#endif
+#if CONFIG_CONTROL_NUM_CHANNELS > 4
+    CONTROL_CH_ENTRY(4),
+#endif
+#if CONFIG_CONTROL_NUM_CHANNELS > 5
+    CONTROL_CH_ENTRY(5),
+#endif
+};
+
+#define CONTROL_NUM_CHANNELS CONFIG_CONTROL_NUM_CHANNELS
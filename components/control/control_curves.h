@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Dimming lookup tables (internal to the control component), generated at build time by
+// gen_curves.py into control_curves.c. All values are Q16 fractions: 0 = 0, 65535 = 1.
+
+// Perceived level -> relative PWM duty (CIE 1931), sampled every 1/256 of the level range
+#define CONTROL_GAMMA_LUT_BITS  8
+#define CONTROL_GAMMA_LUT_LEN   ((1 << CONTROL_GAMMA_LUT_BITS) + 1)
+
+// Ramp progress over time for each profile, sampled at 64 equal time steps
+#define CONTROL_SHAPE_LUT_SEGS  64
+#define CONTROL_SHAPE_LUT_LEN   (CONTROL_SHAPE_LUT_SEGS + 1)
+#define CONTROL_SHAPE_COUNT     4   // control_profile_t values after CONTROL_PROFILE_DEFAULT
+
+extern const uint16_t control_gamma_lut[CONTROL_GAMMA_LUT_LEN];
+extern const uint16_t control_shape_lut[CONTROL_SHAPE_COUNT][CONTROL_SHAPE_LUT_LEN];
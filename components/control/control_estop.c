@@ -0,0 +1,47 @@
+#include "control_estop.h"
+#include <stdatomic.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "driver/ledc.h"
+#include "control_channels.h"
+
+// ledc_stop() must not be fetched from flash when called from an ISR
+#if !CONFIG_LEDC_CTRL_FUNC_IN_IRAM
+#error "control_estop_trigger() needs CONFIG_LEDC_CTRL_FUNC_IN_IRAM"
+#endif
+
+static atomic_bool s_latched = false;
+static atomic_uint_fast32_t s_count = 0;
+static atomic_uint_fast32_t s_last_us = 0;
+static atomic_uint_fast32_t s_worst_us = 0;
+
+IRAM_ATTR uint32_t control_estop_trigger(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    // Latch first so control_task stops programming the hardware behind us
+    atomic_store(&s_latched, true);
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+        // Disables the PWM output at idle level 0, whatever fade the channel is running
+        ledc_stop(LEDC_LOW_SPEED_MODE, (ledc_channel_t)i, 0);
+    }
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+    atomic_fetch_add(&s_count, 1);
+    atomic_store(&s_last_us, dt);
+    uint_fast32_t worst = atomic_load(&s_worst_us);
+    while (dt > worst && !atomic_compare_exchange_weak(&s_worst_us, &worst, dt)) {
+    }
+    return dt;
+}
+
+IRAM_ATTR bool control_estop_active(void)
+{
+    return atomic_load(&s_latched);
+}
+
+void control_estop_get_stats(control_estop_stats_t *out)
+{
+    out->count = (uint32_t)atomic_load(&s_count);
+    out->last_us = (uint32_t)atomic_load(&s_last_us);
+    out->worst_us = (uint32_t)atomic_load(&s_worst_us);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "control.h"
+
+// Latched emergency-off (internal to the control component).
+// control_estop_trigger() forces every configured channel's output low straight through the
+// LEDC driver's IRAM-resident ledc_stop(), bypassing the mailbox and control_task. It takes
+// no mutex and does a fixed amount of register work per channel, so it is safe from ISRs
+// and its latency is bounded. control_task finishes the job (cancelling fade bookkeeping and
+// zeroing duty registers) when it next runs, and applies nothing while the latch is set.
+
+// Force all outputs off and set the latch. ISR-safe; returns the latency in microseconds.
+uint32_t control_estop_trigger(void);
+
+// True once control_estop_trigger() has run (until reboot)
+bool control_estop_active(void);
+
+void control_estop_get_stats(control_estop_stats_t *out);
@@ -0,0 +1,117 @@
+#include "control_plan.h"
+#include "control_curves.h"
+
+static inline uint32_t max_duty(uint8_t res_bits)
+{
+    return (1u << res_bits) - 1;
+}
+
+uint32_t control_level_to_duty(uint32_t level, bool gamma, uint8_t res_bits)
+{
+    uint32_t max = max_duty(res_bits);
+    if (level == 0) return 0;
+    if (level >= CONTROL_LEVEL_MAX) return max;
+
+    uint32_t y = level;
+    if (gamma) {
+        uint32_t idx = level >> (16 - CONTROL_GAMMA_LUT_BITS);
+        uint32_t frac = level & ((1u << (16 - CONTROL_GAMMA_LUT_BITS)) - 1);
+        uint32_t a = control_gamma_lut[idx], b = control_gamma_lut[idx + 1];
+        y = a + (((b - a) * frac) >> (16 - CONTROL_GAMMA_LUT_BITS));
+    }
+    return (uint32_t)(((uint64_t)y * max + CONTROL_LEVEL_MAX / 2) / CONTROL_LEVEL_MAX);
+}
+
+uint32_t control_duty_to_level(uint32_t duty, bool gamma, uint8_t res_bits)
+{
+    uint32_t max = max_duty(res_bits);
+    if (duty == 0) return 0;
+    if (duty >= max) return CONTROL_LEVEL_MAX;
+
+    uint32_t y = (uint32_t)(((uint64_t)duty * CONTROL_LEVEL_MAX + max / 2) / max);
+    if (!gamma) return y;
+
+    // Largest table index whose value is <= y, then interpolate within that step
+    uint32_t lo = 0, hi = CONTROL_GAMMA_LUT_LEN - 2;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (control_gamma_lut[mid] <= y) lo = mid; else hi = mid - 1;
+    }
+    uint32_t a = control_gamma_lut[lo], b = control_gamma_lut[lo + 1];
+    uint32_t step = 1u << (16 - CONTROL_GAMMA_LUT_BITS);
+    uint32_t frac = (b > a) ? ((y - a) * step) / (b - a) : 0;
+    if (frac >= step) frac = step - 1;
+    uint32_t level = (lo << (16 - CONTROL_GAMMA_LUT_BITS)) + frac;
+    return level > CONTROL_LEVEL_MAX ? CONTROL_LEVEL_MAX : level;
+}
+
+uint32_t control_pct_to_duty(uint8_t pct, bool gamma, uint8_t res_bits)
+{
+    if (pct > 100) pct = 100;
+    uint32_t duty = control_level_to_duty((pct * CONTROL_LEVEL_MAX) / 100, gamma, res_bits);
+    // Any non-zero request must light the output, however coarse the resolution
+    if (pct > 0 && duty == 0) duty = 1;
+    return duty;
+}
+
+// Profile progress (Q16) at `pos` (Q16 fraction of the ramp time)
+static uint32_t shape_at(control_profile_t profile, uint32_t pos)
+{
+    const uint16_t *lut = control_shape_lut[profile - 1];
+    uint32_t x = pos * CONTROL_SHAPE_LUT_SEGS;
+    uint32_t idx = x >> 16;
+    if (idx >= CONTROL_SHAPE_LUT_SEGS) return lut[CONTROL_SHAPE_LUT_SEGS];
+    int32_t a = lut[idx], b = lut[idx + 1];
+    return (uint32_t)(a + (int32_t)(((int64_t)(b - a) * (x & 0xFFFF)) >> 16));
+}
+
+uint8_t control_plan_ramp(control_plan_t *plan, control_profile_t profile, bool gamma,
+                          uint8_t res_bits, uint32_t from_duty, uint32_t to_duty,
+                          uint32_t ramp_ms, uint32_t step_ms)
+{
+    plan->count = 0;
+    if (ramp_ms == 0 || from_duty == to_duty) {
+        plan->seg[plan->count++] = (control_seg_t){ .duty = to_duty, .ms = 0 };
+        return plan->count;
+    }
+    // The hardware fade is already linear in duty; perceptual-linear is too without gamma
+    if (profile <= CONTROL_PROFILE_LINEAR || profile >= CONTROL_PROFILE_COUNT ||
+        (profile == CONTROL_PROFILE_PERCEPTUAL && !gamma)) {
+        plan->seg[plan->count++] = (control_seg_t){ .duty = to_duty, .ms = ramp_ms };
+        return plan->count;
+    }
+
+    uint32_t n = control_calc_step_count(ramp_ms, step_ms);
+    if (n == 0 || n > CONTROL_PLAN_MAX_SEGS) n = CONTROL_PLAN_MAX_SEGS;
+
+    int64_t l0 = control_duty_to_level(from_duty, gamma, res_bits);
+    int64_t l1 = control_duty_to_level(to_duty, gamma, res_bits);
+    uint32_t prev_duty = from_duty;
+    uint32_t prev_ms = 0;
+
+    for (uint32_t i = 1; i <= n; ++i) {
+        uint32_t t_ms = (uint32_t)(((uint64_t)ramp_ms * i) / n);
+        uint32_t duty = to_duty;
+        if (i < n) {
+            uint32_t s = shape_at(profile, (i << 16) / n);
+            int64_t level = l0 + ((l1 - l0) * (int64_t)s) / (int64_t)CONTROL_LEVEL_MAX;
+            duty = control_level_to_duty((uint32_t)level, gamma, res_bits);
+        }
+        // Flat stretches fold into the next segment that actually moves
+        if (duty == prev_duty) continue;
+        plan->seg[plan->count++] = (control_seg_t){ .duty = duty, .ms = t_ms - prev_ms };
+        prev_duty = duty;
+        prev_ms = t_ms;
+    }
+    // Reached the target early through rounding: keep the overall duration
+    if (prev_ms < ramp_ms) {
+        plan->seg[plan->count - 1].ms += ramp_ms - prev_ms;
+    }
+    return plan->count;
+}
+
+uint32_t control_calc_step_count(uint32_t ramp_ms, uint32_t step_ms)
+{
+    if (step_ms == 0) return 0;
+    return (ramp_ms + step_ms - 1) / step_ms; // ceil
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "control.h"
+
+// Profile-aware ramp planner (internal to the control component).
+// LEDC fades are linear in duty, so a shaped ramp is approximated by a chain of linear
+// hardware fades whose end points come from the generated lookup tables. Integer-only.
+
+#define CONTROL_PLAN_MAX_SEGS   16
+#define CONTROL_LEVEL_MAX       65535u  // full-scale perceived level (Q16)
+
+typedef struct {
+    uint32_t duty;  // duty reached at the end of the segment
+    uint32_t ms;    // segment duration
+} control_seg_t;
+
+typedef struct {
+    control_seg_t seg[CONTROL_PLAN_MAX_SEGS];
+    uint8_t count;
+} control_plan_t;
+
+// Level (0..CONTROL_LEVEL_MAX) <-> duty at `res_bits` resolution. With `gamma` the mapping
+// is perceptual (CIE 1931), otherwise linear.
+uint32_t control_level_to_duty(uint32_t level, bool gamma, uint8_t res_bits);
+uint32_t control_duty_to_level(uint32_t duty, bool gamma, uint8_t res_bits);
+
+// Percent (0-100) to duty; 0 and 100 always map to fully off and fully on.
+uint32_t control_pct_to_duty(uint8_t pct, bool gamma, uint8_t res_bits);
+
+// Split a ramp from `from_duty` to `to_duty` over `ramp_ms` into linear segments following
+// `profile` (not CONTROL_PROFILE_DEFAULT). Segments are about `step_ms` long, at most
+// CONTROL_PLAN_MAX_SEGS of them; consecutive segments never repeat a duty and the last one
+// ends exactly at `to_duty`. A zero-length or no-op ramp yields one zero-length segment.
+// Returns the segment count.
+uint8_t control_plan_ramp(control_plan_t *plan, control_profile_t profile, bool gamma,
+                          uint8_t res_bits, uint32_t from_duty, uint32_t to_duty,
+                          uint32_t ramp_ms, uint32_t step_ms);
@@ -0,0 +1,31 @@
+#include "control_ramp.h"
+
+void control_ramp_begin(control_ramp_t *r, uint32_t from_duty, uint32_t to_duty,
+                        uint32_t ramp_ms, int64_t now_us)
+{
+    r->start_duty = from_duty;
+    r->target_duty = to_duty;
+    r->start_us = now_us;
+    r->end_us = now_us + (int64_t)ramp_ms * 1000;
+    r->active = (ramp_ms > 0 && from_duty != to_duty);
+    if (!r->active) {
+        r->end_us = now_us;
+    }
+}
+
+uint32_t control_ramp_duty_at(const control_ramp_t *r, int64_t now_us)
+{
+    if (!r->active || now_us >= r->end_us) return r->target_duty;
+    if (now_us <= r->start_us) return r->start_duty;
+
+    int64_t span = r->end_us - r->start_us;
+    int64_t elapsed = now_us - r->start_us;
+    int64_t delta = (int64_t)r->target_duty - (int64_t)r->start_duty;
+    return (uint32_t)((int64_t)r->start_duty + (delta * elapsed) / span);
+}
+
+void control_ramp_finish(control_ramp_t *r, uint32_t duty)
+{
+    r->target_duty = duty;
+    r->active = false;
+}
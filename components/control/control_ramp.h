@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-channel ramp bookkeeping for the control task (internal to the control component).
+// The control task owns all instances.
+
+typedef struct {
+    uint32_t start_duty;  // duty the hardware was at when the ramp began
+    uint32_t target_duty; // duty the ramp converges to
+    int64_t start_us;     // monotonic start time
+    int64_t end_us;       // monotonic time the ramp is expected to finish
+    bool active;          // true while a hardware fade is in flight
+} control_ramp_t;
+
+// Start tracking a ramp from `from_duty` to `to_duty` lasting `ramp_ms`.
+// A zero-length ramp (or from == to) is recorded as already complete.
+void control_ramp_begin(control_ramp_t *r, uint32_t from_duty, uint32_t to_duty,
+                        uint32_t ramp_ms, int64_t now_us);
+
+// Linear estimate of the duty at `now_us`. Used when the hardware duty cannot be read back.
+uint32_t control_ramp_duty_at(const control_ramp_t *r, int64_t now_us);
+
+// Mark the ramp complete (fade-end event or preemption). The output then holds `duty`.
+void control_ramp_finish(control_ramp_t *r, uint32_t duty);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Single-writer sequence lock (internal to the control component).
+// The writer bumps the sequence to odd, updates the protected data, then bumps it to even.
+// Readers copy the data and retry if the sequence was odd or changed meanwhile, so they
+// never block and never priority-invert behind the writer.
+//
+// The writer must not be preempted by a reader on the same core while the sequence is odd,
+// otherwise that reader would spin until the writer runs again. Callers on FreeRTOS wrap
+// the write in a critical section; the protected data must be small enough for that.
+
+typedef struct {
+    atomic_uint_fast32_t seq;
+} control_seqlock_t;
+
+static inline void control_seqlock_write_begin(control_seqlock_t *sl)
+{
+    uint_fast32_t s = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+    atomic_store_explicit(&sl->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void control_seqlock_write_end(control_seqlock_t *sl)
+{
+    uint_fast32_t s = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+    atomic_store_explicit(&sl->seq, s + 1, memory_order_release);
+}
+
+// Returns the sequence to pass to control_seqlock_read_retry(); waits out an odd sequence.
+static inline uint_fast32_t control_seqlock_read_begin(const control_seqlock_t *sl)
+{
+    uint_fast32_t s;
+    while ((s = atomic_load_explicit((atomic_uint_fast32_t *)&sl->seq, memory_order_acquire)) & 1u) {
+        // writer in progress on another core; it holds the line for a few dozen cycles
+    }
+    return s;
+}
+
+// True if the data copied since control_seqlock_read_begin() may be torn and must be re-read.
+static inline bool control_seqlock_read_retry(const control_seqlock_t *sl, uint_fast32_t start)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit((atomic_uint_fast32_t *)&sl->seq, memory_order_relaxed) != start;
+}
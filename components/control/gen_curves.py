@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+Generate the control component's dimming lookup tables (control_curves.c).
+Run by the build; the tables end up as const data in flash so the firmware never
+evaluates pow()/exp() at runtime.
+Usage: gen_curves.py out.c
+"""
+import sys, math
+
+GAMMA_BITS = 8          # must match CONTROL_GAMMA_LUT_BITS in control_curves.h
+SHAPE_SEGS = 64         # must match CONTROL_SHAPE_LUT_SEGS
+SUNRISE_K = 5.0         # steepness of the exponential sunrise curve
+FULL = 65535
+
+def cie1931(l):
+    # Perceived lightness (0..1) -> relative luminance (0..1), CIE 1931
+    L = l * 100.0
+    if L <= 8.0:
+        return L / 903.3
+    return ((L + 16.0) / 116.0) ** 3
+
+def shape_linear(t):
+    return t
+
+def shape_scurve(t):
+    # smootherstep: zero slope and curvature at both ends
+    return t * t * t * (t * (t * 6.0 - 15.0) + 10.0)
+
+def shape_sunrise(t):
+    return (math.exp(SUNRISE_K * t) - 1.0) / (math.exp(SUNRISE_K) - 1.0)
+
+# Order matches control_profile_t minus CONTROL_PROFILE_DEFAULT
+SHAPES = [
+    ('LINEAR', shape_linear),
+    ('PERCEPTUAL', shape_linear),
+    ('SCURVE', shape_scurve),
+    ('SUNRISE', shape_sunrise),
+]
+
+def q16(x):
+    return max(0, min(FULL, int(round(x * FULL))))
+
+def rows(values, per_line=12):
+    out = []
+    for i in range(0, len(values), per_line):
+        out.append('    ' + ', '.join('%5d' % v for v in values[i:i + per_line]) + ',')
+    return '\n'.join(out)
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: gen_curves.py out.c'); sys.exit(2)
+    n = 1 << GAMMA_BITS
+    gamma = [q16(cie1931(i / n)) for i in range(n + 1)]
+    lines = [
+        '// Generated by gen_curves.py - do not edit',
+        '#include "control_curves.h"',
+        '',
+        'const uint16_t control_gamma_lut[CONTROL_GAMMA_LUT_LEN] = {',
+        rows(gamma),
+        '};',
+        '',
+        'const uint16_t control_shape_lut[CONTROL_SHAPE_COUNT][CONTROL_SHAPE_LUT_LEN] = {',
+    ]
+    for name, fn in SHAPES:
+        lines.append('    // %s' % name)
+        lines.append('    {')
+        lines.append('    ' + rows([q16(fn(i / SHAPE_SEGS)) for i in range(SHAPE_SEGS + 1)]).replace('\n', '\n    '))
+        lines.append('    },')
+    lines.append('};')
+    with open(sys.argv[1], 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+if __name__ == '__main__':
+    main()
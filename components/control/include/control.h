@@ -6,20 +6,85 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
-// Public API for PWM control of grow light and air pump.
+// Public API for PWM control of grow light, air pump and any extra channels configured
+// in Kconfig (CONFIG_CONTROL_NUM_CHANNELS). Channel 0 is the light, channel 1 the pump.
 // Security/safety: outputs default to OFF on init. All public functions are thread-safe.
 
+// Upper bound on configured channels (LEDC channels available on every target)
+#define CONTROL_MAX_CHANNELS 6
+
+// Ramp profiles for control_cmd_t.profile. Levels are perceptual on channels with gamma
+// enabled in Kconfig (the light by default), so e.g. 10% looks like a tenth of full.
+typedef enum {
+    CONTROL_PROFILE_DEFAULT = 0,    // CONFIG_CONTROL_DEFAULT_PROFILE
+    CONTROL_PROFILE_LINEAR,         // linear in PWM duty (single hardware fade)
+    CONTROL_PROFILE_PERCEPTUAL,     // linear in perceived level
+    CONTROL_PROFILE_SCURVE,         // eases in and out
+    CONTROL_PROFILE_SUNRISE,        // exponential: slow start, fast finish
+    CONTROL_PROFILE_COUNT
+} control_profile_t;
+
 typedef struct {
-    uint8_t light_pct; // 0-100
-    uint8_t pump_pct;  // 0-100
+    union {
+        uint8_t pct[CONTROL_MAX_CHANNELS];  // 0-100, target of the last applied command
+        struct {
+            uint8_t light_pct;              // alias for pct[0]
+            uint8_t pump_pct;               // alias for pct[1]
+        };
+    };
+    uint8_t ramping;                        // bit n: a fade towards pct[n] is in flight
+    uint8_t owner[CONTROL_MAX_CHANNELS];    // ACTOR_* whose command drives each channel
+    int64_t ramp_end_us[CONTROL_MAX_CHANNELS]; // esp_timer time each fade ends (valid while ramping)
 } control_state_t;
 
+// Command mailbox counters (monotonic since boot)
+typedef struct {
+    uint32_t posted;    // commands accepted by control_post_cmd
+    uint32_t coalesced; // pending commands replaced by a newer one from the same actor
+    uint32_t dropped;   // commands discarded on arrival because their ts was past the actor's expiry
+    uint32_t applied;   // commands applied to the outputs
+    uint32_t deferred;  // commands stored behind a higher-priority hold (no wakeup, no fade)
+    uint32_t redundant; // commands repeating the actor's live value (hold refreshed only)
+} control_mbox_stats_t;
+
+// Emergency-off latency, measured inside control_emergency_off()
+typedef struct {
+    uint32_t count;     // times triggered since boot
+    uint32_t last_us;   // latency of the last trigger
+    uint32_t worst_us;  // worst latency seen
+} control_estop_stats_t;
+
+struct control_cmd; // control_cmd_t, defined in ipc.h
+
 // Initialize control component. Creates control task, LEDC, and watchdog registration.
-// The control task listens on the global g_cmd_queue for commands.
+// The control task applies commands posted with control_post_cmd().
 esp_err_t control_init(void);
 
-// Get last applied state (thread-safe snapshot)
+// Post a command to the control task. Non-blocking, never fails for lack of space, and
+// safe from ISR context (leave ts at 0 there). Only the latest value per actor and channel
+// is kept. Each channel follows the highest-priority actor with a live command:
+// ACTOR_SAFETY > ACTOR_BLE > ACTOR_CLOUD > ACTOR_SCHEDULE. A command stays live for the
+// actor's hold time (Kconfig, 0 = until replaced); lower-priority commands posted meanwhile
+// are kept and take over when the hold ends. Safety commands never expire.
+// Returns ESP_ERR_TIMEOUT if ts is older than the actor's expiry time.
+esp_err_t control_post_cmd(const struct control_cmd *cmd);
+
+// Snapshot of the mailbox counters
+esp_err_t control_get_mbox_stats(control_mbox_stats_t *out_stats);
+
+// Force every output off now, bypassing the mailbox: cancels fades in flight and drives the
+// PWM pins low within a bounded number of microseconds. Safe from ISR context. Latched until
+// reboot: later commands are recorded but no longer applied.
+esp_err_t control_emergency_off(void);
+
+// Latency of the emergency-off path
+esp_err_t control_get_estop_stats(control_estop_stats_t *out_stats);
+
+// Get last applied state, including in-flight targets. Lock-free and non-blocking from any
+// task on either core. Producers don't need this to change a single channel: set only
+// that bit in control_cmd_t.channels.
 esp_err_t control_get_state(control_state_t *out_state);
 
 // Visible helper for unit tests: compute step count for a given ramp and step_ms.
+// The ramp planner (control_plan.h) uses it to size profiled ramps.
 uint32_t control_calc_step_count(uint32_t ramp_ms, uint32_t step_ms);
@@ -0,0 +1,180 @@
+#include "unity.h"
+#include "control_ramp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Host benchmark: command-to-duty latency while ramps are running.
+// Commands (some in bursts, like a dragged slider) arrive at random times and are replayed
+// through a discrete-event model of both control_task designs, in simulated microseconds:
+//
+//   blocking: the old task slept through every ramp before reading the next command
+//   event-driven: post to the mailbox and notify, wake control_task (which may first be
+//     kept off the CPU by the Wi-Fi/BLE stacks, or still be in arbitrate() or a fade-end
+//     segment of the running ramp), read back the running ramp with control_ramp_duty_at(),
+//     start the new fade. A command that is still in the mailbox when a newer one arrives
+//     is replaced by it (latest wins) and has no latency of its own.
+//
+// Latency is arrival to the new fade starting. Step costs are ESP32-C3 estimates; the
+// ramp bookkeeping itself runs for real and its host CPU time is reported.
+
+#define N_CMDS          2000
+#define MIN_RAMP_MS     500
+#define MAX_RAMP_MS     10000
+#define MAX_GAP_MS      15000
+#define BURST_PCT       15      // commands following the previous one within BURST_GAP_US
+#define BURST_GAP_US    3000
+#define DUTY_MAX        255
+
+#define WAKE_US         40      // xTaskNotify and switch into control_task
+#define STACK_PCT       10      // arrivals that find a higher-priority stack task running
+#define STACK_MAX_US    2000    // ... for up to this long
+#define ARBITRATE_US    60      // mailbox scan and arbitration
+#define FADE_START_US   30      // ledc_fade_stop, set_fade_with_time, fade_start
+#define SEGMENT_MS      100     // CONFIG_CONTROL_RAMP_STEP_MS: one fade-end event per segment
+#define FADE_END_US     25      // handle_fade_end: next segment
+
+static int64_t s_arrival_us[N_CMDS];
+static uint32_t s_target[N_CMDS];
+static uint32_t s_ramp_ms[N_CMDS];
+static int64_t s_blocking_lat_us[N_CMDS];
+static int64_t s_event_lat_us[N_CMDS];
+
+void setUp(void) { srand(1234); }
+void tearDown(void) {}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int64_t pct(const int64_t *sorted, int n, int p)
+{
+    int i = (n * p) / 100;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+static void report(const char *name, int64_t *lat, int n)
+{
+    qsort(lat, n, sizeof(lat[0]), cmp_i64);
+    printf("%-12s n=%d p50=%lldus p90=%lldus p99=%lldus max=%lldus\n", name, n,
+           (long long)pct(lat, n, 50), (long long)pct(lat, n, 90),
+           (long long)pct(lat, n, 99), (long long)lat[n - 1]);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void make_commands(void)
+{
+    int64_t t = 0;
+    for (int i = 0; i < N_CMDS; ++i) {
+        if (rand() % 100 < BURST_PCT) t += 1 + rand() % BURST_GAP_US;
+        else t += (int64_t)(rand() % MAX_GAP_MS) * 1000;
+        s_arrival_us[i] = t;
+        s_target[i] = (uint32_t)(rand() % (DUTY_MAX + 1));
+        s_ramp_ms[i] = MIN_RAMP_MS + (uint32_t)(rand() % (MAX_RAMP_MS - MIN_RAMP_MS));
+    }
+}
+
+// End of the fade-end handler the task runs last at or before `t`, 0 if none
+static int64_t segment_busy_until(const control_ramp_t *r, int64_t t)
+{
+    if (!r->active || t <= r->start_us) return 0;
+    int64_t edge = r->start_us + (t - r->start_us) / (SEGMENT_MS * 1000) * (SEGMENT_MS * 1000);
+    if (edge > r->end_us) edge = r->end_us;
+    return edge > r->start_us ? edge + FADE_END_US : 0;
+}
+
+void test_ramp_latency_blocking_vs_event_driven(void)
+{
+    make_commands();
+
+    // Blocking: applied only once the previous ramp sleep has finished
+    int64_t busy_until_us = 0;
+    for (int i = 0; i < N_CMDS; ++i) {
+        int64_t applied_us = s_arrival_us[i] > busy_until_us ? s_arrival_us[i] : busy_until_us;
+        s_blocking_lat_us[i] = applied_us - s_arrival_us[i];
+        busy_until_us = applied_us + (int64_t)s_ramp_ms[i] * 1000;
+    }
+
+    // Event-driven
+    control_ramp_t ramp = {0};
+    int64_t task_free_us = 0;   // end of the last arbitrate()
+    int applied = 0, replaced = 0, queued = 0, preempted = 0;
+    double cpu_ns = 0;
+    for (int i = 0; i < N_CMDS; ++i) {
+        int64_t ready = s_arrival_us[i] + WAKE_US;
+        if (rand() % 100 < STACK_PCT) ready += rand() % STACK_MAX_US;
+        int64_t busy = segment_busy_until(&ramp, ready);
+        if (busy < task_free_us) busy = task_free_us;
+        int64_t start = ready > busy ? ready : busy;
+        if (busy > ready) queued++;
+        // Still in the mailbox when the next one arrives: replaced
+        if (i + 1 < N_CMDS && s_arrival_us[i + 1] < start) {
+            replaced++;
+            continue;
+        }
+
+        double t0 = now_ns();
+        bool was_active = ramp.active && start < ramp.end_us;
+        uint32_t from = control_ramp_duty_at(&ramp, start);
+        control_ramp_begin(&ramp, from, s_target[i], s_ramp_ms[i], start);
+        cpu_ns += now_ns() - t0;
+        if (was_active) {
+            preempted++;
+            TEST_ASSERT_EQUAL_UINT32(from, ramp.start_duty);
+        }
+
+        task_free_us = start + ARBITRATE_US + FADE_START_US;
+        s_event_lat_us[applied++] = task_free_us - s_arrival_us[i];
+    }
+
+    report("blocking", s_blocking_lat_us, N_CMDS);
+    report("event-driven", s_event_lat_us, applied);
+    printf("event-driven: %d preempted a running ramp, %d waited for the task, %d replaced in the mailbox\n",
+           preempted, queued, replaced);
+    printf("ramp bookkeeping cpu (host): %.1f ns/cmd\n", cpu_ns / applied);
+
+    // Every path of the model is exercised
+    TEST_ASSERT_TRUE(preempted > N_CMDS / 4);
+    TEST_ASSERT_TRUE(queued > 0);
+    TEST_ASSERT_TRUE(replaced > 0);
+    TEST_ASSERT_EQUAL_INT(N_CMDS, applied + replaced);
+
+    // Never faster than the fixed path, bounded by the worst stall in front of the task
+    int64_t floor_us = WAKE_US + ARBITRATE_US + FADE_START_US;
+    int64_t bound_us = floor_us + STACK_MAX_US + FADE_END_US + ARBITRATE_US + FADE_START_US;
+    TEST_ASSERT_EQUAL_INT64(floor_us, s_event_lat_us[0]);
+    TEST_ASSERT_TRUE(s_event_lat_us[applied - 1] <= bound_us);
+    TEST_ASSERT_TRUE(pct(s_event_lat_us, applied, 99) > floor_us);
+    TEST_ASSERT_TRUE(pct(s_event_lat_us, applied, 99) <= bound_us);
+    TEST_ASSERT_TRUE(pct(s_event_lat_us, applied, 99) * 100 < pct(s_blocking_lat_us, N_CMDS, 99));
+}
+
+void test_ramp_duty_interpolates(void)
+{
+    control_ramp_t r;
+    control_ramp_begin(&r, 0, 200, 1000, 0);
+    TEST_ASSERT_TRUE(r.active);
+    TEST_ASSERT_EQUAL_UINT32(0, control_ramp_duty_at(&r, 0));
+    TEST_ASSERT_EQUAL_UINT32(100, control_ramp_duty_at(&r, 500000));
+    TEST_ASSERT_EQUAL_UINT32(200, control_ramp_duty_at(&r, 2000000));
+
+    control_ramp_begin(&r, 50, 50, 1000, 0);
+    TEST_ASSERT_FALSE(r.active);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ramp_duty_interpolates);
+    RUN_TEST(test_ramp_latency_blocking_vs_event_driven);
+    return UNITY_END();
+}
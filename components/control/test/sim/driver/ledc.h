@@ -0,0 +1,20 @@
+#pragma once
+
+// Simulated LEDC backend for host tests: just the types and calls the control component
+// uses. test_estop.c provides the implementation.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// The simulated ledc_stop() has no flash to be cached out of
+#define CONFIG_LEDC_CTRL_FUNC_IN_IRAM 1
+
+typedef enum { LEDC_LOW_SPEED_MODE, LEDC_SPEED_MODE_MAX } ledc_mode_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3, LEDC_TIMER_MAX } ledc_timer_t;
+typedef enum {
+    LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2,
+    LEDC_CHANNEL_3, LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_MAX
+} ledc_channel_t;
+
+esp_err_t ledc_stop(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t idle_level);
@@ -0,0 +1,115 @@
+#include "unity.h"
+#include "control_arb.h"
+#include <string.h>
+
+// Host tests for actor arbitration: priority order, override holds and command expiry.
+
+#define S(x) ((int64_t)(x) * 1000000)
+
+static control_arb_slot_t s_slots[ACTOR_COUNT];
+static uint32_t s_stamp;
+
+void setUp(void)
+{
+    memset(s_slots, 0, sizeof(s_slots));
+    s_stamp = 0;
+}
+void tearDown(void) {}
+
+static void post(uint32_t actor, uint8_t pct, int64_t now_us)
+{
+    s_slots[actor] = (control_arb_slot_t){
+        .stamp = ++s_stamp,
+        .until_us = control_arb_hold_until(actor, now_us),
+        .pct = pct,
+    };
+}
+
+static int winner_pct(int64_t now_us)
+{
+    int w = control_arb_winner(s_slots, now_us);
+    return w < 0 ? -1 : s_slots[w].pct;
+}
+
+void test_no_commands_no_winner(void)
+{
+    TEST_ASSERT_EQUAL_INT(-1, control_arb_winner(s_slots, 0));
+}
+
+void test_priority_order(void)
+{
+    TEST_ASSERT_TRUE(control_arb_policy[ACTOR_SAFETY].prio > control_arb_policy[ACTOR_BLE].prio);
+    TEST_ASSERT_TRUE(control_arb_policy[ACTOR_BLE].prio > control_arb_policy[ACTOR_CLOUD].prio);
+    TEST_ASSERT_TRUE(control_arb_policy[ACTOR_CLOUD].prio > control_arb_policy[ACTOR_SCHEDULE].prio);
+    TEST_ASSERT_TRUE(control_arb_policy[ACTOR_SCHEDULE].prio > control_arb_policy[ACTOR_UNKNOWN].prio);
+}
+
+// Assumes the default non-zero BLE/cloud holds
+void test_ble_override_defers_schedule_until_hold_ends(void)
+{
+    post(ACTOR_SCHEDULE, 70, S(0));
+    TEST_ASSERT_EQUAL_INT(70, winner_pct(S(1)));
+
+    post(ACTOR_BLE, 20, S(10));
+    TEST_ASSERT_EQUAL_INT(ACTOR_BLE, control_arb_winner(s_slots, S(11)));
+
+    // Scheduled OFF during the override is stored, not applied
+    post(ACTOR_SCHEDULE, 0, S(100));
+    TEST_ASSERT_EQUAL_INT(20, winner_pct(S(101)));
+
+    // Once the BLE hold lapses the latest schedule value takes over
+    int64_t end = S(10) + S(control_arb_policy[ACTOR_BLE].hold_s);
+    TEST_ASSERT_EQUAL_INT(20, winner_pct(end - 1));
+    TEST_ASSERT_EQUAL_INT(0, winner_pct(end));
+}
+
+void test_cloud_sits_between_ble_and_schedule(void)
+{
+    post(ACTOR_SCHEDULE, 70, S(0));
+    post(ACTOR_CLOUD, 40, S(5));
+    TEST_ASSERT_EQUAL_INT(40, winner_pct(S(6)));
+    post(ACTOR_BLE, 10, S(7));
+    TEST_ASSERT_EQUAL_INT(10, winner_pct(S(8)));
+    // Back to the schedule once both overrides have lapsed
+    int64_t ble_end = S(7) + S(control_arb_policy[ACTOR_BLE].hold_s);
+    int64_t cloud_end = S(5) + S(control_arb_policy[ACTOR_CLOUD].hold_s);
+    int64_t after_both = (ble_end > cloud_end ? ble_end : cloud_end);
+    TEST_ASSERT_EQUAL_INT(70, winner_pct(after_both));
+}
+
+void test_safety_is_latched(void)
+{
+    post(ACTOR_SCHEDULE, 70, S(0));
+    post(ACTOR_SAFETY, 0, S(1));
+    post(ACTOR_BLE, 100, S(2));
+    TEST_ASSERT_EQUAL_INT(ACTOR_SAFETY, control_arb_winner(s_slots, S(3)));
+    TEST_ASSERT_EQUAL_INT(ACTOR_SAFETY, control_arb_winner(s_slots, S(1000000)));
+}
+
+void test_expiry_discards_late_commands(void)
+{
+    time_t now = 1700000000;
+    // Unknown timestamp is never considered stale
+    TEST_ASSERT_FALSE(control_arb_expired(ACTOR_CLOUD, 0, now));
+    // Schedule replays missed events with their original time: never expires by default
+    TEST_ASSERT_FALSE(control_arb_expired(ACTOR_SCHEDULE, now - 86400, now));
+    uint32_t expiry = control_arb_policy[ACTOR_CLOUD].expiry_s;
+    if (expiry) {
+        TEST_ASSERT_FALSE(control_arb_expired(ACTOR_CLOUD, now - expiry, now));
+        TEST_ASSERT_TRUE(control_arb_expired(ACTOR_CLOUD, now - expiry - 1, now));
+    }
+    // A clock that is behind the sender (not yet synced) does not drop commands
+    TEST_ASSERT_FALSE(control_arb_expired(ACTOR_CLOUD, now + 10, now));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_commands_no_winner);
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_ble_override_defers_schedule_until_hold_ends);
+    RUN_TEST(test_cloud_sits_between_ble_and_schedule);
+    RUN_TEST(test_safety_is_latched);
+    RUN_TEST(test_expiry_discards_late_commands);
+    return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#include "unity.h"
+#include "control_estop.h"
+#include "control_channels.h"
+#include "driver/ledc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host test: emergency-off against a simulated LEDC backend.
+// A "hardware" thread keeps fading every channel up, the way the LEDC fade engine does
+// while control_task sleeps. control_estop_trigger() must pull all outputs low, keep them
+// low while the fade engine keeps running, and report a bounded worst-case latency.
+
+#define N_TRIGGERS      2000
+#define REG_WRITE_NS    200     // simulated cost of one ledc_stop() register sequence
+#define P99_BOUND_US    50      // the work itself: a few register writes per channel
+#define WORST_BOUND_US  10000   // a preemptible host may deschedule us mid-call
+
+typedef struct {
+    atomic_uint duty;
+    atomic_bool out_enabled;    // sig_out_en: false forces the pin to the idle level
+    atomic_uint idle_level;
+} sim_channel_t;
+
+static sim_channel_t s_sim[CONTROL_NUM_CHANNELS];
+static atomic_bool s_fading;
+static atomic_bool s_stop_hw;
+
+static void spin_ns(uint64_t ns)
+{
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &b);
+    } while ((uint64_t)(b.tv_sec - a.tv_sec) * 1000000000ull + (uint64_t)(b.tv_nsec - a.tv_nsec) < ns);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+esp_err_t ledc_stop(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t idle_level)
+{
+    if (channel >= CONTROL_NUM_CHANNELS) return ESP_ERR_INVALID_ARG;
+    spin_ns(REG_WRITE_NS);
+    atomic_store(&s_sim[channel].idle_level, idle_level);
+    atomic_store(&s_sim[channel].out_enabled, false);
+    return ESP_OK;
+}
+
+// Level seen on the pin: PWM when enabled and duty > 0, otherwise the idle level
+static bool pin_can_be_high(int ch)
+{
+    if (!atomic_load(&s_sim[ch].out_enabled)) return atomic_load(&s_sim[ch].idle_level) != 0;
+    return atomic_load(&s_sim[ch].duty) > 0;
+}
+
+// Fade engine: keeps stepping duty, like hardware does until the driver stops it
+static void *fade_engine(void *arg)
+{
+    while (!atomic_load(&s_stop_hw)) {
+        if (atomic_load(&s_fading)) {
+            for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) atomic_fetch_add(&s_sim[i].duty, 1);
+        }
+        struct timespec d = { .tv_sec = 0, .tv_nsec = 1000 };
+        nanosleep(&d, NULL);
+    }
+    return NULL;
+}
+
+static void outputs_on(void)
+{
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) {
+        atomic_store(&s_sim[i].duty, 100);
+        atomic_store(&s_sim[i].out_enabled, true);
+        atomic_store(&s_sim[i].idle_level, 1);
+    }
+    atomic_store(&s_fading, true);
+}
+
+static uint32_t s_lat_us[N_TRIGGERS];
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_estop_forces_all_outputs_low_during_fades(void)
+{
+    pthread_t hw;
+    atomic_store(&s_stop_hw, false);
+    outputs_on();
+    pthread_create(&hw, NULL, fade_engine, NULL);
+    spin_ns(50000);
+
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) TEST_ASSERT_TRUE(pin_can_be_high(i));
+    control_estop_trigger();
+    TEST_ASSERT_TRUE(control_estop_active());
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) TEST_ASSERT_FALSE(pin_can_be_high(i));
+
+    // The fade engine is still running; the outputs must stay low regardless
+    spin_ns(2000000);
+    for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) TEST_ASSERT_FALSE(pin_can_be_high(i));
+
+    atomic_store(&s_stop_hw, true);
+    pthread_join(hw, NULL);
+}
+
+void test_estop_worst_case_latency_recorded(void)
+{
+    pthread_t hw;
+    atomic_store(&s_stop_hw, false);
+    pthread_create(&hw, NULL, fade_engine, NULL);
+
+    for (int n = 0; n < N_TRIGGERS; ++n) {
+        outputs_on();
+        s_lat_us[n] = control_estop_trigger();
+        for (int i = 0; i < CONTROL_NUM_CHANNELS; ++i) TEST_ASSERT_FALSE(pin_can_be_high(i));
+    }
+    atomic_store(&s_stop_hw, true);
+    pthread_join(hw, NULL);
+
+    qsort(s_lat_us, N_TRIGGERS, sizeof(s_lat_us[0]), cmp_u32);
+    uint32_t p99 = s_lat_us[N_TRIGGERS * 99 / 100];
+    uint32_t worst = s_lat_us[N_TRIGGERS - 1];
+    control_estop_stats_t st;
+    control_estop_get_stats(&st);
+    printf("estop: channels=%d p50=%uus p99=%uus worst=%uus (stats worst=%uus count=%u)\n",
+           CONTROL_NUM_CHANNELS, s_lat_us[N_TRIGGERS / 2], p99, worst, st.worst_us, st.count);
+
+    // Telemetry sees the same worst case the caller measured
+    TEST_ASSERT_TRUE(st.count >= N_TRIGGERS);
+    TEST_ASSERT_TRUE(st.worst_us >= worst);
+    TEST_ASSERT_TRUE(p99 < P99_BOUND_US);
+    TEST_ASSERT_TRUE(worst < WORST_BOUND_US);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_estop_forces_all_outputs_low_during_fades);
+    RUN_TEST(test_estop_worst_case_latency_recorded);
+    return UNITY_END();
+}
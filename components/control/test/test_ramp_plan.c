@@ -0,0 +1,140 @@
+#include "unity.h"
+#include "control_plan.h"
+#include "control_curves.h"
+
+// Host tests for the profile-aware ramp planner and the generated dimming tables.
+
+#define RES 13
+#define MAX_DUTY ((1u << RES) - 1)
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint32_t plan_total_ms(const control_plan_t *p)
+{
+    uint32_t ms = 0;
+    for (int i = 0; i < p->count; ++i) ms += p->seg[i].ms;
+    return ms;
+}
+
+void test_pct_to_duty_endpoints(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, control_pct_to_duty(0, true, RES));
+    TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, control_pct_to_duty(100, true, RES));
+    TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, control_pct_to_duty(100, false, RES));
+    TEST_ASSERT_EQUAL_UINT32(MAX_DUTY / 2, control_pct_to_duty(50, false, RES));
+    // 1% is dim but never dark, even at 8 bits
+    TEST_ASSERT_TRUE(control_pct_to_duty(1, true, 8) >= 1);
+}
+
+void test_gamma_is_monotonic_and_perceptual(void)
+{
+    uint32_t prev = 0;
+    for (uint8_t pct = 1; pct <= 100; ++pct) {
+        uint32_t d = control_pct_to_duty(pct, true, RES);
+        TEST_ASSERT_TRUE(d >= prev);
+        prev = d;
+    }
+    // Half perceived brightness is well under half the duty (CIE L*=50 -> Y~18%)
+    uint32_t half = control_pct_to_duty(50, true, RES);
+    TEST_ASSERT_TRUE(half > MAX_DUTY / 7 && half < MAX_DUTY / 4);
+    // The bottom 10% gets tens of distinct steps at 13 bits, instead of a handful at 8 bits
+    TEST_ASSERT_TRUE(control_pct_to_duty(10, true, RES) >= 60);
+}
+
+void test_level_duty_round_trip(void)
+{
+    for (uint32_t duty = 0; duty <= MAX_DUTY; duty += 7) {
+        uint32_t lvl = control_duty_to_level(duty, true, RES);
+        uint32_t back = control_level_to_duty(lvl, true, RES);
+        TEST_ASSERT_TRUE(back + 1 >= duty && back <= duty + 1);
+    }
+}
+
+void test_plan_zero_ramp_and_noop(void)
+{
+    control_plan_t p;
+    TEST_ASSERT_EQUAL_UINT8(1, control_plan_ramp(&p, CONTROL_PROFILE_SCURVE, true, RES, 0, 500, 0, 100));
+    TEST_ASSERT_EQUAL_UINT32(500, p.seg[0].duty);
+    TEST_ASSERT_EQUAL_UINT32(0, p.seg[0].ms);
+
+    TEST_ASSERT_EQUAL_UINT8(1, control_plan_ramp(&p, CONTROL_PROFILE_SCURVE, true, RES, 500, 500, 1000, 100));
+}
+
+void test_plan_linear_is_one_hardware_fade(void)
+{
+    control_plan_t p;
+    TEST_ASSERT_EQUAL_UINT8(1, control_plan_ramp(&p, CONTROL_PROFILE_LINEAR, true, RES, 0, MAX_DUTY, 5000, 100));
+    TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, p.seg[0].duty);
+    TEST_ASSERT_EQUAL_UINT32(5000, p.seg[0].ms);
+    // Without gamma a perceptual ramp is linear in duty as well
+    TEST_ASSERT_EQUAL_UINT8(1, control_plan_ramp(&p, CONTROL_PROFILE_PERCEPTUAL, false, RES, 0, MAX_DUTY, 5000, 100));
+}
+
+void test_plan_profiles_shape_and_duration(void)
+{
+    const control_profile_t profiles[] = {
+        CONTROL_PROFILE_PERCEPTUAL, CONTROL_PROFILE_SCURVE, CONTROL_PROFILE_SUNRISE,
+    };
+    for (unsigned k = 0; k < sizeof(profiles) / sizeof(profiles[0]); ++k) {
+        control_plan_t up, down;
+        uint8_t n = control_plan_ramp(&up, profiles[k], true, RES, 0, MAX_DUTY, 1000, 100);
+        TEST_ASSERT_EQUAL_UINT8(control_calc_step_count(1000, 100), n);
+        TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, up.seg[n - 1].duty);
+        TEST_ASSERT_EQUAL_UINT32(1000, plan_total_ms(&up));
+        for (int i = 1; i < n; ++i) TEST_ASSERT_TRUE(up.seg[i].duty > up.seg[i - 1].duty);
+
+        n = control_plan_ramp(&down, profiles[k], true, RES, MAX_DUTY, 0, 1000, 100);
+        TEST_ASSERT_EQUAL_UINT32(0, down.seg[n - 1].duty);
+        TEST_ASSERT_EQUAL_UINT32(1000, plan_total_ms(&down));
+        for (int i = 1; i < n; ++i) TEST_ASSERT_TRUE(down.seg[i].duty < down.seg[i - 1].duty);
+    }
+
+    // Sunrise stays dim for the first half; S-curve starts slower than perceptual-linear
+    control_plan_t sun, s, lin;
+    control_plan_ramp(&sun, CONTROL_PROFILE_SUNRISE, true, RES, 0, MAX_DUTY, 1000, 100);
+    control_plan_ramp(&s, CONTROL_PROFILE_SCURVE, true, RES, 0, MAX_DUTY, 1000, 100);
+    control_plan_ramp(&lin, CONTROL_PROFILE_PERCEPTUAL, true, RES, 0, MAX_DUTY, 1000, 100);
+    TEST_ASSERT_TRUE(sun.seg[4].duty < MAX_DUTY / 50);
+    TEST_ASSERT_TRUE(s.seg[0].duty < lin.seg[0].duty);
+}
+
+void test_plan_segment_cap_and_flat_stretches(void)
+{
+    control_plan_t p;
+    // Long ramp is capped at CONTROL_PLAN_MAX_SEGS segments
+    uint8_t n = control_plan_ramp(&p, CONTROL_PROFILE_SCURVE, true, RES, 0, MAX_DUTY, 60000, 100);
+    TEST_ASSERT_EQUAL_UINT8(CONTROL_PLAN_MAX_SEGS, n);
+    TEST_ASSERT_EQUAL_UINT32(60000, plan_total_ms(&p));
+
+    // A tiny step at low resolution repeats duties; those fold into fewer segments
+    n = control_plan_ramp(&p, CONTROL_PROFILE_SUNRISE, true, 8, 0, 3, 1000, 100);
+    TEST_ASSERT_TRUE(n >= 1 && n <= 3);
+    TEST_ASSERT_EQUAL_UINT32(3, p.seg[n - 1].duty);
+    TEST_ASSERT_EQUAL_UINT32(1000, plan_total_ms(&p));
+    for (int i = 1; i < n; ++i) TEST_ASSERT_TRUE(p.seg[i].duty != p.seg[i - 1].duty);
+}
+
+void test_generated_tables_bounds(void)
+{
+    TEST_ASSERT_EQUAL_UINT16(0, control_gamma_lut[0]);
+    TEST_ASSERT_EQUAL_UINT16(65535, control_gamma_lut[CONTROL_GAMMA_LUT_LEN - 1]);
+    for (int k = 0; k < CONTROL_SHAPE_COUNT; ++k) {
+        TEST_ASSERT_EQUAL_UINT16(0, control_shape_lut[k][0]);
+        TEST_ASSERT_EQUAL_UINT16(65535, control_shape_lut[k][CONTROL_SHAPE_LUT_SEGS]);
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pct_to_duty_endpoints);
+    RUN_TEST(test_gamma_is_monotonic_and_perceptual);
+    RUN_TEST(test_level_duty_round_trip);
+    RUN_TEST(test_plan_zero_ramp_and_noop);
+    RUN_TEST(test_plan_linear_is_one_hardware_fade);
+    RUN_TEST(test_plan_profiles_shape_and_duration);
+    RUN_TEST(test_plan_segment_cap_and_flat_stretches);
+    RUN_TEST(test_generated_tables_bounds);
+    return UNITY_END();
+}
@@ -13,5 +13,5 @@
 // Initialize networking subsystem (starts Wi-Fi, SNTP, and management task)
 esp_err_t net_init(void);
 
-// Set Wi-Fi credentials, save them to NVS, and trigger a connection attempt.
+// Set Wi-Fi credentials, queue them for NVS (storage_task), and trigger a connection attempt.
 esp_err_t net_set_credentials(const char *ssid, const char *psk);
@@ -13,6 +13,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include "storage.h"
+#include "net_record.h"
 #include "ipc.h"
 #include "sdkconfig.h"
 #include "esp_sntp.h"
@@ -20,14 +21,8 @@
 
 static const char *TAG = "net";
 
-#define STORAGE_KEY_WIFI "wifi_creds"
 #define WIFI_MAX_RETRY   CONFIG_NET_WIFI_MAX_RETRY
 
-typedef struct {
-    char ssid[32];
-    char psk[64];
-} wifi_creds_t;
-
 static wifi_creds_t s_creds;
 static bool s_have_creds = false;
 static int s_retry_count = 0;
@@ -95,9 +90,9 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
 
 static esp_err_t load_credentials(void)
 {
-    size_t len = sizeof(s_creds);
-    esp_err_t err = storage_load_config(STORAGE_KEY_WIFI, &s_creds, &len);
-    if (err == ESP_OK && len == sizeof(s_creds)) {
+    memset(&s_creds, 0, sizeof(s_creds));
+    esp_err_t err = storage_record_load(&wifi_creds_schema, &s_creds);
+    if (err == ESP_OK) {
         s_have_creds = (s_creds.ssid[0] != '\0');
         if (s_have_creds) {
             ESP_LOGI(TAG, "Loaded Wi-Fi credentials for SSID (redacted)");
@@ -106,6 +101,7 @@ static esp_err_t load_credentials(void)
         }
     } else {
         ESP_LOGW(TAG, "Failed to load Wi-Fi credentials (err=%s), assuming none exist.", esp_err_to_name(err));
+        memset(&s_creds, 0, sizeof(s_creds));
         s_have_creds = false;
     }
     return ESP_OK;
@@ -225,6 +221,11 @@ esp_err_t net_init(void)
     return ESP_OK;
 }
 
+static void on_creds_saved(const char *key, esp_err_t err, void *arg)
+{
+    if (err != ESP_OK) ESP_LOGE(TAG, "Failed to write Wi-Fi credentials: %s", esp_err_to_name(err));
+}
+
 esp_err_t net_set_credentials(const char *ssid, const char *psk)
 {
     if (!ssid || strlen(ssid) == 0) return ESP_ERR_INVALID_ARG;
@@ -235,7 +236,8 @@ esp_err_t net_set_credentials(const char *ssid, const char *psk)
         strncpy(creds.psk, psk, sizeof(creds.psk) - 1);
     }
 
-    esp_err_t err = storage_save_config(STORAGE_KEY_WIFI, &creds, sizeof(creds));
+    // Queued for storage_task; the provisioning callback does not wait for flash
+    esp_err_t err = storage_record_save_async(&wifi_creds_schema, &creds, on_creds_saved, NULL);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save Wi-Fi credentials: %s", esp_err_to_name(err));
         return err;
@@ -0,0 +1,42 @@
+#include "net_record.h"
+#include <string.h>
+
+// Tags are fixed: a new field takes the next free one, a removed field's tag is retired
+enum {
+    TAG_SSID = 1,
+    TAG_PSK,
+};
+
+static const storage_field_t s_fields[] = {
+    STORAGE_FIELD(TAG_SSID, STORAGE_FIELD_STR, wifi_creds_t, ssid),
+    STORAGE_FIELD(TAG_PSK, STORAGE_FIELD_STR, wifi_creds_t, psk),
+};
+
+// The struct as older firmware wrote it, frozen here so wifi_creds_t can change
+typedef struct {
+    char ssid[32];
+    char psk[64];
+} wifi_creds_v0_t;
+
+static esp_err_t from_raw_struct(void *rec, const void *raw, size_t raw_len)
+{
+    if (raw_len != sizeof(wifi_creds_v0_t)) return ESP_ERR_INVALID_SIZE;
+    const wifi_creds_v0_t *v0 = raw;
+    wifi_creds_t *c = rec;
+    memset(c, 0, sizeof(*c));
+    strncpy(c->ssid, v0->ssid, sizeof(c->ssid) - 1);
+    strncpy(c->psk, v0->psk, sizeof(c->psk) - 1);
+    return ESP_OK;
+}
+
+static const storage_migrate_fn_t s_migrations[] = {
+    from_raw_struct,    // 0 -> 1
+};
+
+const storage_schema_t wifi_creds_schema = {
+    .key = NET_RECORD_KEY,
+    .version = 1,
+    .fields = s_fields,
+    .field_count = sizeof(s_fields) / sizeof(s_fields[0]),
+    .migrations = s_migrations,
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "storage_record.h"
+
+// Wi-Fi credentials as a storage record under "wifi_creds". Version 0 is the raw struct
+// stored by firmware before records; it is migrated on the first load.
+#define NET_RECORD_KEY  "wifi_creds"
+
+typedef struct {
+    char ssid[32];
+    char psk[64];
+} wifi_creds_t;
+
+extern const storage_schema_t wifi_creds_schema;
@@ -0,0 +1,75 @@
+#include "unity.h"
+#include "net_record.h"
+#include "storage.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+// Host tests for the Wi-Fi credentials record on the storage NVS stand-in: credentials
+// stored as the raw struct by older firmware survive the upgrade, and a typical SSID/PSK
+// pair takes a fraction of the 96-byte struct.
+
+void setUp(void)
+{
+    storage_deinit();
+    sim_nvs_reset();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+}
+
+void tearDown(void) {}
+
+void test_raw_struct_upgraded(void)
+{
+    wifi_creds_t old = {0};
+    strcpy(old.ssid, "greenhouse");
+    strcpy(old.psk, "correct horse battery staple");
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(NET_RECORD_KEY, &old, sizeof(old)));
+
+    wifi_creds_t c = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&wifi_creds_schema, &c));
+    TEST_ASSERT_EQUAL_STRING(old.ssid, c.ssid);
+    TEST_ASSERT_EQUAL_STRING(old.psk, c.psk);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = sizeof(buf);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(NET_RECORD_KEY, buf, &len));
+    TEST_ASSERT_EQUAL_HEX8(STORAGE_RECORD_MAGIC, buf[0]);
+    printf("wifi_creds: %u bytes stored, was %u\n", (unsigned)len, (unsigned)sizeof(wifi_creds_t));
+    TEST_ASSERT_TRUE(len < sizeof(wifi_creds_t) / 2);
+
+    memset(&c, 0, sizeof(c));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&wifi_creds_schema, &c));
+    TEST_ASSERT_EQUAL_MEMORY(&old, &c, sizeof(c));
+}
+
+void test_full_length_credentials(void)
+{
+    wifi_creds_t in;
+    memset(in.ssid, 's', sizeof(in.ssid) - 1);
+    in.ssid[sizeof(in.ssid) - 1] = '\0';
+    memset(in.psk, 'p', sizeof(in.psk) - 1);
+    in.psk[sizeof(in.psk) - 1] = '\0';
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_save(&wifi_creds_schema, &in));
+
+    wifi_creds_t c = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&wifi_creds_schema, &c));
+    TEST_ASSERT_EQUAL_MEMORY(&in, &c, sizeof(c));
+}
+
+void test_wrong_size_blob_rejected(void)
+{
+    char ssid_only[32] = "greenhouse";
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(NET_RECORD_KEY, ssid_only, sizeof(ssid_only)));
+    wifi_creds_t c = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, storage_record_load(&wifi_creds_schema, &c));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_struct_upgraded);
+    RUN_TEST(test_full_length_credentials);
+    RUN_TEST(test_wrong_size_blob_rejected);
+    return UNITY_END();
+}
@@ -16,6 +16,8 @@
 #include "secure_part.h"
 #include <strings.h>
 #include "storage.h"
+#include "telemetry.h"
+#include "ipc.h"
 
 static const char *TAG = "ota";
 
@@ -258,6 +260,11 @@ static esp_err_t ota_verify_manifest_signature(const cJSON *manifest, const char
     return ESP_OK;
 }
 
+// OTA abandoned at `stage`: audit record (success is not recorded, the device reboots at once)
+static void audit_fail(uint16_t stage, esp_err_t err) {
+    telemetry_audit_event(ACTOR_CLOUD, TELEMETRY_AUDIT_OTA_FAIL, stage, err, 0);
+}
+
 /**
  * @brief Main OTA task.
  */
@@ -272,6 +279,7 @@ static void ota_task(void *pvParameters) {
             cJSON *manifest = cJSON_Parse(manifest_str);
             if (!manifest) {
                 ESP_LOGE(TAG, "Failed to parse manifest JSON");
+                audit_fail(TELEMETRY_AUDIT_OTA_MANIFEST, ESP_FAIL);
                 free(manifest_str);
                 continue;
             }
@@ -284,14 +292,17 @@ static void ota_task(void *pvParameters) {
 
             if (!url || !digest_hex || !signature_b64 || !version_item) {
                 ESP_LOGE(TAG, "Manifest missing required fields");
+                audit_fail(TELEMETRY_AUDIT_OTA_MANIFEST, ESP_ERR_INVALID_ARG);
                 cJSON_Delete(manifest);
                 free(manifest_str);
                 continue;
             }
             
             // 1. Verify manifest signature
-            if (ota_verify_manifest_signature(manifest, digest_hex, signature_b64) != ESP_OK) {
+            esp_err_t sig_err = ota_verify_manifest_signature(manifest, digest_hex, signature_b64);
+            if (sig_err != ESP_OK) {
                 ESP_LOGE(TAG, "Manifest signature verification failed");
+                audit_fail(TELEMETRY_AUDIT_OTA_SIGNATURE, sig_err);
                 cJSON_Delete(manifest);
                 free(manifest_str);
                 continue;
@@ -306,6 +317,7 @@ static void ota_task(void *pvParameters) {
             bool allow_rollback = cJSON_IsTrue(cJSON_GetObjectItem(manifest, "allow_rollback"));
             if (!allow_rollback && new_version <= current_version) {
                 ESP_LOGE(TAG, "Rollback protection: new version (%d) is not greater than current version (%d)", new_version, current_version);
+                audit_fail(TELEMETRY_AUDIT_OTA_ROLLBACK, ESP_ERR_INVALID_VERSION);
                 cJSON_Delete(manifest);
                 free(manifest_str);
                 continue;
@@ -330,10 +342,12 @@ static void ota_task(void *pvParameters) {
                 .http_config = &http_cfg,
             };
 
+            telemetry_audit_event(ACTOR_CLOUD, TELEMETRY_AUDIT_OTA_START, 0, (int32_t)new_version, (int32_t)current_version);
             esp_https_ota_handle_t ota_handle = NULL;
             esp_err_t err = esp_https_ota_begin(&ota_cfg, &ota_handle);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "esp_https_ota_begin failed: %s", esp_err_to_name(err));
+                audit_fail(TELEMETRY_AUDIT_OTA_DOWNLOAD, err);
                 cJSON_Delete(manifest);
                 free(manifest_str);
                 continue;
@@ -343,6 +357,7 @@ static void ota_task(void *pvParameters) {
             err = ota_download_and_verify(ota_handle, digest_hex);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "Image verification failed");
+                audit_fail(TELEMETRY_AUDIT_OTA_DOWNLOAD, err);
                 esp_https_ota_abort(ota_handle);
                 cJSON_Delete(manifest);
                 free(manifest_str);
@@ -355,6 +370,7 @@ static void ota_task(void *pvParameters) {
             err = esp_https_ota_finish(ota_handle);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "esp_https_ota_finish failed: %s", esp_err_to_name(err));
+                audit_fail(TELEMETRY_AUDIT_OTA_FINISH, err);
             } else {
                 ESP_LOGI(TAG, "OTA update successful, persisting version and rebooting...");
                 storage_save_uint32("ota_version", new_version);
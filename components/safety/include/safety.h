@@ -18,9 +18,10 @@ esp_err_t safety_init(void);
 /**
  * @brief Trigger an immediate, safe shutdown of all actuators.
  *
- * This function sends a command to the control task to set all outputs to 0
- * with no ramp time. It can be called from any task.
+ * Forces all PWM outputs low through control_emergency_off(), cancelling any fade
+ * in flight, without going through the control task. Bounded latency; safe from any
+ * task and from ISR context. Latched until reboot.
  *
- * @return ESP_OK if the command was sent successfully, or an error code.
+ * @return ESP_OK (the outputs are off when this returns).
  */
 esp_err_t safety_safe_shutdown(void);
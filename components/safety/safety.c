@@ -3,6 +3,7 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
+#include "control.h"
 #include "ipc.h"
 #include "sdkconfig.h"
 #include <time.h>
@@ -55,22 +56,20 @@ esp_err_t safety_init(void)
 
 esp_err_t safety_safe_shutdown(void)
 {
-    ESP_LOGW(TAG, "Performing safe shutdown: disabling all actuators immediately.");
+    // Kill the outputs directly: no mailbox, no waiting for control_task or a running fade
+    control_emergency_off();
 
-    control_cmd_t cmd = {
-        .actor = ACTOR_SAFETY,
-        .ts = time(NULL),
-        .light_pct = 0,
-        .pump_pct = 0,
-        .ramp_ms = 0, // Apply instantly
-    };
-
-    // Use xQueueSendToFront to ensure this critical command is processed immediately.
-    if (xQueueSendToFront(g_cmd_queue, &cmd, 0) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to send shutdown command to control queue. Actuators may remain on.");
-        return ESP_FAIL;
+    // Record the shutdown as a (latched) safety command too, so the arbitration state and
+    // published owners reflect it. Skipped from ISRs, where ESP_LOG and time() don't belong.
+    if (!xPortInIsrContext()) {
+        ESP_LOGW(TAG, "Safe shutdown: all actuators forced off.");
+        control_cmd_t cmd = {
+            .actor = ACTOR_SAFETY,
+            .ts = time(NULL),
+            .channels = CMD_CH_ALL,
+            .ramp_ms = 0,
+        };
+        control_post_cmd(&cmd);
     }
-
     return ESP_OK;
 }
-
@@ -3,31 +3,125 @@
 #include <time.h>
 #include <esp_err.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 
 // Schedule component: compute next ON/OFF events based on UTC time + IANA TZ string.
 // Stores and retrieves schedules via storage component (blob API).
 
 typedef struct {
     int on_hour;   // 0-23 local
-    int pump_on_interval_min;    // 5-3600
+    int on_min;    // 0-59 local
     int off_hour;  // 0-23 local
+    int off_min;   // 0-59 local
+    int pump_on_interval_min;    // 5-3600
     int pump_on_duration_min;   // 1-3600
     char tz[64];   // IANA timezone string, e.g., "America/Los_Angeles"
 } schedule_t;
 
+// Daily program: a variable-length list of setpoints, each setting one channel to a level
+// from its minute until the next setpoint of that channel (wrapping across days and weeks).
+// When a program is saved it replaces the ON/OFF window of schedule_t for the light; a
+// program without pump setpoints keeps the pump waveform (or the cycle of schedule_t).
+#define SCHEDULE_CH_LIGHT       0   // control channel index (CMD_CH(n))
+#define SCHEDULE_CH_PUMP        1
+#define SCHEDULE_NUM_CHANNELS   2
+#define SCHEDULE_DAYS_ALL       0x7F
+#define SCHEDULE_MAX_SETPOINTS  256
+
+typedef struct {
+    uint16_t minute;    // local minute of day, 0-1439
+    uint8_t days;       // bit n = weekday n (0 = Sunday, as tm_wday)
+    uint8_t channel;    // SCHEDULE_CH_*
+    uint8_t pct;        // 0-100
+    uint8_t reserved;
+} schedule_setpoint_t;
+
+// Pump waveform: segments played back to back and repeated, phase-locked to the UTC epoch
+// so the pattern continues across reboots (e.g. 15 s on / 45 s off, or bursts of short
+// pulses). Edges are timed with esp_timer to a few milliseconds and go straight to control.
+// Without a saved waveform the pump follows the interval/duration of schedule_t.
+#define SCHEDULE_WAVE_MAX_SEGS      8
+#define SCHEDULE_WAVE_MIN_SEG_MS    100
+#define SCHEDULE_WAVE_MAX_PERIOD_MS (7u * 24 * 3600 * 1000)
+
+typedef struct {
+    uint32_t ms;        // segment length, >= SCHEDULE_WAVE_MIN_SEG_MS
+    uint8_t pct;        // pump level during the segment, 0-100
+    uint8_t reserved[3];
+} schedule_wave_seg_t;
+
+typedef struct {
+    uint8_t count;      // segments in use, 1..SCHEDULE_WAVE_MAX_SEGS
+    uint8_t reserved[3];
+    schedule_wave_seg_t seg[SCHEDULE_WAVE_MAX_SEGS];
+} schedule_pump_wave_t;
+
+typedef struct {
+    uint32_t wakeups;   // schedule_task wakeups since boot
+    uint32_t rebuilds;  // timeline compilations (config, DST or horizon)
+    uint32_t events;    // transitions applied
+    uint64_t cpu_us;    // time spent awake in schedule_task
+    uint32_t pump_edges;        // pump waveform level changes posted
+    uint32_t pump_late_max_us;  // worst delay of a waveform edge behind its wall-clock time
+    int64_t next_on_utc;        // next ON/OFF of the schedule_t window, as
+    int64_t next_off_utc;       // schedule_compute_next_events(); 0 before time sync
+} schedule_stats_t;
+
 // Initialize schedule subsystem
 esp_err_t schedule_init(void);
 
 // Load saved schedule; if not present, fills with defaults and returns ESP_OK
 esp_err_t schedule_load(schedule_t *out);
 
-// Save schedule
+// Save schedule; wakes schedule_task so the new schedule takes effect immediately. The
+// saves below return once storage_task has the data; schedule_load() and friends see it
+// at once and a failed flash write is logged.
 esp_err_t schedule_save(const schedule_t *s);
 
+// Save a program of `count` setpoints (any order; at most SCHEDULE_MAX_SETPOINTS) and wake
+// schedule_task. count == 0 removes the program and returns to the schedule_t window.
+esp_err_t schedule_program_save(const schedule_setpoint_t *sp, size_t count);
+
+// Load the saved program into `out` (room for `max` setpoints) and its length into `*count`.
+// Returns ESP_ERR_NOT_FOUND if none is saved, ESP_ERR_INVALID_SIZE if `max` is too small
+// (`*count` is then the need) and ESP_ERR_INVALID_VERSION if the stored one is corrupt.
+// `*count` is left alone on any other error.
+esp_err_t schedule_program_load(schedule_setpoint_t *out, size_t max, size_t *count);
+
+// Save the pump waveform and wake schedule_task. count == 0 removes it and returns to the
+// interval/duration of schedule_t. A program with pump setpoints overrides either.
+esp_err_t schedule_pump_wave_save(const schedule_pump_wave_t *w);
+
+// Load the saved pump waveform. Returns ESP_ERR_NOT_FOUND if none is saved.
+esp_err_t schedule_pump_wave_load(schedule_pump_wave_t *out);
+
+// schedule_task activity counters
+esp_err_t schedule_get_stats(schedule_stats_t *out);
+
 // Compute next ON and OFF event (UTC timestamps) relative to now_utc. Returns ESP_OK if computed.
 esp_err_t schedule_compute_next_events(time_t now_utc, const schedule_t *s, time_t *next_on_utc, time_t *next_off_utc);
 
-// Reconcile missed events since last_boot_utc and perform callback for each missed event (callback runs in caller context)
-// callback(event_is_on, event_time_utc, void *arg)
-typedef void (*schedule_event_cb_t)(bool on, time_t event_time_utc, void *arg);
-esp_err_t schedule_reconcile(time_t last_seen_utc, time_t now_utc, const schedule_t *s, schedule_event_cb_t cb, void *arg);
+// A transition that should have happened while the device was off
+typedef struct {
+    time_t at;          // UTC instant it was due
+    uint8_t channel;    // SCHEDULE_CH_*
+    uint8_t pct;        // level it would have set
+} schedule_missed_event_t;
+
+// Receives missed transitions in batches of up to SCHEDULE_MISSED_BATCH, oldest first
+#define SCHEDULE_MISSED_BATCH 8
+typedef void (*schedule_missed_cb_t)(const schedule_missed_event_t *ev, size_t count, void *arg);
+
+// Walk every transition in (last_seen_utc, now_utc] (multi-day gaps and DST changes included),
+// reporting each level change to `cb`, and return the levels in force at now_utc in `level`.
+// Intermediate states are not applied: the caller posts one command with `level`.
+// `missed` (optional) receives the number of transitions reported.
+esp_err_t schedule_reconcile(time_t last_seen_utc, time_t now_utc, const schedule_t *s,
+                             schedule_missed_cb_t cb, void *arg,
+                             uint8_t level[SCHEDULE_NUM_CHANNELS], size_t *missed);
+
+// Callback used by schedule_task for transitions missed while the device was off. The
+// last-seen time is persisted by schedule_task (RTC memory every wakeup, NVS at most every
+// CONFIG_SCHEDULE_LAST_SEEN_PERIOD_S) and reconciled once after the first time sync.
+void schedule_register_missed_callback(schedule_missed_cb_t cb, void *arg);
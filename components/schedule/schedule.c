@@ -5,20 +5,83 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
-#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include "storage.h"
+#include "schedule_record.h"
 #include "nvs.h"
 #include "sdkconfig.h"
 #include "ipc.h"
 #include "control.h"
+#include "telemetry.h"
+#include "schedule_program.h"
+#include "schedule_timeline.h"
+#include "schedule_wave.h"
+#include "schedule_pump.h"
+#include "schedule_run.h"
+#include "tz.h"
 
 static const char *TAG = "schedule";
 
-#define STORAGE_KEY_SCHEDULE "schedule_cfg"
+#define STORAGE_KEY_SCHEDULE SCHEDULE_RECORD_KEY
+#define STORAGE_KEY_PROGRAM  "sched_prog"
+#define PROGRAM_VERSION      1
+#define STORAGE_KEY_LAST_SEEN "sched_seen"
+#define STORAGE_KEY_WAVE     "sched_wave"
+#define LAST_SEEN_RTC_MAGIC  0x5345454E  // "SEEN"
+
+// Pump cycles are aligned to whole intervals since the UTC epoch, so they sit at the same
+// instants across reboots and missed ones can be reconstructed
+#define PUMP_ANCHOR_UTC      0
+
+#ifdef CONFIG_SCHEDULE_PUMP_WAVE
+#define PUMP_WAVE_ENABLED    true
+#else
+#define PUMP_WAVE_ENABLED    false
+#endif
+
+// Stored program: header followed by `count` setpoints
+typedef struct {
+    uint16_t version;
+    uint16_t count;
+} program_hdr_t;
 
 // Forward declaration
 static void schedule_task(void *arg);
 
+static TaskHandle_t s_task;
+static schedule_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static schedule_missed_cb_t s_missed_cb;
+static void *s_missed_cb_arg;
+
+// Last time the schedule state was known applied. RTC memory survives soft resets and
+// costs nothing to update; NVS covers power loss and is written at a bounded rate.
+static RTC_NOINIT_ATTR struct {
+    uint32_t magic;
+    uint32_t seen_utc;
+} s_rtc_seen;
+static time_t s_seen_written;
+
+// Waveform edges, from the esp_timer task: straight to the control mailbox
+static void post_pump_wave(uint8_t pct, void *arg)
+{
+    control_cmd_t cmd = {
+        .actor = ACTOR_SCHEDULE,
+        .ts = time(NULL),
+        .channels = CMD_CH(SCHEDULE_CH_PUMP),
+    };
+    cmd.pct[SCHEDULE_CH_PUMP] = pct;
+    control_post_cmd(&cmd);
+}
+
+// A stored input of the timeline changed (only saves with new content get here): recompile
+// now rather than at the next transition
+static void on_config_change(const char *key, uint32_t version, void *arg)
+{
+    if (s_task) xTaskNotifyGive(s_task);
+}
+
 esp_err_t schedule_init(void)
 {
     // This function is called from app_main, which already initializes storage.
@@ -26,12 +89,22 @@ esp_err_t schedule_init(void)
 
     // Load the schedule to apply timezone early.
     schedule_t s;
-    if (schedule_load(&s) == ESP_OK && s.tz[0]) {
-        setenv("TZ", s.tz, 1);
-        tzset();
+    if (schedule_load(&s) == ESP_OK && s.tz[0]) tz_set(s.tz);
+
+    const char *inputs[] = { STORAGE_KEY_SCHEDULE, STORAGE_KEY_PROGRAM, STORAGE_KEY_WAVE };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        if (storage_subscribe(inputs[i], on_config_change, NULL) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to subscribe to '%s'", inputs[i]);
+            return ESP_FAIL;
+        }
+    }
+
+    if (schedule_pump_init(post_pump_wave, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the pump waveform timer");
+        return ESP_FAIL;
     }
 
-    BaseType_t r = xTaskCreate(schedule_task, "schedule_task", 4096, NULL, 5, NULL);
+    BaseType_t r = xTaskCreate(schedule_task, "schedule_task", 4096, NULL, 5, &s_task);
     if (r != pdPASS) {
         ESP_LOGE(TAG, "Failed to create schedule_task");
         return ESP_FAIL;
@@ -47,6 +120,8 @@ static void fill_defaults(schedule_t *s)
     s->on_min = 0;
     s->off_hour = CONFIG_SCHEDULE_DEFAULT_OFF_HOUR;
     s->off_min = 0;
+    s->pump_on_interval_min = CONFIG_SCHEDULE_PUMP_ON_INTERVAL_MIN;
+    s->pump_on_duration_min = CONFIG_SCHEDULE_PUMP_ON_DURATION_MIN;
     strncpy(s->tz, CONFIG_SCHEDULE_DEFAULT_TZ, sizeof(s->tz) - 1);
     s->tz[sizeof(s->tz) - 1] = '\0';
 }
@@ -55,10 +130,11 @@ esp_err_t schedule_load(schedule_t *out)
 {
     if (!out) return ESP_ERR_INVALID_ARG;
 
-    size_t len = sizeof(schedule_t);
-    esp_err_t err = storage_load_config(STORAGE_KEY_SCHEDULE, out, &len);
+    // Fields the stored record lacks (saved before they existed) keep their defaults
+    fill_defaults(out);
+    esp_err_t err = storage_record_load(&schedule_schema, out);
 
-    if (err == ESP_OK && len == sizeof(schedule_t)) {
+    if (err == ESP_OK) {
         ESP_LOGI(TAG, "Loaded schedule: ON %02d:%02d, OFF %02d:%02d, TZ=%s",
                  out->on_hour, out->on_min, out->off_hour, out->off_min, out->tz);
         return ESP_OK;
@@ -67,152 +143,357 @@ esp_err_t schedule_load(schedule_t *out)
     if (err == ESP_ERR_NVS_NOT_FOUND) {
         ESP_LOGI(TAG, "No schedule found in NVS, using defaults.");
     } else {
-        ESP_LOGW(TAG, "Failed to load schedule (err=%s, len=%d), using defaults.", esp_err_to_name(err), len);
+        ESP_LOGW(TAG, "Failed to load schedule (err=%s), using defaults.", esp_err_to_name(err));
     }
 
     fill_defaults(out);
     return schedule_save(out); // Save defaults back to NVS
 }
 
+// Saves are written by storage_task: callers (BLE and MQTT handlers among them) do not
+// wait for flash, loads see the new value at once, and schedule_task is woken by the
+// change notification once it is in flash
+static void on_save_done(const char *key, esp_err_t err, void *arg)
+{
+    if (err != ESP_OK) ESP_LOGE(TAG, "Failed to write '%s': %s", key, esp_err_to_name(err));
+}
+
 esp_err_t schedule_save(const schedule_t *s)
 {
     if (!s) return ESP_ERR_INVALID_ARG;
-    esp_err_t err = storage_save_config(STORAGE_KEY_SCHEDULE, s, sizeof(*s));
+    esp_err_t err = storage_record_save_async(&schedule_schema, s, on_save_done, NULL);
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "Saved schedule: ON %02d:%02d, OFF %02d:%02d, TZ=%s",
                  s->on_hour, s->on_min, s->off_hour, s->off_min, s->tz);
-        // Apply the new timezone immediately
-        setenv("TZ", s->tz, 1);
-        tzset();
+        // Apply the new timezone immediately; an unknown one keeps the current zone
+        if (s->tz[0]) tz_set(s->tz);
     } else {
         ESP_LOGE(TAG, "Failed to save schedule: %s", esp_err_to_name(err));
     }
     return err;
 }
 
-// Helper to build a time_t for the next occurrence of hour:min, starting from a given date.
-// It correctly handles advancing to the next day if the time has already passed.
-static time_t get_next_event_time(time_t now_utc, int hour, int min)
+esp_err_t schedule_program_save(const schedule_setpoint_t *sp, size_t count)
 {
-    struct tm local_tm;
-    localtime_r(&now_utc, &local_tm);
-
-    struct tm event_tm = local_tm;
-    event_tm.tm_hour = hour;
-    event_tm.tm_min = min;
-    event_tm.tm_sec = 0;
-
-    time_t event_utc = mktime(&event_tm);
+    esp_err_t err = schedule_program_validate(sp, count);
+    if (err != ESP_OK) return err;
+
+    size_t len = sizeof(program_hdr_t) + count * sizeof(*sp);
+    uint8_t *blob = malloc(len);
+    if (!blob) return ESP_ERR_NO_MEM;
+    program_hdr_t hdr = { .version = PROGRAM_VERSION, .count = (uint16_t)count };
+    memcpy(blob, &hdr, sizeof(hdr));
+    if (count) memcpy(blob + sizeof(hdr), sp, count * sizeof(*sp));
+    err = storage_save_config_async(STORAGE_KEY_PROGRAM, blob, len, on_save_done, NULL);
+    free(blob);
 
-    // If the calculated event time is in the past, calculate it for the next day.
-    if (event_utc <= now_utc) {
-        event_tm.tm_mday += 1;
-        // mktime handles month/year rollovers
-        event_utc = mktime(&event_tm);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Saved program: %u setpoints", (unsigned)count);
+    } else {
+        ESP_LOGE(TAG, "Failed to save program: %s", esp_err_to_name(err));
     }
-    return event_utc;
+    return err;
 }
 
-esp_err_t schedule_compute_next_events(time_t now_utc, const schedule_t *s, time_t *next_on_utc, time_t *next_off_utc)
+esp_err_t schedule_program_load(schedule_setpoint_t *out, size_t max, size_t *count)
 {
-    if (!s || !next_on_utc || !next_off_utc) return ESP_ERR_INVALID_ARG;
+    if (!count || (max && !out)) return ESP_ERR_INVALID_ARG;
+
+    size_t len = 0;
+    esp_err_t err = storage_load_config(STORAGE_KEY_PROGRAM, NULL, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK) return err;
+    // A stored length that cannot be a program is corrupt, like a bad header below:
+    // ESP_ERR_INVALID_SIZE only ever means `max` is too small
+    if (len < sizeof(program_hdr_t) || (len - sizeof(program_hdr_t)) % sizeof(*out) != 0) {
+        return ESP_ERR_INVALID_VERSION;
+    }
 
-    *next_on_utc = get_next_event_time(now_utc, s->on_hour, s->on_min);
-    *next_off_utc = get_next_event_time(now_utc, s->off_hour, s->off_min);
+    uint8_t *blob = malloc(len);
+    if (!blob) return ESP_ERR_NO_MEM;
+    err = storage_load_config(STORAGE_KEY_PROGRAM, blob, &len);
+    if (err == ESP_OK) {
+        program_hdr_t hdr;
+        memcpy(&hdr, blob, sizeof(hdr));
+        if (hdr.version != PROGRAM_VERSION || len != sizeof(hdr) + hdr.count * sizeof(*out)) {
+            err = ESP_ERR_INVALID_VERSION;
+        } else if (hdr.count > max) {
+            // The documented exception: *count carries the size needed
+            *count = hdr.count;
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            memcpy(out, blob + sizeof(hdr), hdr.count * sizeof(*out));
+            err = schedule_program_validate(out, hdr.count);
+            if (err == ESP_OK) *count = hdr.count;
+        }
+    }
+    free(blob);
+    return err;
+}
 
-    return ESP_OK;
+esp_err_t schedule_pump_wave_save(const schedule_pump_wave_t *w)
+{
+    if (!w) return ESP_ERR_INVALID_ARG;
+    schedule_pump_wave_t copy = {0};
+    if (w->count) {
+        esp_err_t err = schedule_wave_validate(w);
+        if (err != ESP_OK) return err;
+        copy = *w;
+    }
+    esp_err_t err = storage_save_config_async(STORAGE_KEY_WAVE, &copy, sizeof(copy), on_save_done, NULL);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Saved pump waveform: %u segments, period %u ms",
+                 copy.count, (unsigned)(copy.count ? schedule_wave_period_ms(&copy) : 0));
+    } else {
+        ESP_LOGE(TAG, "Failed to save pump waveform: %s", esp_err_to_name(err));
+    }
+    return err;
 }
 
-/**
- * @brief Determines if, according to the schedule, the lights should currently be ON.
- *
- * This function handles the case where the ON/OFF times span across midnight.
- * E.g., ON at 22:00, OFF at 06:00.
- */
-static bool is_currently_on(time_t now_utc, const schedule_t *s)
+esp_err_t schedule_pump_wave_load(schedule_pump_wave_t *out)
 {
-    struct tm local_tm;
-    localtime_r(&now_utc, &local_tm);
+    if (!out) return ESP_ERR_INVALID_ARG;
+    size_t len = sizeof(*out);
+    esp_err_t err = storage_load_config(STORAGE_KEY_WAVE, out, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND || (err == ESP_OK && out->count == 0)) return ESP_ERR_NOT_FOUND;
+    if (err == ESP_OK && len != sizeof(*out)) err = ESP_ERR_INVALID_SIZE;
+    if (err == ESP_OK) err = schedule_wave_validate(out);
+    return err;
+}
 
-    int now_min_of_day = local_tm.tm_hour * 60 + local_tm.tm_min;
-    int on_min_of_day = s->on_hour * 60 + s->on_min;
-    int off_min_of_day = s->off_hour * 60 + s->off_min;
+// Waveform for the pump, unless the program drives it or the generator is disabled
+static bool pump_wave_for(const schedule_week_t *week, const schedule_t *s, schedule_pump_wave_t *w)
+{
+    if (!PUMP_WAVE_ENABLED || week->n[SCHEDULE_CH_PUMP] > 0) return false;
+    esp_err_t err = schedule_pump_wave_load(w);
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "Pump waveform unusable (%s); using the interval", esp_err_to_name(err));
+        }
+        schedule_wave_from_legacy(s, CONFIG_SCHEDULE_PUMP_ON_PCT, w);
+    }
+    return true;
+}
 
-    if (on_min_of_day < off_min_of_day) {
-        // Simple case: ON and OFF are on the same day.
-        // e.g., ON 07:00, OFF 21:00
-        return now_min_of_day >= on_min_of_day && now_min_of_day < off_min_of_day;
+// Compile the saved program, or the ON/OFF window of `s` if there is none
+static esp_err_t compile_program(const schedule_t *s, schedule_week_t *w)
+{
+    schedule_setpoint_t legacy[2];
+    size_t n = 0;
+    schedule_setpoint_t *sp = malloc(SCHEDULE_MAX_SETPOINTS * sizeof(*sp));
+    esp_err_t err = sp ? schedule_program_load(sp, SCHEDULE_MAX_SETPOINTS, &n) : ESP_ERR_NO_MEM;
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Program unusable (%s); using the ON/OFF window", esp_err_to_name(err));
+    }
+    if (err != ESP_OK || n == 0) {
+        err = schedule_week_compile(w, legacy, schedule_program_from_legacy(s, CONFIG_SCHEDULE_LIGHT_ON_PCT, legacy));
     } else {
-        // Overnight case: ON time is later than OFF time.
-        // e.g., ON 22:00, OFF 06:00
-        return now_min_of_day >= on_min_of_day || now_min_of_day < off_min_of_day;
+        err = schedule_week_compile(w, sp, n);
+        ESP_LOGI(TAG, "Program: %u setpoints (light %u, pump %u per week)",
+                 (unsigned)n, w->n[SCHEDULE_CH_LIGHT], w->n[SCHEDULE_CH_PUMP]);
     }
+    free(sp);
+    return err;
 }
 
+static esp_err_t reconcile_week(const schedule_week_t *week, const schedule_t *s, time_t from, time_t to,
+                                schedule_missed_cb_t cb, void *arg,
+                                uint8_t level[SCHEDULE_NUM_CHANNELS], size_t *missed)
+{
+    schedule_pump_wave_t wave;
+    schedule_timeline_cfg_t cfg = {
+        .pump_on_pct = CONFIG_SCHEDULE_PUMP_ON_PCT,
+        .pump_anchor = PUMP_ANCHOR_UTC,
+        .pump_wave = pump_wave_for(week, s, &wave),
+    };
+    return schedule_run_reconcile(week, s, &cfg, &wave, from, to, cb, arg, level, missed);
+}
 
-esp_err_t schedule_reconcile(time_t last_seen_utc, time_t now_utc, const schedule_t *s, schedule_event_cb_t cb, void *arg)
+esp_err_t schedule_reconcile(time_t last_seen_utc, time_t now_utc, const schedule_t *s,
+                             schedule_missed_cb_t cb, void *arg,
+                             uint8_t level[SCHEDULE_NUM_CHANNELS], size_t *missed)
 {
-    if (!s || !cb) return ESP_ERR_INVALID_ARG;
-    if (last_seen_utc >= now_utc) return ESP_OK;
+    if (!s || !level) return ESP_ERR_INVALID_ARG;
+    if (last_seen_utc > now_utc) last_seen_utc = now_utc;
 
-    // The most reliable way to reconcile is to check the state at `last_seen_utc`
-    // and the state at `now_utc`. If they are different, we know a transition was missed.
-    // A full reconciliation of all missed events is complex with DST. This is a robust simplification.
+    schedule_week_t week = {0};
+    esp_err_t err = compile_program(s, &week);
+    if (err == ESP_OK) err = reconcile_week(&week, s, last_seen_utc, now_utc, cb, arg, level, missed);
+    schedule_week_free(&week);
+    return err;
+}
 
-    bool was_on = is_currently_on(last_seen_utc, s);
-    bool should_be_on = is_currently_on(now_utc, s);
+void schedule_register_missed_callback(schedule_missed_cb_t cb, void *arg)
+{
+    s_missed_cb = cb;
+    s_missed_cb_arg = arg;
+}
 
-    if (was_on != should_be_on) {
-        ESP_LOGI(TAG, "Reconciling state change: was %s, should be %s", was_on ? "ON" : "OFF", should_be_on ? "ON" : "OFF");
-        // We fire a single callback to get the system into the correct state.
-        // We use `now_utc` as the event time.
-        cb(should_be_on, now_utc, arg);
-    } else {
-        ESP_LOGI(TAG, "No state change to reconcile.");
+// A schedule change while BLE/cloud holds the channel is stored by control as the value
+// to return to when the override ends; it does not wake control_task or restart a fade.
+static void note_override(int ch)
+{
+    control_state_t st;
+    if (control_get_state(&st) == ESP_OK && st.owner[ch] != ACTOR_SCHEDULE && st.owner[ch] != ACTOR_UNKNOWN) {
+        ESP_LOGI(TAG, "ch%d held by actor %u; schedule change applies when the override ends", ch, st.owner[ch]);
     }
-
-    return ESP_OK;
 }
 
-static void send_control_cmd(bool is_on)
+static void post_level(int ch, uint8_t pct)
 {
-    // Preserve current pump setting; only change light according to schedule
-    control_state_t st = {0};
-    uint8_t pump_pct = 0;
-    if (control_get_state(&st) == ESP_OK) {
-        pump_pct = st.pump_pct;
+    control_cmd_t cmd = {
+        .actor = ACTOR_SCHEDULE,
+        .ts = time(NULL),
+        .channels = CMD_CH(ch),
+        .ramp_ms = ch == SCHEDULE_CH_LIGHT ? 1000 : 500,
+    };
+    cmd.pct[ch] = pct;
+    if (control_post_cmd(&cmd) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post ch%d command to control", ch);
+    } else {
+        note_override(ch);
+        telemetry_audit_event(ACTOR_SCHEDULE, TELEMETRY_AUDIT_SCHED_STEP, CMD_CH(ch), pct, 0);
+        ESP_LOGI(TAG, "%s -> %u%%", ch == SCHEDULE_CH_LIGHT ? "Light" : "Pump", pct);
     }
+}
+
+// Initial and reconciled state: every channel in `mask` in a single command
+static void post_levels(const uint8_t level[SCHEDULE_NUM_CHANNELS], uint8_t mask)
+{
     control_cmd_t cmd = {
         .actor = ACTOR_SCHEDULE,
         .ts = time(NULL),
-        .light_pct = is_on ? CONFIG_SCHEDULE_LIGHT_ON_PCT : 0,
-        .pump_pct = pump_pct,
         .ramp_ms = 1000,
     };
-    if (xQueueSend(g_cmd_queue, &cmd, 0) != pdPASS) {
-        ESP_LOGW(TAG, "Failed to send command to control queue");
+    for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+        if (!(mask & CMD_CH(ch))) continue;
+        cmd.channels |= CMD_CH(ch);
+        cmd.pct[ch] = level[ch];
+    }
+    if (control_post_cmd(&cmd) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post schedule state to control");
+        return;
+    }
+    for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+        if (!(mask & CMD_CH(ch))) continue;
+        note_override(ch);
+        telemetry_audit_event(ACTOR_SCHEDULE, TELEMETRY_AUDIT_SCHED_STEP, CMD_CH(ch), level[ch], 0);
+    }
+    if (mask & CMD_CH(SCHEDULE_CH_PUMP)) {
+        ESP_LOGI(TAG, "Light -> %u%%, Pump -> %u%%", level[SCHEDULE_CH_LIGHT], level[SCHEDULE_CH_PUMP]);
+    } else {
+        ESP_LOGI(TAG, "Light -> %u%%, Pump follows its waveform", level[SCHEDULE_CH_LIGHT]);
+    }
+}
+
+static time_t load_last_seen(void)
+{
+    uint32_t seen = 0;
+    storage_load_uint32(STORAGE_KEY_LAST_SEEN, &seen);
+    // The RTC copy is newer when it survived a soft reset
+    if (s_rtc_seen.magic == LAST_SEEN_RTC_MAGIC && s_rtc_seen.seen_utc > seen) {
+        seen = s_rtc_seen.seen_utc;
+    }
+    return (time_t)seen;
+}
+
+static void mark_seen(time_t now, bool force)
+{
+    s_rtc_seen.seen_utc = (uint32_t)now;
+    s_rtc_seen.magic = LAST_SEEN_RTC_MAGIC;
+    if (force || now - s_seen_written >= CONFIG_SCHEDULE_LAST_SEEN_PERIOD_S) {
+        if (storage_save_uint32_async(STORAGE_KEY_LAST_SEEN, (uint32_t)now, NULL, NULL) == ESP_OK) {
+            s_seen_written = now;
+        }
+    }
+}
+
+// Walk what was missed since the device last ran the schedule; the audit path gets every
+// transition, control gets only the resulting state
+static void reconcile_on_boot(const schedule_week_t *week, const schedule_t *s, time_t now)
+{
+    time_t seen = load_last_seen();
+    if (seen == 0) {
+        ESP_LOGI(TAG, "No last-seen time; nothing to reconcile");
+        return;
+    }
+    if (seen > now) seen = now;
+    time_t earliest = now - (time_t)CONFIG_SCHEDULE_RECONCILE_MAX_DAYS * 86400;
+    if (seen < earliest) {
+        ESP_LOGW(TAG, "Offline since %lld; reconciling the last %d days only",
+                 (long long)seen, CONFIG_SCHEDULE_RECONCILE_MAX_DAYS);
+        seen = earliest;
+    }
+    uint8_t level[SCHEDULE_NUM_CHANNELS];
+    size_t missed = 0;
+    if (reconcile_week(week, s, seen, now, s_missed_cb, s_missed_cb_arg, level, &missed) == ESP_OK) {
+        ESP_LOGI(TAG, "Reconciled %u missed transitions over %lld s", (unsigned)missed, (long long)(now - seen));
     }
 }
 
+esp_err_t schedule_get_stats(schedule_stats_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    schedule_pump_get_stats(&out->pump_edges, &out->pump_late_max_us);
+    return ESP_OK;
+}
+
+// Timeline compiled since the last call: log it and count it
+static void note_rebuilds(const schedule_run_t *run, uint32_t *seen)
+{
+    if (run->rebuilds == *seen) return;
+    ESP_LOGI(TAG, "Timeline: %u transitions until %lld (UTC%+ld s)",
+             run->tl.count, (long long)run->tl.valid_until, (long)run->tl.utc_offset);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.rebuilds += run->rebuilds - *seen;
+    portEXIT_CRITICAL(&s_stats_lock);
+    *seen = run->rebuilds;
+}
+
+// Next ON/OFF of the window, kept with the stats so the heartbeat needs neither the stored
+// schedule nor tz. Recomputed when the schedule changed or one of them has passed.
+static void note_next_events(const schedule_t *s, time_t now, bool changed)
+{
+    if (!changed && now < s_stats.next_on_utc && now < s_stats.next_off_utc) return;
+    time_t on = 0, off = 0;
+    schedule_compute_next_events(now, s, &on, &off);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.next_on_utc = on;
+    s_stats.next_off_utc = off;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void post_level_cb(int ch, uint8_t pct, void *arg)
+{
+    post_level(ch, pct);
+}
+
+// `s` seconds as a timeout. pdMS_TO_TICKS() multiplies in TickType_t, which wraps past
+// 42949 s at 100 Hz; kept below portMAX_DELAY, which would never time out.
+static TickType_t sleep_ticks(time_t s)
+{
+    if (s <= 0) return 0;
+    uint64_t ticks = (uint64_t)s * configTICK_RATE_HZ;
+    return ticks < portMAX_DELAY ? (TickType_t)ticks : portMAX_DELAY - 1;
+}
+
 static void schedule_task(void *arg)
 {
     ESP_LOGI(TAG, "schedule_task starting");
-    ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
 
-    // Wait for time to be synchronized before starting the main loop
+    // Wait for time to be synchronized before starting the main loop. Nothing to do until
+    // then, so block outright instead of polling.
     ESP_LOGI(TAG, "Waiting for time sync...");
-    while (true) {
-        EventBits_t b = xEventGroupWaitBits(g_net_state_event_group, NET_BIT_TIME_SYNCED,
-                                            pdFALSE, pdTRUE, pdMS_TO_TICKS(1000));
-        ESP_ERROR_CHECK(esp_task_wdt_reset());
-        if (b & NET_BIT_TIME_SYNCED) break;
-    }
+    xEventGroupWaitBits(g_net_state_event_group, NET_BIT_TIME_SYNCED, pdFALSE, pdTRUE, portMAX_DELAY);
     // Print current UTC and local time after sync
     time_t now = time(NULL);
     struct tm tm_utc = {0}, tm_loc = {0};
     char buf_utc[32] = {0}, buf_loc[48] = {0};
     gmtime_r(&now, &tm_utc);
-    localtime_r(&now, &tm_loc);
+    tz_localtime(now, &tm_loc);
     strftime(buf_utc, sizeof(buf_utc), "%Y-%m-%d %H:%M:%S UTC", &tm_utc);
     strftime(buf_loc, sizeof(buf_loc), "%Y-%m-%d %H:%M:%S %Z", &tm_loc);
     ESP_LOGI(TAG, "Time is synchronized: %s | Local: %s | epoch=%lld",
@@ -220,81 +501,67 @@ static void schedule_task(void *arg)
 
     schedule_t s;
     schedule_load(&s);
-
-    // Set initial state and remember it
-    bool last_on = is_currently_on(time(NULL), &s);
-    ESP_LOGI(TAG, "Initial schedule state is %s", last_on ? "ON" : "OFF");
-    send_control_cmd(last_on);
-
-    // Initialize pump cycle state
-    uint32_t pump_on_pct = CONFIG_SCHEDULE_PUMP_ON_PCT;
-    int pump_duration_min = CONFIG_SCHEDULE_PUMP_ON_DURATION_MIN;
-    int pump_interval_min = CONFIG_SCHEDULE_PUMP_ON_INTERVAL_MIN;
-    if (pump_interval_min < pump_duration_min) {
-        ESP_LOGW(TAG, "Pump interval (%d) < duration (%d); clamping interval=duration", pump_interval_min, pump_duration_min);
-        pump_interval_min = pump_duration_min;
+    if (s.pump_on_interval_min < s.pump_on_duration_min) {
+        ESP_LOGW(TAG, "Pump interval (%d) < duration (%d); clamping interval=duration",
+                 s.pump_on_interval_min, s.pump_on_duration_min);
     }
-    time_t start_epoch = time(NULL); // anchor for cycles
-    // Align to the next minute boundary for consistent cadence
-    start_epoch = start_epoch - (start_epoch % 60);
-
-    for (;;) {
-        ESP_ERROR_CHECK(esp_task_wdt_reset());
 
-        // Reload schedule in case it was changed by another task (e.g., BLE)
-        schedule_load(&s);
-
-        time_t now_utc = time(NULL);
-        bool should_be_on = is_currently_on(now_utc, &s);
-        if (should_be_on != last_on) {
-            ESP_LOGI(TAG, "Minute check: state changed -> %s", should_be_on ? "ON" : "OFF");
-            send_control_cmd(should_be_on);
-            last_on = should_be_on;
-        } else {
-            ESP_LOGD(TAG, "Minute check: no change (%s)", should_be_on ? "ON" : "OFF");
-        }
+    static schedule_week_t week;
+    static schedule_run_t run = {
+        .cfg = {
+            .pump_on_pct = CONFIG_SCHEDULE_PUMP_ON_PCT,
+            .pump_anchor = PUMP_ANCHOR_UTC,
+        },
+    };
+    uint32_t rebuilds_seen = 0;
+    schedule_pump_wave_t wave;
+    compile_program(&s, &week);
+    run.cfg.pump_wave = pump_wave_for(&week, &s, &wave);
+    reconcile_on_boot(&week, &s, now);
+    schedule_run_start(&run, &week, &s, now);
+    note_rebuilds(&run, &rebuilds_seen);
+    note_next_events(&s, now, true);
+
+    // Set initial state (the outcome of any missed transitions) and remember it
+    ESP_LOGI(TAG, "Initial schedule state is %s", run.level[SCHEDULE_CH_LIGHT] ? "ON" : "OFF");
+    post_levels(run.level, schedule_run_channels(&run));
+    if (run.cfg.pump_wave) schedule_pump_start(&wave);
+    mark_seen(now, true);
 
-        // Pump cycle: ON for duration then OFF, with interval
-        // Compute minutes since anchor
-        int minutes_since_anchor = (int)((now_utc - start_epoch) / 60);
-        int minutes_into_cycle = minutes_since_anchor % pump_interval_min;
-        bool pump_should_be_on = minutes_into_cycle < pump_duration_min;
-        // Apply pump state without altering intended light schedule state
-        uint8_t desired_light = last_on ? CONFIG_SCHEDULE_LIGHT_ON_PCT : 0;
-        uint8_t desired_pump = pump_should_be_on ? pump_on_pct : 0;
-        // Send only if a change is needed vs. last commanded state (approximate)
-        static uint8_t last_cmd_light = 0, last_cmd_pump = 0;
-        if (desired_light != last_cmd_light || desired_pump != last_cmd_pump) {
-            control_cmd_t pump_cmd = {
-                .actor = ACTOR_SCHEDULE,
-                .ts = now_utc,
-                .seq = 0,
-                .light_pct = desired_light,
-                .pump_pct = desired_pump,
-                .ramp_ms = 500,
-            };
-            if (xQueueSend(g_cmd_queue, &pump_cmd, 0) != pdPASS) {
-                ESP_LOGW(TAG, "Failed to send pump control command");
-            } else {
-                last_cmd_light = desired_light;
-                last_cmd_pump = desired_pump;
-                ESP_LOGI(TAG, "Pump %s (%u%%) [cycle %d/%d min]",
-                         pump_should_be_on ? "ON" : "OFF", desired_pump,
-                         minutes_into_cycle + 1, pump_interval_min);
+    for (;;) {
+        // Block until the next transition or a change of the stored schedule. The sleep is
+        // capped so a wall-clock step (SNTP correction) is picked up within the cap.
+        now = time(NULL);
+        time_t wake_at = schedule_run_wake_at(&run, now, CONFIG_SCHEDULE_MAX_SLEEP_S);
+        bool changed = ulTaskNotifyTake(pdTRUE, sleep_ticks(wake_at - now)) != 0;
+
+        int64_t t0 = esp_timer_get_time();
+        now = time(NULL);
+        if (changed) {
+            schedule_load(&s);
+            compile_program(&s, &week);
+            bool was_wave = run.cfg.pump_wave;
+            run.cfg.pump_wave = pump_wave_for(&week, &s, &wave);
+            if (run.cfg.pump_wave) {
+                // Restarts in phase with the wall clock and posts the level right away
+                schedule_pump_start(&wave);
+            } else if (was_wave) {
+                // The program takes the pump over: post its level below whatever it is
+                schedule_pump_stop();
+                run.level[SCHEDULE_CH_PUMP] = UINT8_MAX;
             }
         }
-
-        // Sleep until next minute boundary, feeding WDT in chunks
-    int sec_into_min = (int)(now_utc % 60);
-        int sleep_s = 60 - sec_into_min;
-        if (sleep_s <= 0) sleep_s = 60;
-    // Feed WDT more frequently than its timeout (typically 5s)
-    const int chunk = 1;
-        while (sleep_s > 0) {
-            int d = (sleep_s > chunk) ? chunk : sleep_s;
-            vTaskDelay(pdMS_TO_TICKS(d * 1000));
-            sleep_s -= d;
-            ESP_ERROR_CHECK(esp_task_wdt_reset());
-        }
+        uint32_t applied = schedule_run_step(&run, &week, &s, now, changed, post_level_cb, NULL);
+        note_rebuilds(&run, &rebuilds_seen);
+        note_next_events(&s, now, changed);
+
+        mark_seen(now, false);
+
+        int64_t dt = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.wakeups++;
+        s_stats.events += applied;
+        s_stats.cpu_us += (uint64_t)dt;
+        portEXIT_CRITICAL(&s_stats_lock);
     }
 }
@@ -0,0 +1,148 @@
+#include "schedule_program.h"
+#include "tz.h"
+#include <stdlib.h>
+#include <string.h>
+
+esp_err_t schedule_program_validate(const schedule_setpoint_t *sp, size_t count)
+{
+    if (count > SCHEDULE_MAX_SETPOINTS || (count && !sp)) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < count; ++i) {
+        if (sp[i].minute >= SCHEDULE_MIN_PER_DAY || sp[i].days == 0 || sp[i].days > SCHEDULE_DAYS_ALL ||
+            sp[i].channel >= SCHEDULE_NUM_CHANNELS || sp[i].pct > 100) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+size_t schedule_program_from_legacy(const schedule_t *s, uint8_t light_on_pct, schedule_setpoint_t out[2])
+{
+    int on = s->on_hour * 60 + s->on_min;
+    int off = s->off_hour * 60 + s->off_min;
+    if (on == off || on < 0 || off < 0 || on >= SCHEDULE_MIN_PER_DAY || off >= SCHEDULE_MIN_PER_DAY) {
+        return 0;
+    }
+    out[0] = (schedule_setpoint_t){ .minute = on, .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_LIGHT, .pct = light_on_pct };
+    out[1] = (schedule_setpoint_t){ .minute = off, .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_LIGHT, .pct = 0 };
+    return 2;
+}
+
+// Helper to build a time_t for the next occurrence of hour:min, starting from a given date.
+// It correctly handles advancing to the next day if the time has already passed.
+static time_t get_next_event_time(time_t now_utc, int hour, int min)
+{
+    int64_t local = tz_to_local(now_utc);
+    int64_t midnight = local - (local % 86400 + 86400) % 86400;
+    time_t event_utc = tz_to_utc(midnight + hour * 3600 + min * 60);
+
+    // If the calculated event time is in the past, calculate it for the next day.
+    if (event_utc <= now_utc) {
+        event_utc = tz_to_utc(midnight + 86400 + hour * 3600 + min * 60);
+    }
+    return event_utc;
+}
+
+esp_err_t schedule_compute_next_events(time_t now_utc, const schedule_t *s, time_t *next_on_utc, time_t *next_off_utc)
+{
+    if (!s || !next_on_utc || !next_off_utc) return ESP_ERR_INVALID_ARG;
+
+    *next_on_utc = get_next_event_time(now_utc, s->on_hour, s->on_min);
+    *next_off_utc = get_next_event_time(now_utc, s->off_hour, s->off_min);
+
+    return ESP_OK;
+}
+
+
+// Sort key: channel, minute of the week, position in the program
+typedef struct {
+    uint16_t mow;
+    uint16_t idx;
+    uint8_t ch;
+    uint8_t pct;
+} expand_t;
+
+static int cmp_expand(const void *a, const void *b)
+{
+    const expand_t *x = a, *y = b;
+    if (x->ch != y->ch) return x->ch - y->ch;
+    if (x->mow != y->mow) return x->mow - y->mow;
+    return x->idx - y->idx;
+}
+
+esp_err_t schedule_week_compile(schedule_week_t *w, const schedule_setpoint_t *sp, size_t count)
+{
+    esp_err_t err = schedule_program_validate(sp, count);
+    if (err != ESP_OK) return err;
+    schedule_week_free(w);
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) total += __builtin_popcount(sp[i].days);
+    if (total == 0) return ESP_OK;
+
+    expand_t *tmp = malloc(total * sizeof(*tmp));
+    schedule_week_entry_t *e = malloc(total * sizeof(*e));
+    if (!tmp || !e) {
+        free(tmp);
+        free(e);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < count; ++i) {
+        for (int d = 0; d < 7; ++d) {
+            if (!(sp[i].days & (1u << d))) continue;
+            tmp[k++] = (expand_t){
+                .mow = (uint16_t)(d * SCHEDULE_MIN_PER_DAY + sp[i].minute),
+                .idx = (uint16_t)i, .ch = sp[i].channel, .pct = sp[i].pct,
+            };
+        }
+    }
+    qsort(tmp, total, sizeof(*tmp), cmp_expand);
+
+    // Collapse same channel and minute to the last setpoint given
+    size_t n = 0;
+    for (size_t i = 0; i < total; ++i) {
+        bool dup = i + 1 < total && tmp[i + 1].ch == tmp[i].ch && tmp[i + 1].mow == tmp[i].mow;
+        if (dup) continue;
+        if (w->n[tmp[i].ch] == 0) w->first[tmp[i].ch] = (uint16_t)n;
+        w->n[tmp[i].ch]++;
+        e[n++] = (schedule_week_entry_t){ .mow = tmp[i].mow, .pct = tmp[i].pct };
+    }
+    free(tmp);
+    w->e = e;
+    return ESP_OK;
+}
+
+void schedule_week_free(schedule_week_t *w)
+{
+    free(w->e);
+    memset(w, 0, sizeof(*w));
+}
+
+uint16_t schedule_week_lower_bound(const schedule_week_t *w, int ch, uint16_t mow)
+{
+    const schedule_week_entry_t *e = w->e + w->first[ch];
+    uint16_t lo = 0, hi = w->n[ch];
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)((lo + hi) / 2);
+        if (e[mid].mow < mow) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+int schedule_week_level(const schedule_week_t *w, int ch, uint16_t mow)
+{
+    uint16_t n = w->n[ch];
+    if (n == 0) return -1;
+    const schedule_week_entry_t *e = w->e + w->first[ch];
+    // Last entry at or before mow is just before the first one after it
+    uint16_t i = schedule_week_lower_bound(w, ch, (uint16_t)(mow + 1));
+    return e[i ? i - 1 : n - 1].pct;
+}
+
+uint16_t schedule_local_mow(time_t t)
+{
+    int64_t local = tz_to_local(t);
+    int64_t day = local / 86400 - (local % 86400 < 0);
+    // 1970-01-01 was a Thursday
+    return (uint16_t)((((day % 7) + 11) % 7) * SCHEDULE_MIN_PER_DAY + (local - day * 86400) / 60);
+}
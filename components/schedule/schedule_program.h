@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+#include "schedule.h"
+
+// Compiled weekly program (internal to the schedule component).
+// Setpoints are expanded over their weekday masks into one array per channel sorted by
+// minute of the week, so the level at any instant is a binary search instead of a walk
+// over the program.
+
+#define SCHEDULE_MIN_PER_DAY    1440
+#define SCHEDULE_MIN_PER_WEEK   (7 * SCHEDULE_MIN_PER_DAY)
+
+typedef struct {
+    uint16_t mow;   // minute of the week, 0 = Sunday 00:00 local
+    uint8_t pct;
+} schedule_week_entry_t;
+
+typedef struct {
+    schedule_week_entry_t *e;                   // heap; channel ranges back to back
+    uint16_t first[SCHEDULE_NUM_CHANNELS];
+    uint16_t n[SCHEDULE_NUM_CHANNELS];          // 0: channel has no program
+} schedule_week_t;
+
+// Check ranges: count, minute, weekday mask, channel and level
+esp_err_t schedule_program_validate(const schedule_setpoint_t *sp, size_t count);
+
+// Express the ON/OFF window of `s` as light setpoints (every day). Returns the count (0-2).
+size_t schedule_program_from_legacy(const schedule_t *s, uint8_t light_on_pct, schedule_setpoint_t out[2]);
+
+// Expand and sort `sp` into `w`. Setpoints of one channel at the same minute of the week:
+// the later one in `sp` wins. `w` must be zeroed or previously compiled.
+esp_err_t schedule_week_compile(schedule_week_t *w, const schedule_setpoint_t *sp, size_t count);
+void schedule_week_free(schedule_week_t *w);
+
+// Index (relative to the channel range) of the first entry at or after `mow`
+uint16_t schedule_week_lower_bound(const schedule_week_t *w, int ch, uint16_t mow);
+
+// Level of channel `ch` at `mow`: the last setpoint at or before it, wrapping to the end of
+// the previous week. -1 if the channel has no program.
+int schedule_week_level(const schedule_week_t *w, int ch, uint16_t mow);
+
+// Local minute of the week of `t` (zone set with tz_set())
+uint16_t schedule_local_mow(time_t t);
@@ -0,0 +1,114 @@
+#include "schedule_pump.h"
+#include <stdatomic.h>
+#include <sys/time.h>
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "schedule_wave.h"
+
+// The waveform is double-buffered: schedule_task fills the idle slot and publishes it, the
+// timer callback reads whichever slot is current. A slot is rewritten only two updates
+// later, long after a callback (a few microseconds) has finished with it.
+static schedule_pump_wave_t s_slot[2];
+static _Atomic(const schedule_pump_wave_t *) s_wave;
+static esp_timer_handle_t s_timer;
+static schedule_pump_out_t s_out;
+static void *s_out_arg;
+static atomic_int s_level = -1;         // level last posted, -1: post on the next callback
+static atomic_int_fast64_t s_edge_ms;   // edge the armed timer is aiming at
+static atomic_uint_fast32_t s_edges;
+static atomic_uint_fast32_t s_late_max_us;
+
+static int64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void on_edge(void *arg)
+{
+    const schedule_pump_wave_t *w = atomic_load(&s_wave);
+    if (!w) return;
+
+    int64_t now_us = wall_us();
+    int64_t next_ms;
+    uint8_t pct = schedule_wave_level(w, now_us / 1000, &next_ms);
+    int last = atomic_exchange(&s_level, pct);
+    if (last != pct) {
+        s_out(pct, s_out_arg);
+        int64_t late = now_us - atomic_load(&s_edge_ms) * 1000;
+        if (last >= 0 && late >= 0) {
+            atomic_fetch_add(&s_edges, 1);
+            if (late > UINT32_MAX) late = UINT32_MAX;   // wall clock stepped past the edge
+            uint_fast32_t worst = atomic_load(&s_late_max_us);
+            while ((uint_fast32_t)late > worst && !atomic_compare_exchange_weak(&s_late_max_us, &worst, late)) {
+            }
+        }
+    }
+
+    // An early wakeup (esp_timer and the wall clock run apart by a few us) finds the same
+    // level and simply re-arms for the remainder. Long gaps are split so a wall-clock step
+    // is noticed within CONFIG_SCHEDULE_MAX_SLEEP_S.
+    int64_t delay_us = (int64_t)CONFIG_SCHEDULE_MAX_SLEEP_S * 1000000;
+    if (next_ms != SCHEDULE_WAVE_NEVER && next_ms * 1000 - now_us < delay_us) {
+        delay_us = next_ms * 1000 - now_us;
+        if (delay_us < 0) delay_us = 0;
+        atomic_store(&s_edge_ms, next_ms);
+    }
+    esp_timer_start_once(s_timer, (uint64_t)delay_us);
+}
+
+esp_err_t schedule_pump_init(schedule_pump_out_t out, void *arg)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    s_out = out;
+    s_out_arg = arg;
+    const esp_timer_create_args_t args = {
+        .callback = on_edge,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "pump_wave",
+    };
+    return esp_timer_create(&args, &s_timer);
+}
+
+// Run the callback now. If it was running concurrently and re-armed the timer from the
+// old waveform, the start fails; stop that timer and try again.
+static void kick(void)
+{
+    do {
+        esp_timer_stop(s_timer);
+    } while (esp_timer_start_once(s_timer, 0) == ESP_ERR_INVALID_STATE);
+}
+
+esp_err_t schedule_pump_start(const schedule_pump_wave_t *w)
+{
+    if (!s_timer) return ESP_ERR_INVALID_STATE;
+    esp_err_t err = schedule_wave_validate(w);
+    if (err != ESP_OK) return err;
+
+    const schedule_pump_wave_t *cur = atomic_load(&s_wave);
+    schedule_pump_wave_t *slot = cur == &s_slot[0] ? &s_slot[1] : &s_slot[0];
+    *slot = *w;
+    atomic_store(&s_wave, slot);
+    atomic_store(&s_level, -1);
+    kick();
+    return ESP_OK;
+}
+
+void schedule_pump_stop(void)
+{
+    atomic_store(&s_wave, NULL);
+    if (s_timer) esp_timer_stop(s_timer);
+    atomic_store(&s_level, -1);
+}
+
+bool schedule_pump_running(void)
+{
+    return atomic_load(&s_wave) != NULL;
+}
+
+void schedule_pump_get_stats(uint32_t *edges, uint32_t *late_max_us)
+{
+    if (edges) *edges = atomic_load(&s_edges);
+    if (late_max_us) *late_max_us = atomic_load(&s_late_max_us);
+}
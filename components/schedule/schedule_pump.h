@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "schedule.h"
+
+// Pump waveform generator (internal to the schedule component). An esp_timer one-shot is
+// armed for the next edge of the waveform in wall-clock time; its callback hands the new
+// level to `out` (which posts to control) without going through schedule_task. Each edge
+// is recomputed from the wall clock, so timer drift and SNTP steps never accumulate.
+
+typedef void (*schedule_pump_out_t)(uint8_t pct, void *arg);
+
+// Create the timer. `out` is called from the esp_timer task.
+esp_err_t schedule_pump_init(schedule_pump_out_t out, void *arg);
+
+// Play `w` (validated) from now on; the current level is posted right away. Replaces any
+// waveform already playing. Single caller (schedule_task).
+esp_err_t schedule_pump_start(const schedule_pump_wave_t *w);
+
+// Stop driving the pump; the level last posted stays until someone else changes it
+void schedule_pump_stop(void);
+
+bool schedule_pump_running(void);
+
+// Edges posted and the worst delay of one behind its wall-clock time
+void schedule_pump_get_stats(uint32_t *edges, uint32_t *late_max_us);
@@ -0,0 +1,91 @@
+#include "schedule_record.h"
+#include <string.h>
+
+// Tags are fixed: a new field takes the next free one, a removed field's tag is retired
+enum {
+    TAG_ON_HOUR = 1,
+    TAG_ON_MIN,
+    TAG_OFF_HOUR,
+    TAG_OFF_MIN,
+    TAG_PUMP_INTERVAL,
+    TAG_PUMP_DURATION,
+    TAG_TZ,
+};
+
+static const storage_field_t s_fields[] = {
+    STORAGE_FIELD(TAG_ON_HOUR, STORAGE_FIELD_INT, schedule_t, on_hour),
+    STORAGE_FIELD(TAG_ON_MIN, STORAGE_FIELD_INT, schedule_t, on_min),
+    STORAGE_FIELD(TAG_OFF_HOUR, STORAGE_FIELD_INT, schedule_t, off_hour),
+    STORAGE_FIELD(TAG_OFF_MIN, STORAGE_FIELD_INT, schedule_t, off_min),
+    STORAGE_FIELD(TAG_PUMP_INTERVAL, STORAGE_FIELD_INT, schedule_t, pump_on_interval_min),
+    STORAGE_FIELD(TAG_PUMP_DURATION, STORAGE_FIELD_INT, schedule_t, pump_on_duration_min),
+    STORAGE_FIELD(TAG_TZ, STORAGE_FIELD_STR, schedule_t, tz),
+};
+
+// schedule_t as firmware before records stored it (raw, under the legacy "<key>" and
+// "<key>_bak" items), frozen here so schedule_t can change. It had no minutes: lights
+// switched on the hour.
+typedef struct {
+    int32_t on_hour;
+    int32_t pump_on_interval_min;
+    int32_t off_hour;
+    int32_t pump_on_duration_min;
+    char tz[64];
+} schedule_v0_t;
+
+// The raw struct once minutes were added, as development builds stored it before records
+typedef struct {
+    int32_t on_hour, on_min, off_hour, off_min;
+    int32_t pump_on_interval_min, pump_on_duration_min;
+    char tz[64];
+} schedule_v0_min_t;
+
+static void copy_tz(schedule_t *s, char *tz, size_t tz_size)
+{
+    tz[tz_size - 1] = '\0';
+    strncpy(s->tz, tz, sizeof(s->tz) - 1);
+    s->tz[sizeof(s->tz) - 1] = '\0';
+}
+
+// Version 0 is whichever raw layout the blob's size matches
+static esp_err_t from_raw_struct(void *rec, const void *raw, size_t raw_len)
+{
+    schedule_t *s = rec;
+    if (raw_len == sizeof(schedule_v0_t)) {
+        schedule_v0_t v0;
+        memcpy(&v0, raw, sizeof(v0));
+        s->on_hour = v0.on_hour;
+        s->on_min = 0;
+        s->off_hour = v0.off_hour;
+        s->off_min = 0;
+        s->pump_on_interval_min = v0.pump_on_interval_min;
+        s->pump_on_duration_min = v0.pump_on_duration_min;
+        copy_tz(s, v0.tz, sizeof(v0.tz));
+        return ESP_OK;
+    }
+    if (raw_len == sizeof(schedule_v0_min_t)) {
+        schedule_v0_min_t v0;
+        memcpy(&v0, raw, sizeof(v0));
+        s->on_hour = v0.on_hour;
+        s->on_min = v0.on_min;
+        s->off_hour = v0.off_hour;
+        s->off_min = v0.off_min;
+        s->pump_on_interval_min = v0.pump_on_interval_min;
+        s->pump_on_duration_min = v0.pump_on_duration_min;
+        copy_tz(s, v0.tz, sizeof(v0.tz));
+        return ESP_OK;
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
+
+static const storage_migrate_fn_t s_migrations[] = {
+    from_raw_struct,    // 0 -> 1
+};
+
+const storage_schema_t schedule_schema = {
+    .key = SCHEDULE_RECORD_KEY,
+    .version = 1,
+    .fields = s_fields,
+    .field_count = sizeof(s_fields) / sizeof(s_fields[0]),
+    .migrations = s_migrations,
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "schedule.h"
+#include "storage_record.h"
+
+// schedule_t as a storage record under "schedule_cfg". Version 0 is the raw struct stored
+// by firmware before records; it is migrated on the first load.
+#define SCHEDULE_RECORD_KEY     "schedule_cfg"
+
+extern const storage_schema_t schedule_schema;
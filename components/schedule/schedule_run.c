@@ -0,0 +1,102 @@
+#include "schedule_run.h"
+#include <stdlib.h>
+#include <string.h>
+#include "schedule_wave.h"
+
+uint8_t schedule_run_channels(const schedule_run_t *r)
+{
+    uint8_t mask = 0;
+    for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+        if (!(r->cfg.pump_wave && ch == SCHEDULE_CH_PUMP)) mask |= 1u << ch;
+    }
+    return mask;
+}
+
+void schedule_run_start(schedule_run_t *r, const schedule_week_t *week, const schedule_t *s, time_t now)
+{
+    schedule_timeline_build(&r->tl, week, s, &r->cfg, now);
+    r->rebuilds++;
+    memcpy(r->level, r->tl.level, sizeof(r->level));
+}
+
+time_t schedule_run_wake_at(const schedule_run_t *r, time_t now, uint32_t max_sleep_s)
+{
+    const schedule_transition_t *ev = schedule_timeline_peek(&r->tl);
+    time_t wake_at = ev ? ev->at : r->tl.valid_until;
+    if (wake_at > r->tl.valid_until) wake_at = r->tl.valid_until;
+    if (wake_at < now) wake_at = now;
+    if (wake_at - now > (time_t)max_sleep_s) wake_at = now + max_sleep_s;
+    return wake_at;
+}
+
+uint32_t schedule_run_step(schedule_run_t *r, const schedule_week_t *week, const schedule_t *s, time_t now,
+                           bool changed, schedule_post_cb_t post, void *arg)
+{
+    uint32_t posts = 0;
+    uint8_t mask = schedule_run_channels(r);
+    if (changed || schedule_timeline_stale(&r->tl, now)) {
+        schedule_timeline_build(&r->tl, week, s, &r->cfg, now);
+        r->rebuilds++;
+        // The rebuilt timeline knows the levels in force right now
+        for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+            if ((mask & (1u << ch)) && r->tl.level[ch] != r->level[ch]) {
+                r->level[ch] = r->tl.level[ch];
+                post(ch, r->level[ch], arg);
+                posts++;
+            }
+        }
+    }
+    // Apply every transition that is due, posting only actual changes
+    const schedule_transition_t *ev;
+    while ((ev = schedule_timeline_peek(&r->tl)) && ev->at <= now) {
+        for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+            if ((ev->channels & SCHEDULE_EV_CH(ch)) && ev->pct[ch] != r->level[ch]) {
+                r->level[ch] = ev->pct[ch];
+                post(ch, r->level[ch], arg);
+                posts++;
+            }
+        }
+        r->tl.next++;
+    }
+    return posts;
+}
+
+// Missed transitions are handed over in batches so a long outage does not cost one
+// callback (and one audit message) per pump cycle
+typedef struct {
+    schedule_missed_event_t ev[SCHEDULE_MISSED_BATCH];
+    size_t n;
+    schedule_missed_cb_t cb;
+    void *arg;
+} missed_batch_t;
+
+static void flush_missed(missed_batch_t *b)
+{
+    if (b->n && b->cb) b->cb(b->ev, b->n, b->arg);
+    b->n = 0;
+}
+
+static void collect_missed(time_t at, int ch, uint8_t pct, void *arg)
+{
+    missed_batch_t *b = arg;
+    b->ev[b->n++] = (schedule_missed_event_t){ .at = at, .channel = (uint8_t)ch, .pct = pct };
+    if (b->n == SCHEDULE_MISSED_BATCH) flush_missed(b);
+}
+
+esp_err_t schedule_run_reconcile(const schedule_week_t *week, const schedule_t *s,
+                                 const schedule_timeline_cfg_t *cfg, const schedule_pump_wave_t *wave,
+                                 time_t from, time_t to, schedule_missed_cb_t cb, void *arg,
+                                 uint8_t level[SCHEDULE_NUM_CHANNELS], size_t *missed)
+{
+    if (cfg->pump_wave && !wave) return ESP_ERR_INVALID_ARG;
+    schedule_timeline_t *scratch = malloc(sizeof(*scratch));
+    if (!scratch) return ESP_ERR_NO_MEM;
+    missed_batch_t batch = { .cb = cb, .arg = arg };
+    size_t n = schedule_timeline_walk(scratch, week, s, cfg, from, to, collect_missed, &batch, level);
+    flush_missed(&batch);
+    free(scratch);
+    // A pump waveform resumes in phase by itself; its missed pulses are not reported
+    if (cfg->pump_wave) level[SCHEDULE_CH_PUMP] = schedule_wave_level(wave, (int64_t)to * 1000, NULL);
+    if (missed) *missed = n;
+    return ESP_OK;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+#include "schedule.h"
+#include "schedule_program.h"
+#include "schedule_timeline.h"
+
+// schedule_task's loop and missed-transition walk with the clock passed in (internal to the
+// schedule component). schedule_task feeds it time(NULL); host tests drive it from a
+// virtual clock to simulate years in seconds.
+
+typedef void (*schedule_post_cb_t)(int ch, uint8_t pct, void *arg);
+
+typedef struct {
+    schedule_timeline_t tl;
+    schedule_timeline_cfg_t cfg;
+    uint8_t level[SCHEDULE_NUM_CHANNELS];   // last level posted per channel
+    uint32_t rebuilds;                      // timeline compilations
+} schedule_run_t;
+
+// Channels the loop posts itself; while a pump waveform plays (cfg.pump_wave), its timer
+// owns the pump. As a CMD_CH() mask.
+uint8_t schedule_run_channels(const schedule_run_t *r);
+
+// Compile the timeline at `now`. r->level holds the levels in force, for the caller to post
+// as one command. r->cfg must be set.
+void schedule_run_start(schedule_run_t *r, const schedule_week_t *week, const schedule_t *s, time_t now);
+
+// When the loop wakes up next: the next transition or the end of the timeline, at most
+// `max_sleep_s` after `now` so wall-clock steps and DST changes are noticed
+time_t schedule_run_wake_at(const schedule_run_t *r, time_t now, uint32_t max_sleep_s);
+
+// One wakeup at `now`: recompile when `changed` (new schedule) or the timeline went stale,
+// posting channels whose level differs, then post every transition that is due. Each
+// level change is posted once. Returns the number of posts.
+uint32_t schedule_run_step(schedule_run_t *r, const schedule_week_t *week, const schedule_t *s, time_t now,
+                           bool changed, schedule_post_cb_t post, void *arg);
+
+// Walk every transition in (from, to] and report level changes to `cb` in batches of up
+// to SCHEDULE_MISSED_BATCH. With cfg->pump_wave the pump is left to `wave` and only its
+// level at `to` is returned. `level` receives the levels in force at `to`.
+esp_err_t schedule_run_reconcile(const schedule_week_t *week, const schedule_t *s,
+                                 const schedule_timeline_cfg_t *cfg, const schedule_pump_wave_t *wave,
+                                 time_t from, time_t to, schedule_missed_cb_t cb, void *arg,
+                                 uint8_t level[SCHEDULE_NUM_CHANNELS], size_t *missed);
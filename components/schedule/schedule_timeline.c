@@ -0,0 +1,161 @@
+#include "schedule_timeline.h"
+#include "tz.h"
+#include <string.h>
+
+bool schedule_timeline_stale(const schedule_timeline_t *tl, time_t now)
+{
+    return now >= tl->valid_until || tz_offset(now) != tl->utc_offset;
+}
+
+// Instant whose local time decides the levels at `now`. During the second pass through a
+// repeated hour, every setpoint of that hour already fired on the first pass (setpoints
+// use the first occurrence), so the levels are those from just before the clock went back.
+static time_t in_force_at(time_t now)
+{
+    time_t first = tz_to_utc(tz_to_local(now));
+    if (first == now) return now;
+    // The change is in (first, now]: bisect for it
+    int32_t off = tz_offset(first);
+    time_t lo = first, hi = now;
+    while (hi - lo > 1) {
+        time_t mid = lo + (hi - lo) / 2;
+        if (tz_offset(mid) == off) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+// Insert in time order; transitions at the same instant share one entry. When full, the
+// latest transition is dropped so the array always holds the earliest ones.
+static void insert(schedule_timeline_t *tl, bool *truncated, time_t at, int ch, uint8_t pct)
+{
+    int i = tl->count;
+    while (i > 0 && tl->ev[i - 1].at > at) i--;
+    if (i > 0 && tl->ev[i - 1].at == at) {
+        tl->ev[i - 1].channels |= SCHEDULE_EV_CH(ch);
+        tl->ev[i - 1].pct[ch] = pct;
+        return;
+    }
+    if (tl->count == SCHEDULE_TIMELINE_MAX) {
+        *truncated = true;
+        if (i == SCHEDULE_TIMELINE_MAX) return;
+        tl->count--;
+    }
+    memmove(&tl->ev[i + 1], &tl->ev[i], (tl->count - i) * sizeof(tl->ev[0]));
+    tl->ev[i] = (schedule_transition_t){ .at = at, .channels = SCHEDULE_EV_CH(ch) };
+    tl->ev[i].pct[ch] = pct;
+    tl->count++;
+}
+
+void schedule_timeline_build(schedule_timeline_t *tl, const schedule_week_t *week, const schedule_t *s,
+                             const schedule_timeline_cfg_t *cfg, time_t now)
+{
+    memset(tl, 0, sizeof(*tl));
+    tl->built_at = now;
+    tl->utc_offset = tz_offset(now);
+    time_t horizon = now + SCHEDULE_TIMELINE_HORIZON_S;
+    bool truncated = false;
+
+    // Levels now: binary search in the program; channels without one are off
+    uint16_t mow = schedule_local_mow(in_force_at(now));
+    uint8_t last[SCHEDULE_NUM_CHANNELS];
+    for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+        int lvl = schedule_week_level(week, ch, mow);
+        tl->level[ch] = lvl < 0 ? 0 : (uint8_t)lvl;
+    }
+
+    // Pump cycle, unless the program drives the pump
+    time_t period = (time_t)s->pump_on_interval_min * 60;
+    time_t on_len = (time_t)s->pump_on_duration_min * 60;
+    if (period < on_len) period = on_len;
+    bool pump_cycle = week->n[SCHEDULE_CH_PUMP] == 0 && !cfg->pump_wave;
+    bool pump_cycles = pump_cycle && on_len > 0 && on_len < period;
+    time_t cycle = 0;
+    if (pump_cycle) {
+        if (pump_cycles) {
+            time_t since = now - cfg->pump_anchor;
+            time_t k = since >= 0 ? since / period : -((-since + period - 1) / period);
+            cycle = cfg->pump_anchor + k * period;
+            tl->level[SCHEDULE_CH_PUMP] = (now - cycle) < on_len ? cfg->pump_on_pct : 0;
+        } else {
+            tl->level[SCHEDULE_CH_PUMP] = on_len > 0 ? cfg->pump_on_pct : 0;
+        }
+    }
+    memcpy(last, tl->level, sizeof(last));
+
+    // Program setpoints, local day by local day (yesterday..day after tomorrow). tz_to_utc()
+    // maps a time skipped by a DST jump to the jump, when the wall clock first passes it.
+    int64_t local_now = tz_to_local(now);
+    int64_t today = local_now / 86400 - (local_now % 86400 < 0);
+    for (int d = -1; d <= 2; ++d) {
+        int64_t day = today + d;
+        time_t midnight = tz_to_utc(day * 86400);
+        if (midnight > horizon) break;
+        if (tz_to_utc((day + 1) * 86400) <= now) continue;
+        // 1970-01-01 was a Thursday
+        uint16_t day_start = (uint16_t)((((day % 7) + 11) % 7) * SCHEDULE_MIN_PER_DAY);
+
+        for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+            const schedule_week_entry_t *e = week->e + week->first[ch];
+            for (uint16_t i = schedule_week_lower_bound(week, ch, day_start);
+                 i < week->n[ch] && e[i].mow < day_start + SCHEDULE_MIN_PER_DAY; ++i) {
+                int minute = e[i].mow - day_start;
+                time_t at = tz_to_utc(day * 86400 + minute * 60);
+                if (at <= now) continue;
+                if (at > horizon) break;
+                if (e[i].pct == last[ch]) continue;
+                insert(tl, &truncated, at, ch, e[i].pct);
+                last[ch] = e[i].pct;
+            }
+        }
+    }
+
+    // Pump edges after now: the OFF of this cycle or the ON of the next
+    if (pump_cycles) {
+        bool on_edge = now >= cycle + on_len;
+        time_t at = on_edge ? cycle + period : cycle + on_len;
+        while (at <= horizon) {
+            size_t before = tl->count;
+            insert(tl, &truncated, at, SCHEDULE_CH_PUMP, on_edge ? cfg->pump_on_pct : 0);
+            // Once a pump edge no longer fits, no later one will
+            if (truncated && tl->count == before && tl->ev[tl->count - 1].at < at) break;
+            at += on_edge ? on_len : period - on_len;
+            on_edge = !on_edge;
+        }
+    }
+
+    tl->valid_until = truncated ? tl->ev[tl->count - 1].at : horizon;
+}
+
+size_t schedule_timeline_walk(schedule_timeline_t *scratch, const schedule_week_t *week, const schedule_t *s,
+                              const schedule_timeline_cfg_t *cfg, time_t from, time_t to,
+                              schedule_walk_cb_t cb, void *arg, uint8_t level[SCHEDULE_NUM_CHANNELS])
+{
+    size_t n = 0;
+    schedule_timeline_build(scratch, week, s, cfg, from);
+    memcpy(level, scratch->level, SCHEDULE_NUM_CHANNELS);
+    for (;;) {
+        const schedule_transition_t *ev;
+        while ((ev = schedule_timeline_peek(scratch)) && ev->at <= to) {
+            for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+                if ((ev->channels & SCHEDULE_EV_CH(ch)) && ev->pct[ch] != level[ch]) {
+                    level[ch] = ev->pct[ch];
+                    if (cb) cb(ev->at, ch, level[ch], arg);
+                    n++;
+                }
+            }
+            scratch->next++;
+        }
+        // Every transition up to valid_until was in this build
+        time_t until = scratch->valid_until;
+        if (until >= to) break;
+        schedule_timeline_build(scratch, week, s, cfg, until);
+        for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+            if (scratch->level[ch] != level[ch]) {
+                level[ch] = scratch->level[ch];
+                if (cb) cb(until, ch, level[ch], arg);
+                n++;
+            }
+        }
+    }
+    return n;
+}
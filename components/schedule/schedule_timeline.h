@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "schedule.h"
+#include "schedule_program.h"
+
+// Compiled schedule timeline (internal to the schedule component).
+// The weekly program (and the pump cycle, if the program has no pump setpoints) is expanded
+// once into a sorted array of upcoming UTC transitions, so schedule_task can sleep until the
+// next one instead of re-evaluating local time every minute.
+
+#define SCHEDULE_TIMELINE_MAX       64
+#define SCHEDULE_TIMELINE_HORIZON_S (24 * 3600)
+
+// Channel bits of a transition
+#define SCHEDULE_EV_CH(n)   (1u << (n))
+#define SCHEDULE_EV_LIGHT   SCHEDULE_EV_CH(SCHEDULE_CH_LIGHT)
+#define SCHEDULE_EV_PUMP    SCHEDULE_EV_CH(SCHEDULE_CH_PUMP)
+
+typedef struct {
+    time_t at;          // UTC instant
+    uint8_t channels;   // SCHEDULE_EV_* that change at `at`
+    uint8_t pct[SCHEDULE_NUM_CHANNELS];  // level from `at` on, for channels in the mask
+} schedule_transition_t;
+
+typedef struct {
+    schedule_transition_t ev[SCHEDULE_TIMELINE_MAX];
+    uint16_t count;
+    uint16_t next;          // first transition not consumed yet
+    time_t built_at;
+    time_t valid_until;     // rebuild at or after this instant
+    int32_t utc_offset;     // local UTC offset (s) at build time
+    uint8_t level[SCHEDULE_NUM_CHANNELS];   // levels in force at built_at
+} schedule_timeline_t;
+
+// Pump cycle used when the program has no pump setpoints
+typedef struct {
+    uint8_t pump_on_pct;
+    time_t pump_anchor;     // UTC start of a pump cycle (cycles repeat every interval)
+    bool pump_wave;         // the waveform generator drives the pump instead: no cycle edges
+} schedule_timeline_cfg_t;
+
+// Compile transitions in (now, now + horizon] from `week` (pump cycle from `s` and `cfg`)
+// in the tz_set() zone. Keeps the earliest SCHEDULE_TIMELINE_MAX transitions and sets
+// valid_until to the last one kept if any were left out.
+void schedule_timeline_build(schedule_timeline_t *tl, const schedule_week_t *week, const schedule_t *s,
+                             const schedule_timeline_cfg_t *cfg, time_t now);
+
+// Next transition not consumed yet, or NULL when the timeline is exhausted
+static inline const schedule_transition_t *schedule_timeline_peek(const schedule_timeline_t *tl)
+{
+    return tl->next < tl->count ? &tl->ev[tl->next] : NULL;
+}
+
+// True if the timeline no longer describes `now`: horizon reached or UTC offset changed
+bool schedule_timeline_stale(const schedule_timeline_t *tl, time_t now);
+
+// One transition reported by schedule_timeline_walk()
+typedef void (*schedule_walk_cb_t)(time_t at, int ch, uint8_t pct, void *arg);
+
+// Report every level change in (from, to], oldest first, rebuilding `scratch` as often as
+// the span needs (multi-day gaps, DST changes). `level` receives the levels at `to`.
+// Returns the number of transitions reported.
+size_t schedule_timeline_walk(schedule_timeline_t *scratch, const schedule_week_t *week, const schedule_t *s,
+                              const schedule_timeline_cfg_t *cfg, time_t from, time_t to,
+                              schedule_walk_cb_t cb, void *arg, uint8_t level[SCHEDULE_NUM_CHANNELS]);
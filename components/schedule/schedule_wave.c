@@ -0,0 +1,60 @@
+#include "schedule_wave.h"
+#include <string.h>
+
+esp_err_t schedule_wave_validate(const schedule_pump_wave_t *w)
+{
+    if (!w || w->count == 0 || w->count > SCHEDULE_WAVE_MAX_SEGS) return ESP_ERR_INVALID_ARG;
+    uint64_t period = 0;
+    for (int i = 0; i < w->count; ++i) {
+        if (w->seg[i].ms < SCHEDULE_WAVE_MIN_SEG_MS || w->seg[i].pct > 100) return ESP_ERR_INVALID_ARG;
+        period += w->seg[i].ms;
+    }
+    return period <= SCHEDULE_WAVE_MAX_PERIOD_MS ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void schedule_wave_from_legacy(const schedule_t *s, uint8_t pump_on_pct, schedule_pump_wave_t *out)
+{
+    uint32_t on_ms = s->pump_on_duration_min > 0 ? (uint32_t)s->pump_on_duration_min * 60000u : 0;
+    uint32_t period_ms = s->pump_on_interval_min > 0 ? (uint32_t)s->pump_on_interval_min * 60000u : 0;
+    memset(out, 0, sizeof(*out));
+    out->count = 1;
+    if (on_ms == 0) {
+        out->seg[0] = (schedule_wave_seg_t){ .ms = period_ms ? period_ms : 60000u, .pct = 0 };
+    } else if (on_ms >= period_ms) {
+        out->seg[0] = (schedule_wave_seg_t){ .ms = on_ms, .pct = pump_on_pct };
+    } else {
+        out->seg[0] = (schedule_wave_seg_t){ .ms = on_ms, .pct = pump_on_pct };
+        out->seg[1] = (schedule_wave_seg_t){ .ms = period_ms - on_ms, .pct = 0 };
+        out->count = 2;
+    }
+}
+
+uint32_t schedule_wave_period_ms(const schedule_pump_wave_t *w)
+{
+    uint32_t period = 0;
+    for (int i = 0; i < w->count; ++i) period += w->seg[i].ms;
+    return period;
+}
+
+uint8_t schedule_wave_level(const schedule_pump_wave_t *w, int64_t utc_ms, int64_t *next_ms)
+{
+    int64_t period = schedule_wave_period_ms(w);
+    int64_t phase = utc_ms % period;
+    if (phase < 0) phase += period;
+
+    // Segment containing the phase, then the first following segment at another level
+    int i = 0;
+    int64_t edge = utc_ms - phase + w->seg[0].ms;
+    while (edge <= utc_ms) edge += w->seg[++i].ms;
+    uint8_t pct = w->seg[i].pct;
+    for (int k = 1; k < w->count; ++k) {
+        const schedule_wave_seg_t *seg = &w->seg[(i + k) % w->count];
+        if (seg->pct != pct) {
+            if (next_ms) *next_ms = edge;
+            return pct;
+        }
+        edge += seg->ms;
+    }
+    if (next_ms) *next_ms = SCHEDULE_WAVE_NEVER;
+    return pct;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "schedule.h"
+
+// Pump waveform arithmetic (internal to the schedule component). The pattern repeats every
+// period since the UTC epoch, so the level at any instant is a function of wall-clock time
+// alone and survives reboots.
+
+#define SCHEDULE_WAVE_NEVER INT64_MAX
+
+// Check ranges: count, segment lengths, total period and levels
+esp_err_t schedule_wave_validate(const schedule_pump_wave_t *w);
+
+// Express the pump interval/duration of `s` as a waveform (on, then off)
+void schedule_wave_from_legacy(const schedule_t *s, uint8_t pump_on_pct, schedule_pump_wave_t *out);
+
+// Sum of the segment lengths
+uint32_t schedule_wave_period_ms(const schedule_pump_wave_t *w);
+
+// Level at `utc_ms` (ms since the UTC epoch). `next_ms` receives the instant of the next
+// level change, or SCHEDULE_WAVE_NEVER for a constant waveform; adjacent segments with the
+// same level are not an edge.
+uint8_t schedule_wave_level(const schedule_pump_wave_t *w, int64_t utc_ms, int64_t *next_ms);
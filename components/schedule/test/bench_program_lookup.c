@@ -0,0 +1,161 @@
+#include "unity.h"
+#include "schedule_program.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Host benchmark: per-tick cost of "what level is channel X at now" for weekly programs of
+// growing size. The compiled program answers with a binary search, so the cost should stay
+// flat from a dozen setpoints to the SCHEDULE_MAX_SETPOINTS limit, where a walk over the
+// setpoints grows linearly. Also checks compile + lookup against that walk.
+
+#define LOOKUPS     2000000
+#define RUNS        5
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Reference: latest setpoint at or before `mow` over the previous 7 days, later entry wins ties
+static int walk_level(const schedule_setpoint_t *sp, size_t n, int ch, uint16_t mow)
+{
+    int best = -1, best_age = SCHEDULE_MIN_PER_WEEK;
+    for (size_t i = 0; i < n; ++i) {
+        if (sp[i].channel != ch) continue;
+        for (int d = 0; d < 7; ++d) {
+            if (!(sp[i].days & (1u << d))) continue;
+            int at = d * SCHEDULE_MIN_PER_DAY + sp[i].minute;
+            int age = ((int)mow - at + SCHEDULE_MIN_PER_WEEK) % SCHEDULE_MIN_PER_WEEK;
+            if (age <= best_age) { best_age = age; best = sp[i].pct; }
+        }
+    }
+    return best;
+}
+
+static size_t random_program(schedule_setpoint_t *sp, size_t n, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < n; ++i) {
+        sp[i] = (schedule_setpoint_t){
+            .minute = (uint16_t)(rand() % SCHEDULE_MIN_PER_DAY),
+            .days = (uint8_t)(1 + rand() % SCHEDULE_DAYS_ALL),
+            .channel = (uint8_t)(rand() % SCHEDULE_NUM_CHANNELS),
+            .pct = (uint8_t)(rand() % 101),
+        };
+    }
+    return n;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_compile_matches_walk(void)
+{
+    static schedule_setpoint_t sp[SCHEDULE_MAX_SETPOINTS];
+    const size_t sizes[] = { 1, 2, 12, 100, SCHEDULE_MAX_SETPOINTS };
+    for (unsigned k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        size_t n = random_program(sp, sizes[k], 1234 + k);
+        schedule_week_t w = {0};
+        TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&w, sp, n));
+        for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+            for (uint16_t mow = 0; mow < SCHEDULE_MIN_PER_WEEK; ++mow) {
+                TEST_ASSERT_EQUAL_INT(walk_level(sp, n, ch, mow), schedule_week_level(&w, ch, mow));
+            }
+        }
+        schedule_week_free(&w);
+    }
+}
+
+void test_legacy_window_and_edges(void)
+{
+    schedule_t s = { .on_hour = 22, .on_min = 15, .off_hour = 6, .off_min = 45 };
+    schedule_setpoint_t sp[4];
+    size_t n = schedule_program_from_legacy(&s, 70, sp);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    schedule_week_t w = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&w, sp, n));
+    TEST_ASSERT_EQUAL_INT(70, schedule_week_level(&w, SCHEDULE_CH_LIGHT, 0));          // Sunday 00:00
+    TEST_ASSERT_EQUAL_INT(70, schedule_week_level(&w, SCHEDULE_CH_LIGHT, 6 * 60 + 44));
+    TEST_ASSERT_EQUAL_INT(0, schedule_week_level(&w, SCHEDULE_CH_LIGHT, 6 * 60 + 45));
+    TEST_ASSERT_EQUAL_INT(70, schedule_week_level(&w, SCHEDULE_CH_LIGHT, SCHEDULE_MIN_PER_WEEK - 1));
+    TEST_ASSERT_EQUAL_INT(-1, schedule_week_level(&w, SCHEDULE_CH_PUMP, 0));
+
+    // Same minute twice: the later setpoint wins; weekday masks select days
+    sp[0] = (schedule_setpoint_t){ .minute = 600, .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_PUMP, .pct = 10 };
+    sp[1] = (schedule_setpoint_t){ .minute = 600, .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_PUMP, .pct = 20 };
+    sp[2] = (schedule_setpoint_t){ .minute = 660, .days = 1u << 3, .channel = SCHEDULE_CH_PUMP, .pct = 0 };
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&w, sp, 3));
+    TEST_ASSERT_EQUAL_INT(20, schedule_week_level(&w, SCHEDULE_CH_PUMP, 2 * SCHEDULE_MIN_PER_DAY + 700));
+    TEST_ASSERT_EQUAL_INT(0, schedule_week_level(&w, SCHEDULE_CH_PUMP, 3 * SCHEDULE_MIN_PER_DAY + 700));
+    schedule_week_free(&w);
+
+    // Rejected: bad minute, empty day mask, unknown channel, level over 100, too many
+    schedule_setpoint_t bad = { .minute = SCHEDULE_MIN_PER_DAY, .days = 1, .channel = 0, .pct = 1 };
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_program_validate(&bad, 1));
+    bad = (schedule_setpoint_t){ .minute = 0, .days = 0, .channel = 0, .pct = 1 };
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_program_validate(&bad, 1));
+    bad = (schedule_setpoint_t){ .minute = 0, .days = 1, .channel = SCHEDULE_NUM_CHANNELS, .pct = 1 };
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_program_validate(&bad, 1));
+    bad = (schedule_setpoint_t){ .minute = 0, .days = 1, .channel = 0, .pct = 101 };
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_program_validate(&bad, 1));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_program_validate(sp, SCHEDULE_MAX_SETPOINTS + 1));
+}
+
+// Best-of-RUNS ns per lookup over a pseudo-random walk through the week
+static double time_lookup(const schedule_week_t *w, const schedule_setpoint_t *sp, size_t n, bool walk)
+{
+    double best = 1e9;
+    volatile int sink = 0;
+    size_t iters = walk ? LOOKUPS / 100 : LOOKUPS;
+    for (int r = 0; r < RUNS; ++r) {
+        uint32_t x = 12345;
+        int64_t t0 = now_ns();
+        for (size_t i = 0; i < iters; ++i) {
+            x = x * 1103515245u + 12345u;
+            uint16_t mow = (uint16_t)((x >> 8) % SCHEDULE_MIN_PER_WEEK);
+            sink += walk ? walk_level(sp, n, SCHEDULE_CH_LIGHT, mow) : schedule_week_level(w, SCHEDULE_CH_LIGHT, mow);
+        }
+        double ns = (double)(now_ns() - t0) / iters;
+        if (ns < best) best = ns;
+    }
+    (void)sink;
+    return best;
+}
+
+void test_lookup_cost_is_flat(void)
+{
+    static schedule_setpoint_t sp[SCHEDULE_MAX_SETPOINTS];
+    const size_t sizes[] = { 12, 64, SCHEDULE_MAX_SETPOINTS };
+    double cost[3];
+    for (unsigned k = 0; k < 3; ++k) {
+        // Light-only, every day: a week holds 7x as many entries as setpoints
+        size_t n = sizes[k];
+        for (size_t i = 0; i < n; ++i) {
+            sp[i] = (schedule_setpoint_t){
+                .minute = (uint16_t)(i * SCHEDULE_MIN_PER_DAY / n), .days = SCHEDULE_DAYS_ALL,
+                .channel = SCHEDULE_CH_LIGHT, .pct = (uint8_t)(i % 101),
+            };
+        }
+        schedule_week_t w = {0};
+        TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&w, sp, n));
+        cost[k] = time_lookup(&w, sp, n, false);
+        double walk = time_lookup(&w, sp, n, true);
+        printf("program: %3u setpoints (%4u week entries): lookup %.1f ns, walk %.1f ns\n",
+               (unsigned)n, w.n[SCHEDULE_CH_LIGHT], cost[k], walk);
+        schedule_week_free(&w);
+    }
+    // log2(1792) / log2(84) ~ 1.7: allow noise, but nothing close to the 21x of a walk
+    TEST_ASSERT_TRUE(cost[2] < 3.0 * cost[0]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_compile_matches_walk);
+    RUN_TEST(test_legacy_window_and_edges);
+    RUN_TEST(test_lookup_cost_is_flat);
+    return UNITY_END();
+}
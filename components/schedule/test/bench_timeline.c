@@ -0,0 +1,250 @@
+#include "unity.h"
+#include "schedule_timeline.h"
+#include "tz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host benchmark: schedule_task wakeups and CPU time per simulated day.
+// Baseline is the old loop: wake every second to feed the WDT, re-evaluate local time every
+// minute. The timeline loop sleeps until the next transition (capped like
+// CONFIG_SCHEDULE_MAX_SLEEP_S). Both run against the same virtual clock; the timeline's
+// output is checked minute by minute against a direct evaluation of the schedule.
+
+#define SIM_DAYS        30
+#define MAX_SLEEP_S     3600
+#define LIGHT_ON_PCT    70
+#define PUMP_ON_PCT     70
+// 2024-03-15 00:00 UTC: the window covers the EU spring-forward on 2024-03-31
+#define SIM_START       1710460800
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Reference: what the old per-minute loop computed
+static bool ref_light_on(time_t t, const schedule_t *s)
+{
+    struct tm lt;
+    localtime_r(&t, &lt);
+    int m = lt.tm_hour * 60 + lt.tm_min;
+    int on = s->on_hour * 60 + s->on_min, off = s->off_hour * 60 + s->off_min;
+    if (on < off) return m >= on && m < off;
+    return m >= on || m < off;
+}
+
+static bool ref_pump_on(time_t t, const schedule_t *s, time_t anchor)
+{
+    int mins = (int)((t - anchor) / 60);
+    return mins % s->pump_on_interval_min < s->pump_on_duration_min;
+}
+
+typedef struct {
+    uint64_t wakeups;
+    uint64_t rebuilds;
+    uint64_t events;
+    int64_t cpu_ns;
+} sim_result_t;
+
+static sim_result_t run_baseline(const schedule_t *s, time_t start, time_t end)
+{
+    sim_result_t r = {0};
+    time_t anchor = start - (start % 60);
+    int last_light = -1, last_pump = -1;
+    for (time_t t = start; t < end; t += 60) {
+        // 60 one-second WDT wakeups per minute, one of which evaluates the schedule
+        r.wakeups += 60;
+        int64_t t0 = now_ns();
+        schedule_t copy = *s;   // stands in for the per-minute schedule_load()
+        int light = ref_light_on(t, &copy);
+        int pump = ref_pump_on(t, &copy, anchor);
+        if (light != last_light) { last_light = light; r.events++; }
+        if (pump != last_pump) { last_pump = pump; r.events++; }
+        r.cpu_ns += now_ns() - t0;
+    }
+    return r;
+}
+
+static void run_timeline(const schedule_t *s, time_t start, time_t end, bool verify, sim_result_t *out)
+{
+    sim_result_t r = {0};
+    static schedule_timeline_t tl;
+    schedule_timeline_cfg_t cfg = { .pump_on_pct = PUMP_ON_PCT, .pump_anchor = start - (start % 60) };
+    schedule_setpoint_t sp[2];
+    schedule_week_t week = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&week, sp, schedule_program_from_legacy(s, LIGHT_ON_PCT, sp)));
+    time_t now = start;
+    int64_t t0 = now_ns();
+    schedule_timeline_build(&tl, &week, s, &cfg, now);
+    r.cpu_ns += now_ns() - t0;
+    r.rebuilds++;
+    uint8_t light = tl.level[SCHEDULE_CH_LIGHT], pump = tl.level[SCHEDULE_CH_PUMP];
+
+    while (now < end) {
+        const schedule_transition_t *ev = schedule_timeline_peek(&tl);
+        time_t wake_at = ev ? ev->at : tl.valid_until;
+        if (wake_at > tl.valid_until) wake_at = tl.valid_until;
+        if (wake_at - now > MAX_SLEEP_S) wake_at = now + MAX_SLEEP_S;
+        if (wake_at >= end) wake_at = end;
+
+        // Output held while asleep must match the schedule at every minute in between
+        if (verify) {
+            for (time_t t = now; t < wake_at; t += 60) {
+                TEST_ASSERT_EQUAL_INT(ref_light_on(t, s) ? LIGHT_ON_PCT : 0, light);
+                TEST_ASSERT_EQUAL_INT(ref_pump_on(t, s, cfg.pump_anchor) ? PUMP_ON_PCT : 0, pump);
+            }
+        }
+        now = wake_at;
+        if (now >= end) break;
+        r.wakeups++;
+
+        t0 = now_ns();
+        if (schedule_timeline_stale(&tl, now)) {
+            schedule_timeline_build(&tl, &week, s, &cfg, now);
+            r.rebuilds++;
+            if (tl.level[SCHEDULE_CH_LIGHT] != light) { light = tl.level[SCHEDULE_CH_LIGHT]; r.events++; }
+            if (tl.level[SCHEDULE_CH_PUMP] != pump) { pump = tl.level[SCHEDULE_CH_PUMP]; r.events++; }
+        }
+        while ((ev = schedule_timeline_peek(&tl)) && ev->at <= now) {
+            if ((ev->channels & SCHEDULE_EV_LIGHT) && ev->pct[SCHEDULE_CH_LIGHT] != light) { light = ev->pct[SCHEDULE_CH_LIGHT]; r.events++; }
+            if ((ev->channels & SCHEDULE_EV_PUMP) && ev->pct[SCHEDULE_CH_PUMP] != pump) { pump = ev->pct[SCHEDULE_CH_PUMP]; r.events++; }
+            tl.next++;
+        }
+        r.cpu_ns += now_ns() - t0;
+    }
+    schedule_week_free(&week);
+    *out = r;
+}
+
+static schedule_t make_schedule(int on_h, int on_m, int off_h, int off_m, int interval, int duration)
+{
+    schedule_t s = {
+        .on_hour = on_h, .on_min = on_m, .off_hour = off_h, .off_min = off_m,
+        .pump_on_interval_min = interval, .pump_on_duration_min = duration,
+    };
+    strcpy(s.tz, "CET-1CEST,M3.5.0,M10.5.0/3");
+    return s;
+}
+
+void setUp(void)
+{
+    // Also sets TZ for libc, which the reference implementation uses
+    tz_set("Europe/Berlin");
+}
+void tearDown(void) {}
+
+void test_timeline_matches_reference_across_dst(void)
+{
+    const schedule_t cases[] = {
+        make_schedule(7, 0, 21, 0, 30, 5),
+        make_schedule(22, 15, 6, 45, 45, 10),    // overnight window
+        make_schedule(2, 30, 3, 30, 7, 1),       // falls in the spring-forward gap
+    };
+    time_t end = SIM_START + SIM_DAYS * 86400;
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        sim_result_t r;
+        run_timeline(&cases[i], SIM_START, end, true, &r);
+    }
+}
+
+void test_timeline_truncates_and_rebuilds(void)
+{
+    // A 2-minute pump cycle needs far more than SCHEDULE_TIMELINE_MAX transitions a day
+    schedule_t s = make_schedule(7, 0, 21, 0, 2, 1);
+    static schedule_timeline_t tl;
+    schedule_timeline_cfg_t cfg = { .pump_on_pct = PUMP_ON_PCT, .pump_anchor = SIM_START };
+    schedule_setpoint_t sp[2];
+    schedule_week_t week = {0};
+    schedule_week_compile(&week, sp, schedule_program_from_legacy(&s, LIGHT_ON_PCT, sp));
+    schedule_timeline_build(&tl, &week, &s, &cfg, SIM_START);
+    schedule_week_free(&week);
+    TEST_ASSERT_EQUAL_UINT16(SCHEDULE_TIMELINE_MAX, tl.count);
+    TEST_ASSERT_EQUAL_INT64(tl.ev[tl.count - 1].at, tl.valid_until);
+    for (int i = 1; i < tl.count; ++i) TEST_ASSERT_TRUE(tl.ev[i].at > tl.ev[i - 1].at);
+    sim_result_t r;
+    run_timeline(&s, SIM_START, SIM_START + 2 * 86400, true, &r);
+}
+
+void test_timeline_follows_weekly_program(void)
+{
+    // A dozen light levels on weekdays, fewer at weekends, and a pump program
+    schedule_setpoint_t sp[32];
+    size_t n = 0;
+    for (int i = 0; i < 12; ++i) {
+        sp[n++] = (schedule_setpoint_t){ .minute = (uint16_t)(300 + i * 75), .days = 0x3E,
+                                         .channel = SCHEDULE_CH_LIGHT, .pct = (uint8_t)((i * 37) % 101) };
+    }
+    sp[n++] = (schedule_setpoint_t){ .minute = 480, .days = 0x41, .channel = SCHEDULE_CH_LIGHT, .pct = 40 };
+    sp[n++] = (schedule_setpoint_t){ .minute = 1200, .days = 0x41, .channel = SCHEDULE_CH_LIGHT, .pct = 0 };
+    sp[n++] = (schedule_setpoint_t){ .minute = 150, .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_LIGHT, .pct = 5 };
+    for (int h = 6; h < 22; h += 4) {
+        sp[n++] = (schedule_setpoint_t){ .minute = (uint16_t)(h * 60), .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_PUMP, .pct = 80 };
+        sp[n++] = (schedule_setpoint_t){ .minute = (uint16_t)(h * 60 + 10), .days = SCHEDULE_DAYS_ALL, .channel = SCHEDULE_CH_PUMP, .pct = 0 };
+    }
+    schedule_week_t week = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&week, sp, n));
+    schedule_t s = make_schedule(7, 0, 21, 0, 30, 5);   // pump cycle must not apply
+    schedule_timeline_cfg_t cfg = { .pump_on_pct = PUMP_ON_PCT, .pump_anchor = SIM_START };
+    static schedule_timeline_t tl;
+
+    time_t now = SIM_START, end = SIM_START + SIM_DAYS * 86400;
+    schedule_timeline_build(&tl, &week, &s, &cfg, now);
+    uint8_t level[SCHEDULE_NUM_CHANNELS] = { tl.level[0], tl.level[1] };
+    while (now < end) {
+        const schedule_transition_t *ev = schedule_timeline_peek(&tl);
+        time_t wake_at = ev && ev->at < tl.valid_until ? ev->at : tl.valid_until;
+        for (time_t t = now; t < wake_at && t < end; t += 60) {
+            uint16_t mow = schedule_local_mow(t);
+            for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+                TEST_ASSERT_EQUAL_INT(schedule_week_level(&week, ch, mow), level[ch]);
+            }
+        }
+        now = wake_at;
+        if (schedule_timeline_stale(&tl, now)) {
+            schedule_timeline_build(&tl, &week, &s, &cfg, now);
+            memcpy(level, tl.level, sizeof(level));
+        }
+        while ((ev = schedule_timeline_peek(&tl)) && ev->at <= now) {
+            for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+                if (ev->channels & SCHEDULE_EV_CH(ch)) level[ch] = ev->pct[ch];
+            }
+            tl.next++;
+        }
+    }
+    schedule_week_free(&week);
+}
+
+void test_timeline_wakeups_and_cpu_per_day(void)
+{
+    schedule_t s = make_schedule(7, 0, 21, 0, 30, 5);
+    time_t end = SIM_START + SIM_DAYS * 86400;
+    sim_result_t old = run_baseline(&s, SIM_START, end);
+    sim_result_t tl;
+    run_timeline(&s, SIM_START, end, false, &tl);
+
+    printf("schedule per day: baseline wakeups=%llu cpu=%lldus | timeline wakeups=%llu rebuilds=%llu cpu=%lldus | events %llu vs %llu\n",
+           (unsigned long long)(old.wakeups / SIM_DAYS), (long long)(old.cpu_ns / SIM_DAYS / 1000),
+           (unsigned long long)(tl.wakeups / SIM_DAYS), (unsigned long long)(tl.rebuilds / SIM_DAYS),
+           (long long)(tl.cpu_ns / SIM_DAYS / 1000),
+           (unsigned long long)old.events, (unsigned long long)tl.events);
+
+    // Same transitions applied, far fewer wakeups: 96 pump edges + 2 light edges a day
+    TEST_ASSERT_EQUAL_UINT64(old.events, tl.events + 2);    // baseline counts its initial post
+    TEST_ASSERT_TRUE(tl.wakeups / SIM_DAYS <= 100);
+    TEST_ASSERT_TRUE(old.wakeups >= 500 * tl.wakeups);
+    TEST_ASSERT_TRUE(tl.cpu_ns < old.cpu_ns);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_timeline_matches_reference_across_dst);
+    RUN_TEST(test_timeline_truncates_and_rebuilds);
+    RUN_TEST(test_timeline_follows_weekly_program);
+    RUN_TEST(test_timeline_wakeups_and_cpu_per_day);
+    return UNITY_END();
+}
@@ -0,0 +1,389 @@
+#include "unity.h"
+#include "schedule_run.h"
+#include "tz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host harness: schedule_task's loop (schedule_run_*), schedule_reconcile's walk and
+// schedule_compute_next_events() driven by a virtual clock over years of simulated time,
+// in many time zones. Every posted transition is checked against an independent reference
+// built from glibc's localtime_r(): nothing missed, nothing duplicated, nothing late.
+
+#define SIM_FROM        1735689600      // 2025-01-01 00:00 UTC
+#define SIM_YEARS       3
+#define SIM_TO          (SIM_FROM + SIM_YEARS * 365 * 86400)
+#define MAX_SLEEP_S     3600
+#define NOTIFY_EVERY_S  (2 * 86400 + 17 * 3600 + 13 * 60 + 7)  // schedule_save() now and then
+#define LIGHT_ON_PCT    70
+#define PUMP_ON_PCT     60
+#define N_WINDOWS       300
+#define N_NEXT_SAMPLES  20000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const char *s_zones[] = {
+    "UTC", "Europe/Berlin", "Europe/London", "Europe/Dublin", "America/New_York",
+    "America/St_Johns", "America/Santiago", "America/Sao_Paulo", "Asia/Kolkata",
+    "Asia/Kathmandu", "Asia/Jerusalem", "Australia/Lord_Howe", "Australia/Adelaide",
+    "Pacific/Chatham", "Pacific/Auckland", "Africa/Cairo",
+};
+#define N_ZONES (sizeof(s_zones) / sizeof(s_zones[0]))
+
+// Weekday program with setpoints inside the DST gap and the repeated hour (02:15, 02:45),
+// at both ends of the day, and program-driven pump levels
+static const schedule_setpoint_t s_program[] = {
+    { .minute = 345,  .days = 0x3E, .channel = SCHEDULE_CH_LIGHT, .pct = 20 },
+    { .minute = 390,  .days = 0x3E, .channel = SCHEDULE_CH_LIGHT, .pct = 60 },
+    { .minute = 720,  .days = 0x3E, .channel = SCHEDULE_CH_LIGHT, .pct = 100 },
+    { .minute = 1080, .days = 0x3E, .channel = SCHEDULE_CH_LIGHT, .pct = 60 },
+    { .minute = 1290, .days = 0x3E, .channel = SCHEDULE_CH_LIGHT, .pct = 10 },
+    { .minute = 1335, .days = 0x3E, .channel = SCHEDULE_CH_LIGHT, .pct = 0 },
+    { .minute = 480,  .days = 0x41, .channel = SCHEDULE_CH_LIGHT, .pct = 40 },
+    { .minute = 1439, .days = 0x41, .channel = SCHEDULE_CH_LIGHT, .pct = 5 },
+    { .minute = 0,    .days = 0x7F, .channel = SCHEDULE_CH_LIGHT, .pct = 0 },
+    { .minute = 135,  .days = 0x7F, .channel = SCHEDULE_CH_LIGHT, .pct = 30 },
+    { .minute = 165,  .days = 0x7F, .channel = SCHEDULE_CH_LIGHT, .pct = 0 },
+    { .minute = 360,  .days = 0x7F, .channel = SCHEDULE_CH_PUMP,  .pct = 50 },
+    { .minute = 1200, .days = 0x7F, .channel = SCHEDULE_CH_PUMP,  .pct = 0 },
+};
+
+typedef struct {
+    time_t at;
+    uint8_t ch;
+    uint8_t pct;
+    uint16_t order;     // position within the instant, for a stable sort
+} event_t;
+
+typedef struct {
+    event_t *ev;
+    size_t n, cap;
+} event_list_t;
+
+static void push(event_list_t *l, time_t at, int ch, uint8_t pct, uint16_t order)
+{
+    if (l->n == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 4096;
+        l->ev = realloc(l->ev, l->cap * sizeof(*l->ev));
+        TEST_ASSERT_NOT_NULL(l->ev);
+    }
+    l->ev[l->n++] = (event_t){ .at = at, .ch = (uint8_t)ch, .pct = pct, .order = order };
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+    const event_t *x = a, *y = b;
+    if (x->at != y->at) return x->at < y->at ? -1 : 1;
+    if (x->ch != y->ch) return x->ch - y->ch;
+    return x->order - y->order;
+}
+
+// --- Reference, from glibc (TZ set by tz_set()) ---
+
+static long gl_off(time_t t)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return tm.tm_gmtoff;
+}
+
+// Local seconds to UTC: first occurrence of a repeated time, the jump for a skipped one
+static time_t ref_to_utc(int64_t local)
+{
+    long before = gl_off((time_t)(local - 86400)), after = gl_off((time_t)(local + 86400));
+    time_t best = 0;
+    bool found = false;
+    const time_t cand[] = { (time_t)(local - before), (time_t)(local - after) };
+    for (int i = 0; i < 2; ++i) {
+        if (cand[i] + gl_off(cand[i]) == local && (!found || cand[i] < best)) {
+            best = cand[i];
+            found = true;
+        }
+    }
+    if (found) return best;
+    time_t lo = (time_t)(local - 86400), hi = (time_t)(local + 86400);
+    while (hi - lo > 1) {
+        time_t mid = lo + (hi - lo) / 2;
+        if (gl_off(mid) == before) lo = mid; else hi = mid;
+    }
+    return hi;
+}
+
+typedef struct {
+    const schedule_setpoint_t *sp;
+    size_t n_sp;
+    schedule_t s;
+    bool pump_cycle;
+} scenario_t;
+
+// Level changes in (from, to] and the levels in force at `from`
+static void ref_events(const scenario_t *sc, time_t from, time_t to, event_list_t *out,
+                       uint8_t level[SCHEDULE_NUM_CHANNELS])
+{
+    event_list_t raw = {0};
+    // Setpoints from a week before `from` settle the level in force at `from`
+    int64_t d0 = (from + gl_off(from)) / 86400 - 8, d1 = (to + gl_off(to)) / 86400 + 1;
+    for (int64_t d = d0; d <= d1; ++d) {
+        int wday = (int)(((d % 7) + 11) % 7);
+        for (size_t i = 0; i < sc->n_sp; ++i) {
+            const schedule_setpoint_t *p = &sc->sp[i];
+            if (!(p->days & (1u << wday))) continue;
+            push(&raw, ref_to_utc(d * 86400 + p->minute * 60), p->channel, p->pct, p->minute);
+        }
+    }
+    qsort(raw.ev, raw.n, sizeof(raw.ev[0]), cmp_event);
+
+    bool has[SCHEDULE_NUM_CHANNELS] = { false };
+    uint8_t cur[SCHEDULE_NUM_CHANNELS] = { 0 };
+    memset(level, 0, SCHEDULE_NUM_CHANNELS);
+    for (size_t i = 0; i < raw.n; ++i) {
+        const event_t *e = &raw.ev[i];
+        has[e->ch] = true;
+        // Several setpoints landing on one instant (a DST gap): the last one counts
+        if (i + 1 < raw.n && raw.ev[i + 1].at == e->at && raw.ev[i + 1].ch == e->ch) continue;
+        if (e->at <= from) {
+            cur[e->ch] = level[e->ch] = e->pct;
+        } else if (e->at <= to && e->pct != cur[e->ch]) {
+            cur[e->ch] = e->pct;
+            push(out, e->at, e->ch, e->pct, 0);
+        }
+    }
+    free(raw.ev);
+
+    if (sc->pump_cycle && !has[SCHEDULE_CH_PUMP]) {
+        time_t period = sc->s.pump_on_interval_min * 60, on = sc->s.pump_on_duration_min * 60;
+        level[SCHEDULE_CH_PUMP] = from % period < on ? PUMP_ON_PCT : 0;
+        for (time_t c = from - from % period; c <= to; c += period) {
+            if (c > from) push(out, c, SCHEDULE_CH_PUMP, PUMP_ON_PCT, 0);
+            if (c + on > from && c + on <= to) push(out, c + on, SCHEDULE_CH_PUMP, 0, 0);
+        }
+    }
+    qsort(out->ev, out->n, sizeof(out->ev[0]), cmp_event);
+}
+
+// --- Virtual-clock runs ---
+
+static event_list_t s_posts;
+static time_t s_vnow;
+
+static void record_post(int ch, uint8_t pct, void *arg)
+{
+    push(&s_posts, s_vnow, ch, pct, 0);
+}
+
+typedef struct {
+    const event_t *ev;
+    size_t n, next;
+    bool mismatch;
+} missed_check_t;
+
+static void check_missed(const schedule_missed_event_t *ev, size_t count, void *arg)
+{
+    missed_check_t *c = arg;
+    TEST_ASSERT_TRUE(count > 0 && count <= SCHEDULE_MISSED_BATCH);
+    for (size_t i = 0; i < count; ++i, ++c->next) {
+        if (c->next >= c->n || c->ev[c->next].at != ev[i].at || c->ev[c->next].ch != ev[i].channel ||
+            c->ev[c->next].pct != ev[i].pct) {
+            c->mismatch = true;
+        }
+    }
+}
+
+static double cpu_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double wall_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    uint64_t ticks, posts, rebuilds;
+    double cpu_s, wall_s;
+} totals_t;
+
+static totals_t s_tot;
+
+static void report_mismatch(const char *zone, const event_list_t *want, size_t i)
+{
+    const event_t *w = i < want->n ? &want->ev[i] : NULL;
+    const event_t *g = i < s_posts.n ? &s_posts.ev[i] : NULL;
+    printf("%s: first difference at #%zu: want %lld ch%d %u%%, got %lld ch%d %u%%\n", zone, i,
+           w ? (long long)w->at : -1LL, w ? w->ch : -1, w ? w->pct : 0,
+           g ? (long long)g->at : -1LL, g ? g->ch : -1, g ? g->pct : 0);
+}
+
+static void simulate(const char *zone, const scenario_t *sc)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set(zone));
+    schedule_week_t week = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&week, sc->sp, sc->n_sp));
+
+    event_list_t want = {0};
+    uint8_t want_level[SCHEDULE_NUM_CHANNELS];
+    ref_events(sc, SIM_FROM, SIM_TO, &want, want_level);
+
+    // The task loop: sleep until the next wakeup, with schedule_save() notifications mixed in
+    static schedule_run_t run;
+    memset(&run, 0, sizeof(run));
+    run.cfg = (schedule_timeline_cfg_t){ .pump_on_pct = PUMP_ON_PCT, .pump_anchor = 0 };
+    s_posts.n = 0;
+    uint64_t ticks = 0;
+    double c0 = cpu_s(), w0 = wall_s();
+    s_vnow = SIM_FROM;
+    schedule_run_start(&run, &week, &sc->s, s_vnow);
+    uint8_t start_level[SCHEDULE_NUM_CHANNELS];
+    memcpy(start_level, run.level, sizeof(start_level));
+    time_t notify_at = SIM_FROM + NOTIFY_EVERY_S;
+    for (;;) {
+        time_t wake = schedule_run_wake_at(&run, s_vnow, MAX_SLEEP_S);
+        bool changed = false;
+        if (notify_at <= wake) {
+            wake = notify_at;
+            notify_at += NOTIFY_EVERY_S;
+            changed = true;
+        }
+        if (wake > SIM_TO) break;
+        s_vnow = wake;
+        schedule_run_step(&run, &week, &sc->s, s_vnow, changed, record_post, NULL);
+        ticks++;
+    }
+    double cpu = cpu_s() - c0, wall = wall_s() - w0;
+    s_tot.ticks += ticks;
+    s_tot.posts += s_posts.n;
+    s_tot.rebuilds += run.rebuilds;
+    s_tot.cpu_s += cpu;
+    s_tot.wall_s += wall;
+
+    // Initial levels, then exactly the reference transitions at exactly their instants
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(want_level, start_level, SCHEDULE_NUM_CHANNELS);
+    size_t i = 0;
+    while (i < want.n && i < s_posts.n && cmp_event(&want.ev[i], &s_posts.ev[i]) == 0) i++;
+    if (i != want.n || i != s_posts.n) report_mismatch(zone, &want, i);
+    TEST_ASSERT_EQUAL_size_t(want.n, i);
+    TEST_ASSERT_EQUAL_size_t(want.n, s_posts.n);
+
+    // Reconciliation over random outages: the same transitions, and the same end state
+    srand(1234);
+    for (int k = 0; k < N_WINDOWS; ++k) {
+        time_t from = SIM_FROM + (time_t)((double)rand() / RAND_MAX * (SIM_TO - SIM_FROM - 30 * 86400));
+        time_t to = from + rand() % (k % 10 == 0 ? 30 * 86400 : 3 * 86400);
+        event_list_t win = {0};
+        uint8_t lv_from[SCHEDULE_NUM_CHANNELS], lv_to[SCHEDULE_NUM_CHANNELS], got[SCHEDULE_NUM_CHANNELS];
+        ref_events(sc, from, to, &win, lv_from);
+        event_list_t none = {0};
+        ref_events(sc, to, to, &none, lv_to);
+        missed_check_t c = { .ev = win.ev, .n = win.n };
+        size_t missed = 0;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_run_reconcile(&week, &sc->s, &run.cfg, NULL, from, to,
+                                                             check_missed, &c, got, &missed));
+        TEST_ASSERT_FALSE(c.mismatch);
+        TEST_ASSERT_EQUAL_size_t(win.n, c.next);
+        TEST_ASSERT_EQUAL_size_t(win.n, missed);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(lv_to, got, SCHEDULE_NUM_CHANNELS);
+        free(win.ev);
+        free(none.ev);
+    }
+
+    free(want.ev);
+    schedule_week_free(&week);
+}
+
+// Next ON/OFF of the legacy window: the first light transition to that level after `t`
+static void check_next_events(const char *zone, const scenario_t *sc)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set(zone));
+    event_list_t want = {0};
+    uint8_t level[SCHEDULE_NUM_CHANNELS];
+    ref_events(sc, SIM_FROM, SIM_TO, &want, level);
+
+    srand(99);
+    for (int k = 0; k < N_NEXT_SAMPLES; ++k) {
+        time_t t = SIM_FROM + (time_t)((double)rand() / RAND_MAX * (SIM_TO - SIM_FROM - 3 * 86400));
+        if (k % 4 == 0) t -= t % 900;   // on quarter hours, where the events are
+        time_t on, off, want_on = 0, want_off = 0;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_compute_next_events(t, &sc->s, &on, &off));
+        // First event after t (binary search), then scan forward
+        size_t lo = 0, hi = want.n;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (want.ev[mid].at <= t) lo = mid + 1; else hi = mid;
+        }
+        for (size_t i = lo; i < want.n && (!want_on || !want_off); ++i) {
+            if (want.ev[i].ch != SCHEDULE_CH_LIGHT) continue;
+            if (want.ev[i].pct && !want_on) want_on = want.ev[i].at;
+            if (!want.ev[i].pct && !want_off) want_off = want.ev[i].at;
+        }
+        TEST_ASSERT_EQUAL_INT64(want_on, on);
+        TEST_ASSERT_EQUAL_INT64(want_off, off);
+    }
+    free(want.ev);
+}
+
+static scenario_t legacy_scenario(void)
+{
+    // ON inside the spring-forward gap of most DST zones, OFF late in the evening
+    scenario_t sc = {
+        .s = { .on_hour = 2, .on_min = 30, .off_hour = 23, .off_min = 0,
+               .pump_on_interval_min = 30, .pump_on_duration_min = 5 },
+        .pump_cycle = true,
+    };
+    static schedule_setpoint_t legacy[2];
+    sc.sp = legacy;
+    sc.n_sp = schedule_program_from_legacy(&sc.s, LIGHT_ON_PCT, legacy);
+    return sc;
+}
+
+static void print_totals(const char *what, const totals_t *t, int runs)
+{
+    printf("%s: %d zones x %d years in %.2f s: %llu ticks, %llu transitions, %llu rebuilds | "
+           "%.0f transitions/s, %.0f ns CPU/tick, %.0fx real time\n",
+           what, runs, SIM_YEARS, t->wall_s, (unsigned long long)t->ticks, (unsigned long long)t->posts,
+           (unsigned long long)t->rebuilds, t->posts / t->wall_s, t->cpu_s * 1e9 / t->ticks,
+           (double)runs * (SIM_TO - SIM_FROM) / t->wall_s);
+}
+
+void test_legacy_window_and_pump_cycle_years(void)
+{
+    scenario_t sc = legacy_scenario();
+    memset(&s_tot, 0, sizeof(s_tot));
+    for (size_t z = 0; z < N_ZONES; ++z) simulate(s_zones[z], &sc);
+    print_totals("legacy window + pump cycle", &s_tot, (int)N_ZONES);
+    // Roughly 98 transitions a day per zone; a tick should be cheap next to a second
+    TEST_ASSERT_TRUE(s_tot.posts > N_ZONES * SIM_YEARS * 365ull * 90);
+    TEST_ASSERT_TRUE(s_tot.cpu_s * 1e9 / s_tot.ticks < 50000);
+}
+
+void test_weekly_program_years(void)
+{
+    scenario_t sc = { .sp = s_program, .n_sp = sizeof(s_program) / sizeof(s_program[0]) };
+    sc.s = (schedule_t){ .pump_on_interval_min = 30, .pump_on_duration_min = 5 };
+    memset(&s_tot, 0, sizeof(s_tot));
+    for (size_t z = 0; z < N_ZONES; ++z) simulate(s_zones[z], &sc);
+    print_totals("weekly program", &s_tot, (int)N_ZONES);
+    TEST_ASSERT_TRUE(s_tot.cpu_s * 1e9 / s_tot.ticks < 50000);
+}
+
+void test_compute_next_events_years(void)
+{
+    scenario_t sc = legacy_scenario();
+    for (size_t z = 0; z < N_ZONES; ++z) check_next_events(s_zones[z], &sc);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_legacy_window_and_pump_cycle_years);
+    RUN_TEST(test_weekly_program_years);
+    RUN_TEST(test_compute_next_events_years);
+    free(s_posts.ev);
+    return UNITY_END();
+}
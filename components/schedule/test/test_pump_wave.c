@@ -0,0 +1,300 @@
+#include "unity.h"
+#include "schedule_wave.h"
+#include "schedule_pump.h"
+#include "esp_timer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// Host tests for the pump waveform: level/edge arithmetic against a brute-force reference,
+// and edge timing of the timer-driven generator while other threads load every CPU.
+
+#define RUN_MS          6000
+#define P99_BOUND_US    10000
+#define N_LOADERS       8
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static schedule_pump_wave_t make_wave(int n, const uint32_t *ms, const uint8_t *pct)
+{
+    schedule_pump_wave_t w = { .count = (uint8_t)n };
+    for (int i = 0; i < n; ++i) w.seg[i] = (schedule_wave_seg_t){ .ms = ms[i], .pct = pct[i] };
+    return w;
+}
+
+// Reference: walk the segments from the epoch-aligned cycle start
+static uint8_t ref_level(const schedule_pump_wave_t *w, int64_t t_ms)
+{
+    int64_t period = schedule_wave_period_ms(w);
+    int64_t phase = ((t_ms % period) + period) % period;
+    for (int i = 0; i < w->count; ++i) {
+        if (phase < w->seg[i].ms) return w->seg[i].pct;
+        phase -= w->seg[i].ms;
+    }
+    return 0xFF;
+}
+
+void test_wave_validate(void)
+{
+    const uint32_t ok_ms[] = { 15000, 45000 };
+    const uint8_t ok_pct[] = { 80, 0 };
+    schedule_pump_wave_t w = make_wave(2, ok_ms, ok_pct);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_wave_validate(&w));
+
+    w.count = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_wave_validate(&w));
+    w = make_wave(2, ok_ms, ok_pct);
+    w.seg[1].ms = SCHEDULE_WAVE_MIN_SEG_MS - 1;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_wave_validate(&w));
+    w = make_wave(2, ok_ms, ok_pct);
+    w.seg[0].pct = 101;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_wave_validate(&w));
+    w = make_wave(2, ok_ms, ok_pct);
+    w.seg[0].ms = SCHEDULE_WAVE_MAX_PERIOD_MS;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, schedule_wave_validate(&w));
+}
+
+void test_wave_level_and_edges_match_reference(void)
+{
+    const uint32_t a_ms[] = { 15000, 45000 };                       // 15 s on / 45 s off
+    const uint8_t a_pct[] = { 80, 0 };
+    const uint32_t b_ms[] = { 300, 200, 300, 200, 300, 58700 };     // three pulses a minute
+    const uint8_t b_pct[] = { 100, 0, 100, 0, 100, 0 };
+    const uint32_t c_ms[] = { 1000, 2000, 500, 1500 };              // equal neighbours merge
+    const uint8_t c_pct[] = { 40, 40, 0, 0 };
+    schedule_pump_wave_t waves[] = { make_wave(2, a_ms, a_pct), make_wave(6, b_ms, b_pct),
+                                     make_wave(4, c_ms, c_pct) };
+
+    for (unsigned k = 0; k < sizeof(waves) / sizeof(waves[0]); ++k) {
+        const schedule_pump_wave_t *w = &waves[k];
+        TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_wave_validate(w));
+        // Around the epoch, and across a day in 2026 with a step that is prime to every period
+        const int64_t starts[] = { -200000, 1767225600000LL };
+        for (int s = 0; s < 2; ++s) {
+            for (int64_t t = starts[s]; t < starts[s] + 400000; t += 37) {
+                int64_t next;
+                uint8_t pct = schedule_wave_level(w, t, &next);
+                TEST_ASSERT_EQUAL_UINT8(ref_level(w, t), pct);
+                TEST_ASSERT_TRUE(next > t);
+                TEST_ASSERT_TRUE(ref_level(w, next) != pct);
+                TEST_ASSERT_EQUAL_UINT8(pct, ref_level(w, next - 1));
+                // Nothing changes in between
+                TEST_ASSERT_EQUAL_UINT8(pct, ref_level(w, t + (next - t) / 2));
+            }
+        }
+    }
+
+    // A constant waveform has no edge
+    const uint32_t d_ms[] = { 1000, 1000 };
+    const uint8_t d_pct[] = { 60, 60 };
+    schedule_pump_wave_t d = make_wave(2, d_ms, d_pct);
+    int64_t next;
+    TEST_ASSERT_EQUAL_UINT8(60, schedule_wave_level(&d, 12345, &next));
+    TEST_ASSERT_TRUE(next == SCHEDULE_WAVE_NEVER);
+}
+
+void test_wave_from_legacy_keeps_the_minute_cycle(void)
+{
+    schedule_t s = { .pump_on_interval_min = 30, .pump_on_duration_min = 5 };
+    schedule_pump_wave_t w;
+    schedule_wave_from_legacy(&s, 70, &w);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_wave_validate(&w));
+    TEST_ASSERT_EQUAL_UINT32(30 * 60000u, schedule_wave_period_ms(&w));
+    // Same phase as the timeline cycle anchored at the epoch: on for the first 5 minutes
+    for (int64_t t = 0; t < 3 * 86400; t += 60) {
+        uint8_t want = (t / 60) % 30 < 5 ? 70 : 0;
+        TEST_ASSERT_EQUAL_UINT8(want, schedule_wave_level(&w, t * 1000, NULL));
+    }
+    s.pump_on_duration_min = 45;    // duration >= interval: always on
+    schedule_wave_from_legacy(&s, 70, &w);
+    TEST_ASSERT_EQUAL_UINT8(70, schedule_wave_level(&w, 987654321, NULL));
+}
+
+// --- Timer-driven generator ---
+
+struct esp_timer {
+    esp_timer_cb_t cb;
+    void *arg;
+    bool armed;
+    struct timespec deadline;   // CLOCK_REALTIME, the clock gettimeofday() reads
+};
+
+static struct esp_timer s_tmr;
+static pthread_mutex_t s_tmr_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_tmr_cv = PTHREAD_COND_INITIALIZER;
+static atomic_bool s_tmr_quit;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    s_tmr.cb = args->callback;
+    s_tmr.arg = args->arg;
+    *out = &s_tmr;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    pthread_mutex_lock(&s_tmr_mu);
+    if (t->armed) {
+        pthread_mutex_unlock(&s_tmr_mu);
+        return ESP_ERR_INVALID_STATE;
+    }
+    clock_gettime(CLOCK_REALTIME, &t->deadline);
+    uint64_t ns = (uint64_t)t->deadline.tv_nsec + timeout_us * 1000;
+    t->deadline.tv_sec += ns / 1000000000;
+    t->deadline.tv_nsec = ns % 1000000000;
+    t->armed = true;
+    pthread_cond_signal(&s_tmr_cv);
+    pthread_mutex_unlock(&s_tmr_mu);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&s_tmr_mu);
+    esp_err_t err = t->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    t->armed = false;
+    pthread_mutex_unlock(&s_tmr_mu);
+    return err;
+}
+
+// Dispatch thread: runs callbacks one at a time, like the esp_timer task
+static void *timer_task(void *arg)
+{
+    pthread_mutex_lock(&s_tmr_mu);
+    while (!atomic_load(&s_tmr_quit)) {
+        if (!s_tmr.armed) {
+            pthread_cond_wait(&s_tmr_cv, &s_tmr_mu);
+            continue;
+        }
+        struct timespec dl = s_tmr.deadline;
+        if (pthread_cond_timedwait(&s_tmr_cv, &s_tmr_mu, &dl) == 0) continue;  // re-armed or stopped
+        if (!s_tmr.armed) continue;
+        s_tmr.armed = false;
+        pthread_mutex_unlock(&s_tmr_mu);
+        s_tmr.cb(s_tmr.arg);
+        pthread_mutex_lock(&s_tmr_mu);
+    }
+    pthread_mutex_unlock(&s_tmr_mu);
+    return NULL;
+}
+
+static int64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+#define MAX_POSTS 256
+static struct { int64_t at_us; uint8_t pct; } s_posts[MAX_POSTS];
+static atomic_int s_nposts;
+
+static void record_post(uint8_t pct, void *arg)
+{
+    int i = atomic_fetch_add(&s_nposts, 1);
+    if (i < MAX_POSTS) {
+        s_posts[i].at_us = wall_us();
+        s_posts[i].pct = pct;
+    }
+}
+
+// Simulated load: spin, touch memory and yield now and then, on more threads than CPUs
+static volatile uint32_t s_sink;
+
+static void *loader(void *arg)
+{
+    uint32_t buf[4096] = {0};
+    while (!atomic_load(&s_tmr_quit)) {
+        for (int i = 0; i < 200000; ++i) buf[i & 4095] += (uint32_t)i;
+        s_sink = buf[17];
+        sched_yield();
+    }
+    return NULL;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+void test_timer_edges_under_load(void)
+{
+    // Pulsed bursts: 150 ms pulses, two per burst, a burst every second
+    const uint32_t ms[] = { 150, 100, 150, 600 };
+    const uint8_t pct[] = { 90, 0, 90, 0 };
+    schedule_pump_wave_t w = make_wave(4, ms, pct);
+
+    pthread_t tt, load[N_LOADERS];
+    atomic_store(&s_tmr_quit, false);
+    pthread_create(&tt, NULL, timer_task, NULL);
+    for (int i = 0; i < N_LOADERS; ++i) pthread_create(&load[i], NULL, loader, NULL);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_pump_init(record_post, NULL));
+
+    int64_t start_us = wall_us();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_pump_start(&w));
+    TEST_ASSERT_TRUE(schedule_pump_running());
+    usleep(RUN_MS * 1000);
+    schedule_pump_stop();
+    int64_t stop_us = wall_us();
+    usleep(50000);
+    int n = atomic_load(&s_nposts);
+    TEST_ASSERT_FALSE(schedule_pump_running());
+
+    atomic_store(&s_tmr_quit, true);
+    pthread_mutex_lock(&s_tmr_mu);
+    pthread_cond_signal(&s_tmr_cv);
+    pthread_mutex_unlock(&s_tmr_mu);
+    pthread_join(tt, NULL);
+    for (int i = 0; i < N_LOADERS; ++i) pthread_join(load[i], NULL);
+
+    // First post: the level at start. Then one post per edge, in order, each at or after
+    // its wall-clock instant.
+    TEST_ASSERT_TRUE(n > 1 && n <= MAX_POSTS);
+    TEST_ASSERT_EQUAL_UINT8(schedule_wave_level(&w, s_posts[0].at_us / 1000, NULL), s_posts[0].pct);
+    TEST_ASSERT_TRUE(s_posts[0].at_us - start_us < P99_BOUND_US);
+
+    int64_t late[MAX_POSTS];
+    int edges = 0;
+    int64_t edge_ms;
+    schedule_wave_level(&w, s_posts[0].at_us / 1000, &edge_ms);
+    while (edge_ms * 1000 < stop_us - P99_BOUND_US) {
+        int64_t next_ms;
+        uint8_t want = schedule_wave_level(&w, edge_ms, &next_ms);
+        TEST_ASSERT_TRUE(edges + 1 < n);
+        TEST_ASSERT_EQUAL_UINT8(want, s_posts[edges + 1].pct);
+        late[edges] = s_posts[edges + 1].at_us - edge_ms * 1000;
+        TEST_ASSERT_TRUE(late[edges] >= 0);
+        edges++;
+        edge_ms = next_ms;
+    }
+    qsort(late, edges, sizeof(late[0]), cmp_i64);
+    int64_t p50 = late[edges / 2], p99 = late[edges * 99 / 100], worst = late[edges - 1];
+
+    uint32_t st_edges, st_late;
+    schedule_pump_get_stats(&st_edges, &st_late);
+    printf("pump wave: %d edges in %d ms with %d loader threads: p50=%lldus p99=%lldus worst=%lldus "
+           "(stats edges=%u worst=%uus)\n", edges, RUN_MS, N_LOADERS,
+           (long long)p50, (long long)p99, (long long)worst, st_edges, st_late);
+
+    TEST_ASSERT_TRUE(edges >= RUN_MS / 1000 * 4 - 4);
+    TEST_ASSERT_TRUE(st_edges >= (uint32_t)edges);
+    TEST_ASSERT_TRUE(p99 < P99_BOUND_US);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_wave_validate);
+    RUN_TEST(test_wave_level_and_edges_match_reference);
+    RUN_TEST(test_wave_from_legacy_keeps_the_minute_cycle);
+    RUN_TEST(test_timer_edges_under_load);
+    return UNITY_END();
+}
@@ -0,0 +1,115 @@
+#include "unity.h"
+#include "schedule_timeline.h"
+#include "tz.h"
+#include <string.h>
+#include <time.h>
+
+// Host tests: walking missed transitions across multi-day gaps and DST changes.
+// Every reported transition is checked against a minute-by-minute evaluation of the
+// schedule over the same span.
+
+#define LIGHT_ON_PCT    70
+#define PUMP_ON_PCT     60
+#define MAX_EVENTS      4096
+// 2024-03-25 00:00 UTC: a 10-day gap from here crosses the EU spring-forward (2024-03-31)
+#define GAP_START       1711324800
+
+typedef struct {
+    time_t at;
+    int ch;
+    uint8_t pct;
+} event_t;
+
+static event_t s_got[MAX_EVENTS];
+static size_t s_n_got;
+
+static void record(time_t at, int ch, uint8_t pct, void *arg)
+{
+    (void)arg;
+    if (s_n_got < MAX_EVENTS) s_got[s_n_got++] = (event_t){ at, ch, pct };
+}
+
+static uint8_t ref_level(const schedule_week_t *w, const schedule_t *s, time_t t, int ch)
+{
+    if (ch == SCHEDULE_CH_PUMP && w->n[SCHEDULE_CH_PUMP] == 0) {
+        long mins = (long)(t / 60);
+        return mins % s->pump_on_interval_min < s->pump_on_duration_min ? PUMP_ON_PCT : 0;
+    }
+    int lvl = schedule_week_level(w, ch, schedule_local_mow(t));
+    return lvl < 0 ? 0 : (uint8_t)lvl;
+}
+
+static void check_walk(const schedule_t *s, time_t from, time_t to)
+{
+    schedule_setpoint_t sp[2];
+    schedule_week_t week = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, schedule_week_compile(&week, sp, schedule_program_from_legacy(s, LIGHT_ON_PCT, sp)));
+    schedule_timeline_cfg_t cfg = { .pump_on_pct = PUMP_ON_PCT, .pump_anchor = 0 };
+    static schedule_timeline_t scratch;
+    uint8_t level[SCHEDULE_NUM_CHANNELS];
+
+    s_n_got = 0;
+    size_t n = schedule_timeline_walk(&scratch, &week, s, &cfg, from, to, record, NULL, level);
+    TEST_ASSERT_EQUAL_UINT32(s_n_got, n);
+
+    // Minute-by-minute reference: a transition wherever a level differs from a minute ago
+    size_t k = 0;
+    for (time_t t = from + 60; t <= to; t += 60) {
+        for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+            uint8_t now = ref_level(&week, s, t, ch), before = ref_level(&week, s, t - 60, ch);
+            if (now == before) continue;
+            TEST_ASSERT_TRUE(k < n);
+            TEST_ASSERT_EQUAL_INT64(t, s_got[k].at);
+            TEST_ASSERT_EQUAL_INT(ch, s_got[k].ch);
+            TEST_ASSERT_EQUAL_INT(now, s_got[k].pct);
+            k++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(k, n);
+    for (int ch = 0; ch < SCHEDULE_NUM_CHANNELS; ++ch) {
+        TEST_ASSERT_EQUAL_INT(ref_level(&week, s, to, ch), level[ch]);
+    }
+    schedule_week_free(&week);
+}
+
+void setUp(void)
+{
+    // Also sets TZ for libc, which the reference implementation uses
+    tz_set("Europe/Berlin");
+}
+void tearDown(void) {}
+
+void test_walk_multi_day_gap_across_dst(void)
+{
+    schedule_t s = { .on_hour = 7, .on_min = 0, .off_hour = 21, .off_min = 0,
+                     .pump_on_interval_min = 30, .pump_on_duration_min = 5 };
+    check_walk(&s, GAP_START, GAP_START + 10 * 86400);
+    // 96 pump edges and 2 light edges per day
+    TEST_ASSERT_TRUE(s_n_got >= 10 * 98 - 2 && s_n_got <= 10 * 98 + 2);
+}
+
+void test_walk_overnight_window_and_dst_gap(void)
+{
+    // ON inside the skipped hour on 2024-03-31: takes effect at the jump
+    schedule_t s = { .on_hour = 2, .on_min = 30, .off_hour = 1, .off_min = 15,
+                     .pump_on_interval_min = 45, .pump_on_duration_min = 45 };
+    check_walk(&s, GAP_START + 3 * 86400 + 1800, GAP_START + 9 * 86400);
+}
+
+void test_walk_short_and_empty_gaps(void)
+{
+    schedule_t s = { .on_hour = 7, .on_min = 0, .off_hour = 21, .off_min = 0,
+                     .pump_on_interval_min = 30, .pump_on_duration_min = 5 };
+    check_walk(&s, GAP_START + 7 * 3600 - 60, GAP_START + 7 * 3600 + 60);
+    check_walk(&s, GAP_START, GAP_START);
+    TEST_ASSERT_EQUAL_UINT32(0, s_n_got);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_walk_multi_day_gap_across_dst);
+    RUN_TEST(test_walk_overnight_window_and_dst_gap);
+    RUN_TEST(test_walk_short_and_empty_gaps);
+    return UNITY_END();
+}
@@ -0,0 +1,162 @@
+#include "unity.h"
+#include "schedule_record.h"
+#include "storage.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+
+// Host tests for the schedule record on the storage NVS stand-in: the raw schedule_t older
+// firmware stored (legacy "<key>" + "<key>_bak" items, data + CRC) is upgraded in place
+// instead of being replaced by defaults, a record lacking fields keeps their defaults, and
+// the record is smaller than the struct.
+
+// schedule_t before this series, as stored by the baseline firmware
+typedef struct {
+    int on_hour;
+    int pump_on_interval_min;
+    int off_hour;
+    int pump_on_duration_min;
+    char tz[64];
+} baseline_schedule_t;
+
+static schedule_t defaults(void)
+{
+    schedule_t s = { .on_hour = 7, .off_hour = 21, .pump_on_interval_min = 30,
+                     .pump_on_duration_min = 5, .tz = "UTC" };
+    return s;
+}
+
+static schedule_t custom(void)
+{
+    schedule_t s = { .on_hour = 6, .on_min = 45, .off_hour = 22, .off_min = 15,
+                     .pump_on_interval_min = 120, .pump_on_duration_min = 0,
+                     .tz = "America/Argentina/Buenos_Aires" };
+    return s;
+}
+
+static baseline_schedule_t baseline(void)
+{
+    baseline_schedule_t b = { .on_hour = 6, .pump_on_interval_min = 120, .off_hour = 22,
+                              .pump_on_duration_min = 0, .tz = "America/Argentina/Buenos_Aires" };
+    return b;
+}
+
+// Write `data` the way storage_save_config() did before A/B slots: data + CRC-32 under the
+// backup key (snprintf-truncated to the NVS key limit), then the primary
+static void save_legacy(const char *key, const void *data, size_t len)
+{
+    uint8_t blob[sizeof(baseline_schedule_t) + sizeof(uint32_t)];
+    TEST_ASSERT_TRUE(len + sizeof(uint32_t) <= sizeof(blob));
+    memcpy(blob, data, len);
+    uint32_t crc = storage_crc32(data, len);
+    memcpy(blob + len, &crc, sizeof(crc));
+
+    char backup_key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(backup_key, sizeof(backup_key), "%s_bak", key);
+    nvs_handle_t h;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &h));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_set_blob(h, backup_key, blob, len + sizeof(crc)));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_set_blob(h, key, blob, len + sizeof(crc)));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_commit(h));
+    nvs_close(h);
+}
+
+void setUp(void)
+{
+    storage_deinit();
+    sim_nvs_reset();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+}
+
+void tearDown(void) {}
+
+void test_raw_struct_upgraded(void)
+{
+    baseline_schedule_t old = baseline();
+    save_legacy(SCHEDULE_RECORD_KEY, &old, sizeof(old));
+
+    schedule_t want = custom();
+    want.on_min = 0;
+    want.off_min = 0;
+    schedule_t s = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&schedule_schema, &s));
+    TEST_ASSERT_EQUAL_MEMORY(&want, &s, sizeof(s));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+
+    // Rewritten as a record in the A/B slots, the legacy primary dropped
+    TEST_ASSERT_FALSE(sim_nvs_exists(SCHEDULE_RECORD_KEY));
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = sizeof(buf);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(SCHEDULE_RECORD_KEY, buf, &len));
+    TEST_ASSERT_EQUAL_HEX8(STORAGE_RECORD_MAGIC, buf[0]);
+    TEST_ASSERT_EQUAL_UINT8(schedule_schema.version, buf[1]);
+    printf("schedule: %u bytes stored, was %u\n", (unsigned)len, (unsigned)sizeof(old));
+    TEST_ASSERT_TRUE(len < sizeof(schedule_t));
+
+    // From a fresh boot too, not only from the cache
+    storage_deinit();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    s = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&schedule_schema, &s));
+    TEST_ASSERT_EQUAL_MEMORY(&want, &s, sizeof(s));
+}
+
+void test_minutes_struct_upgraded(void)
+{
+    // The raw schedule_t with minutes, as development builds stored it before records
+    schedule_t old = custom();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(SCHEDULE_RECORD_KEY, &old, sizeof(old)));
+
+    schedule_t s = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&schedule_schema, &s));
+    TEST_ASSERT_EQUAL_MEMORY(&old, &s, sizeof(s));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+}
+
+void test_unterminated_raw_tz_cut(void)
+{
+    baseline_schedule_t old = baseline();
+    memset(old.tz, 'Z', sizeof(old.tz));
+    save_legacy(SCHEDULE_RECORD_KEY, &old, sizeof(old));
+    schedule_t s = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&schedule_schema, &s));
+    TEST_ASSERT_EQUAL_UINT(sizeof(s.tz) - 1, strlen(s.tz));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+}
+
+void test_unknown_blob_rejected(void)
+{
+    uint8_t junk[40] = {1, 2, 3};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(SCHEDULE_RECORD_KEY, junk, sizeof(junk)));
+    schedule_t s = defaults();
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, storage_record_load(&schedule_schema, &s));
+}
+
+void test_missing_fields_keep_defaults(void)
+{
+    // A record from a schema that only had the light window and the zone
+    const storage_schema_t lights_only = {
+        .key = SCHEDULE_RECORD_KEY, .version = 1, .fields = schedule_schema.fields, .field_count = 4,
+    };
+    schedule_t old = custom();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_save(&lights_only, &old));
+
+    schedule_t s = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&schedule_schema, &s));
+    TEST_ASSERT_EQUAL_INT(old.on_min, s.on_min);
+    TEST_ASSERT_EQUAL_INT(old.off_hour, s.off_hour);
+    TEST_ASSERT_EQUAL_INT(30, s.pump_on_interval_min);
+    TEST_ASSERT_EQUAL_STRING("UTC", s.tz);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_struct_upgraded);
+    RUN_TEST(test_minutes_struct_upgraded);
+    RUN_TEST(test_unterminated_raw_tz_cut);
+    RUN_TEST(test_unknown_blob_rejected);
+    RUN_TEST(test_missing_fields_keep_defaults);
+    return UNITY_END();
+}
@@ -3,11 +3,16 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <esp_err.h>
+#include "freertos/FreeRTOS.h"
 
-// Storage component: NVS-backed storage with CRC + backup copy.
+// Storage component: NVS-backed storage with CRC + A/B slots.
 // Purpose: reliably store small configuration blobs (schedules, device config).
-// Security/reliability: each blob stores a CRC; a backup copy is kept under "<key>_bak".
-// On load, if the primary key is corrupt, the backup is used and restored.
+// Security/reliability: each blob is kept in two slots, "<key>.a" and "<key>.b", each with a
+// generation number and a CRC. A save overwrites only the older slot; a load takes the
+// newest slot that verifies and restores a corrupt one from it.
+// Verified values are cached in RAM: loads only touch flash on a miss, saves of unchanged
+// content write nothing, and subscribers are told when a key changes instead of polling.
+// The *_async() saves hand the value to storage_task and return without touching flash.
 
 /**
  * @brief Initialize storage subsystem (must be called before other APIs).
@@ -19,12 +24,21 @@
  */
 esp_err_t storage_init(void);
 
+/**
+ * @brief Drop the cache and subscribers and release NVS (storage_init() starts over).
+ */
+esp_err_t storage_deinit(void);
+
 /**
  * @brief Save a configuration blob to NVS.
  *
- * A CRC is calculated and appended to the data. A backup copy is also maintained
- * for reliability. The save order is backup then primary to ensure the backup is
- * always the last known good version.
+ * The data is written with the next generation number and a CRC into the slot that does
+ * not hold the newest copy, then committed: one blob write per save, and the previous
+ * version stays readable if the write is torn. The first save of a key fills both slots.
+ * Keys are at most 13 characters (room for the slot suffix).
+ *
+ * If the data equals the cached copy of the key nothing is written or committed and no
+ * subscriber is notified. Otherwise subscribers of the key are called after the commit.
  *
  * @param key The key to store the data under.
  * @param data Pointer to the data to save.
@@ -36,9 +50,12 @@ esp_err_t storage_save_config(const char *key, const void *data, size_t len);
 /**
  * @brief Load a configuration blob from NVS.
  *
- * This function attempts to load data from the primary key. If the data is not found
- * or the CRC check fails, it will attempt to load from the backup key. If the backup
-is valid, it will be used to restore the primary key.
+ * This function loads the slot with the newest generation that passes the CRC check. If
+ * the other slot is corrupt it is rewritten from that one. Blobs saved by older firmware
+ * as "<key>" with a "<key>_bak" backup are still read; the next save converts them.
+ *
+ * Blobs up to CONFIG_STORAGE_MAX_BLOB bytes are served from the RAM cache after the first
+ * load or save, and neither path allocates for them once their cache entry has a buffer.
  *
  * To get the required buffer size, call this function with `out_buf` as NULL. The
  * required size will be returned in `len`.
@@ -53,9 +70,80 @@ esp_err_t storage_load_config(const char *key, void *out_buf, size_t *len);
 // Helpers used in tests and utility code
 uint32_t storage_crc32(const void *data, size_t len);
 
-// Build backup key name into out buffer as "<key>_bak"; returns out on success or NULL if too small
+// Build the legacy backup key name into out buffer as "<key>_bak"; returns out on success or NULL if too small
 char *storage_make_backup_key(const char *key, char *out, size_t out_size);
 
 // Simple uint32 convenience APIs
 esp_err_t storage_save_uint32(const char *key, uint32_t value);
 esp_err_t storage_load_uint32(const char *key, uint32_t *out_value);
+
+/**
+ * @brief Completion of an asynchronous save, called from storage_task.
+ *
+ * `err` is the result storage_save_config()/storage_save_uint32() returned for the write.
+ * Storage APIs may be called from it, storage_flush() excepted.
+ */
+typedef void (*storage_done_cb_t)(const char *key, esp_err_t err, void *arg);
+
+/**
+ * @brief Queue a save of a configuration blob for storage_task and return.
+ *
+ * The data is copied into one of CONFIG_STORAGE_WRITE_SLOTS pooled buffers; the caller
+ * waits only if all of them hold saves of other keys. A save of a key whose previous
+ * save is still queued replaces the queued data, so a burst of saves is written once.
+ * Loads return the queued data until it is written. Blobs larger than
+ * CONFIG_STORAGE_MAX_BLOB are written by the caller, after the queued saves.
+ *
+ * @param done Optional, called once the data (or newer data of the key) is in flash or
+ *             the write failed. Saves with different callbacks or args are not merged.
+ * @return ESP_OK once queued, or the argument checks of storage_save_config().
+ */
+esp_err_t storage_save_config_async(const char *key, const void *data, size_t len,
+                                    storage_done_cb_t done, void *arg);
+esp_err_t storage_save_uint32_async(const char *key, uint32_t value, storage_done_cb_t done, void *arg);
+
+/**
+ * @brief Wait until every queued save is written and its callback has returned.
+ *
+ * @return ESP_OK, ESP_ERR_TIMEOUT, the first write error since the previous call, or
+ *         ESP_ERR_INVALID_STATE when called from storage_task.
+ */
+esp_err_t storage_flush(TickType_t timeout);
+
+/**
+ * @brief Called after a key changed in flash (from the saving task, without storage locks held).
+ *
+ * Keep it short, e.g. notify the reader's task; storage APIs may be called from it.
+ */
+typedef void (*storage_change_cb_t)(const char *key, uint32_t version, void *arg);
+
+/**
+ * @brief Call `cb` whenever `key` is saved with new content (`key` NULL: any key).
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM if CONFIG_STORAGE_MAX_SUBSCRIBERS are registered.
+ */
+esp_err_t storage_subscribe(const char *key, storage_change_cb_t cb, void *arg);
+esp_err_t storage_unsubscribe(const char *key, storage_change_cb_t cb, void *arg);
+
+/**
+ * @brief Version of the cached value of `key`, 0 if it is not cached.
+ *
+ * Every change gets a new version and versions never repeat, so a reader that remembers
+ * the version it read can tell whether it is still current. A key evicted from the cache
+ * and read back gets a new version too.
+ */
+uint32_t storage_version(const char *key);
+
+typedef struct {
+    uint32_t loads;             // storage_load_config/_uint32 calls
+    uint32_t cache_hits;        // ... answered from RAM
+    uint32_t saves;             // storage_save_config/_uint32 calls
+    uint32_t saves_skipped;     // ... with unchanged content: no write, commit or notification
+    uint32_t nvs_writes;        // nvs_set_* calls issued
+    uint32_t nvs_commits;
+    uint32_t evictions;
+    uint32_t async_queued;      // *_async() saves that took a pool buffer
+    uint32_t async_coalesced;   // ... merged into a queued save of the same key instead
+} storage_stats_t;
+
+esp_err_t storage_get_stats(storage_stats_t *out);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include "storage.h"
+
+// Versioned config records: a C struct stored field by field as tag/value pairs instead of
+// as its raw bytes, so a record only takes the space its values need and a struct can grow,
+// shrink or reorder without making what is in flash unreadable.
+//
+// Layout: STORAGE_RECORD_MAGIC, schema version, then per field a varint key
+// (tag << 3 | wire type) and either a varint (integers; signed ones zigzag-encoded) or a
+// varint length and that many bytes (strings without the NUL, byte arrays without trailing
+// zeros). Every field is written, zero or not: a missing tag means the default, which need
+// not be zero. A tag identifies one field forever: retire it, never reuse it.
+//
+// Decoding starts from the caller's defaults: tags the record lacks keep them, tags the
+// schema does not know are skipped. Changes that need more than that (units, a field split
+// in two, the raw struct older firmware stored) go in migrations, one per version step.
+
+#define STORAGE_RECORD_MAGIC    0xA7    // a UTF-8 continuation byte: starts no raw string
+#define STORAGE_RECORD_MAX      256     // encoded size limit, on the caller's stack
+
+typedef enum {
+    STORAGE_FIELD_INT,      // signed integer of `size` bytes
+    STORAGE_FIELD_UINT,     // unsigned integer of `size` bytes
+    STORAGE_FIELD_STR,      // char[size], NUL-terminated
+    STORAGE_FIELD_BYTES,    // uint8_t[size]
+} storage_field_type_t;
+
+typedef struct {
+    uint8_t tag;            // 1..127; 1..15 encode in one byte
+    uint8_t type;           // storage_field_type_t
+    uint16_t offset;
+    uint16_t size;
+} storage_field_t;
+
+#define STORAGE_FIELD(tag_, type_, struct_, member_) \
+    { .tag = (tag_), .type = (type_), .offset = offsetof(struct_, member_), \
+      .size = sizeof(((struct_ *)0)->member_) }
+
+/**
+ * @brief Upgrade a record from schema version `from` to `from + 1`.
+ *
+ * For `from` == 0, `raw`/`raw_len` are a blob stored before the key used records (usually
+ * the raw struct) and `rec` holds the defaults; check `raw_len` before using it. For later
+ * versions `rec` holds the version `from` record, decoded with the current field table
+ * (so it only needs to fix what the tags alone do not), and `raw` is NULL.
+ */
+typedef esp_err_t (*storage_migrate_fn_t)(void *rec, const void *raw, size_t raw_len);
+
+typedef struct {
+    const char *key;
+    uint8_t version;                        // written with every save, >= 1
+    const storage_field_t *fields;
+    size_t field_count;
+    // [v]: v -> v + 1 for each v < version, or NULL for a step that only added or retired
+    // tags. Without [0] a blob that is not a record is rejected.
+    const storage_migrate_fn_t *migrations;
+} storage_schema_t;
+
+/**
+ * @brief Encode `rec` into `out`.
+ *
+ * @return ESP_OK with the length in `*len`, ESP_ERR_INVALID_SIZE if it exceeds `cap`.
+ */
+esp_err_t storage_record_encode(const storage_schema_t *schema, const void *rec, uint8_t *out,
+                                size_t cap, size_t *len);
+
+/**
+ * @brief Decode `data` into `rec`, which holds the defaults, and run the migrations from
+ * the stored version to the current one.
+ *
+ * A blob that is not a record is taken as version 0 and handed to migration 0. A record
+ * from a newer schema is decoded as far as the tags are known.
+ *
+ * @param from If not NULL, receives the version found (0 for a non-record blob).
+ * @return ESP_OK; ESP_ERR_INVALID_VERSION for a non-record blob and no migration 0;
+ *         ESP_ERR_INVALID_SIZE for a malformed record or a value that does not fit its field;
+ *         or a migration's error.
+ */
+esp_err_t storage_record_decode(const storage_schema_t *schema, const uint8_t *data, size_t len,
+                                void *rec, uint8_t *from);
+
+/**
+ * @brief Load the record of `schema->key` into `rec`, which holds the defaults.
+ *
+ * A record stored by an older schema is migrated and saved back (asynchronously) in the
+ * current version, so the upgrade happens once. On error `rec` may be partly decoded.
+ *
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND, or the errors of storage_record_decode().
+ */
+esp_err_t storage_record_load(const storage_schema_t *schema, void *rec);
+
+// Encode `rec` and save it like storage_save_config() / storage_save_config_async()
+esp_err_t storage_record_save(const storage_schema_t *schema, const void *rec);
+esp_err_t storage_record_save_async(const storage_schema_t *schema, const void *rec,
+                                    storage_done_cb_t done, void *arg);
@@ -1,6 +1,9 @@
 #include "storage.h"
+#include "storage_priv.h"
 #include <string.h>
 #include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -11,6 +14,76 @@ static const char *TAG = "storage";
 
 static bool s_inited = false;
 
+// Blobs live in two slots, "<key>.a" and "<key>.b", each holding a generation number, the
+// data and a CRC over both. A save overwrites only the slot not holding the newest copy,
+// so a torn or failed write leaves the previous copy intact, and a load takes the newest
+// slot that verifies. Configs saved by older firmware as "<key>" + "<key>_bak" (data + CRC)
+// are still read, and removed by the first save. Keys are at most SLOT_KEY_MAX characters.
+
+typedef struct {
+    uint32_t gen;
+} slot_hdr_t;
+
+typedef struct {
+    uint32_t gen;       // generation of the newest valid slot
+    int8_t newest;      // 0/1, -1: no valid slot (nothing saved, or only the legacy format)
+} slots_t;
+
+// Slot I/O goes through static buffers, one per slot, used under s_lock: a slot is read
+// into and built for writing in s_io[slot] (the legacy format uses s_io[0]). Only blobs
+// over CONFIG_STORAGE_MAX_BLOB use the heap. Each NVS item is read with a single
+// nvs_get_blob() and the CRC is chained over header and data, so nothing is assembled twice.
+#define SLOT_BUF_SIZE   (sizeof(slot_hdr_t) + CONFIG_STORAGE_MAX_BLOB + sizeof(uint32_t))
+
+typedef struct {
+    uint8_t *buf;       // s_io[] or heap
+    size_t off;         // data offset in buf
+    size_t len;         // data length
+} blob_t;
+
+// RAM cache of verified values. Flash is only read on a miss; saves go through to NVS and
+// update the entry, so the cache never holds anything NVS does not. Every change of a key
+// gets a new version from one global sequence, so versions never repeat, not even for a
+// key that was evicted and read back.
+typedef enum { ENTRY_FREE, ENTRY_BLOB, ENTRY_U32 } entry_kind_t;
+
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    entry_kind_t kind;
+    uint8_t *data;      // ENTRY_BLOB: heap, `len` bytes; kept for the next key on eviction
+    size_t len;
+    size_t cap;         // allocated size of `data`
+    slots_t slots;      // ENTRY_BLOB: where `data` is in flash
+    uint32_t u32;       // ENTRY_U32
+    uint32_t version;
+    uint32_t used;      // LRU stamp
+} cache_entry_t;
+
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];    // empty: every key
+    storage_change_cb_t cb;
+    void *arg;
+} subscriber_t;
+
+static cache_entry_t s_cache[CONFIG_STORAGE_CACHE_ENTRIES];
+static subscriber_t s_subs[CONFIG_STORAGE_MAX_SUBSCRIBERS];
+static uint32_t s_seq;
+static uint32_t s_clock;
+static storage_stats_t s_stats;
+static SemaphoreHandle_t s_lock;
+static StaticSemaphore_t s_lock_buf;
+static nvs_handle_t s_handle;           // open from storage_init() to storage_deinit()
+static uint8_t s_io[2][SLOT_BUF_SIZE];
+
+static void lock(void) { xSemaphoreTake(s_lock, portMAX_DELAY); }
+static void unlock(void) { xSemaphoreGive(s_lock); }
+
+static void copy_key(char out[NVS_KEY_NAME_MAX_SIZE], const char *key)
+{
+    strncpy(out, key, NVS_KEY_NAME_MAX_SIZE - 1);
+    out[NVS_KEY_NAME_MAX_SIZE - 1] = '\0';
+}
+
 esp_err_t storage_init(void)
 {
     if (s_inited) {
@@ -26,170 +99,400 @@ esp_err_t storage_init(void)
         ESP_LOGE(TAG, "nvs_flash_init failed: %s", esp_err_to_name(err));
         return err;
     }
+    err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &s_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
     s_inited = true;
+    // Without storage_task the *_async() saves are written by the caller
+    if (storage_async_start() != ESP_OK) ESP_LOGW(TAG, "storage_task not started, saves are synchronous");
     ESP_LOGI(TAG, "Storage initialized (namespace: %s)", CONFIG_STORAGE_NAMESPACE);
     return ESP_OK;
 }
 
-esp_err_t storage_save_config(const char *key, const void *data, size_t len)
+esp_err_t storage_deinit(void)
 {
-    if (!s_inited) return ESP_ERR_INVALID_STATE;
-    if (!key || !data || len == 0) return ESP_ERR_INVALID_ARG;
-
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(err));
-        return err;
+    if (!s_inited) return ESP_OK;
+    storage_async_stop();
+    for (int i = 0; i < CONFIG_STORAGE_CACHE_ENTRIES; ++i) {
+        free(s_cache[i].data);
     }
+    memset(s_cache, 0, sizeof(s_cache));
+    memset(s_subs, 0, sizeof(s_subs));
+    memset(&s_stats, 0, sizeof(s_stats));
+    vSemaphoreDelete(s_lock);
+    nvs_close(s_handle);
+    s_inited = false;
+    return nvs_flash_deinit();
+}
 
-    // Create a temporary buffer for data + CRC
-    size_t blob_size = len + sizeof(uint32_t);
-    uint8_t *blob = malloc(blob_size);
-    if (!blob) {
-        nvs_close(handle);
-        return ESP_ERR_NO_MEM;
+// --- Cache (callers hold s_lock) ---
+
+static cache_entry_t *cache_find(const char *key, entry_kind_t kind)
+{
+    for (int i = 0; i < CONFIG_STORAGE_CACHE_ENTRIES; ++i) {
+        cache_entry_t *e = &s_cache[i];
+        if (e->kind == kind && strcmp(e->key, key) == 0) {
+            e->used = ++s_clock;
+            return e;
+        }
     }
+    return NULL;
+}
 
-    // Copy data and calculate CRC
-    memcpy(blob, data, len);
-    *(uint32_t*)(blob + len) = esp_crc32_le(0, data, len);
+// Forget the value; the buffer stays with the entry for whatever is stored in it next
+static void cache_drop(cache_entry_t *e)
+{
+    uint8_t *data = e->data;
+    size_t cap = e->cap;
+    memset(e, 0, sizeof(*e));
+    e->data = data;
+    e->cap = cap;
+}
 
-    // --- Save Strategy: Backup First ---
-    // 1. Save to backup key
-    char backup_key[NVS_KEY_NAME_MAX_SIZE];
-    snprintf(backup_key, sizeof(backup_key), "%s_bak", key);
-    err = nvs_set_blob(handle, backup_key, blob, blob_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save to backup key '%s': %s", backup_key, esp_err_to_name(err));
-        goto cleanup;
+// Entry for `key`: the existing one, a free one, or the least recently used one
+static cache_entry_t *cache_slot(const char *key, entry_kind_t kind)
+{
+    cache_entry_t *victim = NULL;
+    for (int i = 0; i < CONFIG_STORAGE_CACHE_ENTRIES; ++i) {
+        cache_entry_t *e = &s_cache[i];
+        if (e->kind != ENTRY_FREE && strcmp(e->key, key) == 0) {
+            if (e->kind != kind) cache_drop(e);
+            return e;
+        }
+        if (!victim || (victim->kind != ENTRY_FREE && (e->kind == ENTRY_FREE || e->used < victim->used))) {
+            victim = e;
+        }
     }
-
-    // 2. Save to primary key
-    err = nvs_set_blob(handle, key, blob, blob_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save to primary key '%s': %s", key, esp_err_to_name(err));
-        goto cleanup;
+    if (victim && victim->kind != ENTRY_FREE) {
+        s_stats.evictions++;
+        cache_drop(victim);
     }
+    return victim;
+}
 
-    // 3. Commit changes
-    err = nvs_commit(handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "nvs_commit failed: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Saved config for key '%s' (%d bytes)", key, len);
+// Store `data` for `key`, found in flash as `slots`, and return its new version (a blob too
+// large for the cache gets one as well). Allocates only when the entry's buffer is too small.
+static uint32_t cache_put_blob(const char *key, const void *data, size_t len, const slots_t *slots)
+{
+    cache_entry_t *e = len <= CONFIG_STORAGE_MAX_BLOB ? cache_slot(key, ENTRY_BLOB) : NULL;
+    if (!e) {
+        // Not cacheable: whatever was cached for the key is stale now
+        if ((e = cache_find(key, ENTRY_BLOB)) != NULL) cache_drop(e);
+        return ++s_seq;
+    }
+    if (e->cap < len) {
+        uint8_t *grown = malloc(len);
+        if (!grown) {
+            cache_drop(e);
+            return ++s_seq;
+        }
+        free(e->data);
+        e->data = grown;
+        e->cap = len;
     }
+    memcpy(e->data, data, len);
+    copy_key(e->key, key);
+    e->kind = ENTRY_BLOB;
+    e->len = len;
+    e->slots = *slots;
+    e->used = ++s_clock;
+    e->version = ++s_seq;
+    return e->version;
+}
 
-cleanup:
-    free(blob);
-    nvs_close(handle);
-    return err;
+static uint32_t cache_put_u32(const char *key, uint32_t value)
+{
+    cache_entry_t *e = cache_slot(key, ENTRY_U32);
+    if (!e) return ++s_seq;
+    copy_key(e->key, key);
+    e->kind = ENTRY_U32;
+    e->u32 = value;
+    e->used = ++s_clock;
+    e->version = ++s_seq;
+    return e->version;
 }
 
-// Internal helper to load and verify a blob from a given key
-static esp_err_t load_and_verify(nvs_handle_t handle, const char *key, void *out_buf, size_t *len)
+// Call the subscribers of `key`, outside s_lock so they may use the storage API
+static void notify(const char *key, uint32_t version)
 {
-    size_t required_len;
-    esp_err_t err = nvs_get_blob(handle, key, NULL, &required_len);
-    if (err != ESP_OK) {
-        return err;
+    subscriber_t subs[CONFIG_STORAGE_MAX_SUBSCRIBERS];
+    lock();
+    memcpy(subs, s_subs, sizeof(subs));
+    unlock();
+    for (int i = 0; i < CONFIG_STORAGE_MAX_SUBSCRIBERS; ++i) {
+        if (subs[i].cb && (!subs[i].key[0] || strcmp(subs[i].key, key) == 0)) {
+            subs[i].cb(key, version, subs[i].arg);
+        }
     }
+}
 
-    if (required_len <= sizeof(uint32_t)) {
-        return ESP_ERR_NVS_INVALID_LENGTH;
-    }
+// --- NVS (callers hold s_lock) ---
 
-    size_t data_len = required_len - sizeof(uint32_t);
+static void slot_key(char out[NVS_KEY_NAME_MAX_SIZE], const char *key, int slot)
+{
+    snprintf(out, NVS_KEY_NAME_MAX_SIZE, "%s.%c", key, 'a' + slot);
+}
 
-    // If out_buf is NULL, we're just querying the size.
-    if (out_buf == NULL) {
-        *len = data_len;
-        return ESP_OK;
-    }
+// Backup key of the legacy format. Older firmware built it with snprintf, so keys over
+// 11 characters had it cut to the NVS limit ("schedule_cfg" -> "schedule_cfg_ba").
+static void legacy_backup_key(char out[NVS_KEY_NAME_MAX_SIZE], const char *key)
+{
+    snprintf(out, NVS_KEY_NAME_MAX_SIZE, "%s_bak", key);
+}
 
-    // If the provided buffer is too small.
-    if (*len < data_len) {
-        *len = data_len;
-        return ESP_ERR_NVS_INVALID_LENGTH;
-    }
+// Generations wrap; the newer one is ahead by less than half the range
+static bool gen_newer(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) > 0;
+}
 
-    uint8_t *blob = malloc(required_len);
-    if (!blob) {
-        return ESP_ERR_NO_MEM;
-    }
+static void blob_release(blob_t *b)
+{
+    if (b->buf != s_io[0] && b->buf != s_io[1]) free(b->buf);
+    b->buf = NULL;
+}
 
-    err = nvs_get_blob(handle, key, blob, &required_len);
+// Read and verify the item `nvs_key` into `io` (heap if it does not fit): data + CRC,
+// after a slot header if `hdr` is given. On success `out` holds the data; release it.
+static esp_err_t load_and_verify(const char *nvs_key, uint8_t *io, slot_hdr_t *hdr, blob_t *out)
+{
+    // One read in the common case; NVS reports the size if the item is larger
+    uint8_t *buf = io;
+    size_t size = SLOT_BUF_SIZE;
+    esp_err_t err = nvs_get_blob(s_handle, nvs_key, buf, &size);
+    if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+        err = nvs_get_blob(s_handle, nvs_key, NULL, &size);
+        buf = err == ESP_OK ? malloc(size) : NULL;
+        if (err == ESP_OK && !buf) err = ESP_ERR_NO_MEM;
+        if (err == ESP_OK) err = nvs_get_blob(s_handle, nvs_key, buf, &size);
+    }
+    size_t hdr_len = hdr ? sizeof(*hdr) : 0;
+    if (err == ESP_OK && size <= hdr_len + sizeof(uint32_t)) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
     if (err != ESP_OK) {
-        free(blob);
+        if (buf != io) free(buf);
         return err;
     }
 
-    uint32_t stored_crc = *(uint32_t*)(blob + data_len);
-    uint32_t computed_crc = esp_crc32_le(0, blob, data_len);
-
+    size_t body_len = size - sizeof(uint32_t);
+    uint32_t stored_crc;
+    memcpy(&stored_crc, buf + body_len, sizeof(stored_crc));
+    uint32_t computed_crc = esp_crc32_le(0, buf, body_len);
     if (stored_crc != computed_crc) {
-        ESP_LOGW(TAG, "CRC mismatch for key '%s'. Stored: 0x%x, Computed: 0x%x", key, stored_crc, computed_crc);
-        free(blob);
+        ESP_LOGW(TAG, "CRC mismatch for key '%s'. Stored: 0x%x, Computed: 0x%x", nvs_key,
+                 (unsigned)stored_crc, (unsigned)computed_crc);
+        if (buf != io) free(buf);
         return ESP_ERR_INVALID_CRC;
     }
 
-    memcpy(out_buf, blob, data_len);
-    *len = data_len;
-
-    free(blob);
+    if (hdr) memcpy(hdr, buf, sizeof(*hdr));
+    *out = (blob_t){ .buf = buf, .off = hdr_len, .len = body_len - hdr_len };
     return ESP_OK;
 }
 
-esp_err_t storage_load_config(const char *key, void *out_buf, size_t *len)
+// Write `data` into `slot` of `key` as generation `gen`, built in s_io[slot]. No commit.
+static esp_err_t write_slot(const char *key, int slot, uint32_t gen, const void *data, size_t len)
 {
-    if (!s_inited) return ESP_ERR_INVALID_STATE;
-    if (!key || !len) return ESP_ERR_INVALID_ARG;
-
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &handle);
+    size_t size = sizeof(slot_hdr_t) + len + sizeof(uint32_t);
+    uint8_t *buf = size <= SLOT_BUF_SIZE ? s_io[slot] : malloc(size);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    slot_hdr_t hdr = { .gen = gen };
+    uint32_t crc = esp_crc32_le(0, (const uint8_t *)&hdr, sizeof(hdr));
+    crc = esp_crc32_le(crc, data, len);
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), data, len);
+    memcpy(buf + sizeof(hdr) + len, &crc, sizeof(crc));
+
+    char nvs_key[NVS_KEY_NAME_MAX_SIZE];
+    slot_key(nvs_key, key, slot);
+    esp_err_t err = nvs_set_blob(s_handle, nvs_key, buf, size);
+    s_stats.nvs_writes++;
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(err));
-        return err;
+        ESP_LOGE(TAG, "Failed to save slot '%s': %s", nvs_key, esp_err_to_name(err));
     }
+    if (buf != s_io[slot]) free(buf);
+    return err;
+}
 
-    // 1. Try loading from the primary key
-    err = load_and_verify(handle, key, out_buf, len);
-    if (err == ESP_OK) {
-        nvs_close(handle);
-        ESP_LOGD(TAG, "Loaded config for key '%s'", key);
+// Newest valid copy of `key` into `out` (release it). A slot that exists but does not
+// verify is rewritten from the good one, so two copies exist again. Falls back to the
+// legacy "<key>" / "<key>_bak" pair.
+static esp_err_t fetch(const char *key, blob_t *out, slots_t *slots)
+{
+    blob_t got[2] = {0};
+    slot_hdr_t hdr[2];
+    esp_err_t err[2];
+    for (int i = 0; i < 2; ++i) {
+        char nvs_key[NVS_KEY_NAME_MAX_SIZE];
+        slot_key(nvs_key, key, i);
+        err[i] = load_and_verify(nvs_key, s_io[i], &hdr[i], &got[i]);
+    }
+    int newest = -1;
+    if (err[0] == ESP_OK && (err[1] != ESP_OK || !gen_newer(hdr[1].gen, hdr[0].gen))) {
+        newest = 0;
+    } else if (err[1] == ESP_OK) {
+        newest = 1;
+    }
+
+    if (newest >= 0) {
+        int other = 1 - newest;
+        if (err[other] == ESP_OK) blob_release(&got[other]);
+        *out = got[newest];
+        *slots = (slots_t){ .gen = hdr[newest].gen, .newest = (int8_t)newest };
+        if (err[other] != ESP_OK && err[other] != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Slot %c of '%s' failed (%s). Restoring it.", 'a' + other, key,
+                     esp_err_to_name(err[other]));
+            // Same generation: the good slot stays the one the next save keeps
+            if (write_slot(key, other, slots->gen, out->buf + out->off, out->len) == ESP_OK) {
+                nvs_commit(s_handle);
+                s_stats.nvs_commits++;
+            }
+        }
+        ESP_LOGD(TAG, "Loaded config for key '%s' (generation %u)", key, (unsigned)slots->gen);
         return ESP_OK;
     }
 
-    // 2. If primary fails (not found or corrupt), try the backup
-    ESP_LOGW(TAG, "Primary key '%s' failed (%s). Trying backup.", key, esp_err_to_name(err));
+    // Saved by older firmware: primary, else the backup
+    *slots = (slots_t){ .newest = -1 };
     char backup_key[NVS_KEY_NAME_MAX_SIZE];
-    snprintf(backup_key, sizeof(backup_key), "%s_bak", key);
-
-    size_t backup_len = *len; // Preserve original buffer length for the call
-    esp_err_t backup_err = load_and_verify(handle, backup_key, out_buf, &backup_len);
-
-    if (backup_err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded config from backup key '%s'. Restoring primary key.", backup_key);
-        *len = backup_len; // Update the output length
-
-        // If we had a buffer, restore the primary key now
-        if (out_buf != NULL) {
-            size_t blob_size = backup_len + sizeof(uint32_t);
-            uint8_t *blob = malloc(blob_size);
-            if (blob) {
-                memcpy(blob, out_buf, backup_len);
-                *(uint32_t*)(blob + backup_len) = esp_crc32_le(0, out_buf, backup_len);
-                nvs_set_blob(handle, key, blob, blob_size);
-                nvs_commit(handle);
-                free(blob);
-            }
+    legacy_backup_key(backup_key, key);
+    const char *legacy[2] = { key, backup_key };
+    esp_err_t legacy_err = ESP_ERR_NVS_NOT_FOUND;
+    for (int i = 0; i < 2; ++i) {
+        legacy_err = load_and_verify(legacy[i], s_io[0], NULL, out);
+        if (legacy_err == ESP_OK) {
+            ESP_LOGI(TAG, "Loaded config for key '%s' from legacy key '%s'", key, legacy[i]);
+            return ESP_OK;
+        }
+    }
+    // Report corruption over absence
+    if (err[0] != ESP_ERR_NVS_NOT_FOUND) return err[0];
+    if (err[1] != ESP_ERR_NVS_NOT_FOUND) return err[1];
+    return legacy_err;
+}
+
+esp_err_t storage_save_config(const char *key, const void *data, size_t len)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    if (!key || !data || len == 0 || strlen(key) > SLOT_KEY_MAX) return ESP_ERR_INVALID_ARG;
+
+    lock();
+    s_stats.saves++;
+    // Same bytes as the verified copy in flash: nothing to write, commit or announce
+    cache_entry_t *e = cache_find(key, ENTRY_BLOB);
+    if (e && e->len == len && memcmp(e->data, data, len) == 0) {
+        s_stats.saves_skipped++;
+        unlock();
+        ESP_LOGD(TAG, "Config for key '%s' unchanged, not written", key);
+        return ESP_OK;
+    }
+
+    // Which slot holds the newest copy: known if cached, else read it
+    slots_t slots = { .newest = -1 };
+    if (e) {
+        slots = e->slots;
+    } else {
+        blob_t cur;
+        if (fetch(key, &cur, &slots) == ESP_OK) {
+            blob_release(&cur);
+        } else {
+            slots.newest = -1;
+        }
+    }
+
+    esp_err_t err;
+    if (slots.newest >= 0) {
+        // Only the slot not holding the newest copy; that copy survives a torn write
+        err = write_slot(key, 1 - slots.newest, slots.gen + 1, data, len);
+        slots = (slots_t){ .gen = slots.gen + 1, .newest = (int8_t)(1 - slots.newest) };
+    } else {
+        // First save (or first since the legacy format): both slots, then drop the old keys
+        err = write_slot(key, 0, 1, data, len);
+        if (err == ESP_OK) err = write_slot(key, 1, 1, data, len);
+        if (err == ESP_OK) {
+            char backup_key[NVS_KEY_NAME_MAX_SIZE];
+            nvs_erase_key(s_handle, key);
+            legacy_backup_key(backup_key, key);
+            nvs_erase_key(s_handle, backup_key);
+        }
+        slots = (slots_t){ .gen = 1, .newest = 0 };
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(s_handle);
+        s_stats.nvs_commits++;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "nvs_commit failed: %s", esp_err_to_name(err));
         }
+    }
+
+    uint32_t version = 0;
+    if (err == ESP_OK) {
+        version = cache_put_blob(key, data, len, &slots);
+    } else if ((e = cache_find(key, ENTRY_BLOB)) != NULL) {
+        // Flash may hold either value now; read it back next time
+        cache_drop(e);
+    }
+    unlock();
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Saved config for key '%s' (%u bytes, generation %u)", key, (unsigned)len,
+                 (unsigned)slots.gen);
+        notify(key, version);
+    }
+    return err;
+}
+
+esp_err_t storage_load_config(const char *key, void *out_buf, size_t *len)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    if (!key || !len || strlen(key) > SLOT_KEY_MAX) return ESP_ERR_INVALID_ARG;
+
+    // A save still waiting for storage_task is newer than anything in flash. Answered
+    // without s_lock, which storage_task may hold for the length of a flash write.
+    esp_err_t queued_err;
+    if (storage_async_peek_blob(key, out_buf, len, &queued_err)) return queued_err;
+
+    lock();
+    s_stats.loads++;
+    const uint8_t *data;
+    size_t data_len;
+    blob_t fetched = {0};
+    slots_t slots;
+    cache_entry_t *e = cache_find(key, ENTRY_BLOB);
+    if (e) {
+        s_stats.cache_hits++;
+        data = e->data;
+        data_len = e->len;
     } else {
-        ESP_LOGE(TAG, "Backup key '%s' also failed (%s).", backup_key, esp_err_to_name(backup_err));
-        err = backup_err; // Return the backup error
+        esp_err_t err = fetch(key, &fetched, &slots);
+        if (err != ESP_OK) {
+            unlock();
+            return err;
+        }
+        data = fetched.buf + fetched.off;
+        data_len = fetched.len;
     }
 
-    nvs_close(handle);
+    esp_err_t err = ESP_OK;
+    if (out_buf && *len < data_len) {
+        // The provided buffer is too small
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else if (out_buf) {
+        memcpy(out_buf, data, data_len);
+    }
+    *len = data_len;
+    // Keep what was read for the next call, even a size query
+    if (fetched.buf) {
+        cache_put_blob(key, data, data_len, &slots);
+        blob_release(&fetched);
+    }
+    unlock();
     return err;
 }
 
@@ -212,12 +515,31 @@ esp_err_t storage_save_uint32(const char *key, uint32_t value)
 {
     if (!s_inited) return ESP_ERR_INVALID_STATE;
     if (!key) return ESP_ERR_INVALID_ARG;
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
-    err = nvs_set_u32(handle, key, value);
-    if (err == ESP_OK) err = nvs_commit(handle);
-    nvs_close(handle);
+
+    lock();
+    s_stats.saves++;
+    cache_entry_t *e = cache_find(key, ENTRY_U32);
+    if (e && e->u32 == value) {
+        s_stats.saves_skipped++;
+        unlock();
+        return ESP_OK;
+    }
+    esp_err_t err = nvs_set_u32(s_handle, key, value);
+    s_stats.nvs_writes++;
+    if (err == ESP_OK) {
+        err = nvs_commit(s_handle);
+        s_stats.nvs_commits++;
+    }
+
+    uint32_t version = 0;
+    if (err == ESP_OK) {
+        version = cache_put_u32(key, value);
+    } else if (e) {
+        cache_drop(e);
+    }
+    unlock();
+
+    if (err == ESP_OK) notify(key, version);
     return err;
 }
 
@@ -225,10 +547,81 @@ esp_err_t storage_load_uint32(const char *key, uint32_t *out_value)
 {
     if (!s_inited) return ESP_ERR_INVALID_STATE;
     if (!key || !out_value) return ESP_ERR_INVALID_ARG;
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
-    err = nvs_get_u32(handle, key, out_value);
-    nvs_close(handle);
+
+    if (storage_async_peek_u32(key, out_value)) return ESP_OK;
+
+    lock();
+    s_stats.loads++;
+    cache_entry_t *e = cache_find(key, ENTRY_U32);
+    if (e) {
+        s_stats.cache_hits++;
+        *out_value = e->u32;
+        unlock();
+        return ESP_OK;
+    }
+    esp_err_t err = nvs_get_u32(s_handle, key, out_value);
+    if (err == ESP_OK) cache_put_u32(key, *out_value);
+    unlock();
     return err;
 }
+
+uint32_t storage_version(const char *key)
+{
+    if (!s_inited || !key) return 0;
+    uint32_t version = 0;
+    lock();
+    for (int i = 0; i < CONFIG_STORAGE_CACHE_ENTRIES; ++i) {
+        if (s_cache[i].kind != ENTRY_FREE && strcmp(s_cache[i].key, key) == 0) {
+            version = s_cache[i].version;
+            break;
+        }
+    }
+    unlock();
+    return version;
+}
+
+esp_err_t storage_subscribe(const char *key, storage_change_cb_t cb, void *arg)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    if (!cb || (key && strlen(key) >= NVS_KEY_NAME_MAX_SIZE)) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    lock();
+    for (int i = 0; i < CONFIG_STORAGE_MAX_SUBSCRIBERS; ++i) {
+        if (!s_subs[i].cb) {
+            copy_key(s_subs[i].key, key ? key : "");
+            s_subs[i].cb = cb;
+            s_subs[i].arg = arg;
+            err = ESP_OK;
+            break;
+        }
+    }
+    unlock();
+    return err;
+}
+
+esp_err_t storage_unsubscribe(const char *key, storage_change_cb_t cb, void *arg)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    lock();
+    for (int i = 0; i < CONFIG_STORAGE_MAX_SUBSCRIBERS; ++i) {
+        subscriber_t *sub = &s_subs[i];
+        if (sub->cb == cb && sub->arg == arg && strcmp(sub->key, key ? key : "") == 0) {
+            memset(sub, 0, sizeof(*sub));
+            err = ESP_OK;
+        }
+    }
+    unlock();
+    return err;
+}
+
+esp_err_t storage_get_stats(storage_stats_t *out)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    if (!out) return ESP_ERR_INVALID_ARG;
+    lock();
+    *out = s_stats;
+    unlock();
+    storage_async_stats(out);
+    return ESP_OK;
+}
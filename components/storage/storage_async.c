@@ -0,0 +1,303 @@
+#include "storage.h"
+#include "storage_priv.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "storage_task";
+
+// Write-behind: storage_save_*_async() copy the value into one of a fixed pool of entries
+// and queue the entry on cfg_write_queue; storage_task writes it with the synchronous API,
+// so callers never wait for a flash erase. A save of a key that is still queued overwrites
+// the queued value instead of taking another entry, so a burst of saves costs one write.
+// Loads look at the pool first and see a value before it reaches flash.
+typedef enum { WR_FREE, WR_QUEUED, WR_WRITING } wr_state_t;
+
+typedef struct {
+    wr_state_t state;
+    bool is_u32;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint32_t seq;               // order of the last save into the entry
+    storage_done_cb_t done;
+    void *arg;
+    uint32_t u32;
+    size_t len;
+    uint8_t data[CONFIG_STORAGE_MAX_BLOB];
+} write_entry_t;
+
+#define EV_IDLE         (1 << 0)    // no write queued or in progress
+#define EV_STOPPED      (1 << 1)
+#define STOP_INDEX      0xff
+
+static write_entry_t s_pool[CONFIG_STORAGE_WRITE_SLOTS];
+static SemaphoreHandle_t s_pool_lock;
+static SemaphoreHandle_t s_free;        // counts WR_FREE entries
+static QueueHandle_t cfg_write_queue;   // entry indices, in save order
+static EventGroupHandle_t s_events;
+static TaskHandle_t s_task;
+static volatile uint32_t s_pending;     // writes not finished, callbacks included
+static uint32_t s_seq;
+static esp_err_t s_first_err;           // first failed write since the last storage_flush()
+static uint32_t s_queued;
+static uint32_t s_coalesced;
+static uint32_t s_peeks;                // loads answered from the pool
+
+static void pool_lock(void) { xSemaphoreTake(s_pool_lock, portMAX_DELAY); }
+static void pool_unlock(void) { xSemaphoreGive(s_pool_lock); }
+
+static void storage_task(void *arg)
+{
+    uint8_t idx;
+    for (;;) {
+        xQueueReceive(cfg_write_queue, &idx, portMAX_DELAY);
+        if (idx == STOP_INDEX) break;
+        write_entry_t *w = &s_pool[idx];
+        pool_lock();
+        w->state = WR_WRITING;
+        pool_unlock();
+
+        // Nobody else writes to an entry once it is WR_WRITING
+        esp_err_t err = w->is_u32 ? storage_save_uint32(w->key, w->u32)
+                                  : storage_save_config(w->key, w->data, w->len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Write of '%s' failed: %s", w->key, esp_err_to_name(err));
+        }
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        memcpy(key, w->key, sizeof(key));
+        storage_done_cb_t done = w->done;
+        void *done_arg = w->arg;
+
+        // The cache has the value now (or flash has the old one), loads can stop using the entry
+        pool_lock();
+        // Credentials among them: nothing stays behind in the pool
+        memset(w->data, 0, w->len);
+        w->state = WR_FREE;
+        w->done = NULL;
+        if (err != ESP_OK && s_first_err == ESP_OK) s_first_err = err;
+        pool_unlock();
+        xSemaphoreGive(s_free);
+
+        if (done) done(key, err, done_arg);
+
+        // Idle only after the callback, so storage_flush() returns after it too
+        pool_lock();
+        if (--s_pending == 0) xEventGroupSetBits(s_events, EV_IDLE);
+        pool_unlock();
+    }
+    xEventGroupSetBits(s_events, EV_STOPPED);
+    vTaskDelete(NULL);
+}
+
+esp_err_t storage_async_start(void)
+{
+    memset(s_pool, 0, sizeof(s_pool));
+    s_pending = 0;
+    s_first_err = ESP_OK;
+    s_queued = s_coalesced = s_peeks = 0;
+    s_pool_lock = xSemaphoreCreateMutex();
+    s_free = xSemaphoreCreateCounting(CONFIG_STORAGE_WRITE_SLOTS, CONFIG_STORAGE_WRITE_SLOTS);
+    // Never full: one index per entry, plus the stop request
+    cfg_write_queue = xQueueCreate(CONFIG_STORAGE_WRITE_SLOTS + 1, sizeof(uint8_t));
+    s_events = xEventGroupCreate();
+    if (!s_pool_lock || !s_free || !cfg_write_queue || !s_events) {
+        storage_async_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(s_events, EV_IDLE);
+    if (xTaskCreate(storage_task, "storage_task", CONFIG_STORAGE_TASK_STACK_SIZE, NULL,
+                    CONFIG_STORAGE_TASK_PRIORITY, &s_task) != pdPASS) {
+        s_task = NULL;
+        storage_async_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void storage_async_stop(void)
+{
+    if (s_task) {
+        storage_flush(portMAX_DELAY);
+        uint8_t stop = STOP_INDEX;
+        xQueueSend(cfg_write_queue, &stop, portMAX_DELAY);
+        xEventGroupWaitBits(s_events, EV_STOPPED, pdFALSE, pdTRUE, portMAX_DELAY);
+        s_task = NULL;
+    }
+    if (s_events) vEventGroupDelete(s_events);
+    if (cfg_write_queue) vQueueDelete(cfg_write_queue);
+    if (s_free) vSemaphoreDelete(s_free);
+    if (s_pool_lock) vSemaphoreDelete(s_pool_lock);
+    s_events = NULL;
+    cfg_write_queue = NULL;
+    s_free = NULL;
+    s_pool_lock = NULL;
+}
+
+// --- Pool (callers hold s_pool_lock) ---
+
+// Newest entry holding a save of `key`; with `queued_only` one storage_task has not taken yet
+static write_entry_t *find_entry(const char *key, bool is_u32, bool queued_only)
+{
+    write_entry_t *found = NULL;
+    for (int i = 0; i < CONFIG_STORAGE_WRITE_SLOTS; ++i) {
+        write_entry_t *w = &s_pool[i];
+        if (w->state == WR_FREE || (queued_only && w->state != WR_QUEUED)) continue;
+        if (w->is_u32 != is_u32 || strcmp(w->key, key) != 0) continue;
+        if (!found || (int32_t)(w->seq - found->seq) > 0) found = w;
+    }
+    return found;
+}
+
+static void fill(write_entry_t *w, const void *data, size_t len, uint32_t u32)
+{
+    if (data) {
+        memcpy(w->data, data, len);
+        w->len = len;
+    } else {
+        w->u32 = u32;
+    }
+    w->seq = ++s_seq;
+}
+
+// Copy the value into the pool. `data` NULL: a uint32. Blocks only while every entry is
+// taken by another key; storage_task itself (e.g. a subscriber saving from its callback)
+// never waits for itself and gets ESP_ERR_NO_MEM instead.
+static esp_err_t enqueue(const char *key, const void *data, size_t len, uint32_t u32,
+                         storage_done_cb_t done, void *arg)
+{
+    bool is_u32 = data == NULL;
+    bool reserved = false;
+    for (;;) {
+        pool_lock();
+        // Merge into the queued save of the key, unless both want different completions
+        write_entry_t *w = find_entry(key, is_u32, true);
+        if (w && (!w->done || !done || (w->done == done && w->arg == arg))) {
+            fill(w, data, len, u32);
+            if (done) {
+                w->done = done;
+                w->arg = arg;
+            }
+            s_coalesced++;
+            pool_unlock();
+            if (reserved) xSemaphoreGive(s_free);
+            return ESP_OK;
+        }
+        if (reserved) {
+            // The reservation guarantees a free entry
+            w = s_pool;
+            while (w->state != WR_FREE) ++w;
+            memset(w, 0, offsetof(write_entry_t, data));
+            strcpy(w->key, key);
+            w->is_u32 = is_u32;
+            w->done = done;
+            w->arg = arg;
+            fill(w, data, len, u32);
+            w->state = WR_QUEUED;
+            if (s_pending++ == 0) xEventGroupClearBits(s_events, EV_IDLE);
+            s_queued++;
+            // Under the lock, so saves of one key reach the queue in order
+            uint8_t idx = (uint8_t)(w - s_pool);
+            xQueueSend(cfg_write_queue, &idx, 0);
+            pool_unlock();
+            return ESP_OK;
+        }
+        pool_unlock();
+
+        TickType_t wait = xTaskGetCurrentTaskHandle() == s_task ? 0 : portMAX_DELAY;
+        if (xSemaphoreTake(s_free, wait) != pdTRUE) return ESP_ERR_NO_MEM;
+        reserved = true;
+    }
+}
+
+// Write in the caller: no task, no room, or storage_task's own save that found the pool full
+static esp_err_t save_now(const char *key, const void *data, size_t len, uint32_t u32,
+                          storage_done_cb_t done, void *arg)
+{
+    esp_err_t err = data ? storage_save_config(key, data, len) : storage_save_uint32(key, u32);
+    if (done) done(key, err, arg);
+    return err;
+}
+
+esp_err_t storage_save_config_async(const char *key, const void *data, size_t len,
+                                    storage_done_cb_t done, void *arg)
+{
+    if (!key || !data || len == 0 || strlen(key) > SLOT_KEY_MAX) return ESP_ERR_INVALID_ARG;
+    if (s_task && len <= CONFIG_STORAGE_MAX_BLOB) {
+        if (enqueue(key, data, len, 0, done, arg) == ESP_OK) return ESP_OK;
+    } else if (s_task && xTaskGetCurrentTaskHandle() != s_task) {
+        // Too large for the pool: written here, after what is queued so the order holds
+        xEventGroupWaitBits(s_events, EV_IDLE, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    return save_now(key, data, len, 0, done, arg);
+}
+
+esp_err_t storage_save_uint32_async(const char *key, uint32_t value, storage_done_cb_t done, void *arg)
+{
+    if (!key || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+    if (s_task && enqueue(key, NULL, 0, value, done, arg) == ESP_OK) return ESP_OK;
+    return save_now(key, NULL, 0, value, done, arg);
+}
+
+esp_err_t storage_flush(TickType_t timeout)
+{
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+    // It would wait for itself
+    if (xTaskGetCurrentTaskHandle() == s_task) return ESP_ERR_INVALID_STATE;
+    if (!(xEventGroupWaitBits(s_events, EV_IDLE, pdFALSE, pdTRUE, timeout) & EV_IDLE)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    pool_lock();
+    esp_err_t err = s_first_err;
+    s_first_err = ESP_OK;
+    pool_unlock();
+    return err;
+}
+
+// Nothing pending is the common case and needs no lock: a save the caller made itself is
+// counted before it returns
+bool storage_async_peek_blob(const char *key, void *out_buf, size_t *len, esp_err_t *err)
+{
+    if (!s_task || s_pending == 0) return false;
+    pool_lock();
+    const write_entry_t *w = find_entry(key, false, false);
+    if (w) {
+        if (out_buf && *len < w->len) {
+            *err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            if (out_buf) memcpy(out_buf, w->data, w->len);
+            *err = ESP_OK;
+        }
+        *len = w->len;
+        s_peeks++;
+    }
+    pool_unlock();
+    return w != NULL;
+}
+
+bool storage_async_peek_u32(const char *key, uint32_t *out_value)
+{
+    if (!s_task || s_pending == 0) return false;
+    pool_lock();
+    const write_entry_t *w = find_entry(key, true, false);
+    if (w) {
+        *out_value = w->u32;
+        s_peeks++;
+    }
+    pool_unlock();
+    return w != NULL;
+}
+
+void storage_async_stats(storage_stats_t *out)
+{
+    if (!s_task) return;
+    pool_lock();
+    out->async_queued = s_queued;
+    out->async_coalesced = s_coalesced;
+    out->loads += s_peeks;
+    out->cache_hits += s_peeks;
+    pool_unlock();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "nvs.h"
+#include "storage.h"
+
+// Shared between storage.c and the write-behind queue in storage_async.c
+
+// Blob slots are "<key>.a" / "<key>.b"
+#define SLOT_KEY_MAX    (NVS_KEY_NAME_MAX_SIZE - 3)
+
+// Start/stop storage_task; stop writes out everything still queued first
+esp_err_t storage_async_start(void);
+void storage_async_stop(void);
+
+// Newest queued (not yet written) value of `key`, if any: true and the value, with the
+// semantics of storage_load_config() for `out_buf`/`len` in `*err`
+bool storage_async_peek_blob(const char *key, void *out_buf, size_t *len, esp_err_t *err);
+bool storage_async_peek_u32(const char *key, uint32_t *out_value);
+
+// Fill the write-behind counters of `out` and add the loads answered from the pool
+void storage_async_stats(storage_stats_t *out);
@@ -0,0 +1,237 @@
+#include "storage_record.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "storage";
+
+#define WIRE_VARINT     0
+#define WIRE_LEN        2
+#define HDR_SIZE        2       // magic, version
+
+// --- Varints ---
+
+static size_t put_varint(uint8_t *out, size_t cap, size_t pos, uint64_t v)
+{
+    do {
+        uint8_t b = v & 0x7f;
+        v >>= 7;
+        if (pos < cap) out[pos] = b | (v ? 0x80 : 0);
+        pos++;
+    } while (v);
+    return pos;
+}
+
+static bool get_varint(const uint8_t *data, size_t len, size_t *pos, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 64 && *pos < len; shift += 7) {
+        uint8_t b = data[(*pos)++];
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+// --- Integer fields of 1, 2, 4 or 8 bytes ---
+
+static int64_t read_int(const void *p, size_t size)
+{
+    switch (size) {
+    case 1: return *(const int8_t *)p;
+    case 2: { int16_t v; memcpy(&v, p, 2); return v; }
+    case 4: { int32_t v; memcpy(&v, p, 4); return v; }
+    default: { int64_t v; memcpy(&v, p, 8); return v; }
+    }
+}
+
+static uint64_t read_uint(const void *p, size_t size)
+{
+    switch (size) {
+    case 1: return *(const uint8_t *)p;
+    case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+    case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+    default: { uint64_t v; memcpy(&v, p, 8); return v; }
+    }
+}
+
+// Little-endian target: the low `size` bytes of v
+static void write_int(void *p, size_t size, uint64_t v)
+{
+    memcpy(p, &v, size);
+}
+
+static bool int_fits(int64_t v, size_t size)
+{
+    if (size >= 8) return true;
+    int64_t max = ((int64_t)1 << (size * 8 - 1)) - 1;
+    return v >= -max - 1 && v <= max;
+}
+
+static bool uint_fits(uint64_t v, size_t size)
+{
+    return size >= 8 || v < ((uint64_t)1 << (size * 8));
+}
+
+static const storage_field_t *find_field(const storage_schema_t *schema, uint64_t tag)
+{
+    for (size_t i = 0; i < schema->field_count; ++i) {
+        if (schema->fields[i].tag == tag) return &schema->fields[i];
+    }
+    return NULL;
+}
+
+// --- Codec ---
+
+esp_err_t storage_record_encode(const storage_schema_t *schema, const void *rec, uint8_t *out,
+                                size_t cap, size_t *len)
+{
+    if (!schema || !rec || !out || !len) return ESP_ERR_INVALID_ARG;
+    size_t pos = HDR_SIZE;
+    if (cap >= HDR_SIZE) {
+        out[0] = STORAGE_RECORD_MAGIC;
+        out[1] = schema->version;
+    }
+    for (size_t i = 0; i < schema->field_count; ++i) {
+        const storage_field_t *f = &schema->fields[i];
+        const uint8_t *p = (const uint8_t *)rec + f->offset;
+        if (f->type == STORAGE_FIELD_INT || f->type == STORAGE_FIELD_UINT) {
+            uint64_t v = f->type == STORAGE_FIELD_INT ? zigzag(read_int(p, f->size))
+                                                      : read_uint(p, f->size);
+            pos = put_varint(out, cap, pos, (uint64_t)f->tag << 3 | WIRE_VARINT);
+            pos = put_varint(out, cap, pos, v);
+            continue;
+        }
+        size_t n;
+        if (f->type == STORAGE_FIELD_STR) {
+            n = strnlen((const char *)p, f->size);
+            if (n == f->size) return ESP_ERR_INVALID_ARG;   // not terminated
+        } else {
+            for (n = f->size; n > 0 && p[n - 1] == 0; --n) {}
+        }
+        pos = put_varint(out, cap, pos, (uint64_t)f->tag << 3 | WIRE_LEN);
+        pos = put_varint(out, cap, pos, n);
+        if (pos + n <= cap) memcpy(out + pos, p, n);
+        pos += n;
+    }
+    *len = pos;
+    return pos <= cap ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+// Fields of a record body into `rec`
+static esp_err_t decode_fields(const storage_schema_t *schema, const uint8_t *data, size_t len,
+                               void *rec)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        uint64_t key, v;
+        if (!get_varint(data, len, &pos, &key)) return ESP_ERR_INVALID_SIZE;
+        unsigned wire = key & 7;
+        if (wire != WIRE_VARINT && wire != WIRE_LEN) return ESP_ERR_INVALID_SIZE;
+        if (!get_varint(data, len, &pos, &v)) return ESP_ERR_INVALID_SIZE;
+        if (wire == WIRE_LEN && v > len - pos) return ESP_ERR_INVALID_SIZE;
+
+        const storage_field_t *f = find_field(schema, key >> 3);
+        if (!f) {
+            // Written by a newer schema: skipped
+            if (wire == WIRE_LEN) pos += v;
+            continue;
+        }
+        bool is_int = f->type == STORAGE_FIELD_INT || f->type == STORAGE_FIELD_UINT;
+        if (is_int != (wire == WIRE_VARINT)) return ESP_ERR_INVALID_SIZE;
+
+        uint8_t *p = (uint8_t *)rec + f->offset;
+        switch (f->type) {
+        case STORAGE_FIELD_INT:
+            if (!int_fits(unzigzag(v), f->size)) return ESP_ERR_INVALID_SIZE;
+            write_int(p, f->size, (uint64_t)unzigzag(v));
+            break;
+        case STORAGE_FIELD_UINT:
+            if (!uint_fits(v, f->size)) return ESP_ERR_INVALID_SIZE;
+            write_int(p, f->size, v);
+            break;
+        default:
+            // A string keeps room for its NUL
+            if (v > (uint64_t)f->size - (f->type == STORAGE_FIELD_STR)) return ESP_ERR_INVALID_SIZE;
+            memcpy(p, data + pos, v);
+            memset(p + v, 0, f->size - v);
+            pos += v;
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t storage_record_decode(const storage_schema_t *schema, const uint8_t *data, size_t len,
+                                void *rec, uint8_t *from)
+{
+    if (!schema || !data || !rec) return ESP_ERR_INVALID_ARG;
+    uint8_t version = 0;
+    if (len >= HDR_SIZE && data[0] == STORAGE_RECORD_MAGIC && data[1] != 0) {
+        version = data[1];
+        esp_err_t err = decode_fields(schema, data + HDR_SIZE, len - HDR_SIZE, rec);
+        if (err != ESP_OK) return err;
+    }
+    if (from) *from = version;
+
+    for (uint8_t v = version; v < schema->version; ++v) {
+        storage_migrate_fn_t migrate = schema->migrations ? schema->migrations[v] : NULL;
+        if (!migrate) {
+            // Nothing to convert, except a blob that is not a record
+            if (v == 0) return ESP_ERR_INVALID_VERSION;
+            continue;
+        }
+        esp_err_t err = migrate(rec, v == 0 ? data : NULL, v == 0 ? len : 0);
+        if (err != ESP_OK) return err;
+    }
+    return ESP_OK;
+}
+
+// --- Storage ---
+
+esp_err_t storage_record_load(const storage_schema_t *schema, void *rec)
+{
+    if (!schema || !rec) return ESP_ERR_INVALID_ARG;
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = sizeof(buf);
+    esp_err_t err = storage_load_config(schema->key, buf, &len);
+    if (err != ESP_OK) return err;
+
+    uint8_t from;
+    err = storage_record_decode(schema, buf, len, rec, &from);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Record '%s' (%u bytes) not readable: %s", schema->key, (unsigned)len,
+                 esp_err_to_name(err));
+        return err;
+    }
+    // Upgraded once: the next load reads the current version. A newer record is left
+    // alone, saving it would drop the fields this firmware does not know.
+    if (from < schema->version) {
+        ESP_LOGI(TAG, "Record '%s' migrated from version %u to %u", schema->key, from,
+                 schema->version);
+        storage_record_save_async(schema, rec, NULL, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t storage_record_save(const storage_schema_t *schema, const void *rec)
+{
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len;
+    esp_err_t err = storage_record_encode(schema, rec, buf, sizeof(buf), &len);
+    if (err != ESP_OK) return err;
+    return storage_save_config(schema->key, buf, len);
+}
+
+esp_err_t storage_record_save_async(const storage_schema_t *schema, const void *rec,
+                                    storage_done_cb_t done, void *arg)
+{
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len;
+    esp_err_t err = storage_record_encode(schema, rec, buf, sizeof(buf), &len);
+    if (err != ESP_OK) return err;
+    // Copied into the write-behind pool before this returns
+    return storage_save_config_async(schema->key, buf, len, done, arg);
+}
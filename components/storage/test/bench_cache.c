@@ -0,0 +1,268 @@
+#include "unity.h"
+#include "storage.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_crc.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host benchmark on the linux target's NVS emulation: loads per second from the RAM cache
+// against the uncached path (open, two blob reads, malloc, CRC), and the NVS writes a day
+// of typical traffic no longer issues because unchanged saves are skipped. Also checks
+// change notifications, versions and reading the legacy backup format through the cache.
+
+#define LOADS           200000
+#define BASELINE_LOADS  20000
+#define KEY_SCHED       "bench_sched"
+#define KEY_SEEN        "bench_seen"
+#define KEY_OTHER       "bench_other"
+
+// Same size as schedule_t
+typedef struct {
+    int on_hour, on_min, off_hour, off_min;
+    int pump_on_interval_min, pump_on_duration_min;
+    char tz[64];
+} sched_blob_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The load path before the cache (open, size query, malloc, read, CRC), on one slot: the
+// generation header is skipped
+static esp_err_t uncached_load(const char *key, void *out, size_t *len)
+{
+    char slot[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(slot, sizeof(slot), "%s.a", key);
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    size_t need;
+    err = nvs_get_blob(h, slot, NULL, &need);
+    uint8_t *blob = err == ESP_OK ? malloc(need) : NULL;
+    if (blob && (err = nvs_get_blob(h, slot, blob, &need)) == ESP_OK) {
+        uint32_t crc;
+        memcpy(&crc, blob + need - sizeof(crc), sizeof(crc));
+        if (crc != esp_crc32_le(0, blob, need - sizeof(crc))) err = ESP_ERR_INVALID_CRC;
+        *len = need - 2 * sizeof(crc);
+        memcpy(out, blob + sizeof(crc), *len);
+    }
+    free(blob);
+    nvs_close(h);
+    return err;
+}
+
+typedef struct {
+    int calls;
+    uint32_t version;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+} seen_t;
+
+static void on_change(const char *key, uint32_t version, void *arg)
+{
+    seen_t *s = arg;
+    s->calls++;
+    s->version = version;
+    strncpy(s->key, key, sizeof(s->key) - 1);
+}
+
+static sched_blob_t make_sched(int on_hour)
+{
+    sched_blob_t s = { .on_hour = on_hour, .off_hour = 21, .pump_on_interval_min = 30,
+                       .pump_on_duration_min = 5 };
+    strcpy(s.tz, "Europe/Berlin");
+    return s;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_cached_load_rate(void)
+{
+    sched_blob_t s = make_sched(7), out;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY_SCHED, &s, sizeof(s)));
+
+    size_t len = sizeof(out);
+    int64_t t0 = now_ns();
+    for (int i = 0; i < BASELINE_LOADS; ++i) {
+        TEST_ASSERT_EQUAL_INT(ESP_OK, uncached_load(KEY_SCHED, &out, &len));
+    }
+    double base_ns = (double)(now_ns() - t0) / BASELINE_LOADS;
+
+    storage_stats_t before, after;
+    storage_get_stats(&before);
+    t0 = now_ns();
+    for (int i = 0; i < LOADS; ++i) {
+        len = sizeof(out);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(KEY_SCHED, &out, &len));
+    }
+    double cached_ns = (double)(now_ns() - t0) / LOADS;
+    storage_get_stats(&after);
+
+    TEST_ASSERT_EQUAL_MEMORY(&s, &out, sizeof(s));
+    TEST_ASSERT_EQUAL_UINT32(LOADS, after.cache_hits - before.cache_hits);
+    TEST_ASSERT_EQUAL_UINT32(before.nvs_writes, after.nvs_writes);
+    printf("load %u bytes: cached %.0f ns (%.0f loads/s), uncached %.0f ns (%.0f loads/s), %.1fx\n",
+           (unsigned)sizeof(s), cached_ns, 1e9 / cached_ns, base_ns, 1e9 / base_ns, base_ns / cached_ns);
+    TEST_ASSERT_TRUE(cached_ns < base_ns);
+}
+
+// One simulated day: a heartbeat every 5 min loads the schedule, the scheduler records the
+// last-seen time every 10 min, and clients re-send the same schedule every few minutes
+// (app reconnects, retained MQTT config) with three real edits in between
+void test_day_of_traffic_writes_avoided(void)
+{
+    seen_t seen = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_subscribe(KEY_SCHED, on_change, &seen));
+    storage_stats_t before, after;
+    storage_get_stats(&before);
+
+    int on_hour = 7, saves_blob = 0, saves_u32 = 0;
+    for (int minute = 0; minute < 1440; ++minute) {
+        if (minute % 5 == 0) {
+            sched_blob_t out;
+            size_t len = sizeof(out);
+            TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(KEY_SCHED, &out, &len));
+            TEST_ASSERT_EQUAL_INT(on_hour, out.on_hour);
+        }
+        if (minute % 10 == 0) {
+            // Rounded to the hour, so most records repeat the previous value
+            TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_uint32(KEY_SEEN, 1700000000u + (minute / 60) * 3600u));
+            saves_u32++;
+        }
+        if (minute % 3 == 0) {
+            if (minute == 300 || minute == 720 || minute == 1200) on_hour++;
+            sched_blob_t s = make_sched(on_hour);
+            TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY_SCHED, &s, sizeof(s)));
+            saves_blob++;
+        }
+    }
+    storage_get_stats(&after);
+    storage_unsubscribe(KEY_SCHED, on_change, &seen);
+
+    // Before: backup + primary on every blob save, one value per u32 save
+    uint32_t writes = after.nvs_writes - before.nvs_writes;
+    uint32_t commits = after.nvs_commits - before.nvs_commits;
+    uint32_t writes_before = (uint32_t)(2 * saves_blob + saves_u32);
+    uint32_t commits_before = (uint32_t)(saves_blob + saves_u32);
+    printf("day: %d blob saves, %d u32 saves, %u loads: %u NVS writes (%u before), "
+           "%u commits (%u), %u writes avoided, %u cache hits\n",
+           saves_blob, saves_u32, (unsigned)(after.loads - before.loads), (unsigned)writes,
+           (unsigned)writes_before, (unsigned)commits, (unsigned)commits_before,
+           (unsigned)(writes_before - writes), (unsigned)(after.cache_hits - before.cache_hits));
+
+    TEST_ASSERT_EQUAL_INT(3, seen.calls);
+    TEST_ASSERT_EQUAL_UINT32(3 + 24, writes);
+    TEST_ASSERT_EQUAL_UINT32(3 + 24, commits);
+    TEST_ASSERT_EQUAL_UINT32(after.loads - before.loads, after.cache_hits - before.cache_hits);
+}
+
+void test_notifications_and_versions(void)
+{
+    seen_t one = {0}, all = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_subscribe(KEY_OTHER, on_change, &one));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_subscribe(NULL, on_change, &all));
+
+    uint32_t a = 1, b = 2;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY_OTHER, &a, sizeof(a)));
+    uint32_t v1 = storage_version(KEY_OTHER);
+    TEST_ASSERT_TRUE(v1 != 0);
+    TEST_ASSERT_EQUAL_INT(1, one.calls);
+    TEST_ASSERT_EQUAL_UINT32(v1, one.version);
+    TEST_ASSERT_EQUAL_STRING(KEY_OTHER, one.key);
+
+    // Unchanged: no notification, same version
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY_OTHER, &a, sizeof(a)));
+    TEST_ASSERT_EQUAL_INT(1, one.calls);
+    TEST_ASSERT_EQUAL_UINT32(v1, storage_version(KEY_OTHER));
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY_OTHER, &b, sizeof(b)));
+    TEST_ASSERT_EQUAL_INT(2, one.calls);
+    TEST_ASSERT_TRUE(storage_version(KEY_OTHER) > v1);
+
+    // The catch-all subscriber sees other keys as well
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_uint32(KEY_SEEN, 42));
+    TEST_ASSERT_EQUAL_INT(2, one.calls);
+    TEST_ASSERT_EQUAL_INT(3, all.calls);
+    TEST_ASSERT_EQUAL_STRING(KEY_SEEN, all.key);
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_unsubscribe(KEY_OTHER, on_change, &one));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_unsubscribe(NULL, on_change, &all));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY_OTHER, &a, sizeof(a)));
+    TEST_ASSERT_EQUAL_INT(2, one.calls);
+    TEST_ASSERT_EQUAL_INT(3, all.calls);
+}
+
+void test_eviction_and_size_query(void)
+{
+    // More keys than cache entries: every value still reads back, from flash after eviction
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    for (unsigned i = 0; i < CONFIG_STORAGE_CACHE_ENTRIES + 4; ++i) {
+        snprintf(key, sizeof(key), "bench_ev%u", i);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(key, &i, sizeof(i)));
+    }
+    for (unsigned i = 0; i < CONFIG_STORAGE_CACHE_ENTRIES + 4; ++i) {
+        snprintf(key, sizeof(key), "bench_ev%u", i);
+        unsigned v = UINT32_MAX;
+        size_t len = 0;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(key, NULL, &len));
+        TEST_ASSERT_EQUAL_size_t(sizeof(v), len);
+        // Too small a buffer reports the size needed
+        len = 1;
+        TEST_ASSERT_EQUAL_INT(ESP_ERR_NVS_INVALID_LENGTH, storage_load_config(key, &v, &len));
+        TEST_ASSERT_EQUAL_size_t(sizeof(v), len);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(key, &v, &len));
+        TEST_ASSERT_EQUAL_UINT32(i, v);
+    }
+    storage_stats_t st;
+    storage_get_stats(&st);
+    TEST_ASSERT_TRUE(st.evictions > 0);
+}
+
+void test_legacy_backup_read_through_cache(void)
+{
+    // Saved by older firmware (data + CRC, primary corrupt), as if found in flash after boot
+    uint32_t value = 0xC0FFEE;
+    uint8_t blob[8];
+    memcpy(blob, &value, 4);
+    uint32_t crc = esp_crc32_le(0, blob, 4);
+    memcpy(blob + 4, &crc, 4);
+    nvs_handle_t h;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &h));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_set_blob(h, "bench_rec_bak", blob, sizeof(blob)));
+    blob[0] ^= 0xFF;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_set_blob(h, "bench_rec", blob, sizeof(blob)));
+    nvs_commit(h);
+
+    uint32_t out = 0;
+    size_t len = sizeof(out);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config("bench_rec", &out, &len));
+    TEST_ASSERT_EQUAL_HEX32(value, out);
+
+    // The next save moves it to the slot format
+    value++;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config("bench_rec", &value, sizeof(value)));
+    size_t n = sizeof(blob);
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NVS_NOT_FOUND, nvs_get_blob(h, "bench_rec", blob, &n));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NVS_NOT_FOUND, nvs_get_blob(h, "bench_rec_bak", blob, &n));
+    nvs_close(h);
+}
+
+int main(void)
+{
+    nvs_flash_erase();
+    if (storage_init() != ESP_OK) return 1;
+    UNITY_BEGIN();
+    RUN_TEST(test_cached_load_rate);
+    RUN_TEST(test_day_of_traffic_writes_avoided);
+    RUN_TEST(test_notifications_and_versions);
+    RUN_TEST(test_eviction_and_size_query);
+    RUN_TEST(test_legacy_backup_read_through_cache);
+    return UNITY_END();
+}
@@ -0,0 +1,217 @@
+#include "unity.h"
+#include "storage.h"
+#include "nvs.h"
+#include "esp_crc.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host benchmark of the storage I/O path on the NVS stand-in (test/sim), which keeps its
+// items in static memory, so every heap allocation counted here is storage.c's own.
+// Per-call latency and allocations of cache misses, saves and cache hits, against the
+// previous path: an NVS handle opened and closed per call, a size query and a malloc per
+// item read, a malloc per item written.
+
+#define ROUNDS      2000
+#define KEYS        (CONFIG_STORAGE_CACHE_ENTRIES + 1)     // round-robin: every load misses
+
+// glibc: count the calls that reach the allocator (the linux target links glibc)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+static volatile int s_allocs;
+
+void *malloc(size_t size) { s_allocs++; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { s_allocs++; return __libc_calloc(n, size); }
+void *realloc(void *p, size_t size) { s_allocs++; return __libc_realloc(p, size); }
+void free(void *p) { __libc_free(p); }
+
+// Same size as schedule_t
+typedef struct {
+    int on_hour, on_min, off_hour, off_min;
+    int pump_on_interval_min, pump_on_duration_min;
+    char tz[64];
+} sched_blob_t;
+
+typedef struct {
+    double ns;
+    double allocs;
+} cost_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void key_of(char out[NVS_KEY_NAME_MAX_SIZE], int i)
+{
+    snprintf(out, NVS_KEY_NAME_MAX_SIZE, "io%d", i);
+}
+
+static sched_blob_t make_sched(int on_hour)
+{
+    sched_blob_t s = { .on_hour = on_hour, .off_hour = 21, .pump_on_interval_min = 30,
+                       .pump_on_duration_min = 5 };
+    strcpy(s.tz, "Europe/Berlin");
+    return s;
+}
+
+// --- The previous path, on the same slots ---
+
+static esp_err_t old_read_slot(nvs_handle_t h, const char *nvs_key, uint8_t **blob, size_t *size)
+{
+    esp_err_t err = nvs_get_blob(h, nvs_key, NULL, size);
+    if (err != ESP_OK) return err;
+    *blob = malloc(*size);
+    if ((err = nvs_get_blob(h, nvs_key, *blob, size)) == ESP_OK) {
+        uint32_t crc;
+        memcpy(&crc, *blob + *size - sizeof(crc), sizeof(crc));
+        if (crc != esp_crc32_le(0, *blob, *size - sizeof(crc))) err = ESP_ERR_INVALID_CRC;
+    }
+    return err;
+}
+
+static esp_err_t old_load(const char *key, void *out, size_t len)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    uint8_t *blob[2] = {0};
+    size_t size[2];
+    for (int i = 0; i < 2; ++i) {
+        char nvs_key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(nvs_key, sizeof(nvs_key), "%.13s.%c", key, 'a' + i);
+        err = old_read_slot(h, nvs_key, &blob[i], &size[i]);
+    }
+    if (err == ESP_OK) memcpy(out, blob[0] + sizeof(uint32_t), len);
+    free(blob[0]);
+    free(blob[1]);
+    nvs_close(h);
+    return err;
+}
+
+static esp_err_t old_save(const char *key, int slot, uint32_t gen, const void *data, size_t len)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CONFIG_STORAGE_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    size_t size = sizeof(gen) + len + sizeof(uint32_t);
+    uint8_t *blob = malloc(size);
+    memcpy(blob, &gen, sizeof(gen));
+    memcpy(blob + sizeof(gen), data, len);
+    uint32_t crc = esp_crc32_le(0, blob, sizeof(gen) + len);
+    memcpy(blob + sizeof(gen) + len, &crc, sizeof(crc));
+    char nvs_key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(nvs_key, sizeof(nvs_key), "%.13s.%c", key, 'a' + slot);
+    err = nvs_set_blob(h, nvs_key, blob, size);
+    if (err == ESP_OK) err = nvs_commit(h);
+    free(blob);
+    nvs_close(h);
+    return err;
+}
+
+// --- Measurement ---
+
+typedef enum { OP_MISS, OP_SAVE, OP_HIT, OP_OLD_LOAD, OP_OLD_SAVE } op_t;
+
+static void run_op(op_t op, int i)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    key_of(key, op == OP_MISS ? i % KEYS : 0);
+    sched_blob_t s = make_sched(i & 1), out;
+    size_t len = sizeof(out);
+    switch (op) {
+    case OP_MISS:
+    case OP_HIT:
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(key, &out, &len));
+        break;
+    case OP_SAVE:
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(key, &s, sizeof(s)));
+        break;
+    case OP_OLD_LOAD:
+        TEST_ASSERT_EQUAL_INT(ESP_OK, old_load(key, &out, sizeof(out)));
+        break;
+    case OP_OLD_SAVE:
+        TEST_ASSERT_EQUAL_INT(ESP_OK, old_save("old", i & 1, (uint32_t)i, &s, sizeof(s)));
+        break;
+    }
+}
+
+static cost_t measure(op_t op, int calls)
+{
+    // Warm up: the cache entries get their buffers
+    for (int i = 0; i < KEYS; ++i) run_op(op, i);
+    int allocs = s_allocs;
+    int64_t t0 = now_ns();
+    for (int i = 0; i < calls; ++i) run_op(op, i);
+    return (cost_t){ .ns = (double)(now_ns() - t0) / calls, .allocs = (double)(s_allocs - allocs) / calls };
+}
+
+void setUp(void)
+{
+    storage_deinit();
+    sim_nvs_reset();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    for (int i = 0; i < KEYS; ++i) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        key_of(key, i);
+        sched_blob_t s = make_sched(i);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(key, &s, sizeof(s)));
+    }
+}
+
+void tearDown(void) {}
+
+// --- Tests ---
+
+void test_cache_miss_allocates_nothing(void)
+{
+    storage_stats_t before, after;
+    storage_get_stats(&before);
+    cost_t miss = measure(OP_MISS, ROUNDS * KEYS);
+    storage_get_stats(&after);
+    cost_t old = measure(OP_OLD_LOAD, ROUNDS * KEYS);
+
+    TEST_ASSERT_EQUAL_UINT32(before.cache_hits, after.cache_hits);
+    TEST_ASSERT_EQUAL_INT(0, (int)(miss.allocs * 1000));
+    printf("load (cache miss, %u bytes): %.0f ns, %.2f allocs/call; before: %.0f ns, %.2f allocs/call\n",
+           (unsigned)sizeof(sched_blob_t), miss.ns, miss.allocs, old.ns, old.allocs);
+}
+
+void test_save_allocates_nothing(void)
+{
+    storage_stats_t before, after;
+    storage_get_stats(&before);
+    cost_t save = measure(OP_SAVE, ROUNDS);
+    storage_get_stats(&after);
+    cost_t old = measure(OP_OLD_SAVE, ROUNDS);
+
+    // One slot write per save that changed the content
+    uint32_t written = (after.saves - before.saves) - (after.saves_skipped - before.saves_skipped);
+    TEST_ASSERT_EQUAL_UINT32(written, after.nvs_writes - before.nvs_writes);
+    TEST_ASSERT_EQUAL_INT(0, (int)(save.allocs * 1000));
+    printf("save (%u bytes): %.0f ns, %.2f allocs/call; before: %.0f ns, %.2f allocs/call\n",
+           (unsigned)sizeof(sched_blob_t), save.ns, save.allocs, old.ns, old.allocs);
+}
+
+void test_cache_hit_allocates_nothing(void)
+{
+    cost_t hit = measure(OP_HIT, ROUNDS * KEYS);
+    TEST_ASSERT_EQUAL_INT(0, (int)(hit.allocs * 1000));
+    printf("load (cache hit): %.0f ns, %.2f allocs/call\n", hit.ns, hit.allocs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cache_miss_allocates_nothing);
+    RUN_TEST(test_save_allocates_nothing);
+    RUN_TEST(test_cache_hit_allocates_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Host stand-in for the NVS calls storage.c makes, with fault injection: a write can be
+// torn (the item is left corrupt and the device "loses power"), and stored items can be
+// corrupted in place, and writers can be held as if in a long erase. nvs_sim.c provides
+// the implementation.
+
+#define ESP_ERR_NVS_BASE                0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED     (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND           (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH      (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES       (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   (ESP_ERR_NVS_BASE + 0x10)
+#define NVS_KEY_NAME_MAX_SIZE           16
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out_handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+// Fault injection and inspection
+void sim_nvs_reset(void);                       // empty partition, no faults
+void sim_nvs_tear_write(int n);                 // the n-th next write (0 = next) is torn
+bool sim_nvs_powered(void);                     // false after a torn write until sim_nvs_power_on()
+void sim_nvs_power_on(void);
+bool sim_nvs_corrupt(const char *key);          // flip a byte of a stored item
+bool sim_nvs_exists(const char *key);
+int sim_nvs_writes(void);                       // nvs_set_* calls that reached flash
+void sim_nvs_hold(bool hold);                   // nvs_set_* calls wait while set
+int sim_nvs_held(void);                         // writers waiting
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "nvs.h"
+
+// Host stand-in, see nvs.h
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_deinit(void);
+esp_err_t nvs_flash_erase(void);
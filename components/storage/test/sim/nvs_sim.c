@@ -0,0 +1,153 @@
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// RAM NVS for the host tests, see nvs.h. storage.c serializes its NVS calls, so this does
+// no locking of its own; only the hold flag is shared with the test task. Items are static
+// so the heap use a test sees is storage.c's own.
+
+#define MAX_ITEMS   32
+#define ITEM_MAX    4096
+
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    bool used;
+    size_t len;
+    uint8_t data[ITEM_MAX];
+} item_t;
+
+static item_t s_items[MAX_ITEMS];
+static int s_tear_in = -1;
+static bool s_powered = true;
+static int s_writes;
+static volatile bool s_hold;
+static volatile int s_held;
+
+static item_t *find(const char *key)
+{
+    for (int i = 0; i < MAX_ITEMS; ++i) {
+        if (s_items[i].used && strcmp(s_items[i].key, key) == 0) return &s_items[i];
+    }
+    return NULL;
+}
+
+static void drop(item_t *it)
+{
+    it->used = false;
+    it->len = 0;
+}
+
+void sim_nvs_reset(void)
+{
+    for (int i = 0; i < MAX_ITEMS; ++i) drop(&s_items[i]);
+    s_tear_in = -1;
+    s_powered = true;
+    s_writes = 0;
+    s_hold = false;
+}
+
+void sim_nvs_tear_write(int n) { s_tear_in = n; }
+bool sim_nvs_powered(void) { return s_powered; }
+void sim_nvs_power_on(void) { s_powered = true; }
+bool sim_nvs_exists(const char *key) { return find(key) != NULL; }
+int sim_nvs_writes(void) { return s_writes; }
+void sim_nvs_hold(bool hold) { s_hold = hold; }
+int sim_nvs_held(void) { return s_held; }
+
+bool sim_nvs_corrupt(const char *key)
+{
+    item_t *it = find(key);
+    if (!it) return false;
+    it->data[it->len / 2] ^= 0x5A;
+    return true;
+}
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+esp_err_t nvs_flash_deinit(void) { return ESP_OK; }
+esp_err_t nvs_flash_erase(void) { sim_nvs_reset(); return ESP_OK; }
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out_handle)
+{
+    if (!s_powered) return ESP_ERR_NVS_NOT_INITIALIZED;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return s_powered ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    // A long erase: the writer waits here until released
+    if (s_hold) {
+        s_held++;
+        while (s_hold) vTaskDelay(1);
+        s_held--;
+    }
+    if (!s_powered) return ESP_FAIL;
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+    if (length > ITEM_MAX) return ESP_ERR_INVALID_SIZE;
+    item_t *it = find(key);
+    if (!it) {
+        for (int i = 0; i < MAX_ITEMS && !it; ++i) {
+            if (!s_items[i].used) it = &s_items[i];
+        }
+        if (!it) return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    memcpy(it->data, value, length);
+    bool tear = s_tear_in == 0;
+    if (s_tear_in >= 0) s_tear_in--;
+    if (tear) {
+        // Power lost part way: the second half of the new item never made it
+        memset(it->data + length / 2, 0xFF, length - length / 2);
+        s_powered = false;
+    }
+    strcpy(it->key, key);
+    it->used = true;
+    it->len = length;
+    s_writes++;
+    return tear ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (!s_powered) return ESP_FAIL;
+    item_t *it = find(key);
+    if (!it) return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value) {
+        // Like NVS: a short buffer gets the size needed
+        if (*length < it->len) {
+            *length = it->len;
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out_value, it->data, it->len);
+    }
+    *length = it->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t len = sizeof(*out_value);
+    return nvs_get_blob(handle, key, out_value, &len);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (!s_powered) return ESP_FAIL;
+    item_t *it = find(key);
+    if (!it) return ESP_ERR_NVS_NOT_FOUND;
+    drop(it);
+    return ESP_OK;
+}
@@ -0,0 +1,226 @@
+#include "unity.h"
+#include "storage.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Host tests for the write-behind queue against the NVS stand-in (test/sim), whose writers
+// can be held as if in a long flash erase: the caller returns without touching flash,
+// loads see queued data, saves of a queued key are merged, completion callbacks and
+// storage_flush() report the result, and storage_deinit() writes out what is queued.
+
+#define KEY         "cfg"
+#define BURST       10
+
+typedef struct {
+    uint32_t seq;
+    char text[40];
+} cfg_t;
+
+typedef struct {
+    int calls;
+    esp_err_t err;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint32_t order[4];
+} done_log_t;
+
+static uint32_t s_done_seq;
+
+static cfg_t make_cfg(uint32_t seq)
+{
+    cfg_t c = { .seq = seq };
+    snprintf(c.text, sizeof(c.text), "config number %u", (unsigned)seq);
+    return c;
+}
+
+static uint32_t load_seq(void)
+{
+    cfg_t c = {0};
+    size_t len = sizeof(c);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(KEY, &c, &len));
+    TEST_ASSERT_EQUAL_UINT(sizeof(c), len);
+    return c.seq;
+}
+
+static void on_done(const char *key, esp_err_t err, void *arg)
+{
+    done_log_t *log = arg;
+    if (log->calls < 4) log->order[log->calls] = ++s_done_seq;
+    log->calls++;
+    log->err = err;
+    strcpy(log->key, key);
+}
+
+// Wait until storage_task is stuck in a held flash write
+static void wait_held(void)
+{
+    for (int i = 0; i < 1000 && sim_nvs_held() == 0; ++i) vTaskDelay(1);
+    TEST_ASSERT_EQUAL_INT(1, sim_nvs_held());
+}
+
+void setUp(void)
+{
+    storage_deinit();
+    sim_nvs_reset();
+    s_done_seq = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+}
+
+void tearDown(void)
+{
+    sim_nvs_hold(false);
+}
+
+// --- Tests ---
+
+void test_save_returns_before_flash_write(void)
+{
+    sim_nvs_hold(true);
+    cfg_t c = make_cfg(1);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), NULL, NULL));
+    // The caller is back while storage_task waits for flash
+    wait_held();
+    TEST_ASSERT_EQUAL_INT(0, sim_nvs_writes());
+    TEST_ASSERT_EQUAL_UINT32(1, load_seq());
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_TIMEOUT, storage_flush(pdMS_TO_TICKS(20)));
+
+    sim_nvs_hold(false);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+    TEST_ASSERT_EQUAL_INT(2, sim_nvs_writes());     // first save: both slots
+    TEST_ASSERT_TRUE(sim_nvs_exists(KEY ".a"));
+    TEST_ASSERT_EQUAL_UINT32(1, load_seq());
+}
+
+void test_burst_is_written_once(void)
+{
+    cfg_t c = make_cfg(0);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    int writes = sim_nvs_writes();
+
+    // storage_task busy with another key; the burst piles up behind it
+    sim_nvs_hold(true);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_uint32_async("other", 7, NULL, NULL));
+    wait_held();
+    for (uint32_t i = 1; i <= BURST; ++i) {
+        c = make_cfg(i);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), NULL, NULL));
+        TEST_ASSERT_EQUAL_UINT32(i, load_seq());
+    }
+    sim_nvs_hold(false);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+
+    storage_stats_t st;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_get_stats(&st));
+    TEST_ASSERT_EQUAL_UINT32(2, st.async_queued);
+    TEST_ASSERT_EQUAL_UINT32(BURST - 1, st.async_coalesced);
+    TEST_ASSERT_EQUAL_INT(writes + 1 + 1, sim_nvs_writes());    // "other", one slot of KEY
+    printf("%d saves in a burst: %d flash write\n", BURST, sim_nvs_writes() - writes - 1);
+
+    // What reached flash is the last save
+    storage_deinit();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    TEST_ASSERT_EQUAL_UINT32(BURST, load_seq());
+    uint32_t v = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_uint32("other", &v));
+    TEST_ASSERT_EQUAL_UINT32(7, v);
+}
+
+void test_completion_callbacks(void)
+{
+    done_log_t first = {0}, second = {0};
+    sim_nvs_hold(true);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_uint32_async("other", 1, NULL, NULL));
+    wait_held();
+
+    cfg_t c = make_cfg(1);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), on_done, &first));
+    // Another completion: not merged, written in order
+    c = make_cfg(2);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), on_done, &second));
+    // No callback of its own: rides on the queued save and its callback
+    c = make_cfg(3);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), NULL, NULL));
+    // Same completion: merged, called once
+    c = make_cfg(4);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), on_done, &second));
+    TEST_ASSERT_EQUAL_UINT32(4, load_seq());
+    TEST_ASSERT_EQUAL_INT(0, first.calls);
+
+    sim_nvs_hold(false);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+    TEST_ASSERT_EQUAL_INT(1, first.calls);
+    TEST_ASSERT_EQUAL_INT(1, second.calls);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, first.err);
+    TEST_ASSERT_EQUAL_STRING(KEY, first.key);
+    TEST_ASSERT_TRUE(first.order[0] < second.order[0]);
+    TEST_ASSERT_EQUAL_UINT32(4, load_seq());
+
+    storage_stats_t st;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_get_stats(&st));
+    TEST_ASSERT_EQUAL_UINT32(3, st.async_queued);
+    TEST_ASSERT_EQUAL_UINT32(2, st.async_coalesced);
+}
+
+void test_failure_is_reported(void)
+{
+    done_log_t log = {0};
+    cfg_t c = make_cfg(1);
+    sim_nvs_tear_write(0);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), on_done, &log));
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, storage_flush(portMAX_DELAY));
+    TEST_ASSERT_EQUAL_INT(1, log.calls);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, log.err);
+    // Reported once
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+    sim_nvs_power_on();
+}
+
+void test_too_large_for_pool_written_in_order(void)
+{
+    static uint8_t big[CONFIG_STORAGE_MAX_BLOB + 100];
+    memset(big, 0xA5, sizeof(big));
+    uint8_t small[8] = {1};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, small, sizeof(small), NULL, NULL));
+    // Written by the caller, after the queued save of the key
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, big, sizeof(big), NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+
+    storage_deinit();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    size_t len = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(KEY, NULL, &len));
+    TEST_ASSERT_EQUAL_UINT(sizeof(big), len);
+}
+
+void test_deinit_writes_queued_saves(void)
+{
+    sim_nvs_hold(true);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_uint32_async("other", 1, NULL, NULL));
+    wait_held();
+    cfg_t c = make_cfg(5);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config_async(KEY, &c, sizeof(c), NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_uint32_async("other", 2, NULL, NULL));
+    sim_nvs_hold(false);
+    storage_deinit();
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    TEST_ASSERT_EQUAL_UINT32(5, load_seq());
+    uint32_t v = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_uint32("other", &v));
+    TEST_ASSERT_EQUAL_UINT32(2, v);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_save_returns_before_flash_write);
+    RUN_TEST(test_burst_is_written_once);
+    RUN_TEST(test_completion_callbacks);
+    RUN_TEST(test_failure_is_reported);
+    RUN_TEST(test_too_large_for_pool_written_in_order);
+    RUN_TEST(test_deinit_writes_queued_saves);
+    return UNITY_END();
+}
@@ -0,0 +1,394 @@
+#include "unity.h"
+#include "storage.h"
+#include "storage_record.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+// Host tests for versioned records: codec round trips and varint limits, tags a schema
+// does not know or a record lacks, malformed records, every upgrade path of a schema with
+// three versions after a raw struct, and the write-back of a migrated record through
+// storage (NVS stand-in, test/sim).
+
+#define KEY     "rec"
+
+// --- The test schema: version 3 ---
+//
+// 0: raw struct_v0_t   1: temp (°C), name   2: + interval_s   3: temp in 0.1 °C, + mac
+
+typedef struct {
+    int32_t temp;           // 0.1 °C
+    char name[16];
+    uint16_t interval_s;
+    uint8_t mac[6];
+} rec_t;
+
+typedef struct {
+    int32_t temp_c;
+    char name[16];
+} struct_v0_t;
+
+enum { TAG_TEMP = 1, TAG_NAME, TAG_INTERVAL, TAG_MAC };
+
+static const storage_field_t s_fields[] = {
+    STORAGE_FIELD(TAG_TEMP, STORAGE_FIELD_INT, rec_t, temp),
+    STORAGE_FIELD(TAG_NAME, STORAGE_FIELD_STR, rec_t, name),
+    STORAGE_FIELD(TAG_INTERVAL, STORAGE_FIELD_UINT, rec_t, interval_s),
+    STORAGE_FIELD(TAG_MAC, STORAGE_FIELD_BYTES, rec_t, mac),
+};
+
+static int s_migrated[3];
+
+static esp_err_t from_v0(void *rec, const void *raw, size_t raw_len)
+{
+    if (raw_len != sizeof(struct_v0_t)) return ESP_ERR_INVALID_SIZE;
+    const struct_v0_t *v0 = raw;
+    rec_t *r = rec;
+    r->temp = v0->temp_c;
+    memcpy(r->name, v0->name, sizeof(r->name) - 1);
+    s_migrated[0]++;
+    return ESP_OK;
+}
+
+static esp_err_t from_v2(void *rec, const void *raw, size_t raw_len)
+{
+    rec_t *r = rec;
+    r->temp *= 10;
+    s_migrated[2]++;
+    return ESP_OK;
+}
+
+static const storage_migrate_fn_t s_migrations[] = { from_v0, NULL, from_v2 };
+
+static const storage_schema_t s_schema = {
+    .key = KEY, .version = 3, .fields = s_fields, .field_count = 4, .migrations = s_migrations,
+};
+
+// The same key as older firmware saw it
+static const storage_schema_t s_schema_v1 = { .key = KEY, .version = 1, .fields = s_fields, .field_count = 2 };
+static const storage_schema_t s_schema_v2 = { .key = KEY, .version = 2, .fields = s_fields, .field_count = 3 };
+
+static rec_t defaults(void)
+{
+    rec_t r = { .temp = 200, .interval_s = 60, .mac = {0xde, 0xad} };
+    strcpy(r.name, "default");
+    return r;
+}
+
+static size_t encode(const storage_schema_t *schema, const void *rec, uint8_t *buf)
+{
+    size_t len = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_encode(schema, rec, buf, STORAGE_RECORD_MAX, &len));
+    return len;
+}
+
+void setUp(void)
+{
+    storage_deinit();
+    sim_nvs_reset();
+    memset(s_migrated, 0, sizeof(s_migrated));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+}
+
+void tearDown(void) {}
+
+// --- Codec ---
+
+typedef struct {
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+    char s[8];
+    uint8_t b[4];
+} all_t;
+
+static const storage_field_t s_all_fields[] = {
+    STORAGE_FIELD(1, STORAGE_FIELD_INT, all_t, i8),
+    STORAGE_FIELD(2, STORAGE_FIELD_INT, all_t, i16),
+    STORAGE_FIELD(3, STORAGE_FIELD_INT, all_t, i32),
+    STORAGE_FIELD(4, STORAGE_FIELD_INT, all_t, i64),
+    STORAGE_FIELD(5, STORAGE_FIELD_UINT, all_t, u8),
+    STORAGE_FIELD(6, STORAGE_FIELD_UINT, all_t, u16),
+    STORAGE_FIELD(7, STORAGE_FIELD_UINT, all_t, u32),
+    STORAGE_FIELD(8, STORAGE_FIELD_UINT, all_t, u64),
+    STORAGE_FIELD(9, STORAGE_FIELD_STR, all_t, s),
+    STORAGE_FIELD(127, STORAGE_FIELD_BYTES, all_t, b),
+};
+
+static const storage_schema_t s_all = { .key = "all", .version = 1, .fields = s_all_fields, .field_count = 10 };
+
+static void check_round_trip(const all_t *in)
+{
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = encode(&s_all, in, buf);
+    all_t out;
+    memset(&out, 0x5a, sizeof(out));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_all, buf, len, &out, NULL));
+    TEST_ASSERT_EQUAL_INT(in->i8, out.i8);
+    TEST_ASSERT_EQUAL_INT(in->i16, out.i16);
+    TEST_ASSERT_EQUAL_INT(in->i32, out.i32);
+    TEST_ASSERT_TRUE(in->i64 == out.i64);
+    TEST_ASSERT_EQUAL_UINT(in->u8, out.u8);
+    TEST_ASSERT_EQUAL_UINT(in->u16, out.u16);
+    TEST_ASSERT_EQUAL_UINT32(in->u32, out.u32);
+    TEST_ASSERT_TRUE(in->u64 == out.u64);
+    TEST_ASSERT_EQUAL_STRING(in->s, out.s);
+    TEST_ASSERT_EQUAL_MEMORY(in->b, out.b, sizeof(out.b));
+}
+
+void test_round_trip_at_limits(void)
+{
+    all_t zero = {0};
+    check_round_trip(&zero);
+    all_t min = { INT8_MIN, INT16_MIN, INT32_MIN, INT64_MIN, 0, 0, 0, 0, "", {0, 0, 0, 1} };
+    check_round_trip(&min);
+    all_t max = { INT8_MAX, INT16_MAX, INT32_MAX, INT64_MAX, UINT8_MAX, UINT16_MAX, UINT32_MAX,
+                  UINT64_MAX, "1234567", {0xff, 0xff, 0xff, 0xff} };
+    check_round_trip(&max);
+    // Around the varint byte boundaries
+    const int64_t edges[] = { -65, -64, -63, -1, 1, 63, 64, 65, 8191, 8192, -8193 };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+        all_t a = { .i16 = (int16_t)edges[i], .i32 = (int32_t)edges[i], .i64 = edges[i] * 1000003,
+                    .u16 = (uint16_t)(edges[i] & 0x7fff), .u64 = (uint64_t)edges[i] << 20 };
+        check_round_trip(&a);
+    }
+}
+
+void test_encoding_is_compact(void)
+{
+    // Small magnitudes of either sign take one byte, strings only their characters,
+    // byte arrays stop at the last non-zero byte
+    all_t a = { .i8 = -1, .i16 = 63, .i32 = -64, .s = "ab", .b = {7} };
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = encode(&s_all, &a, buf);
+    // header, 8 integers of 2 bytes, "ab" in 4, one byte in 4 (tag 127 takes a two-byte key)
+    TEST_ASSERT_EQUAL_UINT(2 + 8 * 2 + 4 + 4, len);
+    TEST_ASSERT_EQUAL_HEX8(STORAGE_RECORD_MAGIC, buf[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, buf[1]);
+
+    rec_t r = defaults();
+    len = encode(&s_schema, &r, buf);
+    printf("record: %u bytes for a %u-byte struct\n", (unsigned)len, (unsigned)sizeof(r));
+    TEST_ASSERT_TRUE(len < sizeof(r));
+
+    size_t need = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, storage_record_encode(&s_schema, &r, buf, len - 1, &need));
+    TEST_ASSERT_EQUAL_UINT(len, need);
+    memset(r.name, 'x', sizeof(r.name));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, storage_record_encode(&s_schema, &r, buf, sizeof(buf), &need));
+}
+
+void test_unknown_tags_skipped_missing_tags_keep_defaults(void)
+{
+    // A newer schema added a string and an integer: skipped
+    typedef struct { rec_t r; char note[20]; int32_t level; } newer_t;
+    const storage_field_t newer_fields[] = {
+        s_fields[0], s_fields[1], s_fields[2], s_fields[3],
+        STORAGE_FIELD(20, STORAGE_FIELD_STR, newer_t, note),
+        STORAGE_FIELD(21, STORAGE_FIELD_INT, newer_t, level),
+    };
+    const storage_schema_t newer = { .key = KEY, .version = 4, .fields = newer_fields, .field_count = 6 };
+    newer_t n = { .r = { .temp = -55, .name = "probe", .interval_s = 5, .mac = {1, 2, 3, 4, 5, 6} },
+                  .note = "not known here", .level = -100000 };
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = encode(&newer, &n, buf);
+
+    rec_t r = defaults();
+    uint8_t from = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, buf, len, &r, &from));
+    TEST_ASSERT_EQUAL_UINT8(4, from);
+    TEST_ASSERT_EQUAL_INT(0, s_migrated[0] + s_migrated[2]);
+    TEST_ASSERT_EQUAL_MEMORY(&n.r, &r, sizeof(r));
+
+    // A record without interval and mac: the defaults stay
+    const storage_schema_t fewer = { .key = KEY, .version = 3, .fields = s_fields, .field_count = 2 };
+    rec_t in = { .temp = 215, .name = "short" };
+    len = encode(&fewer, &in, buf);
+    r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, buf, len, &r, NULL));
+    rec_t want = defaults();
+    want.temp = 215;
+    strncpy(want.name, "short", sizeof(want.name));    // zero-padded, as decoded
+    TEST_ASSERT_EQUAL_MEMORY(&want, &r, sizeof(r));
+
+    // Zero is stored, not taken for "missing"
+    in = (rec_t){0};
+    len = encode(&s_schema, &in, buf);
+    r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, buf, len, &r, NULL));
+    TEST_ASSERT_EQUAL_MEMORY(&in, &r, sizeof(r));
+}
+
+void test_malformed_records_rejected(void)
+{
+    rec_t in = defaults();
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = encode(&s_schema, &in, buf);
+
+    // Cut anywhere: a clean error or, at a field boundary, the fields before the cut
+    int rejected = 0;
+    for (size_t n = 2; n < len; ++n) {
+        rec_t r = defaults();
+        esp_err_t err = storage_record_decode(&s_schema, buf, n, &r, NULL);
+        TEST_ASSERT_TRUE(err == ESP_OK || err == ESP_ERR_INVALID_SIZE);
+        rejected += err != ESP_OK;
+    }
+    TEST_ASSERT_TRUE(rejected > 0);
+
+    const uint8_t bad[][8] = {
+        { STORAGE_RECORD_MAGIC, 3, TAG_TEMP << 3 | 1, 0 },                  // unknown wire type
+        { STORAGE_RECORD_MAGIC, 3, TAG_TEMP << 3 | 2, 1, 'x' },             // string for an integer
+        { STORAGE_RECORD_MAGIC, 3, TAG_NAME << 3 | 0, 1 },                  // integer for a string
+        { STORAGE_RECORD_MAGIC, 3, TAG_INTERVAL << 3, 0x80, 0x80, 0x04 },   // 65536 in 16 bits
+        { STORAGE_RECORD_MAGIC, 3, TAG_MAC << 3 | 2, 7, 1, 2, 3, 4 },       // longer than the data
+        { STORAGE_RECORD_MAGIC, 3, TAG_TEMP << 3, 0xff },                   // unterminated varint
+    };
+    const size_t bad_len[] = { 4, 5, 4, 6, 8, 4 };
+    for (size_t i = 0; i < sizeof(bad_len) / sizeof(bad_len[0]); ++i) {
+        rec_t r = defaults();
+        TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, storage_record_decode(&s_schema, bad[i], bad_len[i], &r, NULL));
+    }
+
+    // Too long for the field (16 bytes with the NUL)
+    uint8_t name[2 + 2 + 16] = { STORAGE_RECORD_MAGIC, 3, TAG_NAME << 3 | 2, 16 };
+    memset(name + 4, 'n', 16);
+    rec_t r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, storage_record_decode(&s_schema, name, sizeof(name), &r, NULL));
+    name[3] = 15;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, name, sizeof(name) - 1, &r, NULL));
+    TEST_ASSERT_EQUAL_UINT(15, strlen(r.name));
+}
+
+// --- Migrations ---
+
+static void check_upgraded(const rec_t *r, int32_t temp)
+{
+    TEST_ASSERT_EQUAL_INT32(temp, r->temp);
+    TEST_ASSERT_EQUAL_STRING("pond", r->name);
+}
+
+void test_every_upgrade_path(void)
+{
+    uint8_t buf[STORAGE_RECORD_MAX];
+    uint8_t from;
+    rec_t want_defaults = defaults();
+
+    // 0 -> 3: raw struct, both migrations, defaults for what v0 did not have
+    struct_v0_t v0 = { .temp_c = 21, .name = "pond" };
+    rec_t r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, (const uint8_t *)&v0, sizeof(v0), &r, &from));
+    TEST_ASSERT_EQUAL_UINT8(0, from);
+    check_upgraded(&r, 210);
+    TEST_ASSERT_EQUAL_UINT16(want_defaults.interval_s, r.interval_s);
+    TEST_ASSERT_EQUAL_MEMORY(want_defaults.mac, r.mac, sizeof(r.mac));
+    TEST_ASSERT_EQUAL_INT(1, s_migrated[0]);
+    TEST_ASSERT_EQUAL_INT(1, s_migrated[2]);
+
+    // 1 -> 3: interval from the defaults, temperature converted
+    rec_t old = { .temp = -4, .name = "pond", .interval_s = 999 };
+    size_t len = encode(&s_schema_v1, &old, buf);
+    r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, buf, len, &r, &from));
+    TEST_ASSERT_EQUAL_UINT8(1, from);
+    check_upgraded(&r, -40);
+    TEST_ASSERT_EQUAL_UINT16(want_defaults.interval_s, r.interval_s);
+    TEST_ASSERT_EQUAL_INT(1, s_migrated[0]);
+
+    // 2 -> 3: interval kept
+    len = encode(&s_schema_v2, &old, buf);
+    r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, buf, len, &r, &from));
+    TEST_ASSERT_EQUAL_UINT8(2, from);
+    check_upgraded(&r, -40);
+    TEST_ASSERT_EQUAL_UINT16(999, r.interval_s);
+    TEST_ASSERT_EQUAL_INT(3, s_migrated[2]);
+
+    // 3: nothing to run
+    len = encode(&s_schema, &r, buf);
+    rec_t again = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_decode(&s_schema, buf, len, &again, &from));
+    TEST_ASSERT_EQUAL_UINT8(3, from);
+    TEST_ASSERT_EQUAL_MEMORY(&r, &again, sizeof(r));
+    TEST_ASSERT_EQUAL_INT(3, s_migrated[2]);
+}
+
+void test_unmigratable_blobs_rejected(void)
+{
+    rec_t r = defaults();
+    // Not the size of the raw struct
+    uint8_t junk[sizeof(struct_v0_t) + 4] = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, storage_record_decode(&s_schema, junk, sizeof(junk), &r, NULL));
+    // A schema without a migration from raw blobs
+    struct_v0_t v0 = { .temp_c = 21, .name = "pond" };
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_VERSION,
+                          storage_record_decode(&s_schema_v2, (const uint8_t *)&v0, sizeof(v0), &r, NULL));
+}
+
+// --- Through storage ---
+
+void test_load_writes_back_migrated_record(void)
+{
+    struct_v0_t v0 = { .temp_c = 18, .name = "pond" };
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &v0, sizeof(v0)));
+    int writes = sim_nvs_writes();
+
+    rec_t r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&s_schema, &r));
+    check_upgraded(&r, 180);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+    TEST_ASSERT_EQUAL_INT(writes + 1, sim_nvs_writes());
+
+    // In flash as a version 3 record, smaller than the struct it replaced
+    uint8_t buf[STORAGE_RECORD_MAX];
+    size_t len = sizeof(buf);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config(KEY, buf, &len));
+    TEST_ASSERT_EQUAL_HEX8(STORAGE_RECORD_MAGIC, buf[0]);
+    TEST_ASSERT_EQUAL_UINT8(3, buf[1]);
+    TEST_ASSERT_TRUE(len < sizeof(rec_t));
+
+    // Migrated once: later loads after a reboot run nothing and write nothing
+    storage_deinit();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    rec_t again = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&s_schema, &again));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+    TEST_ASSERT_EQUAL_MEMORY(&r, &again, sizeof(r));
+    TEST_ASSERT_EQUAL_INT(1, s_migrated[0]);
+    TEST_ASSERT_EQUAL_INT(writes + 1, sim_nvs_writes());
+}
+
+void test_newer_record_not_rewritten(void)
+{
+    rec_t in = { .temp = 1, .name = "pond" };
+    const storage_schema_t newer = { .key = KEY, .version = 9, .fields = s_fields, .field_count = 4 };
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_save(&newer, &in));
+    int writes = sim_nvs_writes();
+
+    rec_t r = defaults();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_record_load(&s_schema, &r));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_flush(portMAX_DELAY));
+    TEST_ASSERT_EQUAL_INT(writes, sim_nvs_writes());
+    TEST_ASSERT_EQUAL_MEMORY(&in, &r, sizeof(r));
+
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NVS_NOT_FOUND, storage_record_load(&s_all, &r));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_at_limits);
+    RUN_TEST(test_encoding_is_compact);
+    RUN_TEST(test_unknown_tags_skipped_missing_tags_keep_defaults);
+    RUN_TEST(test_malformed_records_rejected);
+    RUN_TEST(test_every_upgrade_path);
+    RUN_TEST(test_unmigratable_blobs_rejected);
+    RUN_TEST(test_load_writes_back_migrated_record);
+    RUN_TEST(test_newer_record_not_rewritten);
+    return UNITY_END();
+}
@@ -0,0 +1,240 @@
+#include "unity.h"
+#include "storage.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+// Host tests for the A/B slot format against a fault-injecting NVS stand-in (test/sim):
+// one blob write per save, torn writes at every point of a save sequence followed by a
+// reboot, corruption of either slot, generation wrap-around and reading the legacy
+// "<key>" / "<key>_bak" format.
+
+#define KEY         "cfg"
+#define SAVES       12
+
+// --- Helpers ---
+
+typedef struct {
+    uint32_t seq;
+    char text[40];
+} cfg_t;
+
+static cfg_t make_cfg(uint32_t seq)
+{
+    cfg_t c = { .seq = seq };
+    snprintf(c.text, sizeof(c.text), "config number %u", (unsigned)seq);
+    return c;
+}
+
+static void reboot(void)
+{
+    storage_deinit();
+    sim_nvs_power_on();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+}
+
+// Raw blob as storage.c lays it out: optional generation, data, CRC over both
+static void put_raw(const char *nvs_key, const uint32_t *gen, const cfg_t *c)
+{
+    uint8_t buf[sizeof(uint32_t) + sizeof(*c) + sizeof(uint32_t)];
+    size_t n = 0;
+    if (gen) { memcpy(buf, gen, sizeof(*gen)); n += sizeof(*gen); }
+    memcpy(buf + n, c, sizeof(*c));
+    n += sizeof(*c);
+    uint32_t crc = storage_crc32(buf, n);
+    memcpy(buf + n, &crc, sizeof(crc));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, nvs_set_blob(1, nvs_key, buf, n + sizeof(crc)));
+}
+
+static esp_err_t load_cfg(cfg_t *out)
+{
+    size_t len = sizeof(*out);
+    esp_err_t err = storage_load_config(KEY, out, &len);
+    if (err == ESP_OK && len != sizeof(*out)) return ESP_ERR_INVALID_SIZE;
+    return err;
+}
+
+void setUp(void)
+{
+    storage_deinit();
+    sim_nvs_reset();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+}
+
+void tearDown(void) {}
+
+// --- Tests ---
+
+void test_one_write_per_save(void)
+{
+    cfg_t c = make_cfg(1);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    TEST_ASSERT_EQUAL_INT(2, sim_nvs_writes());     // first save fills both slots
+    for (uint32_t i = 2; i <= SAVES; ++i) {
+        c = make_cfg(i);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    }
+    TEST_ASSERT_EQUAL_INT(2 + (SAVES - 1), sim_nvs_writes());
+    printf("%d saves: %d blob writes (%d with primary + backup)\n", SAVES, sim_nvs_writes(), 2 * SAVES);
+
+    // Also after a reboot, when the slot state has to be read back first
+    reboot();
+    int before = sim_nvs_writes();
+    c = make_cfg(SAVES + 1);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    TEST_ASSERT_EQUAL_INT(before + 1, sim_nvs_writes());
+    reboot();
+    cfg_t out;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(SAVES + 1, out.seq);
+}
+
+void test_torn_write_at_every_point(void)
+{
+    // For each write of the sequence: tear it, reboot, and expect the last acknowledged
+    // save back; then the device keeps saving normally
+    // 12 saves are 13 writes: the first save fills both slots
+    for (int tear_at = 0; tear_at <= SAVES; ++tear_at) {
+        setUp();
+        sim_nvs_tear_write(tear_at);
+        uint32_t acked = 0;
+        for (uint32_t i = 1; i <= SAVES && sim_nvs_powered(); ++i) {
+            cfg_t c = make_cfg(i);
+            if (storage_save_config(KEY, &c, sizeof(c)) == ESP_OK) acked = i;
+        }
+        TEST_ASSERT_FALSE(sim_nvs_powered());
+        sim_nvs_tear_write(-1);
+        reboot();
+
+        cfg_t out;
+        esp_err_t err = load_cfg(&out);
+        if (acked == 0) {
+            // Torn during the first save: slot a torn, or b torn with a intact
+            TEST_ASSERT_TRUE(err != ESP_OK || out.seq == 1);
+        } else {
+            TEST_ASSERT_EQUAL_INT(ESP_OK, err);
+            TEST_ASSERT_EQUAL_UINT32(acked, out.seq);
+        }
+
+        cfg_t c = make_cfg(100);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+        reboot();
+        TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+        TEST_ASSERT_EQUAL_UINT32(100, out.seq);
+    }
+}
+
+void test_corrupt_slot_recovered(void)
+{
+    for (uint32_t i = 1; i <= 3; ++i) {
+        cfg_t c = make_cfg(i);
+        TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    }
+    // Generation 3 is in slot a (1: a+b, 2: b, 3: a). Older slot corrupt: newest still read,
+    // and the bad slot is rewritten
+    TEST_ASSERT_TRUE(sim_nvs_corrupt(KEY ".b"));
+    reboot();
+    cfg_t out;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(3, out.seq);
+    storage_deinit();
+    TEST_ASSERT_TRUE(sim_nvs_corrupt(KEY ".a"));
+    sim_nvs_power_on();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_init());
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(3, out.seq);
+
+    // Both corrupt: reported, and a save starts over
+    TEST_ASSERT_TRUE(sim_nvs_corrupt(KEY ".a"));
+    TEST_ASSERT_TRUE(sim_nvs_corrupt(KEY ".b"));
+    reboot();
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_CRC, load_cfg(&out));
+    cfg_t c = make_cfg(4);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    reboot();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(4, out.seq);
+}
+
+void test_generation_wraps(void)
+{
+    uint32_t old_gen = UINT32_MAX, new_gen = 0;
+    cfg_t old_cfg = make_cfg(1), new_cfg = make_cfg(2);
+    put_raw(KEY ".a", &old_gen, &old_cfg);
+    put_raw(KEY ".b", &new_gen, &new_cfg);
+    cfg_t out;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(2, out.seq);
+
+    // The next save goes to slot a, as generation 1
+    cfg_t c = make_cfg(3);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    reboot();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(3, out.seq);
+    TEST_ASSERT_TRUE(sim_nvs_corrupt(KEY ".a"));
+    reboot();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(2, out.seq);
+}
+
+void test_legacy_format_read_and_converted(void)
+{
+    // Written by older firmware, primary corrupt
+    cfg_t c = make_cfg(7);
+    put_raw(KEY, NULL, &c);
+    put_raw(KEY "_bak", NULL, &c);
+    TEST_ASSERT_TRUE(sim_nvs_corrupt(KEY));
+    cfg_t out;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(7, out.seq);
+
+    c = make_cfg(8);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config(KEY, &c, sizeof(c)));
+    TEST_ASSERT_FALSE(sim_nvs_exists(KEY));
+    TEST_ASSERT_FALSE(sim_nvs_exists(KEY "_bak"));
+    TEST_ASSERT_TRUE(sim_nvs_exists(KEY ".a"));
+    TEST_ASSERT_TRUE(sim_nvs_exists(KEY ".b"));
+    reboot();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, load_cfg(&out));
+    TEST_ASSERT_EQUAL_UINT32(8, out.seq);
+}
+
+void test_legacy_truncated_backup_key(void)
+{
+    // Older firmware cut "<key>_bak" to the NVS key limit
+    cfg_t c = make_cfg(5), out;
+    put_raw("schedule_cfg", NULL, &c);
+    put_raw("schedule_cfg_ba", NULL, &c);
+    TEST_ASSERT_TRUE(sim_nvs_corrupt("schedule_cfg"));
+    size_t len = sizeof(out);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_load_config("schedule_cfg", &out, &len));
+    TEST_ASSERT_EQUAL_UINT32(5, out.seq);
+
+    c = make_cfg(6);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config("schedule_cfg", &c, sizeof(c)));
+    TEST_ASSERT_FALSE(sim_nvs_exists("schedule_cfg"));
+    TEST_ASSERT_FALSE(sim_nvs_exists("schedule_cfg_ba"));
+}
+
+void test_key_length_and_missing(void)
+{
+    cfg_t c = make_cfg(1), out;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NVS_NOT_FOUND, load_cfg(&out));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, storage_save_config("thirteen_char", &c, sizeof(c)));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, storage_save_config("fourteen_chars", &c, sizeof(c)));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_write_per_save);
+    RUN_TEST(test_torn_write_at_every_point);
+    RUN_TEST(test_corrupt_slot_recovered);
+    RUN_TEST(test_generation_wraps);
+    RUN_TEST(test_legacy_format_read_and_converted);
+    RUN_TEST(test_legacy_truncated_backup_key);
+    RUN_TEST(test_key_length_and_missing);
+    return UNITY_END();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <esp_err.h>
 
 /**
@@ -8,13 +9,15 @@
  * This component provides a centralized way to handle telemetry data,
  * including periodic heartbeats and event-driven audit logs. It operates
  * in a background task and handles publishing over MQTT when the network
- * is available.
+ * is available. While it is not, messages are kept in a spool on the
+ * CONFIG_TELEMETRY_SPOOL_PARTITION data partition and sent in order, at a
+ * limited rate, once MQTT is back.
  */
 
 /**
  * @brief Initialize the telemetry component.
  *
- * This function creates the telemetry task and the audit log queue.
+ * This function sets up the audit ring and creates the telemetry task.
  *
  * @return ESP_OK on success, or an error code on failure.
  */
@@ -24,15 +27,63 @@ esp_err_t telemetry_init(void);
  * @brief Enqueue an audit log entry for publishing.
  *
  * This function is non-blocking and safe to call from any task.
- * The message is copied and queued for the telemetry task to publish.
+ * The message is formatted straight into the audit ring (at most 255
+ * characters) for the telemetry task to publish.
  *
  * @param format The format string for the log message (printf-style).
  * @param ... Variable arguments for the format string.
- * @return ESP_OK if the message was queued successfully, ESP_ERR_NO_MEM if
- *         memory allocation failed, or ESP_ERR_TIMEOUT if the queue was full.
+ * @return ESP_OK if the message was queued successfully, or ESP_ERR_NO_MEM
+ *         if the ring was full.
  */
 esp_err_t telemetry_audit_log(const char *format, ...);
 
-// Test/helper: trigger an immediate heartbeat publish once.
+// Structured audit events. Each is a 16-byte binary record (time, actor, event, three
+// integer arguments) that telemetry_task renders as a JSON object in the audit batch, e.g.
+// {"ts":1718000000,"actor":"ble","ev":"output","ch":0,"pct":40,"ramp_ms":1000}.
+// What arg0..arg2 hold, per event:
+typedef enum {
+    TELEMETRY_AUDIT_OUTPUT = 1,     // control applied a level: channel, pct, ramp_ms
+    TELEMETRY_AUDIT_CMD_STALE,      // control dropped a command too old to apply: channels, seq, age_s
+    TELEMETRY_AUDIT_ESTOP,          // emergency off: -, latency_us
+    TELEMETRY_AUDIT_BLE_SESSION,    // BLE secure session established
+    TELEMETRY_AUDIT_BLE_CMD,        // BLE control message accepted: channels, ctr
+    TELEMETRY_AUDIT_BLE_REJECT,     // BLE control message refused: reason (TELEMETRY_AUDIT_REJECT_*)
+    TELEMETRY_AUDIT_BLE_PROVISION,  // Wi-Fi credentials received over BLE
+    TELEMETRY_AUDIT_OTA_START,      // OTA manifest accepted, download starts: -, version, current
+    TELEMETRY_AUDIT_OTA_FAIL,       // OTA abandoned: stage (TELEMETRY_AUDIT_OTA_*), err
+    TELEMETRY_AUDIT_SCHED_STEP,     // schedule transition posted to control: channels, pct
+    TELEMETRY_AUDIT_SCHED_MISSED,   // transition missed while off: channel, pct, at (UTC s)
+    TELEMETRY_AUDIT_EVENT_COUNT
+} telemetry_audit_event_t;
+
+// TELEMETRY_AUDIT_BLE_REJECT reasons
+#define TELEMETRY_AUDIT_REJECT_NO_SESSION   1
+#define TELEMETRY_AUDIT_REJECT_DECRYPT      2
+#define TELEMETRY_AUDIT_REJECT_MALFORMED    3
+#define TELEMETRY_AUDIT_REJECT_REPLAY       4
+
+// TELEMETRY_AUDIT_OTA_FAIL stages
+#define TELEMETRY_AUDIT_OTA_MANIFEST        1
+#define TELEMETRY_AUDIT_OTA_SIGNATURE       2
+#define TELEMETRY_AUDIT_OTA_ROLLBACK        3
+#define TELEMETRY_AUDIT_OTA_DOWNLOAD        4
+#define TELEMETRY_AUDIT_OTA_FINISH          5
+
+/**
+ * @brief Record a structured audit event.
+ *
+ * Non-blocking and cheap enough for hot paths from any task (not from an
+ * ISR): the record is copied into the audit ring as is, formatting happens
+ * later on the telemetry task.
+ *
+ * @param actor ACTOR_* the event is attributed to.
+ * @return ESP_OK, ESP_ERR_NO_MEM if the ring was full, or
+ *         ESP_ERR_INVALID_STATE before telemetry_init().
+ */
+esp_err_t telemetry_audit_event(uint8_t actor, telemetry_audit_event_t event, uint16_t arg0,
+                                int32_t arg1, int32_t arg2);
+
+// Test/helper: have the telemetry task publish a heartbeat now (returns before it is sent).
+// ESP_ERR_INVALID_STATE before telemetry_init().
 esp_err_t telemetry_publish_heartbeat(void);
 
@@ -2,92 +2,233 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
-#include "cJSON.h"
 #include "ipc.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_heap_caps.h"
 #include "esp_wifi.h"
 #include "esp_timer.h"
 #include "schedule.h"
+#include "control.h"
 #include <time.h>
 #include "sdkconfig.h"
 #include "aws_mqtt.h"
 #include "net.h"
+#include "telemetry_spool.h"
+#include "telemetry_batch.h"
+#include "telemetry_ring.h"
+#include "telemetry_audit.h"
+#include "telemetry_heartbeat.h"
 
 static const char *TAG = "telemetry";
 
-#define AUDIT_QUEUE_LEN 16
 #define MAX_AUDIT_MSG_LEN 256
 
-static QueueHandle_t s_audit_queue = NULL;
+// Spool entry kinds: the topic a message goes to
+#define SPOOL_AUDIT     0
+#define SPOOL_HEARTBEAT 1
 
-static esp_err_t publish_heartbeat(void) {
-    if (!(xEventGroupGetBits(g_net_state_event_group) & NET_BIT_MQTT_UP)) {
-        ESP_LOGD(TAG, "Skipping heartbeat, MQTT not connected");
-    return ESP_ERR_INVALID_STATE;
+// telemetry_task notification bits
+#define NOTIFY_AUDIT        (1u << 0)   // records in the audit ring
+#define NOTIFY_HEARTBEAT    (1u << 1)   // telemetry_publish_heartbeat()
+
+// Audit ring record types
+#define AUDIT_TEXT      0       // telemetry_audit_log(): NUL-terminated text
+#define AUDIT_EVENT     1       // telemetry_audit_event(): telemetry_audit_rec_t
+
+_Static_assert(TELEMETRY_BATCH_MAX <= TELEMETRY_SPOOL_MAX_PAYLOAD, "audit batch does not fit a spool entry");
+_Static_assert(TELEMETRY_HEARTBEAT_MAX <= TELEMETRY_SPOOL_MAX_PAYLOAD, "heartbeat does not fit a spool entry");
+
+#if CONFIG_TELEMETRY_HEARTBEAT_CBOR
+#define HEARTBEAT_FORMAT    TELEMETRY_ENC_CBOR
+#else
+#define HEARTBEAT_FORMAT    TELEMETRY_ENC_JSON
+#endif
+
+_Static_assert((CONFIG_TELEMETRY_AUDIT_RING_SIZE & (CONFIG_TELEMETRY_AUDIT_RING_SIZE - 1)) == 0,
+               "audit ring size must be a power of two");
+_Static_assert(ACTOR_COUNT == TELEMETRY_AUDIT_ACTORS, "audit actor names out of date");
+
+// Audit messages from any task to telemetry_task: text formatted in place, taking its
+// length (with the NUL) plus a 4-byte header, rounded up to 4 bytes; structured events
+// take 20 bytes
+static uint32_t s_audit_mem[CONFIG_TELEMETRY_AUDIT_RING_SIZE / 4];
+static telemetry_ring_t s_audit_ring;
+static TaskHandle_t s_task = NULL;
+static bool s_spool_ok = false;
+
+// MQTT messages handed to the client and their bytes (payload and topic), for the
+// heartbeat rates; s_rate_* is where the last heartbeat left off
+static uint32_t s_tx_msgs, s_tx_bytes;
+static uint32_t s_rate_msgs, s_rate_bytes;
+static int64_t s_rate_ms;
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static bool mqtt_up(void)
+{
+    return xEventGroupGetBits(g_net_state_event_group) & NET_BIT_MQTT_UP;
+}
+
+static esp_err_t spool_send(uint8_t kind, const void *data, size_t len, void *arg)
+{
+    if (!mqtt_up()) return ESP_ERR_INVALID_STATE;
+    const char *topic = kind == SPOOL_HEARTBEAT ? CONFIG_TELEMETRY_HEARTBEAT_TOPIC : CONFIG_TELEMETRY_AUDIT_TOPIC;
+    esp_err_t err = aws_mqtt_publish(topic, data, (int)len, 1);
+    if (err == ESP_OK) {
+        s_tx_msgs++;
+        s_tx_bytes += len + strlen(topic);
     }
+    return err;
+}
+
+static size_t spool_outbox(void *arg)
+{
+    return aws_mqtt_outbox_size();
+}
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-    ESP_LOGE(TAG, "Failed to create JSON object for heartbeat");
-    return ESP_ERR_NO_MEM;
+// Publish right away when MQTT is up and nothing older is waiting in the spool; otherwise
+// append to the spool, which telemetry_task drains once MQTT is back
+static esp_err_t deliver(uint8_t kind, const void *msg, size_t len)
+{
+    if (telemetry_spool_empty() && spool_send(kind, msg, len, NULL) == ESP_OK) return ESP_OK;
+    if (!s_spool_ok) {
+        ESP_LOGD(TAG, "MQTT not connected and no spool, message dropped");
+        return ESP_ERR_INVALID_STATE;
     }
+    esp_err_t err = telemetry_spool_append(kind, msg, len);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Failed to spool message: %s", esp_err_to_name(err));
+    return err;
+}
+
+static void drain_spool(void)
+{
+    if (!telemetry_spool_empty() && mqtt_up()) telemetry_spool_drain(now_ms());
+}
 
-    // Collect heartbeat info
-    time_t now = time(NULL);
-    uint64_t uptime = esp_timer_get_time() / 1000000ULL;
-    esp_reset_reason_t rr = esp_reset_reason();
-    size_t min_free = esp_get_minimum_free_heap_size();
-    
+static void flush_audit(void)
+{
+    size_t len;
+    const char *payload = telemetry_batch_finish(&len);
+    if (payload) deliver(SPOOL_AUDIT, payload, len);
+}
+
+// Per hour, over the time since the last heartbeat
+static uint32_t per_hour(uint32_t count, int64_t ms)
+{
+    return ms > 0 ? (uint32_t)((uint64_t)count * 3600000 / (uint64_t)ms) : 0;
+}
+
+// Encoded straight into a static buffer from counters kept in RAM: no allocation, no flash
+static esp_err_t publish_heartbeat(void) {
+    static uint8_t buf[TELEMETRY_HEARTBEAT_MAX];
+    telemetry_heartbeat_t hb = {
+        .ts = time(NULL),
+        .uptime_s = esp_timer_get_time() / 1000000ULL,
+        .reset_reason = esp_reset_reason(),
+        .min_free_heap = esp_get_minimum_free_heap_size(),
+        .wifi_rssi = 127,
+    };
     wifi_ap_record_t apinfo;
-    int8_t rssi = (esp_wifi_sta_get_ap_info(&apinfo) == ESP_OK) ? apinfo.rssi : 127;
-
-    schedule_t s;
-    time_t next_on = 0, next_off = 0;
-    if (schedule_load(&s) == ESP_OK) {
-        schedule_compute_next_events(now, &s, &next_on, &next_off);
-    }
-
-    // Build JSON
-    cJSON_AddNumberToObject(root, "ts", now);
-    cJSON_AddNumberToObject(root, "uptime_s", uptime);
-    cJSON_AddNumberToObject(root, "reset_reason", rr);
-    cJSON_AddNumberToObject(root, "min_free_heap", min_free);
-    cJSON_AddNumberToObject(root, "wifi_rssi", rssi);
-    if (next_on > 0) cJSON_AddNumberToObject(root, "next_on_utc", next_on);
-    if (next_off > 0) cJSON_AddNumberToObject(root, "next_off_utc", next_off);
-
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (json_str) {
-        ESP_LOGI(TAG, "Heartbeat: %s", json_str);
-        aws_mqtt_publish(CONFIG_TELEMETRY_HEARTBEAT_TOPIC, json_str, (int)strlen(json_str), 1);
-        free(json_str);
-    }
-    cJSON_Delete(root);
-    return ESP_OK;
+    if (esp_wifi_sta_get_ap_info(&apinfo) == ESP_OK) hb.wifi_rssi = apinfo.rssi;
+
+    control_mbox_stats_t mbox;
+    if (control_get_mbox_stats(&mbox) == ESP_OK) {
+        hb.has_mbox = true;
+        hb.cmd_coalesced = mbox.coalesced;
+        hb.cmd_dropped = mbox.dropped;
+        hb.cmd_deferred = mbox.deferred;
+        hb.cmd_redundant = mbox.redundant;
+    }
+    schedule_stats_t sched;
+    if (schedule_get_stats(&sched) == ESP_OK) {
+        hb.next_on_utc = sched.next_on_utc;
+        hb.next_off_utc = sched.next_off_utc;
+        hb.has_sched = true;
+        hb.sched_wakeups = sched.wakeups;
+        hb.sched_cpu_us = sched.cpu_us;
+        hb.pump_late_max_us = sched.pump_late_max_us;
+    }
+    control_estop_stats_t estop;
+    if (control_get_estop_stats(&estop) == ESP_OK) {
+        hb.estop_count = estop.count;
+        hb.estop_worst_us = estop.worst_us;
+    }
+    if (s_spool_ok) {
+        telemetry_spool_stats_t spool;
+        telemetry_spool_get_stats(&spool);
+        hb.has_spool = true;
+        hb.spool_pending = spool.pending;
+        hb.spool_dropped = spool.dropped;
+    }
+    telemetry_batch_stats_t batch;
+    telemetry_batch_get_stats(&batch);
+    hb.audit_entries = batch.entries;
+    hb.audit_batches = batch.batches;
+    telemetry_ring_stats_t ring;
+    telemetry_ring_get_stats(&s_audit_ring, &ring);
+    hb.audit_ring_peak = ring.peak;
+    hb.audit_ring_full = ring.refused;
+    int64_t ms = now_ms();
+    hb.mqtt_msgs_per_h = per_hour(s_tx_msgs - s_rate_msgs, ms - s_rate_ms);
+    hb.mqtt_bytes_per_h = per_hour(s_tx_bytes - s_rate_bytes, ms - s_rate_ms);
+    s_rate_msgs = s_tx_msgs;
+    s_rate_bytes = s_tx_bytes;
+    s_rate_ms = ms;
+
+    size_t len;
+    esp_err_t err = telemetry_heartbeat_encode(&hb, HEARTBEAT_FORMAT, buf, sizeof(buf), &len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Heartbeat does not fit %u bytes", (unsigned)sizeof(buf));
+        return err;
+    }
+#if CONFIG_TELEMETRY_HEARTBEAT_CBOR
+    ESP_LOGI(TAG, "Heartbeat: %u bytes CBOR", (unsigned)len);
+#else
+    ESP_LOGI(TAG, "Heartbeat: %s", (const char *)buf);
+#endif
+    return deliver(SPOOL_HEARTBEAT, buf, len);
+}
+
+// Into the current batch, as a string or as a JSON value; a full batch goes out first
+static void batch_audit(const char *entry, bool json) {
+    ESP_LOGI(TAG, "Audit: %s", entry);
+    int64_t now = now_ms();
+    esp_err_t (*add)(const char *, int64_t) = json ? telemetry_batch_add_json : telemetry_batch_add;
+    esp_err_t err = add(entry, now);
+    if (err == ESP_ERR_NO_MEM) {
+        flush_audit();
+        err = add(entry, now);
+    }
+    if (err != ESP_OK) ESP_LOGW(TAG, "Audit entry dropped: %s", esp_err_to_name(err));
 }
 
-static void publish_audit_log(const char *msg) {
-    if (!(xEventGroupGetBits(g_net_state_event_group) & NET_BIT_MQTT_UP)) {
-        ESP_LOGD(TAG, "Skipping audit log, MQTT not connected");
-        return;
+// Structured events are rendered here, off the caller's path
+static void publish_audit_record(const void *data, uint8_t type) {
+    if (type == AUDIT_EVENT) {
+        char json[TELEMETRY_AUDIT_JSON_MAX];
+        telemetry_audit_format(data, json, sizeof(json));
+        batch_audit(json, true);
+    } else {
+        batch_audit(data, false);
     }
-    ESP_LOGI(TAG, "Audit: %s", msg);
-    aws_mqtt_publish(CONFIG_TELEMETRY_AUDIT_TOPIC, msg, (int)strlen(msg), 1);
 }
 
 static void telemetry_task(void *arg) {
     ESP_LOGI(TAG, "Telemetry task started");
     TickType_t last_heartbeat_tick = xTaskGetTickCount();
+    TickType_t drain_ticks = pdMS_TO_TICKS(1000 / CONFIG_TELEMETRY_SPOOL_DRAIN_PER_S);
+    if (drain_ticks == 0) drain_ticks = 1;
 
     for (;;) {
-        // Wait for the next event: either a message in the audit queue or the heartbeat timer
-        char audit_msg[MAX_AUDIT_MSG_LEN];
+        // Wait for the next event: a message in the audit ring, a heartbeat request, the
+        // heartbeat timer, the end of the audit batch window, or the next spool drain step
         TickType_t ticks_to_wait = pdMS_TO_TICKS(CONFIG_TELEMETRY_HEARTBEAT_INTERVAL_S * 1000);
         TickType_t elapsed_ticks = xTaskGetTickCount() - last_heartbeat_tick;
         
@@ -99,57 +240,115 @@ static void telemetry_task(void *arg) {
         }
 
         ticks_to_wait -= elapsed_ticks;
+        // While the spool holds messages, poll for MQTT coming back and drain at its pace
+        if (!telemetry_spool_empty() && ticks_to_wait > drain_ticks) ticks_to_wait = drain_ticks;
+        if (!telemetry_batch_empty()) {
+            TickType_t batch_ticks = pdMS_TO_TICKS(telemetry_batch_wait_ms(now_ms()));
+            if (ticks_to_wait > batch_ticks) ticks_to_wait = batch_ticks;
+        }
 
-        if (xQueueReceive(s_audit_queue, audit_msg, ticks_to_wait) == pdPASS) {
-            publish_audit_log(audit_msg);
-        } else {
-            // Timeout occurred, time for a heartbeat
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, ticks_to_wait);
+        if (bits & NOTIFY_HEARTBEAT) {
             publish_heartbeat();
             last_heartbeat_tick = xTaskGetTickCount();
         }
+        const void *audit_rec;
+        uint8_t type;
+        while (telemetry_ring_peek(&s_audit_ring, &audit_rec, &type)) {
+            publish_audit_record(audit_rec, type);
+            telemetry_ring_release(&s_audit_ring);
+        }
+        if (telemetry_batch_due(now_ms())) flush_audit();
+        drain_spool();
     }
 }
 
 esp_err_t telemetry_init(void) {
-    s_audit_queue = xQueueCreate(AUDIT_QUEUE_LEN, MAX_AUDIT_MSG_LEN);
-    if (!s_audit_queue) {
-        ESP_LOGE(TAG, "Failed to create audit queue");
-        return ESP_ERR_NO_MEM;
+    if (s_task) return ESP_OK;
+    telemetry_ring_init(&s_audit_ring, s_audit_mem, sizeof(s_audit_mem));
+    telemetry_batch_init(CONFIG_TELEMETRY_AUDIT_BATCH_MS, CONFIG_TELEMETRY_AUDIT_BATCH_BYTES);
+
+    const telemetry_spool_cfg_t spool_cfg = {
+        .drain_per_s = CONFIG_TELEMETRY_SPOOL_DRAIN_PER_S,
+        .drain_burst = CONFIG_TELEMETRY_SPOOL_DRAIN_BURST,
+        .outbox_max = CONFIG_TELEMETRY_SPOOL_OUTBOX_MAX,
+        .outbox_bytes = spool_outbox,
+        .send = spool_send,
+    };
+    esp_err_t err = telemetry_spool_open(CONFIG_TELEMETRY_SPOOL_PARTITION, &spool_cfg);
+    s_spool_ok = err == ESP_OK;
+    if (!s_spool_ok) {
+        ESP_LOGW(TAG, "No offline spool on '%s' (%s): messages are dropped while MQTT is down",
+                 CONFIG_TELEMETRY_SPOOL_PARTITION, esp_err_to_name(err));
     }
 
-    BaseType_t r = xTaskCreate(telemetry_task, "telemetry_task", 4096, NULL, 3, NULL);
+    BaseType_t r = xTaskCreate(telemetry_task, "telemetry_task", 4096, NULL, 3, &s_task);
     if (r != pdPASS) {
-        vQueueDelete(s_audit_queue);
-        s_audit_queue = NULL;
+        s_task = NULL;
         return ESP_FAIL;
     }
     return ESP_OK;
 }
 
 esp_err_t telemetry_audit_log(const char *format, ...) {
-    if (!s_audit_queue) return ESP_ERR_INVALID_STATE;
+    if (!s_task) return ESP_ERR_INVALID_STATE;
     if (!format) return ESP_ERR_INVALID_ARG;
 
-    char msg[MAX_AUDIT_MSG_LEN];
+    // Formatted straight into the ring: room for the longest message, the rest is given
+    // back on commit. Short of that, room for exactly this one.
     va_list args;
     va_start(args, format);
-    int len = vsnprintf(msg, sizeof(msg), format, args);
+    size_t cap = MAX_AUDIT_MSG_LEN;
+    char *msg = telemetry_ring_reserve(&s_audit_ring, cap);
+    if (!msg) {
+        va_list again;
+        va_copy(again, args);
+        int need = vsnprintf(NULL, 0, format, again);
+        va_end(again);
+        if (need >= 0 && (size_t)need + 1 < cap) {
+            cap = (size_t)need + 1;
+            msg = telemetry_ring_reserve(&s_audit_ring, cap);
+        }
+    }
+    if (!msg) {
+        va_end(args);
+        return ESP_ERR_NO_MEM;
+    }
+    int len = vsnprintf(msg, cap, format, args);
     va_end(args);
 
     if (len < 0) {
+        telemetry_ring_commit(&s_audit_ring, msg, 0, AUDIT_TEXT);
         return ESP_FAIL;
     }
-    if (len >= sizeof(msg)) {
+    if ((size_t)len >= cap) {
         ESP_LOGW(TAG, "Audit message truncated");
+        len = (int)cap - 1;
     }
+    telemetry_ring_commit(&s_audit_ring, msg, (size_t)len + 1, AUDIT_TEXT);
+    xTaskNotify(s_task, NOTIFY_AUDIT, eSetBits);
+    return ESP_OK;
+}
 
-    if (xQueueSend(s_audit_queue, msg, pdMS_TO_TICKS(10)) != pdPASS) {
-        return ESP_ERR_TIMEOUT;
-    }
+esp_err_t telemetry_audit_event(uint8_t actor, telemetry_audit_event_t event, uint16_t arg0,
+                                int32_t arg1, int32_t arg2) {
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+    telemetry_audit_rec_t *rec = telemetry_ring_reserve(&s_audit_ring, sizeof(*rec));
+    if (!rec) return ESP_ERR_NO_MEM;
+    *rec = (telemetry_audit_rec_t){
+        .ts = (uint32_t)time(NULL), .actor = actor, .event = (uint8_t)event,
+        .arg0 = arg0, .arg1 = arg1, .arg2 = arg2,
+    };
+    telemetry_ring_commit(&s_audit_ring, rec, sizeof(*rec), AUDIT_EVENT);
+    xTaskNotify(s_task, NOTIFY_AUDIT, eSetBits);
     return ESP_OK;
 }
 
+// Published by telemetry_task, the only user of the spool, the batch and the heartbeat buffer
 esp_err_t telemetry_publish_heartbeat(void) {
-    return publish_heartbeat();
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+    xTaskNotify(s_task, NOTIFY_HEARTBEAT, eSetBits);
+    return ESP_OK;
 }
 
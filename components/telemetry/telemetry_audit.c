@@ -0,0 +1,58 @@
+#include "telemetry_audit.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+typedef struct {
+    const char *name;
+    const char *args[3];    // JSON key of arg0..arg2; NULL: not used by the event
+} event_desc_t;
+
+static const char *const s_actors[TELEMETRY_AUDIT_ACTORS] = {
+    "unknown", "ble", "schedule", "safety", "cloud",
+};
+
+static const event_desc_t s_events[TELEMETRY_AUDIT_EVENT_COUNT] = {
+    [TELEMETRY_AUDIT_OUTPUT]        = {"output", {"ch", "pct", "ramp_ms"}},
+    [TELEMETRY_AUDIT_CMD_STALE]     = {"cmd_stale", {"channels", "seq", "age_s"}},
+    [TELEMETRY_AUDIT_ESTOP]         = {"estop", {NULL, "latency_us", NULL}},
+    [TELEMETRY_AUDIT_BLE_SESSION]   = {"ble_session", {NULL, NULL, NULL}},
+    [TELEMETRY_AUDIT_BLE_CMD]       = {"ble_cmd", {"channels", "ctr", NULL}},
+    [TELEMETRY_AUDIT_BLE_REJECT]    = {"ble_reject", {"reason", NULL, NULL}},
+    [TELEMETRY_AUDIT_BLE_PROVISION] = {"ble_provision", {NULL, NULL, NULL}},
+    [TELEMETRY_AUDIT_OTA_START]     = {"ota_start", {NULL, "version", "current"}},
+    [TELEMETRY_AUDIT_OTA_FAIL]      = {"ota_fail", {"stage", "err", NULL}},
+    [TELEMETRY_AUDIT_SCHED_STEP]    = {"sched_step", {"channels", "pct", NULL}},
+    [TELEMETRY_AUDIT_SCHED_MISSED]  = {"sched_missed", {"ch", "pct", "at"}},
+};
+
+static const event_desc_t s_unknown = {NULL, {"arg0", "arg1", "arg2"}};
+
+// snprintf at the end of what is there, counting on past `cap` like one long snprintf
+static void append(char *buf, size_t cap, int *len, const char *fmt, ...)
+{
+    size_t pos = (size_t)*len < cap ? (size_t)*len : cap;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(cap ? buf + pos : NULL, cap - pos, fmt, args);
+    va_end(args);
+    if (n > 0) *len += n;
+}
+
+int telemetry_audit_format(const telemetry_audit_rec_t *rec, char *buf, size_t cap)
+{
+    int len = 0;
+    append(buf, cap, &len, "{\"ts\":%lu,\"actor\":", (unsigned long)rec->ts);
+    if (rec->actor < TELEMETRY_AUDIT_ACTORS) append(buf, cap, &len, "\"%s\"", s_actors[rec->actor]);
+    else append(buf, cap, &len, "%u", rec->actor);
+
+    const event_desc_t *ev = &s_unknown;
+    if (rec->event < TELEMETRY_AUDIT_EVENT_COUNT && s_events[rec->event].name) ev = &s_events[rec->event];
+    if (ev->name) append(buf, cap, &len, ",\"ev\":\"%s\"", ev->name);
+    else append(buf, cap, &len, ",\"ev\":%u", rec->event);
+
+    if (ev->args[0]) append(buf, cap, &len, ",\"%s\":%u", ev->args[0], rec->arg0);
+    if (ev->args[1]) append(buf, cap, &len, ",\"%s\":%ld", ev->args[1], (long)rec->arg1);
+    if (ev->args[2]) append(buf, cap, &len, ",\"%s\":%ld", ev->args[2], (long)rec->arg2);
+    append(buf, cap, &len, "}");
+    return len;
+}
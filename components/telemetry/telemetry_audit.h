@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "telemetry.h"
+
+// Structured audit records (internal to the telemetry component): what
+// telemetry_audit_event() puts into the audit ring, and their JSON rendering, done on
+// telemetry_task.
+
+typedef struct {
+    uint32_t ts;        // time(NULL) when recorded
+    uint8_t actor;      // ACTOR_*
+    uint8_t event;      // telemetry_audit_event_t
+    uint16_t arg0;
+    int32_t arg1;
+    int32_t arg2;
+} telemetry_audit_rec_t;
+
+_Static_assert(sizeof(telemetry_audit_rec_t) == 16, "audit record is 16 bytes");
+
+// Actor names, indexed by ACTOR_*
+#define TELEMETRY_AUDIT_ACTORS      5
+
+// Longest rendering of a record, NUL included
+#define TELEMETRY_AUDIT_JSON_MAX    128
+
+/**
+ * @brief Render a record as one JSON object with the event's own argument names, e.g.
+ * {"ts":1718000000,"actor":"ble","ev":"ble_cmd","channels":3,"ctr":17}. An unknown actor
+ * or event is written as its number, with the arguments as "arg0".."arg2".
+ *
+ * @return Length written (without the NUL), as snprintf.
+ */
+int telemetry_audit_format(const telemetry_audit_rec_t *rec, char *buf, size_t cap);
@@ -0,0 +1,145 @@
+#include "telemetry_batch.h"
+#include <string.h>
+
+#define PREFIX      "{\"audit\":["
+#define CLOSING     "]}"
+#define PREFIX_LEN  (sizeof(PREFIX) - 1)
+#define CLOSING_LEN (sizeof(CLOSING) - 1)
+
+static char s_buf[TELEMETRY_BATCH_MAX + 1];
+static size_t s_len;            // bytes in s_buf; 0: empty batch, nothing written yet
+static size_t s_max = TELEMETRY_BATCH_MAX;
+static uint32_t s_window_ms;
+static int64_t s_first_ms;      // when the first entry was added
+static bool s_finished;         // s_buf holds a closed payload
+static telemetry_batch_stats_t s_stats;
+
+esp_err_t telemetry_batch_init(uint32_t window_ms, size_t max_bytes)
+{
+    if (max_bytes < 64 || max_bytes > TELEMETRY_BATCH_MAX) return ESP_ERR_INVALID_ARG;
+    s_window_ms = window_ms;
+    s_max = max_bytes;
+    s_len = 0;
+    s_finished = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    return ESP_OK;
+}
+
+// `msg` as a JSON string at s_buf + pos, within `end`; the new position, 0 if it does not fit
+static size_t put_string(size_t pos, size_t end, const char *msg)
+{
+    static const char hex[] = "0123456789abcdef";
+    if (pos >= end) return 0;
+    s_buf[pos++] = '"';
+    for (const unsigned char *c = (const unsigned char *)msg; *c; ++c) {
+        char esc = 0;
+        switch (*c) {
+        case '"': esc = '"'; break;
+        case '\\': esc = '\\'; break;
+        case '\n': esc = 'n'; break;
+        case '\r': esc = 'r'; break;
+        case '\t': esc = 't'; break;
+        default: break;
+        }
+        if (esc) {
+            if (pos + 2 > end) return 0;
+            s_buf[pos++] = '\\';
+            s_buf[pos++] = esc;
+        } else if (*c < 0x20) {
+            if (pos + 6 > end) return 0;
+            memcpy(s_buf + pos, "\\u00", 4);
+            s_buf[pos + 4] = hex[*c >> 4];
+            s_buf[pos + 5] = hex[*c & 0xf];
+            pos += 6;
+        } else {
+            if (pos + 1 > end) return 0;
+            s_buf[pos++] = (char)*c;
+        }
+    }
+    if (pos + 1 > end) return 0;
+    s_buf[pos++] = '"';
+    return pos;
+}
+
+// `json` as is at s_buf + pos, within `end`; the new position, 0 if it does not fit
+static size_t put_raw(size_t pos, size_t end, const char *json)
+{
+    size_t n = strlen(json);
+    if (pos + n > end) return 0;
+    memcpy(s_buf + pos, json, n);
+    return pos + n;
+}
+
+static esp_err_t add_entry(const char *msg, bool raw, int64_t now_ms)
+{
+    if (!msg || (raw && !*msg)) return ESP_ERR_INVALID_ARG;
+    if (s_finished) {
+        s_finished = false;
+        s_len = 0;
+    }
+    bool first = s_len == 0;
+    size_t start = first ? PREFIX_LEN : s_len + 1;      // after the comma
+    // Room is kept for the closing
+    size_t end = s_max - CLOSING_LEN;
+    size_t pos = raw ? put_raw(start, end, msg) : put_string(start, end, msg);
+    if (!pos) {
+        if (first) {
+            s_stats.dropped++;
+            return ESP_ERR_INVALID_SIZE;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    if (first) {
+        memcpy(s_buf, PREFIX, PREFIX_LEN);
+        s_first_ms = now_ms;
+    } else {
+        s_buf[s_len] = ',';
+    }
+    s_len = pos;
+    s_stats.entries++;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_batch_add(const char *msg, int64_t now_ms)
+{
+    return add_entry(msg, false, now_ms);
+}
+
+esp_err_t telemetry_batch_add_json(const char *json, int64_t now_ms)
+{
+    return add_entry(json, true, now_ms);
+}
+
+bool telemetry_batch_empty(void)
+{
+    return s_finished || s_len == 0;
+}
+
+int64_t telemetry_batch_wait_ms(int64_t now_ms)
+{
+    if (telemetry_batch_empty()) return INT64_MAX;
+    int64_t left = s_first_ms + s_window_ms - now_ms;
+    return left > 0 ? left : 0;
+}
+
+bool telemetry_batch_due(int64_t now_ms)
+{
+    return telemetry_batch_wait_ms(now_ms) == 0;
+}
+
+const char *telemetry_batch_finish(size_t *len)
+{
+    if (telemetry_batch_empty()) return NULL;
+    memcpy(s_buf + s_len, CLOSING, CLOSING_LEN);
+    s_len += CLOSING_LEN;
+    s_buf[s_len] = '\0';
+    s_finished = true;
+    s_stats.batches++;
+    if (len) *len = s_len;
+    return s_buf;
+}
+
+void telemetry_batch_get_stats(telemetry_batch_stats_t *out)
+{
+    if (out) *out = s_stats;
+}
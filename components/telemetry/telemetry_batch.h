@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Audit batcher (internal to the telemetry component): audit entries gathered over a short
+// window, or until a byte budget, go out as one MQTT message instead of one each:
+//
+//   {"audit":["entry 1","entry 2",{"ts":...,"ev":"output",...},...]}
+//
+// Text entries are JSON-escaped in place into a static buffer, structured ones are added as
+// JSON values already rendered: no allocation. The caller passes the time.
+//
+// Single caller (telemetry_task): no locking.
+
+#define TELEMETRY_BATCH_MAX     1024    // largest payload, prefix and closing included
+
+typedef struct {
+    uint32_t entries;       // entries added
+    uint32_t batches;       // payloads finished
+    uint32_t dropped;       // entries too long for an empty batch
+} telemetry_batch_stats_t;
+
+/**
+ * @brief Start over with an empty batch.
+ *
+ * @param window_ms Longest an entry waits for others: the batch is due this long after its
+ *        first entry.
+ * @param max_bytes Payload budget (64..TELEMETRY_BATCH_MAX).
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a budget out of range.
+ */
+esp_err_t telemetry_batch_init(uint32_t window_ms, size_t max_bytes);
+
+/**
+ * @brief Add an entry.
+ *
+ * @return ESP_OK; ESP_ERR_NO_MEM if it does not fit what the batch holds already (finish
+ *         the batch and add it again); ESP_ERR_INVALID_SIZE if it would not fit an empty
+ *         batch either (dropped, counted).
+ */
+esp_err_t telemetry_batch_add(const char *msg, int64_t now_ms);
+
+// Add a JSON value (e.g. an object) as is; same results as telemetry_batch_add
+esp_err_t telemetry_batch_add_json(const char *json, int64_t now_ms);
+
+bool telemetry_batch_empty(void);
+
+// True when the window of the first entry is over
+bool telemetry_batch_due(int64_t now_ms);
+
+// Milliseconds until the batch is due: 0 if it is, INT64_MAX if it is empty
+int64_t telemetry_batch_wait_ms(int64_t now_ms);
+
+/**
+ * @brief Close the batch and return its payload (NUL-terminated, `*len` bytes without the
+ * NUL), valid until the next add or finish; the next add starts a new batch.
+ *
+ * @return NULL if the batch is empty.
+ */
+const char *telemetry_batch_finish(size_t *len);
+
+void telemetry_batch_get_stats(telemetry_batch_stats_t *out);
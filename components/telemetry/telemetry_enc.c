@@ -0,0 +1,111 @@
+#include "telemetry_enc.h"
+#include <string.h>
+
+#define CBOR_UINT       0
+#define CBOR_NEGINT     1
+#define CBOR_TEXT       3
+#define CBOR_MAP_INDEF  0xbf
+#define CBOR_BREAK      0xff
+
+static void put(telemetry_enc_t *e, const void *data, size_t n)
+{
+    if (e->overflow || n > e->cap - e->len) {
+        e->overflow = true;
+        return;
+    }
+    memcpy(e->buf + e->len, data, n);
+    e->len += n;
+}
+
+static void put_byte(telemetry_enc_t *e, uint8_t b)
+{
+    put(e, &b, 1);
+}
+
+// CBOR item head: major type and argument, in the shortest form
+static void cbor_head(telemetry_enc_t *e, uint8_t major, uint64_t v)
+{
+    uint8_t h[9];
+    size_t n;
+    if (v < 24) {
+        h[0] = (uint8_t)(major << 5 | v);
+        n = 1;
+    } else {
+        int bytes = v <= 0xff ? 1 : v <= 0xffff ? 2 : v <= 0xffffffff ? 4 : 8;
+        h[0] = (uint8_t)(major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+        for (int i = 0; i < bytes; ++i) h[1 + i] = (uint8_t)(v >> (8 * (bytes - 1 - i)));
+        n = 1 + (size_t)bytes;
+    }
+    put(e, h, n);
+}
+
+static void json_digits(telemetry_enc_t *e, uint64_t v)
+{
+    char d[20];
+    size_t n = 0;
+    do {
+        d[sizeof(d) - 1 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    put(e, d + sizeof(d) - n, n);
+}
+
+static void key(telemetry_enc_t *e, const char *k)
+{
+    size_t n = strlen(k);
+    if (e->format == TELEMETRY_ENC_CBOR) {
+        cbor_head(e, CBOR_TEXT, n);
+        put(e, k, n);
+    } else {
+        if (!e->first) put_byte(e, ',');
+        put_byte(e, '"');
+        put(e, k, n);
+        put(e, "\":", 2);
+    }
+    e->first = false;
+}
+
+void telemetry_enc_begin(telemetry_enc_t *e, telemetry_enc_format_t format, void *buf, size_t cap)
+{
+    *e = (telemetry_enc_t){.buf = buf, .cap = buf ? cap : 0, .format = format, .first = true};
+    put_byte(e, format == TELEMETRY_ENC_CBOR ? CBOR_MAP_INDEF : '{');
+}
+
+void telemetry_enc_uint(telemetry_enc_t *e, const char *k, uint64_t v)
+{
+    key(e, k);
+    if (e->format == TELEMETRY_ENC_CBOR) cbor_head(e, CBOR_UINT, v);
+    else json_digits(e, v);
+}
+
+void telemetry_enc_int(telemetry_enc_t *e, const char *k, int64_t v)
+{
+    if (v >= 0) {
+        telemetry_enc_uint(e, k, (uint64_t)v);
+        return;
+    }
+    key(e, k);
+    // -1 - v without overflow at INT64_MIN
+    uint64_t m = (uint64_t)(-(v + 1));
+    if (e->format == TELEMETRY_ENC_CBOR) {
+        cbor_head(e, CBOR_NEGINT, m);
+    } else {
+        put_byte(e, '-');
+        json_digits(e, m + 1);
+    }
+}
+
+esp_err_t telemetry_enc_end(telemetry_enc_t *e, size_t *len)
+{
+    if (e->format == TELEMETRY_ENC_CBOR) {
+        put_byte(e, CBOR_BREAK);
+    } else {
+        put_byte(e, '}');
+        // The NUL goes after the object, without counting it
+        if (!e->overflow && e->len < e->cap) e->buf[e->len] = '\0';
+        else e->overflow = true;
+    }
+    if (e->overflow) return ESP_ERR_INVALID_SIZE;
+    if (len) *len = e->len;
+    return ESP_OK;
+}
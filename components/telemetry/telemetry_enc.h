@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Streaming encoder for flat telemetry objects (internal to the telemetry component): keys
+// and integer values written straight into a caller's buffer, as compact JSON
+//
+//   {"ts":1718000000,"uptime_s":42,"wifi_rssi":-61}
+//
+// or as a CBOR map (RFC 8949) of text keys to integers, indefinite length so nothing is
+// patched afterwards. No allocation and no printf.
+//
+// Keys are written as is: plain ASCII without quotes or backslashes.
+
+typedef enum {
+    TELEMETRY_ENC_JSON = 0,
+    TELEMETRY_ENC_CBOR = 1,
+} telemetry_enc_format_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    telemetry_enc_format_t format;
+    bool first;         // no key written yet
+    bool overflow;      // something did not fit; the output is unusable
+} telemetry_enc_t;
+
+// Start an object in `buf` (`cap` bytes)
+void telemetry_enc_begin(telemetry_enc_t *e, telemetry_enc_format_t format, void *buf, size_t cap);
+
+void telemetry_enc_uint(telemetry_enc_t *e, const char *key, uint64_t v);
+void telemetry_enc_int(telemetry_enc_t *e, const char *key, int64_t v);
+
+/**
+ * @brief Close the object. JSON is NUL-terminated (not counted in `len`).
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if the buffer was too small.
+ */
+esp_err_t telemetry_enc_end(telemetry_enc_t *e, size_t *len);
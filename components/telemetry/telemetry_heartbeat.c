@@ -0,0 +1,41 @@
+#include "telemetry_heartbeat.h"
+
+esp_err_t telemetry_heartbeat_encode(const telemetry_heartbeat_t *hb, telemetry_enc_format_t format,
+                                     void *buf, size_t cap, size_t *len)
+{
+    telemetry_enc_t e;
+    telemetry_enc_begin(&e, format, buf, cap);
+    telemetry_enc_int(&e, "ts", hb->ts);
+    telemetry_enc_uint(&e, "uptime_s", hb->uptime_s);
+    telemetry_enc_uint(&e, "reset_reason", hb->reset_reason);
+    telemetry_enc_uint(&e, "min_free_heap", hb->min_free_heap);
+    telemetry_enc_int(&e, "wifi_rssi", hb->wifi_rssi);
+    if (hb->next_on_utc > 0) telemetry_enc_int(&e, "next_on_utc", hb->next_on_utc);
+    if (hb->next_off_utc > 0) telemetry_enc_int(&e, "next_off_utc", hb->next_off_utc);
+    if (hb->has_mbox) {
+        telemetry_enc_uint(&e, "cmd_coalesced", hb->cmd_coalesced);
+        telemetry_enc_uint(&e, "cmd_dropped", hb->cmd_dropped);
+        telemetry_enc_uint(&e, "cmd_deferred", hb->cmd_deferred);
+        telemetry_enc_uint(&e, "cmd_redundant", hb->cmd_redundant);
+    }
+    if (hb->has_sched) {
+        telemetry_enc_uint(&e, "sched_wakeups", hb->sched_wakeups);
+        telemetry_enc_uint(&e, "sched_cpu_us", hb->sched_cpu_us);
+        telemetry_enc_uint(&e, "pump_late_max_us", hb->pump_late_max_us);
+    }
+    if (hb->estop_count) {
+        telemetry_enc_uint(&e, "estop_count", hb->estop_count);
+        telemetry_enc_uint(&e, "estop_worst_us", hb->estop_worst_us);
+    }
+    if (hb->has_spool) {
+        telemetry_enc_uint(&e, "spool_pending", hb->spool_pending);
+        telemetry_enc_uint(&e, "spool_dropped", hb->spool_dropped);
+    }
+    telemetry_enc_uint(&e, "audit_entries", hb->audit_entries);
+    telemetry_enc_uint(&e, "audit_batches", hb->audit_batches);
+    telemetry_enc_uint(&e, "audit_ring_peak", hb->audit_ring_peak);
+    telemetry_enc_uint(&e, "audit_ring_full", hb->audit_ring_full);
+    telemetry_enc_uint(&e, "mqtt_msgs_per_h", hb->mqtt_msgs_per_h);
+    telemetry_enc_uint(&e, "mqtt_bytes_per_h", hb->mqtt_bytes_per_h);
+    return telemetry_enc_end(&e, len);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry_enc.h"
+
+// Heartbeat payload (internal to the telemetry component): telemetry.c fills a snapshot
+// from counters other components keep in RAM, this encodes it.
+
+typedef struct {
+    int64_t ts;                 // time(NULL)
+    uint64_t uptime_s;
+    uint32_t reset_reason;      // esp_reset_reason_t
+    uint32_t min_free_heap;
+    int8_t wifi_rssi;           // 127: not associated
+    int64_t next_on_utc;        // 0: not known, omitted
+    int64_t next_off_utc;
+
+    bool has_mbox;
+    uint32_t cmd_coalesced, cmd_dropped, cmd_deferred, cmd_redundant;
+
+    bool has_sched;
+    uint32_t sched_wakeups;
+    uint64_t sched_cpu_us;
+    uint32_t pump_late_max_us;
+
+    uint32_t estop_count;       // 0: omitted with estop_worst_us
+    uint32_t estop_worst_us;
+
+    bool has_spool;
+    uint32_t spool_pending, spool_dropped;
+
+    uint32_t audit_entries, audit_batches;
+    uint32_t audit_ring_peak, audit_ring_full;
+    uint32_t mqtt_msgs_per_h, mqtt_bytes_per_h;
+} telemetry_heartbeat_t;
+
+// Largest heartbeat, either format: every field at its widest fits
+#define TELEMETRY_HEARTBEAT_MAX     768
+
+/**
+ * @brief Encode `hb` into `buf` (JSON NUL-terminated, see telemetry_enc_end()).
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if `cap` is too small.
+ */
+esp_err_t telemetry_heartbeat_encode(const telemetry_heartbeat_t *hb, telemetry_enc_format_t format,
+                                     void *buf, size_t cap, size_t *len);
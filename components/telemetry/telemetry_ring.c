@@ -0,0 +1,134 @@
+#include "telemetry_ring.h"
+#include <string.h>
+
+// Header: ready bit, padding bit, record size in 4-byte words, record type, payload length
+#define HDR_SIZE        4
+#define HDR_READY       (1u << 31)
+#define HDR_PAD         (1u << 30)
+#define HDR_WORDS(h)    (((h) >> 16) & 0x3fff)
+#define HDR_TYPE(h)     (((h) >> 14) & 0x3)
+#define HDR_LEN(h)      ((h) & 0x3fff)
+
+static uint32_t rec_size(size_t len)
+{
+    return (uint32_t)((HDR_SIZE + len + 3) & ~(size_t)3);
+}
+
+static _Atomic uint32_t *hdr_at(telemetry_ring_t *r, uint32_t pos)
+{
+    return (_Atomic uint32_t *)(r->buf + (pos & (r->size - 1)));
+}
+
+esp_err_t telemetry_ring_init(telemetry_ring_t *r, void *buf, size_t size)
+{
+    if (!r || !buf || ((uintptr_t)buf & 3) || size < 64 || size > 32768 || (size & (size - 1))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(buf, 0, size);
+    r->buf = buf;
+    r->size = (uint32_t)size;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->refused, 0);
+    atomic_init(&r->peak, 0);
+    return ESP_OK;
+}
+
+void *telemetry_ring_reserve(telemetry_ring_t *r, size_t len)
+{
+    if (len == 0 || rec_size(len) > r->size / 2) return NULL;
+    uint32_t need = rec_size(len);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t pad, used;
+    do {
+        // Acquire: the consumer zeroed what it released before moving the tail
+        uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        uint32_t off = head & (r->size - 1);
+        pad = off + need > r->size ? r->size - off : 0;
+        used = head + pad + need - tail;
+        if (used > r->size) {
+            atomic_fetch_add_explicit(&r->refused, 1, memory_order_relaxed);
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&r->head, &head, head + pad + need,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+
+    uint32_t peak = atomic_load_explicit(&r->peak, memory_order_relaxed);
+    while (used > peak && !atomic_compare_exchange_weak_explicit(&r->peak, &peak, used,
+                                                                 memory_order_relaxed,
+                                                                 memory_order_relaxed)) {
+    }
+    if (pad) {
+        atomic_store_explicit(hdr_at(r, head), HDR_READY | HDR_PAD | (pad / 4) << 16,
+                              memory_order_release);
+    }
+    // Size only, not ready: the consumer waits here until the commit
+    uint32_t pos = head + pad;
+    atomic_store_explicit(hdr_at(r, pos), (need / 4) << 16, memory_order_relaxed);
+    return r->buf + (pos & (r->size - 1)) + HDR_SIZE;
+}
+
+void telemetry_ring_commit(telemetry_ring_t *r, void *p, size_t len, uint8_t type)
+{
+    uint8_t *rec = (uint8_t *)p - HDR_SIZE;
+    _Atomic uint32_t *hdr = (_Atomic uint32_t *)rec;
+    uint32_t size = HDR_WORDS(atomic_load_explicit(hdr, memory_order_relaxed)) * 4;
+    if (len > size - HDR_SIZE) len = size - HDR_SIZE;
+
+    uint32_t used = rec_size(len);
+    if (len && used < size) {
+        // Nothing reserved behind this record: give the rest back. Its bytes are zeroed
+        // first, the next reservation may put a header there. The head can only be at
+        // this record's end if it is ours: the record is not released, so the head is
+        // less than a ring size past its start.
+        uint32_t end = (uint32_t)(rec - r->buf) + size;
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        if (((head ^ end) & (r->size - 1)) == 0) {
+            memset(rec + HDR_SIZE + len, 0, size - HDR_SIZE - len);
+            if (atomic_compare_exchange_strong_explicit(&r->head, &head, head - (size - used),
+                                                        memory_order_release, memory_order_relaxed)) {
+                size = used;
+            }
+        }
+    }
+    atomic_store_explicit(hdr, HDR_READY | (size / 4) << 16 | (uint32_t)(type & 0x3) << 14 | (uint32_t)len,
+                          memory_order_release);
+}
+
+// Consumer: zero `size` bytes at the tail and give them back
+static void release_bytes(telemetry_ring_t *r, uint32_t tail, uint32_t size)
+{
+    memset(r->buf + (tail & (r->size - 1)), 0, size);
+    atomic_store_explicit(&r->tail, tail + size, memory_order_release);
+}
+
+size_t telemetry_ring_peek(telemetry_ring_t *r, const void **data, uint8_t *type)
+{
+    for (;;) {
+        uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        if (tail == atomic_load_explicit(&r->head, memory_order_acquire)) return 0;
+        uint32_t h = atomic_load_explicit(hdr_at(r, tail), memory_order_acquire);
+        if (!(h & HDR_READY)) return 0;
+        if ((h & HDR_PAD) || HDR_LEN(h) == 0) {
+            release_bytes(r, tail, HDR_WORDS(h) * 4);
+            continue;
+        }
+        *data = r->buf + (tail & (r->size - 1)) + HDR_SIZE;
+        if (type) *type = (uint8_t)HDR_TYPE(h);
+        return HDR_LEN(h);
+    }
+}
+
+void telemetry_ring_release(telemetry_ring_t *r)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t h = atomic_load_explicit(hdr_at(r, tail), memory_order_relaxed);
+    if (h & HDR_READY) release_bytes(r, tail, HDR_WORDS(h) * 4);
+}
+
+void telemetry_ring_get_stats(telemetry_ring_t *r, telemetry_ring_stats_t *out)
+{
+    out->used = atomic_load(&r->head) - atomic_load(&r->tail);
+    out->peak = atomic_load(&r->peak);
+    out->refused = atomic_load(&r->refused);
+}
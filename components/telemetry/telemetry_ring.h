@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+// Variable-length message ring (internal to the telemetry component): any number of
+// producers, one consumer, no locks. A record takes a 4-byte header and its payload rounded
+// up to 4 bytes, so a 40-byte message costs 44 bytes rather than a fixed-size slot. The
+// header also carries a 2-bit record type for the consumer.
+//
+// Producers reserve room with a compare-and-swap on the head, write the payload in place
+// (e.g. vsnprintf straight into the ring), then commit it, possibly shorter than reserved:
+// if nothing was reserved behind it the rest goes back to the ring. Records are consumed in
+// reservation order; one reserved and not yet committed holds back the ones after it.
+// Records never wrap: one that does not fit before the end of the buffer is placed at its
+// start, behind a padding record.
+//
+// The consumer reads a record in place and releases it, which zeroes its bytes: a header
+// that reads zero (or without the ready bit) is one not committed yet.
+
+typedef struct {
+    uint8_t *buf;               // `size` bytes, 4-byte aligned
+    uint32_t size;              // power of two
+    _Atomic uint32_t head;      // end of the last reservation, free-running
+    _Atomic uint32_t tail;      // start of the oldest record not released, free-running
+    _Atomic uint32_t refused;   // reservations refused: ring full
+    _Atomic uint32_t peak;      // most bytes in use at once
+} telemetry_ring_t;
+
+typedef struct {
+    uint32_t used;      // bytes in use now
+    uint32_t peak;
+    uint32_t refused;
+} telemetry_ring_stats_t;
+
+/**
+ * @brief Set up a ring on `buf`.
+ *
+ * @param size Power of two, 64..32768 bytes; `buf` 4-byte aligned.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG otherwise.
+ */
+esp_err_t telemetry_ring_init(telemetry_ring_t *r, void *buf, size_t size);
+
+/**
+ * @brief Reserve room for a payload of `len` bytes (1..size/2 - 4). Any task; does not block.
+ *
+ * @return Where to write it (4-byte aligned), NULL if the ring is full (counted as refused).
+ */
+void *telemetry_ring_reserve(telemetry_ring_t *r, size_t len);
+
+// Publish a reserved record with its first `len` bytes (at most the reserved length) and
+// `type` (0..3); `len` 0 discards it
+void telemetry_ring_commit(telemetry_ring_t *r, void *p, size_t len, uint8_t type);
+
+// Consumer: the oldest committed record and its type (`type` may be NULL), read in place
+// until released. 0 if there is none (or the oldest one is not committed yet).
+size_t telemetry_ring_peek(telemetry_ring_t *r, const void **data, uint8_t *type);
+
+// Consumer: free the record returned by the last peek
+void telemetry_ring_release(telemetry_ring_t *r);
+
+void telemetry_ring_get_stats(telemetry_ring_t *r, telemetry_ring_stats_t *out);
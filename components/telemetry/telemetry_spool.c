@@ -0,0 +1,331 @@
+#include "telemetry_spool.h"
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+
+static const char *TAG = "spool";
+
+// Sector: header, then entries back to back (4-byte aligned) up to the first erased
+// length. The sector with the highest sequence number is the one being appended to; the
+// live ones are it and its predecessors with consecutive numbers.
+#define SECTOR_SIZE     4096
+#define SECTOR_MAGIC    0x4C4F5053      // "SPOL"
+#define ENTRY_ALIGN     4
+#define LEN_ERASED      0xFFFF
+#define SENT_PENDING    0xFF
+#define SENT_DONE       0x00
+
+// The magic goes last: a header torn halfway does not look valid
+typedef struct {
+    uint32_t seq;
+    uint32_t magic;
+} sector_hdr_t;
+
+typedef struct {
+    uint16_t len;       // payload bytes
+    uint8_t kind;
+    uint8_t sent;       // SENT_PENDING as written, cleared to SENT_DONE once sent
+    uint32_t crc;       // over len, kind and the payload
+} entry_hdr_t;
+
+typedef struct {
+    uint32_t sector;
+    uint32_t off;
+} pos_t;
+
+typedef enum { ENTRY_OK, ENTRY_END, ENTRY_BAD } entry_state_t;
+
+static const esp_partition_t *s_part;
+static telemetry_spool_cfg_t s_cfg;
+static uint32_t s_sectors;
+static uint32_t s_seq;          // of the head sector
+static pos_t s_head;            // where the next entry goes
+static pos_t s_tail;            // oldest entry that may still be pending
+static telemetry_spool_stats_t s_stats;
+static int64_t s_last_ms;
+static bool s_paced;            // s_last_ms is set
+static uint64_t s_tokens;       // drain allowance, in 1/1000 entries
+// One entry, as written or read back
+static uint8_t s_buf[sizeof(entry_hdr_t) + TELEMETRY_SPOOL_MAX_PAYLOAD];
+
+static size_t entry_size(size_t len)
+{
+    return (sizeof(entry_hdr_t) + len + ENTRY_ALIGN - 1) & ~(size_t)(ENTRY_ALIGN - 1);
+}
+
+static size_t addr(pos_t p)
+{
+    return (size_t)p.sector * SECTOR_SIZE + p.off;
+}
+
+static uint32_t next_sector(uint32_t sector)
+{
+    return (sector + 1) % s_sectors;
+}
+
+static uint32_t entry_crc(const entry_hdr_t *h, const void *payload)
+{
+    uint32_t crc = esp_crc32_le(0, (const uint8_t *)h, offsetof(entry_hdr_t, sent));
+    return esp_crc32_le(crc, payload, h->len);
+}
+
+// Entry at `p`; with `verify` its payload is read into s_buf and checked
+static entry_state_t read_entry(pos_t p, entry_hdr_t *h, bool verify)
+{
+    if (p.off + sizeof(*h) > SECTOR_SIZE) return ENTRY_END;
+    if (esp_partition_read(s_part, addr(p), h, sizeof(*h)) != ESP_OK) return ENTRY_BAD;
+    if (h->len == LEN_ERASED) return ENTRY_END;
+    if (h->len == 0 || h->len > TELEMETRY_SPOOL_MAX_PAYLOAD || p.off + entry_size(h->len) > SECTOR_SIZE) {
+        return ENTRY_BAD;
+    }
+    if (!verify) return ENTRY_OK;
+    if (esp_partition_read(s_part, addr(p) + sizeof(*h), s_buf, h->len) != ESP_OK) return ENTRY_BAD;
+    return entry_crc(h, s_buf) == h->crc ? ENTRY_OK : ENTRY_BAD;
+}
+
+static bool read_sector_hdr(uint32_t sector, sector_hdr_t *h)
+{
+    return esp_partition_read(s_part, (size_t)sector * SECTOR_SIZE, h, sizeof(*h)) == ESP_OK &&
+           h->magic == SECTOR_MAGIC;
+}
+
+// Nothing written from `p` to the end of its sector: appending there is safe
+static bool erased_from(pos_t p)
+{
+    while (p.off < SECTOR_SIZE) {
+        size_t n = SECTOR_SIZE - p.off < sizeof(s_buf) ? SECTOR_SIZE - p.off : sizeof(s_buf);
+        if (esp_partition_read(s_part, addr(p), s_buf, n) != ESP_OK) return false;
+        for (size_t i = 0; i < n; ++i) {
+            if (s_buf[i] != 0xff) return false;
+        }
+        p.off += n;
+    }
+    return true;
+}
+
+// --- Mount ---
+
+// Walk the entries of the live sectors, oldest first: count the pending ones, find the
+// first of them and where the head sector ends
+static void scan(uint32_t oldest)
+{
+    bool have_tail = false;
+    for (uint32_t sector = oldest;; sector = next_sector(sector)) {
+        pos_t p = { sector, sizeof(sector_hdr_t) };
+        entry_hdr_t h;
+        entry_state_t st;
+        while ((st = read_entry(p, &h, true)) == ENTRY_OK) {
+            if (h.sent == SENT_PENDING) {
+                if (!have_tail) s_tail = p;
+                have_tail = true;
+                s_stats.pending++;
+            }
+            p.off += entry_size(h.len);
+        }
+        if (sector == s_head.sector) {
+            // A torn append leaves the rest of its sector unusable
+            s_head.off = st == ENTRY_END && erased_from(p) ? p.off : SECTOR_SIZE;
+            break;
+        }
+    }
+    if (!have_tail) s_tail = s_head;
+}
+
+esp_err_t telemetry_spool_open(const char *label, const telemetry_spool_cfg_t *cfg)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!s_part) return ESP_ERR_NOT_FOUND;
+    s_sectors = s_part->size / SECTOR_SIZE;
+    if (s_sectors < 2) {
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_cfg = *cfg;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_paced = false;
+
+    // Head: the highest sequence number
+    bool found = false;
+    for (uint32_t i = 0; i < s_sectors; ++i) {
+        sector_hdr_t h;
+        if (read_sector_hdr(i, &h) && (!found || (int32_t)(h.seq - s_seq) > 0)) {
+            s_seq = h.seq;
+            s_head.sector = i;
+            found = true;
+        }
+    }
+    if (!found) {
+        // Blank: the first append opens sector 0
+        s_seq = 0;
+        s_head = (pos_t){ s_sectors - 1, SECTOR_SIZE };
+        s_tail = s_head;
+        ESP_LOGI(TAG, "Spool on '%s' empty (%u sectors)", label, (unsigned)s_sectors);
+        return ESP_OK;
+    }
+
+    // Back from the head while the numbers are consecutive
+    uint32_t oldest = s_head.sector;
+    uint32_t seq = s_seq;
+    for (uint32_t i = 1; i < s_sectors; ++i) {
+        uint32_t prev = (oldest + s_sectors - 1) % s_sectors;
+        sector_hdr_t h;
+        if (!read_sector_hdr(prev, &h) || h.seq != seq - 1) break;
+        oldest = prev;
+        seq = h.seq;
+    }
+    scan(oldest);
+    ESP_LOGI(TAG, "Spool on '%s': %u entries pending", label, (unsigned)s_stats.pending);
+    return ESP_OK;
+}
+
+void telemetry_spool_close(void)
+{
+    s_part = NULL;
+}
+
+// --- Append ---
+
+// Pending entries of the tail sector are lost: count them and move the tail past it
+static void drop_tail_sector(void)
+{
+    pos_t p = s_tail;
+    entry_hdr_t h;
+    uint32_t lost = 0;
+    while (read_entry(p, &h, false) == ENTRY_OK) {
+        if (h.sent == SENT_PENDING) lost++;
+        p.off += entry_size(h.len);
+    }
+    if (lost > s_stats.pending) lost = s_stats.pending;
+    s_stats.pending -= lost;
+    s_stats.dropped += lost;
+    s_tail = (pos_t){ next_sector(s_tail.sector), sizeof(sector_hdr_t) };
+    ESP_LOGW(TAG, "Spool full, %u oldest entries dropped", (unsigned)lost);
+}
+
+static esp_err_t open_next_sector(void)
+{
+    uint32_t next = next_sector(s_head.sector);
+    if (s_stats.pending && s_tail.sector == next) drop_tail_sector();
+
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)next * SECTOR_SIZE, SECTOR_SIZE);
+    s_stats.erases++;
+    if (err != ESP_OK) return err;
+    sector_hdr_t h = { .seq = s_seq + 1, .magic = SECTOR_MAGIC };
+    err = esp_partition_write(s_part, (size_t)next * SECTOR_SIZE, &h, sizeof(h));
+    s_stats.writes++;
+    if (err != ESP_OK) return err;
+    s_seq = h.seq;
+    s_head = (pos_t){ next, sizeof(h) };
+    return ESP_OK;
+}
+
+esp_err_t telemetry_spool_append(uint8_t kind, const void *data, size_t len)
+{
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+    if (!data || len == 0 || len > TELEMETRY_SPOOL_MAX_PAYLOAD) return ESP_ERR_INVALID_ARG;
+    size_t size = entry_size(len);
+    if (s_head.off + size > SECTOR_SIZE) {
+        esp_err_t err = open_next_sector();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open a spool sector: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    entry_hdr_t h = { .len = (uint16_t)len, .kind = kind, .sent = SENT_PENDING };
+    h.crc = entry_crc(&h, data);
+    memcpy(s_buf, &h, sizeof(h));
+    memcpy(s_buf + sizeof(h), data, len);
+    memset(s_buf + sizeof(h) + len, 0xff, size - sizeof(h) - len);
+    esp_err_t err = esp_partition_write(s_part, addr(s_head), s_buf, size);
+    s_stats.writes++;
+    if (err != ESP_OK) {
+        // Whatever reached flash is not appendable: continue in the next sector
+        s_head.off = SECTOR_SIZE;
+        return err;
+    }
+    if (s_stats.pending == 0) s_tail = s_head;
+    s_head.off += size;
+    s_stats.pending++;
+    s_stats.appended++;
+    return ESP_OK;
+}
+
+bool telemetry_spool_empty(void)
+{
+    return !s_part || s_stats.pending == 0;
+}
+
+// --- Drain ---
+
+// Move the tail to the oldest pending entry and read it into s_buf
+static bool next_pending(entry_hdr_t *h)
+{
+    while (s_stats.pending) {
+        bool at_head = s_tail.sector == s_head.sector && s_tail.off >= s_head.off;
+        entry_state_t st = at_head ? ENTRY_END : read_entry(s_tail, h, true);
+        if (st == ENTRY_OK) {
+            if (h->sent == SENT_PENDING) return true;
+            s_tail.off += entry_size(h->len);
+        } else if (s_tail.sector != s_head.sector) {
+            // End of the sector, or a corrupt entry and with it the rest of the sector
+            s_tail = (pos_t){ next_sector(s_tail.sector), sizeof(sector_hdr_t) };
+        } else {
+            // Corrupted since the mount: what was counted is gone
+            s_stats.dropped += s_stats.pending;
+            s_stats.pending = 0;
+        }
+    }
+    return false;
+}
+
+static void refill(int64_t now_ms)
+{
+    uint32_t burst = s_cfg.drain_burst ? s_cfg.drain_burst : 1;
+    uint64_t cap = (uint64_t)burst * 1000;
+    if (!s_paced) {
+        s_tokens = cap;
+    } else if (now_ms > s_last_ms) {
+        uint64_t elapsed = (uint64_t)(now_ms - s_last_ms);
+        s_tokens = elapsed >= cap ? cap : s_tokens + elapsed * s_cfg.drain_per_s;
+        if (s_tokens > cap) s_tokens = cap;
+    }
+    s_last_ms = now_ms;
+    s_paced = true;
+}
+
+uint32_t telemetry_spool_drain(int64_t now_ms)
+{
+    if (!s_part || !s_cfg.send) return 0;
+    refill(now_ms);
+    uint32_t sent = 0;
+    entry_hdr_t h;
+    while (s_tokens >= 1000 && next_pending(&h)) {
+        if (s_cfg.outbox_bytes && s_cfg.outbox_bytes(s_cfg.arg) >= s_cfg.outbox_max) {
+            s_stats.backpressure++;
+            break;
+        }
+        if (s_cfg.send(h.kind, s_buf, h.len, s_cfg.arg) != ESP_OK) break;
+        uint8_t done = SENT_DONE;
+        esp_err_t err = esp_partition_write(s_part, addr(s_tail) + offsetof(entry_hdr_t, sent), &done, 1);
+        s_stats.writes++;
+        s_tail.off += entry_size(h.len);
+        s_stats.pending--;
+        s_stats.sent++;
+        s_tokens -= 1000;
+        sent++;
+        if (err != ESP_OK) {
+            // At least once: unmarked, the entry is sent again after a reset. Stop here so
+            // it is the only one.
+            ESP_LOGW(TAG, "Failed to mark a spool entry sent: %s", esp_err_to_name(err));
+            break;
+        }
+    }
+    return sent;
+}
+
+void telemetry_spool_get_stats(telemetry_spool_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Store-and-forward spool (internal to the telemetry component): messages that cannot be
+// published while MQTT is down are appended to a ring of flash sectors on a data partition
+// and sent, oldest first, once it is back. Only esp_partition calls touch flash, so the
+// spool runs on the host against a file-backed partition.
+//
+// Sectors are filled in index order and wrap around, so every sector is erased once per
+// turn of the ring, and a sector is only erased right before it is reused. An entry costs
+// one flash write to append and one to mark it sent (a byte cleared in place); opening a
+// sector adds an erase and its header. When the ring is full the oldest sector is dropped.
+// Torn writes are found by CRC after a reset and cost at most the rest of their sector.
+//
+// Single caller (telemetry_task): no locking.
+
+#define TELEMETRY_SPOOL_MAX_PAYLOAD     1024
+
+// Publish one entry. ESP_OK: handed over (marked sent); anything else stops the drain.
+typedef esp_err_t (*telemetry_spool_send_t)(uint8_t kind, const void *data, size_t len, void *arg);
+
+typedef struct {
+    uint32_t drain_per_s;           // steady drain rate (entries/s)
+    uint32_t drain_burst;           // entries that may go at once after a pause
+    size_t outbox_max;              // no sends while outbox_bytes() is at or above this
+    size_t (*outbox_bytes)(void *arg);  // bytes waiting in the MQTT outbox; NULL: none
+    telemetry_spool_send_t send;
+    void *arg;
+} telemetry_spool_cfg_t;
+
+typedef struct {
+    uint32_t pending;       // entries not sent yet
+    uint32_t appended;
+    uint32_t sent;
+    uint32_t dropped;       // lost to a full ring or to corruption
+    uint32_t backpressure;  // drains stopped by a full MQTT outbox
+    uint32_t writes;        // flash writes
+    uint32_t erases;        // sector erases
+} telemetry_spool_stats_t;
+
+/**
+ * @brief Mount the spool on data partition `label`: find the newest sector and the oldest
+ * entry not sent. The partition is used raw; what is on it otherwise is overwritten.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND without the partition, ESP_ERR_INVALID_SIZE if it has
+ *         fewer than two sectors.
+ */
+esp_err_t telemetry_spool_open(const char *label, const telemetry_spool_cfg_t *cfg);
+void telemetry_spool_close(void);
+
+// Append an entry of `len` (1..TELEMETRY_SPOOL_MAX_PAYLOAD) bytes; `kind` is the caller's
+esp_err_t telemetry_spool_append(uint8_t kind, const void *data, size_t len);
+
+// True when there is nothing to send (also when the spool is not open)
+bool telemetry_spool_empty(void);
+
+/**
+ * @brief Send pending entries in order, at most drain_per_s per second (bursts up to
+ * drain_burst) and only while the MQTT outbox is below outbox_max.
+ *
+ * @param now_ms Monotonic time, for the pacing.
+ * @return Entries sent.
+ */
+uint32_t telemetry_spool_drain(int64_t now_ms);
+
+void telemetry_spool_get_stats(telemetry_spool_stats_t *out);
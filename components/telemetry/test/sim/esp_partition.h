@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Host stand-in for the esp_partition calls the spool makes: one data partition backed by
+// a file, with NOR flash rules (a write only clears bits, an erase sets a whole 4 KB
+// sector to 0xFF), per-sector erase counts and torn writes. partition_sim.c provides the
+// implementation.
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+    bool encrypted;
+    bool readonly;
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// Fault injection and inspection
+void sim_part_create(const char *path, const char *label, size_t size);  // fresh, erased
+void sim_part_destroy(void);                    // close and remove the file
+void sim_part_tear_write(int n);                // the n-th next write (0 = next) stops halfway
+bool sim_part_powered(void);                    // false after a torn write until sim_part_power_on()
+void sim_part_power_on(void);
+int sim_part_writes(void);                      // write calls that reached flash
+uint32_t sim_part_erases(size_t sector);        // erases of one sector
@@ -0,0 +1,118 @@
+#include "esp_partition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// File-backed data partition for the host tests, see esp_partition.h. The file is the
+// flash: it outlives a "reboot" (the spool closed and opened again) and can be inspected
+// after a failed run.
+
+#define SECTOR_SIZE     4096
+#define MAX_SECTORS     256
+
+static esp_partition_t s_part;
+static int s_fd = -1;
+static char s_path[256];
+static int s_tear_in = -1;
+static bool s_powered = true;
+static int s_writes;
+static uint32_t s_erases[MAX_SECTORS];
+
+void sim_part_create(const char *path, const char *label, size_t size)
+{
+    sim_part_destroy();
+    snprintf(s_path, sizeof(s_path), "%s", path);
+    s_fd = open(s_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (s_fd < 0 || size > (size_t)MAX_SECTORS * SECTOR_SIZE) abort();
+    uint8_t erased[SECTOR_SIZE];
+    memset(erased, 0xff, sizeof(erased));
+    for (size_t off = 0; off < size; off += SECTOR_SIZE) {
+        if (pwrite(s_fd, erased, SECTOR_SIZE, (off_t)off) != SECTOR_SIZE) abort();
+    }
+    memset(&s_part, 0, sizeof(s_part));
+    s_part.type = ESP_PARTITION_TYPE_DATA;
+    s_part.subtype = ESP_PARTITION_SUBTYPE_ANY;
+    s_part.size = (uint32_t)size;
+    s_part.erase_size = SECTOR_SIZE;
+    snprintf(s_part.label, sizeof(s_part.label), "%s", label);
+    s_tear_in = -1;
+    s_powered = true;
+    s_writes = 0;
+    memset(s_erases, 0, sizeof(s_erases));
+}
+
+void sim_part_destroy(void)
+{
+    if (s_fd >= 0) {
+        close(s_fd);
+        unlink(s_path);
+    }
+    s_fd = -1;
+}
+
+void sim_part_tear_write(int n) { s_tear_in = n; }
+bool sim_part_powered(void) { return s_powered; }
+void sim_part_power_on(void) { s_powered = true; }
+int sim_part_writes(void) { return s_writes; }
+uint32_t sim_part_erases(size_t sector) { return sector < MAX_SECTORS ? s_erases[sector] : 0; }
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    if (s_fd < 0 || type != s_part.type) return NULL;
+    if (label && strcmp(label, s_part.label) != 0) return NULL;
+    return &s_part;
+}
+
+static bool in_range(const esp_partition_t *p, size_t off, size_t size)
+{
+    return p == &s_part && s_fd >= 0 && off <= s_part.size && size <= s_part.size - off;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!in_range(partition, src_offset, size)) return ESP_ERR_INVALID_ARG;
+    return pread(s_fd, dst, size, (off_t)src_offset) == (ssize_t)size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (!in_range(partition, dst_offset, size)) return ESP_ERR_INVALID_ARG;
+    if (!s_powered) return ESP_FAIL;
+    size_t n = size;
+    if (s_tear_in == 0) {
+        n = size / 2;
+        s_powered = false;
+    }
+    if (s_tear_in >= 0) s_tear_in--;
+
+    // NOR: programming only clears bits
+    uint8_t cur[SECTOR_SIZE];
+    const uint8_t *in = src;
+    for (size_t done = 0; done < n;) {
+        size_t chunk = n - done < sizeof(cur) ? n - done : sizeof(cur);
+        if (pread(s_fd, cur, chunk, (off_t)(dst_offset + done)) != (ssize_t)chunk) return ESP_FAIL;
+        for (size_t i = 0; i < chunk; ++i) cur[i] &= in[done + i];
+        if (pwrite(s_fd, cur, chunk, (off_t)(dst_offset + done)) != (ssize_t)chunk) return ESP_FAIL;
+        done += chunk;
+    }
+    s_writes++;
+    return s_powered ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!in_range(partition, offset, size) || offset % SECTOR_SIZE || size % SECTOR_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_powered) return ESP_FAIL;
+    uint8_t erased[SECTOR_SIZE];
+    memset(erased, 0xff, sizeof(erased));
+    for (size_t off = offset; off < offset + size; off += SECTOR_SIZE) {
+        if (pwrite(s_fd, erased, SECTOR_SIZE, (off_t)off) != SECTOR_SIZE) return ESP_FAIL;
+        s_erases[off / SECTOR_SIZE]++;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,91 @@
+#include "unity.h"
+#include "telemetry_audit.h"
+#include <limits.h>
+#include <string.h>
+
+// Host tests for structured audit records: the JSON each event renders to, unknown actors
+// and events, the longest rendering against TELEMETRY_AUDIT_JSON_MAX, and truncation.
+
+static char s_out[TELEMETRY_AUDIT_JSON_MAX];
+
+static const char *render(uint8_t actor, uint8_t event, uint16_t a0, int32_t a1, int32_t a2)
+{
+    telemetry_audit_rec_t rec = {
+        .ts = 1718000000, .actor = actor, .event = event, .arg0 = a0, .arg1 = a1, .arg2 = a2,
+    };
+    int len = telemetry_audit_format(&rec, s_out, sizeof(s_out));
+    TEST_ASSERT_EQUAL_INT((int)strlen(s_out), len);
+    return s_out;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// --- Tests ---
+
+void test_events_render_with_their_arguments(void)
+{
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":\"ble\",\"ev\":\"output\",\"ch\":0,\"pct\":40,\"ramp_ms\":1000}",
+                             render(1, TELEMETRY_AUDIT_OUTPUT, 0, 40, 1000));
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":\"safety\",\"ev\":\"estop\",\"latency_us\":12}",
+                             render(3, TELEMETRY_AUDIT_ESTOP, 0, 12, 0));
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":\"ble\",\"ev\":\"ble_session\"}",
+                             render(1, TELEMETRY_AUDIT_BLE_SESSION, 0, 0, 0));
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":\"cloud\",\"ev\":\"ota_fail\",\"stage\":4,\"err\":-1}",
+                             render(4, TELEMETRY_AUDIT_OTA_FAIL, TELEMETRY_AUDIT_OTA_DOWNLOAD, -1, 0));
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":\"schedule\",\"ev\":\"sched_missed\",\"ch\":1,\"pct\":100,\"at\":1717990000}",
+                             render(2, TELEMETRY_AUDIT_SCHED_MISSED, 1, 100, 1717990000));
+}
+
+void test_every_event_has_a_name(void)
+{
+    for (uint8_t ev = TELEMETRY_AUDIT_OUTPUT; ev < TELEMETRY_AUDIT_EVENT_COUNT; ++ev) {
+        render(0, ev, 1, 2, 3);
+        TEST_ASSERT_NOT_NULL(strstr(s_out, "\"ev\":\""));
+    }
+}
+
+void test_unknown_actor_and_event(void)
+{
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":9,\"ev\":200,\"arg0\":1,\"arg1\":-2,\"arg2\":3}",
+                             render(9, 200, 1, -2, 3));
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"actor\":\"unknown\",\"ev\":0,\"arg0\":0,\"arg1\":0,\"arg2\":0}",
+                             render(0, 0, 0, 0, 0));
+}
+
+void test_longest_rendering_fits(void)
+{
+    // Widest values for every event, and for an unknown one
+    for (unsigned ev = 0; ev <= TELEMETRY_AUDIT_EVENT_COUNT; ++ev) {
+        for (uint8_t actor = 0; actor <= TELEMETRY_AUDIT_ACTORS; ++actor) {
+            telemetry_audit_rec_t rec = {
+                .ts = UINT32_MAX, .actor = actor, .event = (uint8_t)ev,
+                .arg0 = UINT16_MAX, .arg1 = INT32_MIN, .arg2 = INT32_MIN,
+            };
+            int len = telemetry_audit_format(&rec, NULL, 0);
+            TEST_ASSERT_TRUE(len > 0 && len < TELEMETRY_AUDIT_JSON_MAX);
+        }
+    }
+}
+
+void test_truncated_like_snprintf(void)
+{
+    telemetry_audit_rec_t rec = {.ts = 5, .actor = 1, .event = TELEMETRY_AUDIT_BLE_CMD, .arg0 = 3, .arg1 = 17};
+    const char *full = "{\"ts\":5,\"actor\":\"ble\",\"ev\":\"ble_cmd\",\"channels\":3,\"ctr\":17}";
+    char small[20];
+    memset(small, 'x', sizeof(small));
+    TEST_ASSERT_EQUAL_INT((int)strlen(full), telemetry_audit_format(&rec, small, sizeof(small)));
+    TEST_ASSERT_EQUAL_INT(sizeof(small) - 1, strlen(small));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(full, small, sizeof(small) - 1));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_events_render_with_their_arguments);
+    RUN_TEST(test_every_event_has_a_name);
+    RUN_TEST(test_unknown_actor_and_event);
+    RUN_TEST(test_longest_rendering_fits);
+    RUN_TEST(test_truncated_like_snprintf);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+#include "unity.h"
+#include "telemetry_batch.h"
+#include <stdio.h>
+#include <string.h>
+
+// Host tests for the audit batcher: payload framing, escaping and JSON entries, the byte
+// budget, the window, and how many messages a burst of entries turns into.
+
+#define WINDOW_MS   2000
+
+static const char *finish(void)
+{
+    size_t len = 0;
+    const char *p = telemetry_batch_finish(&len);
+    if (p) TEST_ASSERT_EQUAL_UINT32(strlen(p), len);
+    return p;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_init(WINDOW_MS, TELEMETRY_BATCH_MAX));
+}
+
+void tearDown(void) {}
+
+// --- Tests ---
+
+void test_entries_framed_in_order(void)
+{
+    TEST_ASSERT_TRUE(telemetry_batch_empty());
+    TEST_ASSERT_NULL(finish());
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("pump on", 0));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("light 40%", 10));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("", 20));
+    TEST_ASSERT_FALSE(telemetry_batch_empty());
+    TEST_ASSERT_EQUAL_STRING("{\"audit\":[\"pump on\",\"light 40%\",\"\"]}", finish());
+    TEST_ASSERT_TRUE(telemetry_batch_empty());
+    TEST_ASSERT_NULL(finish());
+
+    // The next entry starts a new batch
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("pump off", 30));
+    TEST_ASSERT_EQUAL_STRING("{\"audit\":[\"pump off\"]}", finish());
+
+    telemetry_batch_stats_t st;
+    telemetry_batch_get_stats(&st);
+    TEST_ASSERT_EQUAL_UINT32(4, st.entries);
+    TEST_ASSERT_EQUAL_UINT32(2, st.batches);
+}
+
+void test_json_entries_as_is(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("text", 0));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add_json("{\"ev\":\"output\",\"pct\":40}", 0));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add_json("7", 0));
+    TEST_ASSERT_EQUAL_STRING("{\"audit\":[\"text\",{\"ev\":\"output\",\"pct\":40},7]}", finish());
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_batch_add_json("", 0));
+}
+
+void test_escaping(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("say \"hi\"\\ \n\t\r\x01\x1f caf\xc3\xa9", 0));
+    TEST_ASSERT_EQUAL_STRING("{\"audit\":[\"say \\\"hi\\\"\\\\ \\n\\t\\r\\u0001\\u001f caf\xc3\xa9\"]}",
+                             finish());
+}
+
+void test_byte_budget(void)
+{
+    char msg[101];
+    memset(msg, 'a', 100);
+    msg[100] = '\0';
+    // Prefix 10, closing 2, 102 per entry and a comma between: 9 entries in 930 bytes
+    int added = 0;
+    esp_err_t err;
+    while ((err = telemetry_batch_add(msg, 0)) == ESP_OK) added++;
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NO_MEM, err);
+    TEST_ASSERT_EQUAL_INT(9, added);
+    size_t len;
+    const char *p = telemetry_batch_finish(&len);
+    TEST_ASSERT_EQUAL_UINT32(10 + 9 * 102 + 8 + 2, len);
+    TEST_ASSERT_TRUE(len <= TELEMETRY_BATCH_MAX);
+    TEST_ASSERT_EQUAL_STRING("]}", p + len - 2);
+
+    // The entry that did not fit goes into the next one
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add(msg, 0));
+
+    // Exactly at the budget
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_init(WINDOW_MS, 64));
+    char fit[64 - 10 - 2 - 2 + 1];
+    memset(fit, 'b', sizeof(fit) - 1);
+    fit[sizeof(fit) - 1] = '\0';
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add(fit, 0));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NO_MEM, telemetry_batch_add("", 0));
+    TEST_ASSERT_EQUAL_UINT32(64, strlen(finish()));
+}
+
+void test_oversized_entry_dropped(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_init(WINDOW_MS, 64));
+    char msg[64];
+    memset(msg, 'c', sizeof(msg) - 1);
+    msg[sizeof(msg) - 1] = '\0';
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, telemetry_batch_add(msg, 0));
+    TEST_ASSERT_TRUE(telemetry_batch_empty());
+    // Escaping counts: 10 control characters take 60 bytes
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, telemetry_batch_add("\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01", 0));
+
+    telemetry_batch_stats_t st;
+    telemetry_batch_get_stats(&st);
+    TEST_ASSERT_EQUAL_UINT32(2, st.dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, st.entries);
+
+    // A partly written entry leaves the batch as it was
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("x", 0));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NO_MEM, telemetry_batch_add(msg, 0));
+    TEST_ASSERT_EQUAL_STRING("{\"audit\":[\"x\"]}", finish());
+}
+
+void test_window(void)
+{
+    TEST_ASSERT_EQUAL_INT64(INT64_MAX, telemetry_batch_wait_ms(0));
+    TEST_ASSERT_FALSE(telemetry_batch_due(0));
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("a", 1000));
+    TEST_ASSERT_EQUAL_INT64(WINDOW_MS, telemetry_batch_wait_ms(1000));
+    // Later entries do not extend it
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("b", 2500));
+    TEST_ASSERT_EQUAL_INT64(500, telemetry_batch_wait_ms(2500));
+    TEST_ASSERT_FALSE(telemetry_batch_due(2999));
+    TEST_ASSERT_TRUE(telemetry_batch_due(3000));
+    TEST_ASSERT_EQUAL_INT64(0, telemetry_batch_wait_ms(9000));
+    finish();
+    TEST_ASSERT_FALSE(telemetry_batch_due(9000));
+
+    // A zero window: due as soon as there is an entry
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_init(0, TELEMETRY_BATCH_MAX));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add("c", 5));
+    TEST_ASSERT_TRUE(telemetry_batch_due(5));
+}
+
+void test_burst_becomes_few_messages(void)
+{
+    // A reconcile-like burst: 60 entries of ~40 bytes within a second, sent the way
+    // telemetry_task does (full batch first, then the window)
+    int messages = 0;
+    size_t bytes = 0, raw = 0;
+    for (int i = 0; i < 60; ++i) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "reconcile ch%d duty=%d src=schedule", i % 4, i * 7 % 100);
+        raw += strlen(msg);
+        int64_t now = i * 15;
+        if (telemetry_batch_add(msg, now) == ESP_ERR_NO_MEM) {
+            bytes += strlen(finish());
+            messages++;
+            TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_batch_add(msg, now));
+        }
+        if (telemetry_batch_due(now)) {
+            bytes += strlen(finish());
+            messages++;
+        }
+    }
+    if (!telemetry_batch_empty()) {
+        bytes += strlen(finish());
+        messages++;
+    }
+    printf("60 entries (%u bytes): %d messages, %u bytes\n", (unsigned)raw, messages, (unsigned)bytes);
+    TEST_ASSERT_TRUE(messages <= 4);
+    TEST_ASSERT_TRUE(bytes < raw + 60 * 3 + messages * 12 + 1);
+}
+
+void test_bad_config(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_batch_init(WINDOW_MS, 63));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_batch_init(WINDOW_MS, TELEMETRY_BATCH_MAX + 1));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_batch_add(NULL, 0));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_framed_in_order);
+    RUN_TEST(test_json_entries_as_is);
+    RUN_TEST(test_escaping);
+    RUN_TEST(test_byte_budget);
+    RUN_TEST(test_oversized_entry_dropped);
+    RUN_TEST(test_window);
+    RUN_TEST(test_burst_becomes_few_messages);
+    RUN_TEST(test_bad_config);
+    return UNITY_END();
+}
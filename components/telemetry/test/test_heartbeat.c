@@ -0,0 +1,201 @@
+#include "unity.h"
+#include "telemetry_heartbeat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Host tests for the heartbeat encoder: JSON and CBOR output of the streaming encoder, the
+// widest heartbeat against TELEMETRY_HEARTBEAT_MAX, a buffer too small, and no heap use,
+// counted by wrapping the C allocator.
+
+// --- Counting allocator (glibc: the __libc_* entry points stay reachable) ---
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t n);
+extern void __libc_free(void *p);
+
+static unsigned s_allocs;
+
+void *malloc(size_t n) { s_allocs++; return __libc_malloc(n); }
+void *calloc(size_t n, size_t size) { s_allocs++; return __libc_calloc(n, size); }
+void *realloc(void *p, size_t n) { s_allocs++; return __libc_realloc(p, n); }
+void free(void *p) { __libc_free(p); }
+
+static uint8_t s_buf[TELEMETRY_HEARTBEAT_MAX];
+
+static telemetry_heartbeat_t widest(void)
+{
+    return (telemetry_heartbeat_t){
+        .ts = INT64_MIN, .uptime_s = UINT64_MAX, .reset_reason = UINT32_MAX,
+        .min_free_heap = UINT32_MAX, .wifi_rssi = INT8_MIN,
+        .next_on_utc = INT64_MAX, .next_off_utc = INT64_MAX,
+        .has_mbox = true, .cmd_coalesced = UINT32_MAX, .cmd_dropped = UINT32_MAX,
+        .cmd_deferred = UINT32_MAX, .cmd_redundant = UINT32_MAX,
+        .has_sched = true, .sched_wakeups = UINT32_MAX, .sched_cpu_us = UINT64_MAX,
+        .pump_late_max_us = UINT32_MAX,
+        .estop_count = UINT32_MAX, .estop_worst_us = UINT32_MAX,
+        .has_spool = true, .spool_pending = UINT32_MAX, .spool_dropped = UINT32_MAX,
+        .audit_entries = UINT32_MAX, .audit_batches = UINT32_MAX,
+        .audit_ring_peak = UINT32_MAX, .audit_ring_full = UINT32_MAX,
+        .mqtt_msgs_per_h = UINT32_MAX, .mqtt_bytes_per_h = UINT32_MAX,
+    };
+}
+
+// Keys of a CBOR map of text keys to integers, as written by the encoder; -1 if malformed.
+// The value of `find` goes to `*value`.
+static int cbor_map_keys(const uint8_t *p, size_t len, const char *find, int64_t *value)
+{
+    size_t i = 0;
+    int keys = 0;
+    if (len < 2 || p[i++] != 0xbf) return -1;
+    while (i < len && p[i] != 0xff) {
+        uint64_t arg[2];
+        uint8_t major[2];
+        const char *k = NULL;
+        for (int item = 0; item < 2; ++item) {
+            major[item] = p[i] >> 5;
+            uint8_t ai = p[i++] & 0x1f;
+            size_t n = ai < 24 ? 0 : ai == 24 ? 1 : ai == 25 ? 2 : ai == 26 ? 4 : 8;
+            arg[item] = ai < 24 ? ai : 0;
+            for (size_t b = 0; b < n; ++b) arg[item] = arg[item] << 8 | p[i++];
+            if (item == 0) {
+                if (major[0] != 3) return -1;
+                k = (const char *)p + i;
+                i += arg[0];
+            } else if (major[1] > 1) {
+                return -1;
+            }
+        }
+        if (find && arg[0] == strlen(find) && !memcmp(k, find, arg[0])) {
+            *value = major[1] == 0 ? (int64_t)arg[1] : -1 - (int64_t)arg[1];
+        }
+        keys++;
+    }
+    return i == len - 1 ? keys : -1;
+}
+
+void setUp(void)
+{
+    memset(s_buf, 0xee, sizeof(s_buf));
+}
+
+void tearDown(void) {}
+
+// --- Tests ---
+
+void test_json_object(void)
+{
+    telemetry_enc_t e;
+    size_t len = 0;
+    telemetry_enc_begin(&e, TELEMETRY_ENC_JSON, s_buf, sizeof(s_buf));
+    telemetry_enc_int(&e, "ts", 1718000000);
+    telemetry_enc_uint(&e, "zero", 0);
+    telemetry_enc_int(&e, "rssi", -61);
+    telemetry_enc_int(&e, "min", INT64_MIN);
+    telemetry_enc_uint(&e, "max", UINT64_MAX);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_enc_end(&e, &len));
+    const char *want = "{\"ts\":1718000000,\"zero\":0,\"rssi\":-61,"
+                       "\"min\":-9223372036854775808,\"max\":18446744073709551615}";
+    TEST_ASSERT_EQUAL_STRING(want, (const char *)s_buf);
+    TEST_ASSERT_EQUAL_UINT32(strlen(want), len);
+
+    telemetry_enc_begin(&e, TELEMETRY_ENC_JSON, s_buf, sizeof(s_buf));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_enc_end(&e, &len));
+    TEST_ASSERT_EQUAL_STRING("{}", (const char *)s_buf);
+}
+
+void test_cbor_map(void)
+{
+    telemetry_enc_t e;
+    size_t len = 0;
+    telemetry_enc_begin(&e, TELEMETRY_ENC_CBOR, s_buf, sizeof(s_buf));
+    telemetry_enc_uint(&e, "a", 23);
+    telemetry_enc_uint(&e, "b", 24);
+    telemetry_enc_int(&e, "c", -1);
+    telemetry_enc_int(&e, "d", -500);
+    telemetry_enc_uint(&e, "e", 1718000000);
+    telemetry_enc_uint(&e, "f", 0x100000000ull);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_enc_end(&e, &len));
+    static const uint8_t want[] = {
+        0xbf,
+        0x61, 'a', 0x17,
+        0x61, 'b', 0x18, 24,
+        0x61, 'c', 0x20,
+        0x61, 'd', 0x39, 0x01, 0xf3,
+        0x61, 'e', 0x1a, 0x66, 0x66, 0x99, 0x80,
+        0x61, 'f', 0x1b, 0, 0, 0, 1, 0, 0, 0, 0,
+        0xff,
+    };
+    TEST_ASSERT_EQUAL_UINT32(sizeof(want), len);
+    TEST_ASSERT_EQUAL_MEMORY(want, s_buf, sizeof(want));
+}
+
+void test_widest_heartbeat_fits(void)
+{
+    telemetry_heartbeat_t hb = widest();
+    size_t json = 0, cbor = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_JSON, s_buf, sizeof(s_buf), &json));
+    TEST_ASSERT_EQUAL_UINT32(strlen((const char *)s_buf), json);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_CBOR, s_buf, sizeof(s_buf), &cbor));
+    int64_t rssi = 0;
+    TEST_ASSERT_EQUAL_INT(24, cbor_map_keys(s_buf, cbor, "wifi_rssi", &rssi));
+    TEST_ASSERT_EQUAL_INT64(INT8_MIN, rssi);
+    printf("widest heartbeat: %u bytes JSON, %u bytes CBOR (buffer %u)\n",
+           (unsigned)json, (unsigned)cbor, (unsigned)TELEMETRY_HEARTBEAT_MAX);
+    TEST_ASSERT_TRUE(cbor < json);
+}
+
+void test_optional_fields_omitted(void)
+{
+    telemetry_heartbeat_t hb = {.ts = 1718000000, .uptime_s = 42, .wifi_rssi = 127};
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_JSON, s_buf, sizeof(s_buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("{\"ts\":1718000000,\"uptime_s\":42,\"reset_reason\":0,\"min_free_heap\":0,"
+                             "\"wifi_rssi\":127,\"audit_entries\":0,\"audit_batches\":0,"
+                             "\"audit_ring_peak\":0,\"audit_ring_full\":0,"
+                             "\"mqtt_msgs_per_h\":0,\"mqtt_bytes_per_h\":0}", (const char *)s_buf);
+}
+
+void test_too_small(void)
+{
+    telemetry_heartbeat_t hb = widest();
+    size_t len = 0;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_JSON, s_buf, sizeof(s_buf), &len));
+    // The NUL needs its byte too
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_JSON, s_buf, len, NULL));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_JSON, s_buf, len + 1, NULL));
+
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_CBOR, s_buf, sizeof(s_buf), &len));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_CBOR, s_buf, len - 1, NULL));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_CBOR, s_buf, len, NULL));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, telemetry_heartbeat_encode(&hb, TELEMETRY_ENC_CBOR, NULL, 0, NULL));
+}
+
+void test_no_heap_allocations(void)
+{
+    telemetry_heartbeat_t hb = widest();
+    // The counter sees allocations (called through a pointer the compiler cannot elide)
+    void *(*volatile alloc)(size_t) = malloc;
+    unsigned before = s_allocs;
+    free(alloc(16));
+    TEST_ASSERT_EQUAL_UINT32(before + 1, s_allocs);
+
+    before = s_allocs;
+    for (int i = 0; i < 1000; ++i) {
+        hb.uptime_s = (uint64_t)i * 300;
+        telemetry_heartbeat_encode(&hb, i & 1 ? TELEMETRY_ENC_CBOR : TELEMETRY_ENC_JSON, s_buf, sizeof(s_buf), NULL);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, s_allocs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_json_object);
+    RUN_TEST(test_cbor_map);
+    RUN_TEST(test_widest_heartbeat_fits);
+    RUN_TEST(test_optional_fields_omitted);
+    RUN_TEST(test_too_small);
+    RUN_TEST(test_no_heap_allocations);
+    return UNITY_END();
+}
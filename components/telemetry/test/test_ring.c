@@ -0,0 +1,260 @@
+#include "unity.h"
+#include "telemetry_ring.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+// Host tests for the audit message ring: records back in order, in place and with their
+// type, wrap-around behind padding, giving back the unused part of a reservation, a full
+// ring, and several producer threads against one consumer with nothing lost, torn or
+// reordered.
+
+static uint32_t s_mem[1024];
+static telemetry_ring_t s_ring;
+
+static void *put(const char *msg)
+{
+    size_t len = strlen(msg) + 1;
+    char *p = telemetry_ring_reserve(&s_ring, len);
+    if (p) {
+        memcpy(p, msg, len);
+        telemetry_ring_commit(&s_ring, p, len, 0);
+    }
+    return p;
+}
+
+static const char *get(void)
+{
+    const void *data;
+    return telemetry_ring_peek(&s_ring, &data, NULL) ? data : NULL;
+}
+
+static uint32_t used(void)
+{
+    telemetry_ring_stats_t st;
+    telemetry_ring_get_stats(&s_ring, &st);
+    return st.used;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_ring_init(&s_ring, s_mem, 256));
+}
+
+void tearDown(void) {}
+
+// --- Tests ---
+
+void test_records_in_order(void)
+{
+    TEST_ASSERT_NULL(get());
+    TEST_ASSERT_NOT_NULL(put("one"));
+    TEST_ASSERT_NOT_NULL(put("a longer second record"));
+    // 4 + 4 and 4 + 24 bytes
+    TEST_ASSERT_EQUAL_UINT32(36, used());
+
+    TEST_ASSERT_EQUAL_STRING("one", get());
+    TEST_ASSERT_EQUAL_STRING("one", get());     // until released
+    telemetry_ring_release(&s_ring);
+    TEST_ASSERT_EQUAL_STRING("a longer second record", get());
+    telemetry_ring_release(&s_ring);
+    TEST_ASSERT_NULL(get());
+    TEST_ASSERT_EQUAL_UINT32(0, used());
+}
+
+void test_record_type(void)
+{
+    for (uint8_t type = 0; type < 4; ++type) {
+        uint32_t *p = telemetry_ring_reserve(&s_ring, 16);
+        p[0] = 0xA0u + type;
+        telemetry_ring_commit(&s_ring, p, 16, type);
+    }
+    for (uint8_t type = 0; type < 4; ++type) {
+        const void *data;
+        uint8_t got = 0xff;
+        TEST_ASSERT_EQUAL_UINT32(16, telemetry_ring_peek(&s_ring, &data, &got));
+        TEST_ASSERT_EQUAL_UINT8(type, got);
+        TEST_ASSERT_EQUAL_HEX32(0xA0u + type, *(const uint32_t *)data);
+        telemetry_ring_release(&s_ring);
+    }
+}
+
+void test_uncommitted_holds_back_later(void)
+{
+    char *a = telemetry_ring_reserve(&s_ring, 8);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(put("b"));
+    TEST_ASSERT_NULL(get());
+    strcpy(a, "a");
+    telemetry_ring_commit(&s_ring, a, 2, 0);
+    TEST_ASSERT_EQUAL_STRING("a", get());
+    telemetry_ring_release(&s_ring);
+    TEST_ASSERT_EQUAL_STRING("b", get());
+    telemetry_ring_release(&s_ring);
+
+    // A discarded one is skipped
+    char *c = telemetry_ring_reserve(&s_ring, 8);
+    TEST_ASSERT_NOT_NULL(put("d"));
+    telemetry_ring_commit(&s_ring, c, 0, 0);
+    TEST_ASSERT_EQUAL_STRING("d", get());
+    telemetry_ring_release(&s_ring);
+    TEST_ASSERT_EQUAL_UINT32(0, used());
+}
+
+void test_unused_part_given_back(void)
+{
+    // The last reservation shrinks to what was written
+    char *a = telemetry_ring_reserve(&s_ring, 100);
+    TEST_ASSERT_EQUAL_UINT32(104, used());
+    memset(a, 'x', 100);
+    strcpy(a, "short");
+    telemetry_ring_commit(&s_ring, a, 6, 0);
+    TEST_ASSERT_EQUAL_UINT32(12, used());
+    // The next record goes right after it, over the bytes given back
+    TEST_ASSERT_NOT_NULL(put("next"));
+    TEST_ASSERT_EQUAL_UINT32(24, used());
+
+    // Not the last one: it keeps its room
+    char *b = telemetry_ring_reserve(&s_ring, 100);
+    TEST_ASSERT_NOT_NULL(put("after"));
+    strcpy(b, "b");
+    telemetry_ring_commit(&s_ring, b, 2, 0);
+    TEST_ASSERT_EQUAL_UINT32(24 + 104 + 12, used());
+
+    const char *want[] = {"short", "next", "b", "after"};
+    for (int i = 0; i < 4; ++i) {
+        TEST_ASSERT_EQUAL_STRING(want[i], get());
+        telemetry_ring_release(&s_ring);
+    }
+    TEST_ASSERT_NULL(get());
+    TEST_ASSERT_EQUAL_UINT32(0, used());
+}
+
+void test_wrap_behind_padding(void)
+{
+    char msg[80];
+    for (int i = 0; i < 200; ++i) {
+        snprintf(msg, sizeof(msg), "record %d %.*s", i, i % 50, "..................................................");
+        TEST_ASSERT_NOT_NULL(put(msg));
+        if (i % 3 == 0) continue;
+        // Drain now and then, so the head goes round many times at odd offsets
+        for (const char *got; (got = get()); telemetry_ring_release(&s_ring)) {
+            TEST_ASSERT_EQUAL_INT(0, strncmp(got, "record ", 7));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, used());
+
+    // Exactly in order across the wrap
+    for (int i = 0; i < 4; ++i) {
+        snprintf(msg, sizeof(msg), "w%d %040d", i, i);
+        TEST_ASSERT_NOT_NULL(put(msg));
+    }
+    for (int i = 0; i < 4; ++i) {
+        snprintf(msg, sizeof(msg), "w%d %040d", i, i);
+        TEST_ASSERT_EQUAL_STRING(msg, get());
+        telemetry_ring_release(&s_ring);
+    }
+}
+
+void test_full_ring_refuses(void)
+{
+    int n = 0;
+    while (put("0123456789abcdefghijklmnopqrstu")) n++;     // 36 bytes each
+    TEST_ASSERT_EQUAL_INT(7, n);
+    telemetry_ring_stats_t st;
+    telemetry_ring_get_stats(&s_ring, &st);
+    TEST_ASSERT_EQUAL_UINT32(1, st.refused);
+    TEST_ASSERT_EQUAL_UINT32(252, st.peak);
+
+    // Room again once the consumer releases
+    TEST_ASSERT_NOT_NULL(get());
+    telemetry_ring_release(&s_ring);
+    TEST_ASSERT_NOT_NULL(put("0123456789abcdefghijklmnopqrstu"));
+
+    TEST_ASSERT_NULL(telemetry_ring_reserve(&s_ring, 0));
+    TEST_ASSERT_NULL(telemetry_ring_reserve(&s_ring, 128 - 4 + 1));
+}
+
+void test_bad_init(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_ring_init(&s_ring, s_mem, 100));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_ring_init(&s_ring, s_mem, 32));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_ring_init(&s_ring, (uint8_t *)s_mem + 1, 256));
+}
+
+// --- Producers against the consumer ---
+
+#define PRODUCERS   4
+#define PER_PRODUCER 50000
+
+static void *producer(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    for (int seq = 0; seq < PER_PRODUCER;) {
+        // Reserve the most, write a variable length, like telemetry_audit_log
+        char *p = telemetry_ring_reserve(&s_ring, 64);
+        if (!p) {
+            sched_yield();
+            continue;
+        }
+        int n = snprintf(p, 64, "%d:%d:%.*s", id, seq, seq % 40, "########################################");
+        telemetry_ring_commit(&s_ring, p, (size_t)n + 1, 0);
+        seq++;
+    }
+    return NULL;
+}
+
+void test_producers_and_consumer(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_ring_init(&s_ring, s_mem, sizeof(s_mem)));
+    pthread_t t[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; ++i) pthread_create(&t[i], NULL, producer, (void *)(intptr_t)i);
+
+    int next[PRODUCERS] = {0};
+    int total = 0, bad = 0;
+    while (total < PRODUCERS * PER_PRODUCER) {
+        const void *data;
+        size_t len = telemetry_ring_peek(&s_ring, &data, NULL);
+        if (!len) {
+            sched_yield();
+            continue;
+        }
+        int id, seq, hashes = 0;
+        const char *msg = data;
+        if (sscanf(msg, "%d:%d:", &id, &seq) != 2 || id < 0 || id >= PRODUCERS || seq != next[id]) {
+            bad++;
+        } else {
+            const char *h = strrchr(msg, ':') + 1;
+            while (h[hashes] == '#') hashes++;
+            if (hashes != seq % 40 || h[hashes] != '\0' || len != strlen(msg) + 1) bad++;
+            next[id] = seq + 1;
+        }
+        telemetry_ring_release(&s_ring);
+        total++;
+    }
+    for (int i = 0; i < PRODUCERS; ++i) pthread_join(t[i], NULL);
+
+    telemetry_ring_stats_t st;
+    telemetry_ring_get_stats(&s_ring, &st);
+    printf("%d records, peak %u of %u bytes, %u refused while full\n", total, (unsigned)st.peak,
+           (unsigned)sizeof(s_mem), (unsigned)st.refused);
+    TEST_ASSERT_EQUAL_INT(0, bad);
+    TEST_ASSERT_EQUAL_UINT32(0, st.used);
+    const void *data;
+    TEST_ASSERT_EQUAL_UINT32(0, telemetry_ring_peek(&s_ring, &data, NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_in_order);
+    RUN_TEST(test_record_type);
+    RUN_TEST(test_uncommitted_holds_back_later);
+    RUN_TEST(test_unused_part_given_back);
+    RUN_TEST(test_wrap_behind_padding);
+    RUN_TEST(test_full_ring_refuses);
+    RUN_TEST(test_bad_init);
+    RUN_TEST(test_producers_and_consumer);
+    return UNITY_END();
+}
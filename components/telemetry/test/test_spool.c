@@ -0,0 +1,296 @@
+#include "unity.h"
+#include "telemetry_spool.h"
+#include "esp_partition.h"
+#include <stdio.h>
+#include <string.h>
+
+// Host tests for the store-and-forward spool on a file-backed partition (test/sim): order
+// and no repeats across reboots, the oldest sector dropped when the ring is full, flash
+// writes and erases per entry, even wear, torn writes at every step, and the drain pacing
+// and MQTT outbox backpressure.
+
+#define PART_FILE   "spool_part.bin"
+#define LABEL       "storage"
+#define SECTOR      4096
+
+typedef struct {
+    int count;
+    int seq[256];
+    uint8_t kind[256];
+    size_t outbox;          // bytes "in the MQTT outbox"
+    size_t outbox_max;
+    bool fail;
+} sink_t;
+
+static sink_t s_sink;
+
+static esp_err_t sink_send(uint8_t kind, const void *data, size_t len, void *arg)
+{
+    sink_t *s = arg;
+    if (s->fail) return ESP_FAIL;
+    int seq = -1;
+    sscanf((const char *)data, "entry %d", &seq);
+    if (s->count < 256) {
+        s->seq[s->count] = seq;
+        s->kind[s->count] = kind;
+    }
+    s->count++;
+    s->outbox += len;
+    return ESP_OK;
+}
+
+static size_t sink_outbox(void *arg)
+{
+    return ((sink_t *)arg)->outbox;
+}
+
+static telemetry_spool_cfg_t cfg(uint32_t per_s, uint32_t burst)
+{
+    return (telemetry_spool_cfg_t){
+        .drain_per_s = per_s, .drain_burst = burst, .outbox_max = SIZE_MAX,
+        .outbox_bytes = sink_outbox, .send = sink_send, .arg = &s_sink,
+    };
+}
+
+static void mount(uint32_t per_s, uint32_t burst)
+{
+    telemetry_spool_cfg_t c = cfg(per_s, burst);
+    c.outbox_max = s_sink.outbox_max ? s_sink.outbox_max : SIZE_MAX;
+    telemetry_spool_close();
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_spool_open(LABEL, &c));
+}
+
+static void reboot(void)
+{
+    sim_part_power_on();
+    mount(1000, 1000);
+}
+
+// Entry `seq`: its number, padded to `len` bytes
+static esp_err_t append(int seq, size_t len)
+{
+    char buf[TELEMETRY_SPOOL_MAX_PAYLOAD];
+    memset(buf, 'x', len);
+    int n = snprintf(buf, len, "entry %d", seq);
+    if ((size_t)n + 1 < len) buf[n] = ' ';
+    return telemetry_spool_append((uint8_t)(seq & 1), buf, len);
+}
+
+static uint32_t drain_all(void)
+{
+    static int64_t t = 1000000;
+    t += 1000000;   // a long pause: a full burst
+    return telemetry_spool_drain(t);
+}
+
+static telemetry_spool_stats_t stats(void)
+{
+    telemetry_spool_stats_t st;
+    telemetry_spool_get_stats(&st);
+    return st;
+}
+
+static void check_sent(int first, int count)
+{
+    TEST_ASSERT_EQUAL_INT(count, s_sink.count);
+    for (int i = 0; i < count; ++i) {
+        TEST_ASSERT_EQUAL_INT(first + i, s_sink.seq[i]);
+        TEST_ASSERT_EQUAL_INT((first + i) & 1, s_sink.kind[i]);
+    }
+}
+
+void setUp(void)
+{
+    memset(&s_sink, 0, sizeof(s_sink));
+    sim_part_create(PART_FILE, LABEL, 8 * SECTOR);
+    mount(1000, 1000);
+}
+
+void tearDown(void)
+{
+    telemetry_spool_close();
+    sim_part_destroy();
+}
+
+// --- Tests ---
+
+void test_order_kept_across_reboots(void)
+{
+    for (int i = 0; i < 40; ++i) TEST_ASSERT_EQUAL_INT(ESP_OK, append(i, 150));
+    TEST_ASSERT_FALSE(telemetry_spool_empty());
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(40, stats().pending);
+
+    mount(1000, 15);
+    TEST_ASSERT_EQUAL_UINT32(15, drain_all());
+    check_sent(0, 15);
+
+    // Sent ones are not sent again
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(25, stats().pending);
+    memset(&s_sink, 0, sizeof(s_sink));
+    TEST_ASSERT_EQUAL_UINT32(25, drain_all());
+    check_sent(15, 25);
+    TEST_ASSERT_TRUE(telemetry_spool_empty());
+
+    // Appends continue after what is there
+    reboot();
+    TEST_ASSERT_TRUE(telemetry_spool_empty());
+    TEST_ASSERT_EQUAL_INT(ESP_OK, append(40, 150));
+    memset(&s_sink, 0, sizeof(s_sink));
+    TEST_ASSERT_EQUAL_UINT32(1, drain_all());
+    check_sent(40, 1);
+}
+
+void test_full_ring_drops_oldest_sector(void)
+{
+    // 4 entries of 1000 bytes per sector, 8 sectors
+    const int per_sector = 4, total = 8 * per_sector + 3;
+    for (int i = 0; i < total; ++i) TEST_ASSERT_EQUAL_INT(ESP_OK, append(i, 1000));
+    telemetry_spool_stats_t st = stats();
+    TEST_ASSERT_EQUAL_UINT32(per_sector, st.dropped);
+    TEST_ASSERT_EQUAL_UINT32(total - per_sector, st.pending);
+
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(total - per_sector, stats().pending);
+    TEST_ASSERT_EQUAL_UINT32(total - per_sector, drain_all());
+    check_sent(per_sector, total - per_sector);
+}
+
+void test_flash_writes_bounded(void)
+{
+    // Bursts of appends while "offline", drained when "online"
+    const int rounds = 50, burst = 20;
+    int seq = 0;
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < burst; ++i) TEST_ASSERT_EQUAL_INT(ESP_OK, append(seq++, 60 + (i * 37) % 300));
+        TEST_ASSERT_EQUAL_UINT32(burst, drain_all());
+    }
+    telemetry_spool_stats_t st = stats();
+    TEST_ASSERT_EQUAL_UINT32(seq, st.sent);
+    TEST_ASSERT_EQUAL_UINT32(0, st.dropped);
+    // One write to append, one to mark sent, a header per sector opened
+    TEST_ASSERT_EQUAL_UINT32(2 * seq + st.erases, st.writes);
+    TEST_ASSERT_EQUAL_INT(st.writes, sim_part_writes());
+    printf("%d entries: %u flash writes, %u sector erases\n", seq, (unsigned)st.writes, (unsigned)st.erases);
+}
+
+void test_wear_is_even(void)
+{
+    for (int i = 0; i < 3000; ++i) {
+        TEST_ASSERT_EQUAL_INT(ESP_OK, append(i, 200 + i % 500));
+        if (i % 7 == 0) drain_all();
+    }
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (size_t s = 0; s < 8; ++s) {
+        uint32_t e = sim_part_erases(s);
+        if (e < lo) lo = e;
+        if (e > hi) hi = e;
+    }
+    printf("erases per sector: %u..%u\n", (unsigned)lo, (unsigned)hi);
+    TEST_ASSERT_TRUE(lo > 0);
+    TEST_ASSERT_TRUE(hi - lo <= 1);
+}
+
+void test_torn_write_at_every_step(void)
+{
+    // Appends across a sector boundary, then a drain: each flash write of it torn in turn
+    for (int tear = 0;; ++tear) {
+        sim_part_create(PART_FILE, LABEL, 4 * SECTOR);
+        memset(&s_sink, 0, sizeof(s_sink));
+        mount(1000, 1000);
+        for (int i = 0; i < 6; ++i) TEST_ASSERT_EQUAL_INT(ESP_OK, append(i, 900));
+
+        sim_part_tear_write(tear);
+        int appended = 6;
+        while (appended < 12 && append(appended, 900) == ESP_OK) appended++;
+        if (sim_part_powered()) drain_all();
+        if (sim_part_powered()) {
+            // Past the last write: done
+            TEST_ASSERT_TRUE(tear > 12);
+            break;
+        }
+        int sent = s_sink.count;
+
+        // After the reset: what was appended before the tear, in order, from the first
+        // entry not marked sent (the one whose mark was torn goes again)
+        reboot();
+        memset(&s_sink, 0, sizeof(s_sink));
+        drain_all();
+        int first = appended - s_sink.count;
+        TEST_ASSERT_TRUE(first == sent || first == sent - 1);
+        check_sent(first, s_sink.count);
+
+        // And the spool keeps working
+        TEST_ASSERT_EQUAL_INT(ESP_OK, append(100, 900));
+        memset(&s_sink, 0, sizeof(s_sink));
+        TEST_ASSERT_EQUAL_UINT32(1, drain_all());
+        check_sent(100, 1);
+    }
+}
+
+void test_drain_paced(void)
+{
+    mount(5, 5);
+    for (int i = 0; i < 30; ++i) TEST_ASSERT_EQUAL_INT(ESP_OK, append(i, 100));
+    TEST_ASSERT_EQUAL_UINT32(5, telemetry_spool_drain(0));        // the burst
+    TEST_ASSERT_EQUAL_UINT32(0, telemetry_spool_drain(100));
+    TEST_ASSERT_EQUAL_UINT32(1, telemetry_spool_drain(200));      // 5/s: one per 200 ms
+    TEST_ASSERT_EQUAL_UINT32(1, telemetry_spool_drain(400));
+    TEST_ASSERT_EQUAL_UINT32(5, telemetry_spool_drain(60000));    // no more than a burst
+    uint32_t sent = 12;
+    for (int64_t t = 60000; t <= 62000; t += 50) sent += telemetry_spool_drain(t);
+    TEST_ASSERT_EQUAL_UINT32(12 + 10, sent);
+    check_sent(0, sent);
+}
+
+void test_outbox_backpressure(void)
+{
+    s_sink.outbox_max = 350;
+    mount(1000, 1000);
+    for (int i = 0; i < 10; ++i) TEST_ASSERT_EQUAL_INT(ESP_OK, append(i, 100));
+    // Sends until the outbox reaches its limit
+    TEST_ASSERT_EQUAL_UINT32(4, drain_all());
+    TEST_ASSERT_EQUAL_UINT32(0, drain_all());
+    TEST_ASSERT_EQUAL_UINT32(2, stats().backpressure);
+
+    // Acknowledged: room again
+    s_sink.outbox = 0;
+    TEST_ASSERT_EQUAL_UINT32(4, drain_all());
+    // A failed publish stops the drain, the entry goes next time
+    s_sink.outbox = 0;
+    s_sink.fail = true;
+    TEST_ASSERT_EQUAL_UINT32(0, drain_all());
+    s_sink.fail = false;
+    TEST_ASSERT_EQUAL_UINT32(2, drain_all());
+    check_sent(0, 10);
+}
+
+void test_bad_input(void)
+{
+    uint8_t big[TELEMETRY_SPOOL_MAX_PAYLOAD + 1] = {0};
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_spool_append(0, big, 0));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_ARG, telemetry_spool_append(0, big, sizeof(big)));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, telemetry_spool_append(0, big, sizeof(big) - 1));
+
+    telemetry_spool_cfg_t c = cfg(1, 1);
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NOT_FOUND, telemetry_spool_open("nope", &c));
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_STATE, telemetry_spool_append(0, big, 1));
+    TEST_ASSERT_TRUE(telemetry_spool_empty());
+    sim_part_create(PART_FILE, LABEL, SECTOR);
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_INVALID_SIZE, telemetry_spool_open(LABEL, &c));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_order_kept_across_reboots);
+    RUN_TEST(test_full_ring_drops_oldest_sector);
+    RUN_TEST(test_flash_writes_bounded);
+    RUN_TEST(test_wear_is_even);
+    RUN_TEST(test_torn_write_at_every_step);
+    RUN_TEST(test_drain_paced);
+    RUN_TEST(test_outbox_backpressure);
+    RUN_TEST(test_bad_input);
+    return UNITY_END();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+
+// Time zone component: IANA names resolved through a built-in table of POSIX rules, parsed
+// once. UTC <-> local conversions are arithmetic on the parsed rule with the offset period
+// around the last query cached, so the common case is two comparisons. newlib only
+// understands POSIX TZ strings, so tz_set() is also the one place that sets TZ for libc
+// (log timestamps, strftime).
+//
+// Local time is expressed as seconds since 1970-01-01 00:00 local ("local seconds"); the
+// local day is local / 86400 and the time of day local % 86400.
+
+// Select the zone by IANA name (e.g. "Europe/Berlin") or POSIX TZ string. Unknown names
+// return ESP_ERR_NOT_FOUND and leave the current zone unchanged. The default is UTC.
+esp_err_t tz_set(const char *name);
+
+// POSIX rule of an IANA name in the built-in table, or NULL
+const char *tz_posix_for(const char *iana);
+
+// Offset from UTC in force at `utc`, in seconds east
+int32_t tz_offset(time_t utc);
+
+// UTC to local seconds
+int64_t tz_to_local(time_t utc);
+
+// Local seconds to UTC. A local time skipped by a DST jump maps to the jump; a local time
+// that occurs twice maps to the first occurrence.
+time_t tz_to_utc(int64_t local);
+
+// Broken-down local time of `utc` (tm_isdst set, tm_gmtoff not used)
+void tz_localtime(time_t utc, struct tm *out);
@@ -0,0 +1,178 @@
+#include "unity.h"
+#include "tz.h"
+#include "tz_rule.h"
+#include "tz_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host tests: the rule engine against glibc, which implements the same POSIX TZ rules.
+// Every built-in zone is checked on both sides of each change from 2020 to 2040, at
+// half-hour zones, negative DST (Dublin), changes at 24:00 and later, and the southern
+// hemisphere; local->UTC is checked for gaps and repeated hours.
+
+#define FROM_UTC    1577836800  // 2020-01-01
+#define TO_UTC      2208988800  // 2040-01-01
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static int64_t glibc_offset(time_t t)
+{
+    struct tm lt;
+    localtime_r(&t, &lt);
+    return lt.tm_gmtoff;
+}
+
+static void check_tm(time_t t)
+{
+    struct tm a, b;
+    tz_localtime(t, &a);
+    localtime_r(&t, &b);
+    TEST_ASSERT_EQUAL_INT(b.tm_year, a.tm_year);
+    TEST_ASSERT_EQUAL_INT(b.tm_mon, a.tm_mon);
+    TEST_ASSERT_EQUAL_INT(b.tm_mday, a.tm_mday);
+    TEST_ASSERT_EQUAL_INT(b.tm_hour, a.tm_hour);
+    TEST_ASSERT_EQUAL_INT(b.tm_min, a.tm_min);
+    TEST_ASSERT_EQUAL_INT(b.tm_sec, a.tm_sec);
+    TEST_ASSERT_EQUAL_INT(b.tm_wday, a.tm_wday);
+    TEST_ASSERT_EQUAL_INT(b.tm_yday, a.tm_yday);
+    TEST_ASSERT_EQUAL_INT(b.tm_isdst, a.tm_isdst);
+}
+
+void test_db_sorted_and_parsable(void)
+{
+    for (size_t i = 0; i < tz_db_len; ++i) {
+        if (i) TEST_ASSERT_TRUE(strcmp(tz_db[i - 1].name, tz_db[i].name) < 0);
+        tz_rule_t r;
+        TEST_ASSERT_EQUAL_INT(ESP_OK, tz_rule_parse(tz_db[i].posix, &r));
+        TEST_ASSERT_EQUAL_STRING(tz_db[i].posix, tz_posix_for(tz_db[i].name));
+    }
+    TEST_ASSERT_NULL(tz_posix_for("Mars/Olympus_Mons"));
+    TEST_ASSERT_NULL(tz_posix_for("europe/berlin"));
+}
+
+void test_rejects_bad_rules(void)
+{
+    const char *bad[] = {
+        "", "AB1", "CET", "CET-1CEST,M13.1.0,M10.5.0", "CET-1CEST,M3.6.0,M10.5.0",
+        "CET-1CEST,M3.5.7,M10.5.0", "CET-1CEST,M3.5.0", "<+05", "EST5EDT,J0,J300", ":Europe/Berlin",
+    };
+    tz_rule_t r;
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        TEST_ASSERT_TRUE(tz_rule_parse(bad[i], &r) != ESP_OK);
+    }
+    TEST_ASSERT_EQUAL_INT(ESP_ERR_NOT_FOUND, tz_set("Nowhere/Special"));
+}
+
+// Offsets and broken-down time on both sides of every change, plus a coarse sweep
+static void check_zone(const char *name)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set(name));
+    const char *posix = tz_posix_for(name) ? tz_posix_for(name) : name;
+    tz_rule_t r;
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_rule_parse(posix, &r));
+
+    for (time_t t = FROM_UTC; t < TO_UTC; t += 6 * 3600 + 17) {
+        TEST_ASSERT_EQUAL_INT64(glibc_offset(t), tz_offset(t));
+    }
+    int64_t t = FROM_UTC, to;
+    int changes = 0;
+    while (t < TO_UTC) {
+        tz_rule_offset(&r, t, NULL, &to);
+        if (to >= TO_UTC) break;
+        for (int64_t k = to - 2; k <= to + 1; ++k) {
+            TEST_ASSERT_EQUAL_INT64(glibc_offset((time_t)k), tz_offset((time_t)k));
+            check_tm((time_t)k);
+        }
+        t = to;
+        changes++;
+    }
+    TEST_ASSERT_EQUAL_INT(r.has_dst ? 40 : 0, changes);
+
+    // Local -> UTC: round trip everywhere; gaps map to the jump; repeats to the first one
+    int64_t jump = abs(r.dst_off - r.std_off);
+    for (int64_t u = FROM_UTC; u < FROM_UTC + 2 * 366 * 86400; u += 900) {
+        int64_t local = tz_to_local((time_t)u);
+        time_t back = tz_to_utc(local);
+        TEST_ASSERT_EQUAL_INT64(local, tz_to_local(back));
+        TEST_ASSERT_TRUE(back <= u);
+        if (back < u) TEST_ASSERT_EQUAL_INT64(jump, u - back);     // second occurrence of a repeated time
+    }
+    if (r.has_dst) {
+        tz_rule_offset(&r, FROM_UTC, NULL, &to);
+        for (int i = 0; i < 4; ++i) {
+            int64_t before = tz_to_local((time_t)(to - 1)) + 1, after = tz_to_local((time_t)to);
+            if (after > before) {
+                // Forward jump: every skipped local time maps to the change
+                for (int64_t l = before; l < after; l += 60) TEST_ASSERT_EQUAL_INT64(to, tz_to_utc(l));
+            } else {
+                // Repeat: the first occurrence is `jump` earlier than the second
+                TEST_ASSERT_EQUAL_INT64(to - jump, tz_to_utc(after));
+            }
+            tz_rule_offset(&r, to, NULL, &to);
+        }
+    }
+}
+
+void test_builtin_zones_match_libc(void)
+{
+    for (size_t i = 0; i < tz_db_len; ++i) check_zone(tz_db[i].name);
+}
+
+void test_rule_edge_forms_match_libc(void)
+{
+    const char *rules[] = {
+        "EST5EDT,J60,J300",                         // Julian, Feb 29 never counted
+        "EST5EDT,59,299/1:30",                      // zero-based day, Feb 29 counted
+        "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",         // negative change times
+        "<+13>-13<+14>,M9.5.0/3,M4.1.0/4",          // far east, southern hemisphere
+        "ABC+3:30DEF+2:15,M3.2.0/0,M10.5.6/25",    // odd offsets, change past midnight
+    };
+    for (unsigned i = 0; i < sizeof(rules) / sizeof(rules[0]); ++i) check_zone(rules[i]);
+}
+
+void test_zone_change_drops_cached_offset(void)
+{
+    const time_t july = 1720000000;     // 2024-07-03
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set("Europe/Paris"));
+    TEST_ASSERT_EQUAL_INT(7200, tz_offset(july));
+    // The third zone reuses Paris' slot; the period cached for Paris must not answer
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set("UTC"));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set("Asia/Seoul"));
+    TEST_ASSERT_EQUAL_INT(32400, tz_offset(july));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set("Europe/Paris"));
+    TEST_ASSERT_EQUAL_INT(7200, tz_offset(july));
+}
+
+void test_lookup_cost(void)
+{
+    TEST_ASSERT_EQUAL_INT(ESP_OK, tz_set("Europe/Berlin"));
+    const int n = 2000000;
+    volatile int64_t sink = 0;
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (int i = 0; i < n; ++i) sink += tz_to_local((time_t)(1718000000 + i * 7));
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    double ns_tz = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / n;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (int i = 0; i < n / 10; ++i) { struct tm lt; time_t t = 1718000000 + i * 7; localtime_r(&t, &lt); sink += lt.tm_hour; }
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    double ns_libc = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / (n / 10);
+    printf("UTC->local: tz %.1f ns, localtime_r %.1f ns\n", ns_tz, ns_libc);
+    (void)sink;
+    TEST_ASSERT_TRUE(ns_tz < ns_libc);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_db_sorted_and_parsable);
+    RUN_TEST(test_rejects_bad_rules);
+    RUN_TEST(test_builtin_zones_match_libc);
+    RUN_TEST(test_rule_edge_forms_match_libc);
+    RUN_TEST(test_zone_change_drops_cached_offset);
+    RUN_TEST(test_lookup_cost);
+    return UNITY_END();
+}
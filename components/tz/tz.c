@@ -0,0 +1,129 @@
+#include "tz.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "tz_rule.h"
+#include "tz_db.h"
+
+static const char *TAG = "tz";
+
+#define DAY_S 86400
+
+typedef struct {
+    tz_rule_t rule;
+    char posix[64];
+} tz_zone_t;
+
+// tz_set() fills the idle slot and publishes it; readers use whichever slot they loaded.
+// Zone changes come from provisioning, far apart, so a slot is never rewritten under a reader.
+static tz_zone_t s_zones[2];
+static _Atomic(const tz_zone_t *) s_zone;
+static int s_idle_slot;
+// Bumped by every tz_set(), after publishing the zone. The offset cache is keyed on it
+// rather than on the slot, which tz_set() reuses two zone changes later.
+static _Atomic uint32_t s_zone_gen;
+
+// Offset period around the last query. Guarded by a try-lock: a task that finds it taken
+// computes from the rule instead of waiting, so no task ever spins behind a preempted one.
+static struct {
+    uint32_t gen;           // s_zone_gen + 1 when the period was computed; 0: empty
+    int64_t from, to;
+    int32_t off;
+} s_cache;
+static atomic_flag s_cache_busy = ATOMIC_FLAG_INIT;
+
+static const tz_zone_t s_utc = { .posix = "UTC0" };
+
+static const tz_zone_t *current_zone(void)
+{
+    const tz_zone_t *z = atomic_load_explicit(&s_zone, memory_order_acquire);
+    return z ? z : &s_utc;
+}
+
+const char *tz_posix_for(const char *iana)
+{
+    return iana ? tz_db_lookup(iana) : NULL;
+}
+
+esp_err_t tz_set(const char *name)
+{
+    if (!name || !name[0]) return ESP_ERR_INVALID_ARG;
+    const char *posix = tz_db_lookup(name);
+    if (!posix) posix = name;   // maybe a POSIX string already
+    if (strlen(posix) >= sizeof(s_zones[0].posix)) return ESP_ERR_INVALID_SIZE;
+
+    const tz_zone_t *cur = current_zone();
+    if (strcmp(cur->posix, posix) == 0) return ESP_OK;
+
+    tz_zone_t *z = &s_zones[s_idle_slot];
+    if (tz_rule_parse(posix, &z->rule) != ESP_OK) {
+        ESP_LOGW(TAG, "Unknown time zone '%s'", name);
+        return ESP_ERR_NOT_FOUND;
+    }
+    strcpy(z->posix, posix);
+    atomic_store_explicit(&s_zone, z, memory_order_release);
+    atomic_fetch_add_explicit(&s_zone_gen, 1, memory_order_release);
+    s_idle_slot ^= 1;
+
+    // Keep libc in step for log timestamps and strftime(); this is the only tzset() caller
+    setenv("TZ", posix, 1);
+    tzset();
+    ESP_LOGI(TAG, "Time zone %s (%s)", name, posix);
+    return ESP_OK;
+}
+
+int32_t tz_offset(time_t utc)
+{
+    // Generation first: a zone loaded after it is at least as new, so a period cached
+    // under `gen` never belongs to an older zone
+    uint32_t gen = atomic_load_explicit(&s_zone_gen, memory_order_acquire) + 1;
+    const tz_zone_t *z = current_zone();
+    int64_t t = (int64_t)utc;
+    if (!atomic_flag_test_and_set_explicit(&s_cache_busy, memory_order_acquire)) {
+        int32_t off;
+        if (s_cache.gen == gen && t >= s_cache.from && t < s_cache.to) {
+            off = s_cache.off;
+        } else {
+            off = tz_rule_offset(&z->rule, t, &s_cache.from, &s_cache.to);
+            s_cache.off = off;
+            s_cache.gen = gen;
+        }
+        atomic_flag_clear_explicit(&s_cache_busy, memory_order_release);
+        return off;
+    }
+    return tz_rule_offset(&z->rule, t, NULL, NULL);
+}
+
+int64_t tz_to_local(time_t utc)
+{
+    return (int64_t)utc + tz_offset(utc);
+}
+
+time_t tz_to_utc(int64_t local)
+{
+    return (time_t)tz_rule_to_utc(&current_zone()->rule, local);
+}
+
+void tz_localtime(time_t utc, struct tm *out)
+{
+    int32_t off = tz_offset(utc);
+    int64_t local = (int64_t)utc + off;
+    int64_t days = tz_floor_div(local, DAY_S);
+    int64_t secs = local - days * DAY_S;
+    int64_t y;
+    unsigned m, d;
+    tz_civil_from_days(days, &y, &m, &d);
+    const tz_zone_t *z = current_zone();
+    memset(out, 0, sizeof(*out));
+    out->tm_year = (int)(y - 1900);
+    out->tm_mon = (int)m - 1;
+    out->tm_mday = (int)d;
+    out->tm_hour = (int)(secs / 3600);
+    out->tm_min = (int)(secs / 60 % 60);
+    out->tm_sec = (int)(secs % 60);
+    out->tm_wday = (int)((days % 7 + 11) % 7);
+    out->tm_yday = (int)(days - tz_days_from_civil(y, 1, 1));
+    out->tm_isdst = z->rule.has_dst && off == z->rule.dst_off;
+}
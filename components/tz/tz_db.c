@@ -0,0 +1,90 @@
+#include "tz_db.h"
+#include <string.h>
+
+// IANA name -> POSIX TZ rule, sorted by strcmp() on the name for tz_db_lookup().
+// Rules are the current ones from tzdata; historical changes are not represented.
+const tz_db_entry_t tz_db[] = {
+    { "Africa/Abidjan", "GMT0" },
+    { "Africa/Cairo", "EET-2EEST,M4.5.5/0,M10.5.4/24" },
+    { "Africa/Johannesburg", "SAST-2" },
+    { "Africa/Lagos", "WAT-1" },
+    { "Africa/Nairobi", "EAT-3" },
+    { "America/Anchorage", "AKST9AKDT,M3.2.0,M11.1.0" },
+    { "America/Argentina/Buenos_Aires", "<-03>3" },
+    { "America/Bogota", "<-05>5" },
+    { "America/Chicago", "CST6CDT,M3.2.0,M11.1.0" },
+    { "America/Denver", "MST7MDT,M3.2.0,M11.1.0" },
+    { "America/Halifax", "AST4ADT,M3.2.0,M11.1.0" },
+    { "America/Los_Angeles", "PST8PDT,M3.2.0,M11.1.0" },
+    { "America/Mexico_City", "CST6" },
+    { "America/New_York", "EST5EDT,M3.2.0,M11.1.0" },
+    { "America/Phoenix", "MST7" },
+    { "America/Santiago", "<-04>4<-03>,M9.1.6/24,M4.1.6/24" },
+    { "America/Sao_Paulo", "<-03>3" },
+    { "America/St_Johns", "NST3:30NDT,M3.2.0,M11.1.0" },
+    { "America/Toronto", "EST5EDT,M3.2.0,M11.1.0" },
+    { "America/Vancouver", "PST8PDT,M3.2.0,M11.1.0" },
+    { "Asia/Bangkok", "<+07>-7" },
+    { "Asia/Dubai", "<+04>-4" },
+    { "Asia/Hong_Kong", "HKT-8" },
+    { "Asia/Jakarta", "WIB-7" },
+    { "Asia/Jerusalem", "IST-2IDT,M3.4.4/26,M10.5.0" },
+    { "Asia/Karachi", "PKT-5" },
+    { "Asia/Kathmandu", "<+0545>-5:45" },
+    { "Asia/Kolkata", "IST-5:30" },
+    { "Asia/Manila", "PST-8" },
+    { "Asia/Seoul", "KST-9" },
+    { "Asia/Shanghai", "CST-8" },
+    { "Asia/Singapore", "<+08>-8" },
+    { "Asia/Taipei", "CST-8" },
+    { "Asia/Tehran", "<+0330>-3:30" },
+    { "Asia/Tokyo", "JST-9" },
+    { "Atlantic/Azores", "<-01>1<+00>,M3.5.0/0,M10.5.0/1" },
+    { "Atlantic/Reykjavik", "GMT0" },
+    { "Australia/Adelaide", "ACST-9:30ACDT,M10.1.0,M4.1.0/3" },
+    { "Australia/Brisbane", "AEST-10" },
+    { "Australia/Darwin", "ACST-9:30" },
+    { "Australia/Lord_Howe", "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0" },
+    { "Australia/Melbourne", "AEST-10AEDT,M10.1.0,M4.1.0/3" },
+    { "Australia/Perth", "AWST-8" },
+    { "Australia/Sydney", "AEST-10AEDT,M10.1.0,M4.1.0/3" },
+    { "Etc/UTC", "UTC0" },
+    { "Europe/Amsterdam", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Athens", "EET-2EEST,M3.5.0/3,M10.5.0/4" },
+    { "Europe/Berlin", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Brussels", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Dublin", "IST-1GMT0,M10.5.0,M3.5.0/1" },
+    { "Europe/Helsinki", "EET-2EEST,M3.5.0/3,M10.5.0/4" },
+    { "Europe/Istanbul", "<+03>-3" },
+    { "Europe/Kyiv", "EET-2EEST,M3.5.0/3,M10.5.0/4" },
+    { "Europe/Lisbon", "WET0WEST,M3.5.0/1,M10.5.0" },
+    { "Europe/London", "GMT0BST,M3.5.0/1,M10.5.0" },
+    { "Europe/Madrid", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Moscow", "MSK-3" },
+    { "Europe/Oslo", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Paris", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Prague", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Rome", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Stockholm", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Vienna", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Warsaw", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Zurich", "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Pacific/Auckland", "NZST-12NZDT,M9.5.0,M4.1.0/3" },
+    { "Pacific/Chatham", "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45" },
+    { "Pacific/Honolulu", "HST10" },
+    { "UTC", "UTC0" },
+};
+
+const size_t tz_db_len = sizeof(tz_db) / sizeof(tz_db[0]);
+
+const char *tz_db_lookup(const char *name)
+{
+    size_t lo = 0, hi = tz_db_len;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int c = strcmp(tz_db[mid].name, name);
+        if (c == 0) return tz_db[mid].posix;
+        if (c < 0) lo = mid + 1; else hi = mid;
+    }
+    return NULL;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+// Built-in IANA zone table (internal to the tz component); const, so it stays in flash.
+
+typedef struct {
+    const char *name;   // IANA name, e.g. "Europe/Berlin"
+    const char *posix;  // POSIX TZ rule, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"
+} tz_db_entry_t;
+
+extern const tz_db_entry_t tz_db[];
+extern const size_t tz_db_len;
+
+// Binary search by exact name; NULL if the zone is not in the table
+const char *tz_db_lookup(const char *name);
@@ -0,0 +1,211 @@
+#include "tz_rule.h"
+#include <ctype.h>
+#include <string.h>
+
+#define DAY_S       86400
+#define DEFAULT_AT  (2 * 3600)
+
+int64_t tz_days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+void tz_civil_from_days(int64_t days, int64_t *y, unsigned *m, unsigned *d)
+{
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = (unsigned)(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int64_t)yoe + era * 400 + (*m <= 2);
+}
+
+static bool is_leap(int64_t y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+// ---- parsing ----
+
+static const char *parse_name(const char *p)
+{
+    if (*p == '<') {
+        const char *q = strchr(p, '>');
+        return (q && q - p >= 4) ? q + 1 : NULL;
+    }
+    const char *q = p;
+    while (isalpha((unsigned char)*q)) q++;
+    return q - p >= 3 ? q : NULL;
+}
+
+// [+-]hh[:mm[:ss]] with hh up to 167 (extended POSIX)
+static const char *parse_hms(const char *p, int32_t *out)
+{
+    int sign = 1;
+    if (*p == '+' || *p == '-') sign = (*p++ == '-') ? -1 : 1;
+    if (!isdigit((unsigned char)*p)) return NULL;
+    int32_t v[3] = {0, 0, 0};
+    for (int i = 0; i < 3; ++i) {
+        if (i && *p != ':') break;
+        if (i) p++;
+        if (!isdigit((unsigned char)*p)) return NULL;
+        int32_t n = 0;
+        while (isdigit((unsigned char)*p)) n = n * 10 + (*p++ - '0');
+        v[i] = n;
+    }
+    if (v[0] > 167 || v[1] > 59 || v[2] > 59) return NULL;
+    *out = sign * (v[0] * 3600 + v[1] * 60 + v[2]);
+    return p;
+}
+
+static const char *parse_uint(const char *p, unsigned *out)
+{
+    if (!isdigit((unsigned char)*p)) return NULL;
+    unsigned n = 0;
+    while (isdigit((unsigned char)*p)) n = n * 10 + (unsigned)(*p++ - '0');
+    *out = n;
+    return p;
+}
+
+static const char *parse_when(const char *p, tz_when_t *w)
+{
+    unsigned a, b, c;
+    memset(w, 0, sizeof(*w));
+    if (*p == 'M') {
+        if (!(p = parse_uint(p + 1, &a)) || *p++ != '.' || !(p = parse_uint(p, &b)) ||
+            *p++ != '.' || !(p = parse_uint(p, &c))) return NULL;
+        if (a < 1 || a > 12 || b < 1 || b > 5 || c > 6) return NULL;
+        *w = (tz_when_t){ .form = 'M', .month = (uint8_t)a, .week = (uint8_t)b, .wday = (uint8_t)c };
+    } else if (*p == 'J') {
+        if (!(p = parse_uint(p + 1, &a)) || a < 1 || a > 365) return NULL;
+        *w = (tz_when_t){ .form = 'J', .day = (uint16_t)a };
+    } else {
+        if (!(p = parse_uint(p, &a)) || a > 365) return NULL;
+        *w = (tz_when_t){ .form = 'D', .day = (uint16_t)a };
+    }
+    w->secs = DEFAULT_AT;
+    if (*p == '/') p = parse_hms(p + 1, &w->secs);
+    return p;
+}
+
+esp_err_t tz_rule_parse(const char *posix, tz_rule_t *out)
+{
+    if (!posix || !out) return ESP_ERR_INVALID_ARG;
+    const char *p = posix;
+    if (*p == ':') return ESP_ERR_NOT_SUPPORTED;    // implementation-defined form
+    tz_rule_t r = {0};
+    int32_t off;
+
+    if (!(p = parse_name(p)) || !(p = parse_hms(p, &off))) return ESP_ERR_INVALID_ARG;
+    r.std_off = -off;
+    if (*p == '\0') {
+        *out = r;
+        return ESP_OK;
+    }
+
+    if (!(p = parse_name(p))) return ESP_ERR_INVALID_ARG;
+    r.has_dst = true;
+    r.dst_off = r.std_off + 3600;
+    if (*p && *p != ',') {
+        if (!(p = parse_hms(p, &off))) return ESP_ERR_INVALID_ARG;
+        r.dst_off = -off;
+    }
+    if (*p == '\0') {
+        // No rule given: the POSIX default is implementation-defined; assume the current US rule
+        p = ",M3.2.0,M11.1.0";
+    }
+    if (*p++ != ',' || !(p = parse_when(p, &r.start)) || *p++ != ',' || !(p = parse_when(p, &r.end)) || *p) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = r;
+    return ESP_OK;
+}
+
+// ---- transitions ----
+
+// Local midnight (days since epoch) of the day `w` names in `year`
+static int64_t when_day(const tz_when_t *w, int64_t year)
+{
+    int64_t jan1 = tz_days_from_civil(year, 1, 1);
+    switch (w->form) {
+    case 'J':
+        // 1-365, February 29 is never counted
+        return jan1 + w->day - 1 + (is_leap(year) && w->day >= 60);
+    case 'D':
+        return jan1 + w->day;
+    default: {
+        static const uint8_t mdays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        int64_t first = tz_days_from_civil(year, w->month, 1);
+        int first_wday = (int)((first % 7 + 11) % 7);     // 1970-01-01 was a Thursday
+        int64_t day = first + (w->wday - first_wday + 7) % 7 + 7 * (w->week - 1);
+        int len = mdays[w->month - 1] + (w->month == 2 && is_leap(year));
+        while (day >= first + len) day -= 7;
+        return day;
+    }
+    }
+}
+
+int32_t tz_rule_offset(const tz_rule_t *r, int64_t utc, int64_t *from, int64_t *to)
+{
+    if (!r->has_dst) {
+        if (from) *from = INT64_MIN;
+        if (to) *to = INT64_MAX;
+        return r->std_off;
+    }
+    int64_t y;
+    unsigned m, d;
+    tz_civil_from_days(tz_floor_div(utc + r->std_off, DAY_S), &y, &m, &d);
+
+    // Changes of the previous, current and next year, in time order
+    int64_t at[6];
+    int32_t after[6];
+    int n = 0;
+    for (int64_t yy = y - 1; yy <= y + 1; ++yy) {
+        int64_t s = when_day(&r->start, yy) * DAY_S + r->start.secs - r->std_off;
+        int64_t e = when_day(&r->end, yy) * DAY_S + r->end.secs - r->dst_off;
+        at[n] = s; after[n++] = r->dst_off;
+        at[n] = e; after[n++] = r->std_off;
+    }
+    // A change late in one year may land after an early change of the next
+    for (int i = 1; i < n; ++i) {
+        for (int j = i; j > 0 && at[j - 1] > at[j]; --j) {
+            int64_t ta = at[j]; at[j] = at[j - 1]; at[j - 1] = ta;
+            int32_t tb = after[j]; after[j] = after[j - 1]; after[j - 1] = tb;
+        }
+    }
+    int i = n - 1;
+    while (i >= 0 && at[i] > utc) i--;
+    if (i < 0) {
+        // Before the first change considered: the state the first change leaves
+        if (from) *from = INT64_MIN;
+        if (to) *to = at[0];
+        return after[0] == r->dst_off ? r->std_off : r->dst_off;
+    }
+    if (from) *from = at[i];
+    if (to) *to = i + 1 < n ? at[i + 1] : INT64_MAX;
+    return after[i];
+}
+
+int64_t tz_rule_to_utc(const tz_rule_t *r, int64_t local)
+{
+    int64_t u_std = local - r->std_off;
+    if (!r->has_dst) return u_std;
+    int64_t u_dst = local - r->dst_off;
+    bool std_ok = tz_rule_offset(r, u_std, NULL, NULL) == r->std_off;
+    bool dst_ok = tz_rule_offset(r, u_dst, NULL, NULL) == r->dst_off;
+    if (std_ok && dst_ok) return u_std < u_dst ? u_std : u_dst;
+    if (std_ok) return u_std;
+    if (dst_ok) return u_dst;
+    // Skipped by a forward jump: the jump is where the later candidate's offset starts
+    int64_t from;
+    tz_rule_offset(r, u_std > u_dst ? u_std : u_dst, &from, NULL);
+    return from;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// POSIX TZ rule engine (internal to the tz component).
+// A rule is parsed once; offsets and local<->UTC conversions are then integer arithmetic on
+// the rule, with no libc time functions and no global state.
+
+typedef struct {
+    char form;          // 'M' (Mm.w.d), 'J' (Jn, 1-365, no Feb 29) or 'D' (n, 0-365)
+    uint8_t month;      // 'M': 1-12
+    uint8_t week;       // 'M': 1-5, 5 = last
+    uint8_t wday;       // 'M': 0 = Sunday
+    uint16_t day;       // 'J', 'D'
+    int32_t secs;       // local time of day of the change (may be negative or > 24 h)
+} tz_when_t;
+
+typedef struct {
+    int32_t std_off;    // seconds east of UTC (POSIX offsets count west)
+    int32_t dst_off;
+    bool has_dst;
+    tz_when_t start;    // standard -> daylight, in standard local time
+    tz_when_t end;      // daylight -> standard, in daylight local time
+} tz_rule_t;
+
+// Parse a POSIX TZ string, e.g. "CET-1CEST,M3.5.0,M10.5.0/3" or "<+0545>-5:45"
+esp_err_t tz_rule_parse(const char *posix, tz_rule_t *out);
+
+// Offset in force at `utc`. `from`/`to` (optional) receive the UTC span [from, to) over which
+// that offset stays in force, so callers can cache it.
+int32_t tz_rule_offset(const tz_rule_t *r, int64_t utc, int64_t *from, int64_t *to);
+
+// Local seconds (since 1970-01-01 00:00 local) to UTC. A local time skipped by a forward jump
+// maps to the jump; a repeated local time maps to its first occurrence.
+int64_t tz_rule_to_utc(const tz_rule_t *r, int64_t local);
+
+// Proleptic Gregorian calendar helpers (days since 1970-01-01)
+int64_t tz_days_from_civil(int64_t y, unsigned m, unsigned d);
+void tz_civil_from_days(int64_t days, int64_t *y, unsigned *m, unsigned *d);
+
+static inline int64_t tz_floor_div(int64_t a, int64_t b)
+{
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
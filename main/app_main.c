@@ -21,25 +21,16 @@
 static const char *TAG = "app_main";
 
 // Global IPC handles
-QueueHandle_t g_cmd_queue = NULL;
 EventGroupHandle_t g_net_state_event_group = NULL;
 
-// Reconcile callback to apply schedule state
-static void apply_schedule_cb(bool on, time_t ts, void *arg)
+// Schedule transitions missed while the device was off go to the audit log, one record
+// each. schedule_task applies only the resulting state.
+static void on_missed_schedule_events(const schedule_missed_event_t *ev, size_t count, void *arg)
 {
-    // Preserve pump, only set light according to schedule default
-    control_state_t st = {0};
-    uint8_t pump_pct = 0;
-    if (control_get_state(&st) == ESP_OK) pump_pct = st.pump_pct;
-    control_cmd_t cmd = {
-        .actor = ACTOR_SCHEDULE,
-        .ts = ts,
-        .seq = 0,
-        .light_pct = on ? CONFIG_SCHEDULE_LIGHT_ON_PCT : 0,
-        .pump_pct = pump_pct,
-        .ramp_ms = 500,
-    };
-    xQueueSend(g_cmd_queue, &cmd, 0);
+    for (size_t i = 0; i < count; ++i) {
+        telemetry_audit_event(ACTOR_SCHEDULE, TELEMETRY_AUDIT_SCHED_MISSED, ev[i].channel, ev[i].pct,
+                              (int32_t)ev[i].at);
+    }
 }
 
 // BLE provisioning callback: receives ssid, psk, tz
@@ -61,11 +52,8 @@ static void on_ble_provisioned(const char *ssid, const char *psk, const char *tz
         if (tz && tz[0]) {
             strncpy(s.tz, tz, sizeof(s.tz)-1);
             s.tz[sizeof(s.tz)-1] = '\0';
+            // schedule_save() applies the zone and recompiles the timeline
             schedule_save(&s);
-            // apply TZ immediately for local schedule computations
-            setenv("TZ", s.tz, 1);
-            tzset();
-            ESP_LOGI(TAG, "applied TZ=%s", s.tz);
         }
     }
 }
@@ -88,7 +76,6 @@ void app_main(void)
     esp_ota_mark_app_valid_cancel_rollback();
 
     // Create global IPC primitives
-    g_cmd_queue = xQueueCreate(8, sizeof(control_cmd_t));
     g_net_state_event_group = xEventGroupCreate();
 
     // Safety first: init safety/wdt
@@ -100,16 +87,12 @@ void app_main(void)
     // Control (sets safe defaults OFF)
     if (control_init() != ESP_OK) ESP_LOGW(TAG, "control_init failed");
 
-    // Schedule (loads defaults if none)
+    // Schedule (loads defaults if none). Missed-transition reconciliation runs in
+    // schedule_task after the first time sync.
+    schedule_register_missed_callback(on_missed_schedule_events, NULL);
     if (schedule_init() != ESP_OK) ESP_LOGW(TAG, "schedule_init failed");
     schedule_t s;
     schedule_load(&s);
-    // Apply stored timezone (if any) so schedule computations use local wall clock
-    if (s.tz[0]) {
-        setenv("TZ", s.tz, 1);
-        tzset();
-        ESP_LOGI(TAG, "applied stored TZ=%s", s.tz);
-    }
     ESP_LOGI(TAG, "schedule: ON %02d:%02d OFF %02d:%02d TZ=%s", s.on_hour, s.on_min, s.off_hour, s.off_min, s.tz);
 
     // Register BLE provisioning callback to save credentials and tz
@@ -132,8 +115,6 @@ void app_main(void)
     // OTA
     ota_init();
 
-    // Optionally reconcile missed schedule events since last boot; for demo we use boot time-60s as last seen
-    // Wait for time to be synced before reconciling schedule
     ESP_LOGI(TAG, "Waiting for Wi‑Fi + time sync to start AWS MQTT...");
     EventBits_t bits = xEventGroupWaitBits(g_net_state_event_group, NET_BIT_WIFI_UP | NET_BIT_TIME_SYNCED, pdFALSE, pdTRUE, pdMS_TO_TICKS(30000));
     if ((bits & (NET_BIT_WIFI_UP | NET_BIT_TIME_SYNCED)) == (NET_BIT_WIFI_UP | NET_BIT_TIME_SYNCED)) {
@@ -143,19 +124,6 @@ void app_main(void)
     } else {
         ESP_LOGW(TAG, "AWS start skipped (no Wi‑Fi/time). Will rely on later retries if implemented.");
     }
-    ESP_LOGI(TAG, "Waiting for time sync...");
-    bits = xEventGroupWaitBits(g_net_state_event_group, NET_BIT_TIME_SYNCED, pdFALSE, pdTRUE, pdMS_TO_TICKS(30000));
-    if (bits & NET_BIT_TIME_SYNCED) {
-        time_t now_utc = time(NULL);
-        // A more robust implementation would store the last shutdown time in NVS
-        time_t last_seen = now_utc - 60;
-        ESP_LOGI(TAG, "Time synced. Reconciling schedule...");
-    schedule_reconcile(last_seen, now_utc, &s, apply_schedule_cb, NULL);
-    } else {
-        ESP_LOGW(TAG, "Time not synced after 30s. Skipping schedule reconcile.");
-    }
-
-
     ESP_LOGI(TAG, "init complete; application running");
 
     vTaskDelete(NULL);
@@ -6,22 +6,37 @@
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "net.h" // Reuse NET_BIT_* definitions
+#include "control.h" // CONTROL_MAX_CHANNELS
 
 // This header defines the Inter-Process Communication (IPC) primitives
 // used across the application, as specified in Prompts.md.
 
-// --- Command Queue ---
-// Used to send commands to the control_task.
-typedef struct {
+// --- Command Mailbox ---
+// Commands for the control_task are posted with control_post_cmd() (control.h).
+// The mailbox keeps only the latest pending command per actor.
+typedef struct control_cmd {
     uint32_t actor;     // Identifier for the command source (e.g., ble, schedule, net)
     uint64_t ts;        // Timestamp of command creation
     uint32_t seq;       // Sequence number
-    uint8_t light_pct;  // Light intensity (0-100)
-    uint8_t pump_pct;   // Pump pressure (0-100)
-    uint32_t ramp_ms;   // Duration of the ramp in milliseconds
+    uint8_t channels;   // CMD_CH_* mask: which of the values below to apply
+    uint8_t profile;    // control_profile_t ramp shape; 0 = Kconfig default
+    union {
+        uint8_t pct[CONTROL_MAX_CHANNELS]; // Per-channel level (0-100), used if CMD_CH(n) is set
+        struct {
+            uint8_t light_pct;  // Light intensity (0-100), alias for pct[0]
+            uint8_t pump_pct;   // Pump pressure (0-100), alias for pct[1]
+        };
+    };
+    uint32_t ramp_ms;   // Duration of the ramp in milliseconds (all channels in the mask)
 } control_cmd_t;
 
-extern QueueHandle_t g_cmd_queue;
+// Channel mask bits for control_cmd_t.channels. Channels not in the mask keep their
+// current target (and any fade in progress), so producers never need to read state first.
+// All channels in one command start their fades together.
+#define CMD_CH(n)        (1u << (n))
+#define CMD_CH_LIGHT     CMD_CH(0)
+#define CMD_CH_PUMP      CMD_CH(1)
+#define CMD_CH_ALL       ((1u << CONTROL_MAX_CHANNELS) - 1)
 
 
 // --- Network State Event Group ---
@@ -35,6 +50,8 @@ extern EventGroupHandle_t g_net_state_event_group;
 #define ACTOR_BLE        1
 #define ACTOR_SCHEDULE   2
 #define ACTOR_SAFETY     3
+#define ACTOR_CLOUD      4
+#define ACTOR_COUNT      5
 
 
 // --- Other Queues (to be implemented) ---